@@ -0,0 +1,142 @@
+// Coroutine API benchmark: allocations per request for the callback, future and awaitable forms of
+// HttpClient::request against a local keep-alive server, and allocations per event for
+// EventStream compared with a plain stream callback.
+//
+// Usage: agent_sdk_bench_awaitable [requests] [events]
+
+#include <asio.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "../tests/test_http_server.hpp"
+#include "bench_common.hpp"
+#include "llm/event_stream.hpp"
+#include "net/http_client.hpp"
+
+using namespace agent;
+using namespace agent::net;
+
+// ---- Provider that replays a fixed number of text deltas synchronously on the io_context ----
+
+class BurstProvider : public llm::Provider {
+ public:
+  BurstProvider(asio::io_context& io_ctx, int events) : io_ctx_(io_ctx), events_(events) {}
+
+  std::string name() const override {
+    return "burst";
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return {};
+  }
+
+  std::future<llm::LlmResponse> complete(const llm::LlmRequest&) override {
+    return {};
+  }
+
+  void stream(const llm::LlmRequest&, llm::StreamCallback callback, std::function<void()> on_complete) override {
+    asio::post(io_ctx_, [this, callback = std::move(callback), on_complete = std::move(on_complete)]() {
+      llm::StreamEvent event = llm::TextDelta{"token "};
+      for (int i = 0; i < events_; ++i) callback(event);
+      on_complete();
+    });
+  }
+
+  void cancel() override {}
+
+ private:
+  asio::io_context& io_ctx_;
+  int events_;
+};
+
+int main(int argc, char** argv) {
+  int requests = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int events = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+  // Keep-alive server answering every request; its own allocations are not counted
+  TestHttpServer server([](const std::string&, const std::string&) {
+    bench::exclude_this_thread();
+    return TestHttpServer::response(200, "{\"type\":\"pong\"}", "Content-Type: application/json\r\n");
+  });
+
+  asio::io_context io_ctx;
+  auto work = asio::make_work_guard(io_ctx);
+  std::thread io_thread([&io_ctx]() {
+    io_ctx.run();
+  });
+
+  std::printf("%d requests, %d stream events\n", requests, events);
+  {
+    HttpClient client(io_ctx);
+    HttpOptions options;
+    auto url = server.url("/v1/messages");
+
+    // Warm up the pooled connection
+    client.request(url, options).get();
+
+    auto callback = bench::measure([&]() {
+      for (int i = 0; i < requests; ++i) {
+        std::promise<void> done;
+        client.request(url, options, [&done](HttpResponse) {
+          done.set_value();
+        });
+        done.get_future().get();
+      }
+    });
+    auto future = bench::measure([&]() {
+      for (int i = 0; i < requests; ++i) client.request(url, options).get();
+    });
+    // One coroutine issuing every request: no thread blocks between requests
+    auto awaitable = bench::measure([&]() {
+      asio::co_spawn(
+          io_ctx,
+          [&]() -> asio::awaitable<void> {
+            for (int i = 0; i < requests; ++i) co_await client.async_request(url, options);
+          },
+          asio::use_future)
+          .get();
+    });
+
+    bench::report("request (callback)", callback, requests, "req");
+    bench::report("request (future)", future, requests, "req");
+    bench::report("async_request (co_await)", awaitable, requests, "req");
+  }
+
+  {
+    BurstProvider provider(io_ctx, events);
+    auto callback = bench::measure([&]() {
+      std::promise<void> done;
+      uint64_t received = 0;
+      provider.stream(
+          llm::LlmRequest{},
+          [&received](const llm::StreamEvent&) {
+            ++received;
+          },
+          [&done]() {
+            done.set_value();
+          });
+      done.get_future().get();
+    });
+    auto generator = bench::measure([&]() {
+      asio::co_spawn(
+          io_ctx,
+          [&]() -> asio::awaitable<void> {
+            auto stream = llm::EventStream::open(provider, llm::LlmRequest{});
+            while (co_await stream->next()) {
+            }
+          },
+          asio::use_future)
+          .get();
+    });
+
+    bench::report("stream (callback)", callback, events, "event");
+    bench::report("EventStream (co_await)", generator, events, "event");
+  }
+
+  work.reset();
+  io_thread.join();
+  return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+// Shared benchmark helpers: process-wide allocation counting and timed measurements.
+// Replaces the global operator new/delete, so include it from exactly one translation unit per
+// benchmark executable (each benchmark is a single source file).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+namespace agent::bench {
+
+inline std::atomic<uint64_t> g_allocations{0};
+inline std::atomic<uint64_t> g_allocated_bytes{0};
+inline thread_local bool t_uncounted = false;
+
+// Allocations (and bytes requested) since process start, on every counted thread
+inline uint64_t allocations() {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+inline uint64_t allocated_bytes() {
+  return g_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+// Stop counting the calling thread's allocations, e.g. from a local server's handler so the
+// server's work does not show up in the client's numbers
+inline void exclude_this_thread() {
+  t_uncounted = true;
+}
+
+struct Measurement {
+  double seconds = 0;
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;  // Bytes requested from operator new
+};
+
+inline double cpu_seconds() {
+  return double(std::clock()) / CLOCKS_PER_SEC;
+}
+
+// Wall-clock time and allocations of one call to body
+template <typename Body>
+Measurement measure(Body&& body) {
+  auto allocations_before = allocations();
+  auto bytes_before = allocated_bytes();
+  auto begin = std::chrono::steady_clock::now();
+  body();
+  Measurement m;
+  m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  m.allocations = allocations() - allocations_before;
+  m.bytes = allocated_bytes() - bytes_before;
+  return m;
+}
+
+// As measure(), with the process's CPU time instead of wall-clock time
+template <typename Body>
+Measurement measure_cpu(Body&& body) {
+  auto allocations_before = allocations();
+  auto bytes_before = allocated_bytes();
+  double begin = cpu_seconds();
+  body();
+  Measurement m;
+  m.seconds = cpu_seconds() - begin;
+  m.allocations = allocations() - allocations_before;
+  m.bytes = allocated_bytes() - bytes_before;
+  return m;
+}
+
+inline Measurement& operator+=(Measurement& total, const Measurement& m) {
+  total.seconds += m.seconds;
+  total.allocations += m.allocations;
+  total.bytes += m.bytes;
+  return total;
+}
+
+// One line of time and allocations per unit of work, e.g. report("request", m, requests, "req")
+inline void report(const char* name, const Measurement& m, double count, const char* unit) {
+  std::printf("%-28s %10.3f us/%s  %10.2f allocs/%s  %10.0f bytes/%s\n", name, m.seconds * 1e6 / count, unit, double(m.allocations) / count, unit,
+              double(m.bytes) / count, unit);
+}
+
+}  // namespace agent::bench
+
+void* operator new(size_t size) {
+  if (!agent::bench::t_uncounted) {
+    agent::bench::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    agent::bench::g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
@@ -0,0 +1,58 @@
+// Context copy benchmark: a long session with big tool outputs, and the copies of its history that each
+// agent step made (run_loop and process_stream each took the context by value, and the request holds
+// its own). Messages share their parts copy-on-write, so these copies no longer duplicate the outputs.
+//
+// Usage: agent_sdk_bench_context_copy [turns] [output_bytes] [steps]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "llm/provider.hpp"
+
+using namespace agent;
+using namespace agent::llm;
+
+// ---- Synthetic history: per turn an assistant tool call and a user message with its output ----
+
+static std::vector<Message> synthetic_history(int turns, size_t output_bytes) {
+  std::vector<Message> history{Message::user("Refactor the modules under src/ and keep the tests green.")};
+  std::string output;
+  while (output.size() < output_bytes) output += "  " + std::to_string(output.size()) + "\tint value = compute(\"x\");\n";
+  for (int t = 0; t < turns; ++t) {
+    auto id = "call_" + std::to_string(t);
+    Message call = Message::assistant("Let me look at file " + std::to_string(t) + ".");
+    call.add_tool_call(id, "read", {{"filePath", "src/module_" + std::to_string(t) + ".cpp"}, {"limit", 200}});
+    history.push_back(std::move(call));
+    Message result(Role::User, "");
+    result.add_tool_result(id, "read", output);
+    history.push_back(std::move(result));
+  }
+  return history;
+}
+
+int main(int argc, char** argv) {
+  int turns = argc > 1 ? std::atoi(argv[1]) : 200;
+  size_t output_bytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50000;
+  int steps = argc > 3 ? std::atoi(argv[3]) : 50;
+
+  auto history = synthetic_history(turns, output_bytes);
+  std::printf("%zu messages, %zu bytes of tool output each, %d steps\n", history.size(), output_bytes, steps);
+
+  size_t sink = 0;
+  auto m = bench::measure([&]() {
+    for (int s = 0; s < steps; ++s) {
+      // run_loop's look at the context, then the request built from it
+      std::vector<Message> context(history.begin(), history.end());
+      LlmRequest request;
+      request.messages = std::vector<Message>(history.begin(), history.end());
+      sink += context.size() + request.messages.back().parts().size();
+    }
+  });
+
+  std::printf("context copies: %8.3f ms/step  %10.0f allocs/step  %10.2f MB allocated/step  (%zu)\n", m.seconds * 1e3 / steps,
+              double(m.allocations) / steps, double(m.bytes) / steps / 1e6, sink);
+  return 0;
+}
@@ -0,0 +1,154 @@
+// Streaming body benchmark: replays a recorded-style Anthropic SSE stream from a local server
+// (one chunked-encoding chunk per event) and compares request_stream with request_stream_view.
+//
+// Usage: agent_sdk_bench_http_stream [events] [iterations]
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "../tests/test_http_server.hpp"
+#include "bench_common.hpp"
+#include "net/http_client.hpp"
+
+using namespace agent;
+using namespace agent::net;
+
+// ---- Recorded stream ----
+
+static std::string make_sse_body(int events) {
+  std::string body;
+  auto add_chunk = [&body](const std::string& event) {
+    char size[16];
+    std::snprintf(size, sizeof(size), "%zx\r\n", event.size());
+    body += size;
+    body += event;
+    body += "\r\n";
+  };
+
+  add_chunk(
+      "event: message_start\ndata: {\"type\":\"message_start\",\"message\":{\"id\":\"msg_bench\",\"type\":\"message\",\"role\":\"assistant\","
+      "\"model\":\"claude-sonnet-4\",\"content\":[],\"usage\":{\"input_tokens\":1024,\"output_tokens\":1}}}\n\n");
+  add_chunk(
+      "event: content_block_start\ndata: {\"type\":\"content_block_start\",\"index\":0,"
+      "\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n");
+  for (int i = 0; i < events; ++i) {
+    add_chunk("event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"token " +
+              std::to_string(i) + " \"}}\n\n");
+  }
+  add_chunk("event: content_block_stop\ndata: {\"type\":\"content_block_stop\",\"index\":0}\n\n");
+  add_chunk("event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n");
+  body += "0\r\n\r\n";
+  return "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nTransfer-Encoding: chunked\r\n\r\n" + body;
+}
+
+// ---- Benchmark ----
+
+struct RunResult {
+  double seconds = 0;
+  uint64_t bytes = 0;
+  uint64_t callbacks = 0;
+  uint64_t allocations = 0;       // Whole request, including connection checkout and header parsing
+  uint64_t body_allocations = 0;  // Between the first body callback and completion
+  uint64_t first_body_allocation = 0;
+};
+
+template <typename Start>
+static RunResult run(Start start) {
+  std::promise<std::string> done;
+  RunResult result;
+  auto begin = std::chrono::steady_clock::now();
+  auto allocations_before = bench::allocations();
+  start(result, [&done](int, const std::string& error) {
+    done.set_value(error);
+  });
+  auto error = done.get_future().get();
+  auto allocations_after = bench::allocations();
+  result.allocations = allocations_after - allocations_before;
+  result.body_allocations = result.callbacks ? allocations_after - result.first_body_allocation : 0;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  if (!error.empty()) std::fprintf(stderr, "stream failed: %s\n", error.c_str());
+  return result;
+}
+
+static void accumulate(RunResult& total, const RunResult& r) {
+  total.seconds += r.seconds;
+  total.bytes += r.bytes;
+  total.callbacks += r.callbacks;
+  total.allocations += r.allocations;
+  total.body_allocations += r.body_allocations;
+}
+
+static void report(const char* name, const RunResult& total, int iterations) {
+  std::printf("%-20s %8.1f MB/s  %8.0f callbacks/iter  %8.0f allocs/iter  %8.0f body allocs/iter  %6.3f body allocs/callback\n", name,
+              total.bytes / total.seconds / (1024.0 * 1024.0), double(total.callbacks) / iterations, double(total.allocations) / iterations,
+              double(total.body_allocations) / iterations, total.callbacks ? double(total.body_allocations) / total.callbacks : 0.0);
+}
+
+int main(int argc, char** argv) {
+  int events = argc > 1 ? std::atoi(argv[1]) : 50000;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  auto response = make_sse_body(events);
+  std::printf("SSE body: %d events, %.1f MB, %d iterations\n", events, response.size() / (1024.0 * 1024.0), iterations);
+  // Every request on a connection gets the same response; the server's own allocations are not counted
+  TestHttpServer server([&response](const std::string&, const std::string&) {
+    bench::exclude_this_thread();
+    return response;
+  });
+  auto url = server.url("/v1/messages");
+
+  asio::io_context io_ctx;
+  auto work = asio::make_work_guard(io_ctx);
+  std::thread io_thread([&io_ctx]() {
+    io_ctx.run();
+  });
+
+  {
+    HttpClient client(io_ctx);
+    HttpOptions options;
+    options.method = "POST";
+    options.body = "{}";
+
+    auto string_stream = [&](RunResult& result, auto on_complete) {
+      client.request_stream(
+          url, options,
+          [&result](const std::string& chunk) {
+            if (result.callbacks++ == 0) result.first_body_allocation = bench::allocations();
+            result.bytes += chunk.size();
+          },
+          on_complete);
+    };
+    auto view_stream = [&](RunResult& result, auto on_complete) {
+      client.request_stream_view(
+          url, options,
+          [&result](std::string_view chunk) {
+            if (result.callbacks++ == 0) result.first_body_allocation = bench::allocations();
+            result.bytes += chunk.size();
+          },
+          on_complete);
+    };
+
+    // Warm up the pooled connection and buffers
+    run(string_stream);
+    run(view_stream);
+
+    RunResult string_total;
+    RunResult view_total;
+    for (int i = 0; i < iterations; ++i) {
+      accumulate(string_total, run(string_stream));
+      accumulate(view_total, run(view_stream));
+    }
+
+    report("request_stream", string_total, iterations);
+    report("request_stream_view", view_total, iterations);
+  }
+
+  work.reset();
+  io_thread.join();
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Request serialization benchmark: a synthetic agent session grows one turn at a time and every step
+// builds the request body for the whole history, as each model call does. Compares converting the
+// history to a JSON DOM and dumping it (what the providers did) with splicing cached message fragments.
+//
+// Usage: agent_sdk_bench_request_serialize [turns] [output_bytes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "llm/provider.hpp"
+
+using namespace agent;
+using namespace agent::llm;
+
+// ---- Synthetic session: user prompt, then assistant tool call + tool result per turn ----
+
+static std::vector<Message> synthetic_turn(int turn, size_t output_bytes) {
+  std::vector<Message> turn_messages;
+  auto id = "call_" + std::to_string(turn);
+  Message call = Message::assistant("Let me look at file " + std::to_string(turn) + ".");
+  call.add_tool_call(id, "read", {{"filePath", "src/module_" + std::to_string(turn) + ".cpp"}, {"limit", 200}});
+  turn_messages.push_back(std::move(call));
+
+  std::string output;
+  while (output.size() < output_bytes) output += "  " + std::to_string(output.size()) + "\tint value = compute(\"x\");\n";
+  Message result(Role::User, "");
+  result.add_tool_result(id, "read", output);
+  turn_messages.push_back(std::move(result));
+  return turn_messages;
+}
+
+template <typename Build>
+static void run(const char* name, int turns, size_t output_bytes, Build build) {
+  std::vector<Message> history{Message::user("Refactor the modules under src/ and keep the tests green.")};
+  size_t bytes = 0;
+  bench::Measurement total;
+  for (int turn = 0; turn < turns; ++turn) {
+    for (auto& m : synthetic_turn(turn, output_bytes)) history.push_back(std::move(m));
+
+    // The session hands each call a copy of the history
+    LlmRequest request;
+    request.model = "bench-model";
+    request.system_prompt = "You are a coding agent.";
+    request.messages = history;
+
+    total += bench::measure([&]() {
+      bytes += build(request).size();
+    });
+  }
+  std::printf("%-28s %9.3f ms/step  %10.1f allocs/step  (%zu messages, %.1f MB total)\n", name, total.seconds * 1e3 / turns,
+              double(total.allocations) / turns, history.size(), bytes / 1e6);
+}
+
+int main(int argc, char** argv) {
+  int turns = argc > 1 ? std::atoi(argv[1]) : 150;
+  size_t output_bytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4096;
+  std::printf("%d turns, %zu-byte tool outputs\n", turns, output_bytes);
+
+  run("anthropic json dump", turns, output_bytes, [](const LlmRequest& r) { return r.to_anthropic_format().dump(); });
+  run("anthropic spliced", turns, output_bytes, [](const LlmRequest& r) { return r.to_anthropic_body(); });
+  run("openai json dump", turns, output_bytes, [](const LlmRequest& r) { return r.to_openai_format().dump(); });
+  run("openai spliced", turns, output_bytes, [](const LlmRequest& r) { return r.to_openai_body(); });
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Many concurrent sessions, each mostly waiting: every model call and tool completes after a delay on
+// the io_context. With prompt() each running session needs a thread of its own to drive it; with
+// prompt_async all of them are driven by the io_context's threads. Reports wall time and the most
+// threads alive at once.
+//
+// Usage: agent_sdk_bench_session_concurrency [sessions] [turns] [latency_ms] [io_threads]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "session/session.hpp"
+#include "tool/tool.hpp"
+
+using namespace agent;
+using namespace agent::llm;
+using Clock = std::chrono::steady_clock;
+
+static std::chrono::milliseconds g_latency{20};
+
+// Answers after the latency: a tool call when the last message is the prompt, else a short answer
+class LatencyProvider : public Provider {
+ public:
+  explicit LatencyProvider(asio::io_context& io_ctx) : io_ctx_(io_ctx) {}
+
+  std::string name() const override {
+    return "latency";
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return {};
+  }
+
+  std::future<LlmResponse> complete(const LlmRequest&) override {
+    std::promise<LlmResponse> promise;
+    promise.set_value({});
+    return promise.get_future();
+  }
+
+  void stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) override {
+    bool answered = !request.messages.empty() && !request.messages.back().tool_results().empty();
+    auto id = "call_" + std::to_string(request.messages.size());
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, g_latency);
+    timer->async_wait([timer, answered, id, turn = request.messages.size(), callback, on_complete](const std::error_code&) {
+      if (answered) {
+        callback(TextDelta{"done"});
+        callback(FinishStep{FinishReason::Stop, {100, 1}});
+      } else {
+        callback(TextDelta{"Let me check."});
+        callback(ToolCallComplete{id, "bench_wait", {{"turn", turn}}});
+        callback(FinishStep{FinishReason::ToolCalls, {100, 10}});
+      }
+      on_complete();
+    });
+  }
+
+  void cancel() override {}
+
+ private:
+  asio::io_context& io_ctx_;
+};
+
+// Completes after the latency, on an io_context timer
+class BenchWaitTool : public SimpleTool {
+ public:
+  explicit BenchWaitTool(asio::io_context& io_ctx) : SimpleTool("bench_wait", "Waits, then returns"), io_ctx_(io_ctx) {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    auto promise = std::make_shared<std::promise<ToolResult>>();
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, g_latency);
+    timer->async_wait([timer, promise](const std::error_code&) {
+      promise->set_value(ToolResult::success("waited"));
+    });
+    return promise->get_future();
+  }
+
+ private:
+  asio::io_context& io_ctx_;
+};
+
+static int thread_count() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("Threads:")) return std::atoi(line.c_str() + 8);
+  }
+  return 0;
+}
+
+static void run(const char* name, bool async, int sessions, int turns, int io_threads) {
+  asio::io_context io_ctx;
+  auto work = asio::make_work_guard(io_ctx);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < io_threads; ++i) {
+    threads.emplace_back([&io_ctx]() {
+      io_ctx.run();
+    });
+  }
+
+  ToolRegistry::instance().register_tool(std::make_shared<BenchWaitTool>(io_ctx));
+  Config config;
+  config.default_model = "latency-model";
+  config.providers["ollama"] = ProviderConfig{};
+  auto agent = config.get_or_create_agent(AgentType::Build);
+  agent.permissions["bench_wait"] = Permission::Allow;
+  config.agents[agent.id] = agent;
+
+  std::vector<std::shared_ptr<Session>> all;
+  for (int s = 0; s < sessions; ++s) all.push_back(Session::create(io_ctx, config, AgentType::Build));
+
+  // Samples the thread count while the sessions run
+  std::atomic<bool> running{true};
+  std::atomic<int> peak_threads{0};
+  std::thread sampler([&]() {
+    while (running) {
+      peak_threads = std::max(peak_threads.load(), thread_count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+
+  auto begin = Clock::now();
+  if (async) {
+    // Each completion starts the session's next turn
+    std::mutex mutex;
+    std::condition_variable cv;
+    int finished = 0;
+    for (auto& session : all) {
+      auto remaining = std::make_shared<int>(turns);
+      session->on_complete([&, weak = std::weak_ptr<Session>(session), remaining](FinishReason) {
+        if (--*remaining > 0) {
+          // The next turn, once this run has ended
+          asio::post(io_ctx, [weak, remaining]() {
+            if (auto s = weak.lock()) s->prompt_async("turn " + std::to_string(*remaining));
+          });
+          return;
+        }
+        std::lock_guard lock(mutex);
+        if (++finished == sessions) cv.notify_one();
+      });
+      session->prompt_async("turn 0");
+    }
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [&]() {
+      return finished == sessions;
+    });
+  } else {
+    std::vector<std::thread> drivers;
+    for (auto& session : all) {
+      drivers.emplace_back([&session, turns]() {
+        for (int t = 0; t < turns; ++t) session->prompt("turn " + std::to_string(t));
+      });
+    }
+    for (auto& driver : drivers) driver.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  running = false;
+  sampler.join();
+
+  size_t messages = 0;
+  for (auto& session : all) messages += session->messages().size();
+  all.clear();
+  work.reset();
+  for (auto& thread : threads) thread.join();
+  ToolRegistry::instance().unregister_tool("bench_wait");
+
+  // Per turn: two model calls and a tool, each one latency
+  double ideal = 3.0 * turns * g_latency.count() / 1e3;
+  std::printf("%-28s %8.3f s (ideal %.3f s)  %10.0f turns/s  %6d threads at peak  (%zu messages)\n", name, seconds, ideal, sessions * turns / seconds,
+              peak_threads.load(), messages);
+}
+
+int main(int argc, char** argv) {
+  int sessions = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int turns = argc > 2 ? std::atoi(argv[2]) : 3;
+  g_latency = std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 20);
+  int io_threads = argc > 4 ? std::atoi(argv[4]) : 2;
+
+  ProviderFactory::instance().factory("ollama");  // Registers the built-ins before overriding
+  ProviderFactory::instance().register_provider("ollama", [](const ProviderConfig&, asio::io_context& io_ctx) {
+    return std::make_shared<LatencyProvider>(io_ctx);
+  });
+
+  std::printf("%d sessions, %d turns each, %lld ms per model call and tool, %d io threads\n", sessions, turns,
+              static_cast<long long>(g_latency.count()), io_threads);
+  run("prompt (thread per session)", false, sessions, turns, io_threads);
+  run("prompt_async", true, sessions, turns, io_threads);
+  return 0;
+}
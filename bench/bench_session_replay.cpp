@@ -0,0 +1,128 @@
+// End-to-end session benchmark without network access: a synthetic cassette of agent turns (streamed
+// text, then a tool call) is replayed through Session::prompt by a ReplayProvider registered in place of
+// the ollama provider. At maximum speed the time per turn is the session's own overhead (request
+// building, stream handling, tool dispatch, bookkeeping); with injected latency it shows how much of
+// that overhead still adds to a realistic stream. Allocations are counted per turn, and the resident set
+// is reported after each run.
+//
+// Usage: agent_sdk_bench_session_replay [turns] [tokens_per_turn] [latency_us]
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "bench_common.hpp"
+#include "llm/replay.hpp"
+#include "session/session.hpp"
+#include "tool/tool.hpp"
+
+using namespace agent;
+using namespace agent::llm;
+
+static double resident_mb() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  statm >> pages >> resident;
+  return double(resident) * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+class BenchEchoTool : public SimpleTool {
+ public:
+  BenchEchoTool() : SimpleTool("bench_echo", "Returns a fixed block of text") {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    std::promise<ToolResult> promise;
+    promise.set_value(ToolResult::success(std::string(1000, 'x')));
+    return promise.get_future();
+  }
+};
+
+// Each prompt is one turn: tokens text deltas and a tool call, then a short answer after the result
+static std::shared_ptr<ReplayCassette> synthetic_cassette(int turns, int tokens) {
+  auto cassette = std::make_shared<ReplayCassette>();
+  for (int t = 0; t < turns; ++t) {
+    ReplayRecording call;
+    for (int i = 0; i < tokens; ++i) call.events.push_back({std::chrono::microseconds(i), TextDelta{" token" + std::to_string(i)}});
+    auto id = "call_" + std::to_string(t);
+    call.events.push_back({std::chrono::microseconds(tokens), ToolCallDelta{id, "bench_echo", ""}});
+    call.events.push_back({std::chrono::microseconds(tokens), ToolCallComplete{id, "bench_echo", {{"turn", t}}}});
+    call.events.push_back({std::chrono::microseconds(tokens), FinishStep{FinishReason::ToolCalls, {1000, tokens}}});
+    cassette->add(std::move(call));
+
+    ReplayRecording answer;
+    answer.events.push_back({std::chrono::microseconds(0), TextDelta{"done"}});
+    answer.events.push_back({std::chrono::microseconds(0), FinishStep{FinishReason::Stop, {1000, 1}}});
+    cassette->add(std::move(answer));
+  }
+  return cassette;
+}
+
+static void run(const char* name, int turns, int tokens, ReplayOptions options) {
+  auto ollama = ProviderFactory::instance().factory("ollama");
+  auto cassette = synthetic_cassette(turns, tokens);
+  cassette->rewind();
+  register_replay_provider("ollama", cassette, options);
+
+  asio::io_context io_ctx;
+  auto work = asio::make_work_guard(io_ctx);
+  std::thread io_thread([&io_ctx]() {
+    io_ctx.run();
+  });
+
+  Config config;
+  config.default_model = "replay-model";
+  config.providers["ollama"] = ProviderConfig{};
+  auto agent = config.get_or_create_agent(AgentType::Build);
+  agent.permissions["bench_echo"] = Permission::Allow;
+  config.agents[agent.id] = agent;
+
+  auto session = Session::create(io_ctx, config, AgentType::Build);
+  auto m = bench::measure([&]() {
+    for (int t = 0; t < turns; ++t) session->prompt("turn " + std::to_string(t));
+  });
+
+  work.reset();
+  io_thread.join();
+  ProviderFactory::instance().register_provider("ollama", ollama);
+
+  // Two model calls per turn: tokens + 3 events, then 2 for the answer
+  double events = double(turns) * (tokens + 5);
+  double streamed = 0;  // Injected delays alone
+  if (options.pacing == ReplayPacing::Injected) {
+    streamed = turns * (2 * options.first_token_latency.count() + options.event_interval.count() * (tokens + 3)) / 1e6;
+  }
+  std::printf("%-20s %8.3f ms/turn  %8.3f ms/turn over the stream  %10.0f events/s  %8.0f allocs/turn  %7.1f MB RSS  (%zu messages)\n", name,
+              m.seconds * 1e3 / turns, (m.seconds - streamed) * 1e3 / turns, events / m.seconds, double(m.allocations) / turns, resident_mb(),
+              session->messages().size());
+}
+
+int main(int argc, char** argv) {
+  int turns = argc > 1 ? std::atoi(argv[1]) : 50;
+  int tokens = argc > 2 ? std::atoi(argv[2]) : 400;
+  int latency_us = argc > 3 ? std::atoi(argv[3]) : 200;
+
+  ToolRegistry::instance().register_tool(std::make_shared<BenchEchoTool>());
+
+  std::printf("%d turns, %d tokens per turn\n", turns, tokens);
+
+  ReplayOptions fast;
+  fast.pacing = ReplayPacing::MaxSpeed;
+  run("max speed", turns, tokens, fast);
+
+  ReplayOptions injected;
+  injected.pacing = ReplayPacing::Injected;
+  injected.first_token_latency = std::chrono::microseconds(latency_us * 10);
+  injected.event_interval = std::chrono::microseconds(latency_us);
+  run("injected latency", turns, tokens, injected);
+  return 0;
+}
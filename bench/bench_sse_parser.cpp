@@ -0,0 +1,123 @@
+// SSE framing benchmark: parses recorded-style Anthropic and OpenAI streams with SseParser and with the
+// substr-based buffering the providers used before, delivered in network-sized chunks.
+//
+// Usage: agent_sdk_bench_sse_parser [events] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "net/sse_parser.hpp"
+
+using namespace agent::net;
+
+// ---- Recorded streams ----
+
+static std::string anthropic_stream(int events) {
+  std::string body =
+      "event: message_start\ndata: {\"type\":\"message_start\",\"message\":{\"id\":\"msg_bench\",\"type\":\"message\",\"role\":\"assistant\","
+      "\"model\":\"claude-sonnet-4\",\"content\":[],\"usage\":{\"input_tokens\":1024,\"output_tokens\":1}}}\n\n"
+      "event: content_block_start\ndata: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n";
+  for (int i = 0; i < events; ++i) {
+    body += "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"token " +
+            std::to_string(i) + " \"}}\n\n";
+    if (i % 100 == 99) body += "event: ping\ndata: {\"type\": \"ping\"}\n\n";
+  }
+  body += "event: content_block_stop\ndata: {\"type\":\"content_block_stop\",\"index\":0}\n\n";
+  body += "event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n";
+  return body;
+}
+
+static std::string openai_stream(int events) {
+  std::string body;
+  for (int i = 0; i < events; ++i) {
+    body += "data: {\"id\":\"chatcmpl-bench\",\"object\":\"chat.completion.chunk\",\"created\":1700000000,\"model\":\"gpt-4o\","
+            "\"choices\":[{\"index\":0,\"delta\":{\"content\":\"token " +
+            std::to_string(i) + " \"},\"finish_reason\":null}]}\r\n\r\n";
+  }
+  body += "data: [DONE]\r\n\r\n";
+  return body;
+}
+
+// Network-sized pieces (TLS records and TCP reads rarely line up with events)
+static std::vector<std::string_view> split(const std::string& body, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<size_t> size(64, 4096);
+  std::vector<std::string_view> chunks;
+  for (size_t pos = 0; pos < body.size();) {
+    size_t n = std::min(size(rng), body.size() - pos);
+    chunks.emplace_back(body.data() + pos, n);
+    pos += n;
+  }
+  return chunks;
+}
+
+// ---- Parsers ----
+
+// The providers' previous framing: append, find the blank line, substr out the block, reassign the rest
+static size_t parse_legacy(const std::vector<std::string_view>& chunks) {
+  size_t dispatched = 0;
+  std::string sse_buffer;
+  for (auto chunk : chunks) {
+    sse_buffer.append(chunk);
+    size_t pos;
+    while ((pos = sse_buffer.find("\n\n")) != std::string::npos || (pos = sse_buffer.find("\r\n\r\n")) != std::string::npos) {
+      std::string event_block = sse_buffer.substr(0, pos);
+      size_t skip = (sse_buffer.substr(pos, 4) == "\r\n\r\n") ? 4 : 2;
+      sse_buffer = sse_buffer.substr(pos + skip);
+
+      std::istringstream stream(event_block);
+      std::string line;
+      std::string event_data;
+      while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.starts_with("data: ")) {
+          if (!event_data.empty()) event_data += "\n";
+          event_data += line.substr(6);
+        }
+      }
+      if (!event_data.empty()) dispatched++;
+    }
+  }
+  return dispatched;
+}
+
+static size_t parse_incremental(const std::vector<std::string_view>& chunks) {
+  size_t dispatched = 0;
+  SseParser parser([&dispatched](const SseEventView& event) {
+    dispatched += !event.data.empty();
+  });
+  for (auto chunk : chunks) parser.feed(chunk);
+  return dispatched;
+}
+
+// ---- Benchmark ----
+
+template <typename Parse>
+static void run(const char* name, const std::string& body, const std::vector<std::string_view>& chunks, int iterations, Parse parse) {
+  parse(chunks);  // Warm up
+  size_t events = 0;
+  auto m = agent::bench::measure([&]() {
+    for (int i = 0; i < iterations; ++i) events += parse(chunks);
+  });
+
+  std::printf("%-32s %9.1f MB/s  %7.2f M events/s  %8.2f allocs/event\n", name, body.size() * double(iterations) / m.seconds / (1024.0 * 1024.0),
+              events / m.seconds / 1e6, double(m.allocations) / events);
+}
+
+int main(int argc, char** argv) {
+  int events = argc > 1 ? std::atoi(argv[1]) : 20000;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  for (auto [name, body] : {std::pair{"anthropic", anthropic_stream(events)}, std::pair{"openai", openai_stream(events)}}) {
+    auto chunks = split(body, 42);
+    std::printf("%s: %.1f MB in %zu chunks, %d iterations\n", name, body.size() / (1024.0 * 1024.0), chunks.size(), iterations);
+    run("  substr buffering (previous)", body, chunks, iterations, parse_legacy);
+    run("  SseParser", body, chunks, iterations, parse_incremental);
+  }
+  return 0;
+}
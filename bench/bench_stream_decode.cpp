@@ -0,0 +1,123 @@
+// Delta decoding benchmark: decodes recorded-style Anthropic and OpenAI stream events with a full DOM parse
+// (what the providers did for every event) and with the field-selective decoders, on one thread.
+// Throughput is tokens (delta events) per second of CPU time, i.e. per core.
+//
+// Usage: agent_sdk_bench_stream_decode [events] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "bench_common.hpp"
+#include "llm/stream_decoder.hpp"
+
+using namespace agent::llm;
+using json = nlohmann::json;
+
+// ---- Recorded events (SSE data payloads) ----
+
+static std::vector<std::string> anthropic_events(int events) {
+  std::vector<std::string> data;
+  for (int i = 0; i < events; ++i) {
+    // Every tenth token is a tool-argument fragment
+    std::string delta = i % 10 == 9 ? "{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"path\\\": \\\"src/" + std::to_string(i) + "\"}"
+                                    : "{\"type\":\"text_delta\",\"text\":\" token\\n" + std::to_string(i) + "\"}";
+    data.push_back("{\"type\":\"content_block_delta\",\"index\":" + std::string(i % 10 == 9 ? "1" : "0") + ",\"delta\":" + delta + "}");
+    if (i % 100 == 99) data.push_back("{\"type\": \"ping\"}");
+  }
+  return data;
+}
+
+static std::vector<std::string> openai_events(int events) {
+  std::vector<std::string> data;
+  for (int i = 0; i < events; ++i) {
+    std::string delta = i % 10 == 9 ? "{\"tool_calls\":[{\"index\":0,\"function\":{\"arguments\":\"\\\"src/" + std::to_string(i) + "\"}}]}"
+                                    : "{\"content\":\" token " + std::to_string(i) + "\"}";
+    data.push_back(
+        "{\"id\":\"chatcmpl-bench\",\"object\":\"chat.completion.chunk\",\"created\":1700000000,\"model\":\"gpt-4o\","
+        "\"system_fingerprint\":\"fp_bench\",\"choices\":[{\"index\":0,\"delta\":" +
+        delta + ",\"logprobs\":null,\"finish_reason\":null}]}");
+  }
+  return data;
+}
+
+// ---- Decoders (each returns the bytes of text it extracted, so nothing is optimized away) ----
+
+// The providers' previous per-event work: parse to a DOM, then read the delta fields
+static size_t anthropic_dom(const std::string& data) {
+  auto j = json::parse(data);
+  std::string type = j.value("type", "");
+  if (type != "content_block_delta") return 0;
+  auto& delta = j["delta"];
+  std::string delta_type = delta.value("type", "");
+  if (delta_type == "text_delta") return delta["text"].get<std::string>().size();
+  if (delta_type == "input_json_delta") return delta["partial_json"].get<std::string>().size();
+  return 0;
+}
+
+static size_t anthropic_fast(const std::string& data) {
+  static AnthropicDelta delta;
+  if (!decode_anthropic_delta(data, delta)) return anthropic_dom(data);
+  return delta.kind == AnthropicDelta::Kind::Ping ? 0 : delta.text.size();
+}
+
+static size_t openai_dom(const std::string& data) {
+  auto j = json::parse(data);
+  if (j.contains("error") || (j.contains("usage") && !j["usage"].is_null())) return 0;
+  if (!j.contains("choices") || j["choices"].empty()) return 0;
+  auto& delta = j["choices"][0]["delta"];
+  size_t bytes = 0;
+  if (delta.contains("content") && !delta["content"].is_null()) bytes += delta["content"].get<std::string>().size();
+  if (delta.contains("tool_calls")) {
+    for (const auto& tc : delta["tool_calls"]) {
+      if (tc.contains("function") && tc["function"].contains("arguments")) bytes += tc["function"]["arguments"].get<std::string>().size();
+    }
+  }
+  return bytes;
+}
+
+static size_t openai_fast(const std::string& data) {
+  static OpenAIDelta delta;
+  if (!decode_openai_delta(data, delta)) return openai_dom(data);
+  size_t bytes = delta.content ? delta.content->size() : 0;
+  for (const auto& tc : delta.tool_arguments) bytes += tc.arguments.size();
+  return bytes;
+}
+
+// ---- Benchmark ----
+
+template <typename Decode>
+static double run(const char* name, const std::vector<std::string>& events, int iterations, Decode decode) {
+  for (const auto& data : events) decode(data);  // Warm up (and size the reused buffers)
+  size_t bytes = 0;
+  auto m = agent::bench::measure_cpu([&]() {
+    for (int i = 0; i < iterations; ++i) {
+      for (const auto& data : events) bytes += decode(data);
+    }
+  });
+  double total = double(events.size()) * iterations;
+
+  std::printf("%-24s %8.2f M tokens/s/core  %7.1f ns/event  %8.2f allocs/event  (%zu bytes)\n", name, total / m.seconds / 1e6,
+              m.seconds * 1e9 / total, double(m.allocations) / total, bytes);
+  return total / m.seconds;
+}
+
+int main(int argc, char** argv) {
+  int events = argc > 1 ? std::atoi(argv[1]) : 100000;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  auto anthropic = anthropic_events(events);
+  std::printf("anthropic: %zu events, %d iterations\n", anthropic.size(), iterations);
+  double dom = run("  json::parse (previous)", anthropic, iterations, anthropic_dom);
+  double fast = run("  decode_anthropic_delta", anthropic, iterations, anthropic_fast);
+  std::printf("  speedup %.1fx\n", fast / dom);
+
+  auto openai = openai_events(events);
+  std::printf("openai: %zu events, %d iterations\n", openai.size(), iterations);
+  dom = run("  json::parse (previous)", openai, iterations, openai_dom);
+  fast = run("  decode_openai_delta", openai, iterations, openai_fast);
+  std::printf("  speedup %.1fx\n", fast / dom);
+  return 0;
+}
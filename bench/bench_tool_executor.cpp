@@ -0,0 +1,102 @@
+// Bursts of parallel tool calls: several sessions each get a response asking for many greps at once,
+// every call is started right away and the session waits for all of them. Tools run on the shared
+// ToolExecutor, so the burst queues on a thread per core instead of starting a thread per call.
+// Reports wall time, the most threads alive at once, and the executor's queue metrics.
+//
+// Usage: agent_sdk_bench_tool_executor [sessions] [calls_per_session] [files] [lines_per_file]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tool/builtin/builtins.hpp"
+
+using namespace agent;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static int thread_count() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("Threads:")) return std::atoi(line.c_str() + 8);
+  }
+  return 0;
+}
+
+// files source-like files spread over a few directories
+static fs::path make_tree(int files, int lines) {
+  auto root = fs::temp_directory_path() / "agent_bench_tool_executor";
+  fs::remove_all(root);
+  for (int f = 0; f < files; ++f) {
+    auto dir = root / ("dir" + std::to_string(f % 16));
+    fs::create_directories(dir);
+    std::ofstream out(dir / ("file" + std::to_string(f) + ".cpp"));
+    for (int l = 0; l < lines; ++l) {
+      out << "  int value_" << l << " = compute(" << f << ", " << l << ");  // " << (l % 97 == 0 ? "TODO revisit" : "steady") << "\n";
+    }
+  }
+  return root;
+}
+
+int main(int argc, char** argv) {
+  int sessions = argc > 1 ? std::atoi(argv[1]) : 8;
+  int calls = argc > 2 ? std::atoi(argv[2]) : 20;
+  int files = argc > 3 ? std::atoi(argv[3]) : 400;
+  int lines = argc > 4 ? std::atoi(argv[4]) : 200;
+
+  auto root = make_tree(files, lines);
+  tools::GrepTool grep;
+  const char* patterns[] = {"TODO", "value_1[0-9]", "compute\\(3", "steady$", "no_such_symbol"};
+
+  std::atomic<bool> running{true};
+  std::atomic<int> peak_threads{0};
+  std::thread sampler([&]() {
+    while (running) {
+      peak_threads = std::max(peak_threads.load(), thread_count());
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  auto begin = Clock::now();
+  std::vector<std::thread> drivers;
+  std::atomic<size_t> output_bytes{0};
+  for (int s = 0; s < sessions; ++s) {
+    drivers.emplace_back([&, s]() {
+      ToolContext ctx;
+      ctx.session_id = "bench-" + std::to_string(s);
+      ctx.working_dir = root.string();
+      std::vector<std::future<ToolResult>> results;
+      for (int c = 0; c < calls; ++c) {
+        json args = {{"pattern", patterns[(s + c) % 5]}, {"path", (root / ("dir" + std::to_string(c % 16))).string()}};
+        results.push_back(grep.execute(args, ctx));
+      }
+      for (auto& result : results) output_bytes += result.get().output.size();
+    });
+  }
+  for (auto& driver : drivers) driver.join();
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+  running = false;
+  sampler.join();
+
+  std::printf("%d sessions x %d parallel greps over %d files of %d lines, %u hardware threads\n", sessions, calls, files, lines,
+              std::thread::hardware_concurrency());
+  std::printf("%8.3f s  %8.0f calls/s  %5d threads at peak  (%zu bytes of output)\n", seconds, sessions * calls / seconds, peak_threads.load(),
+              output_bytes.load());
+
+  auto stats = ToolExecutor::instance().stats();
+  for (auto lane : {ToolLane::Compute, ToolLane::Blocking}) {
+    const auto& s = stats[lane];
+    std::printf("%-9s %3zu threads  %6llu tasks  %6llu stolen  %5zu max queued  %8.2f ms average wait  %8.2f ms max wait\n",
+                lane == ToolLane::Compute ? "compute" : "blocking", s.threads, static_cast<unsigned long long>(s.completed),
+                static_cast<unsigned long long>(s.stolen), s.max_queued, s.average_wait().count() / 1e3, s.max_wait.count() / 1e3);
+  }
+  fs::remove_all(root);
+  return 0;
+}
@@ -1,15 +1,21 @@
 // Agent initialization
 #include "agent.hpp"
 
+#include <cstdlib>
 #include <filesystem>
 
+#include "core/tokenizer.hpp"
 #include "core/version.hpp"
 #include "llm/anthropic.hpp"
+#include "llm/replay.hpp"
+#include "llm/trace.hpp"
 #include "log/log.h"
 #include "mcp/client.hpp"
+#include "net/tls_session_cache.hpp"
 #include "plugin/qwen/qwen_oauth.hpp"
 #include "skill/skill.hpp"
 #include "tool/builtin/builtins.hpp"
+#include "tool/executor.hpp"
 
 namespace agent {
 
@@ -36,6 +42,38 @@ void init() {
   // Discover skills from current working directory and standard locations
   auto cwd = std::filesystem::current_path();
   auto config = Config::load_default();
+
+  // Record provider traffic when asked to (view with agent_sdk_trace_view)
+  if (const char* trace_file = std::getenv("AGENT_TRACE_FILE"); trace_file && *trace_file) {
+    llm::TraceRecorder::instance().start(trace_file);
+  } else if (config.trace_file) {
+    llm::TraceRecorder::instance().start(*config.trace_file);
+  }
+
+  // Per-tool concurrency limits
+  for (const auto& [tool_id, limit] : config.tools.limits) {
+    ToolExecutor::instance().set_tool_limit(tool_id, limit);
+  }
+
+  // Exact token counts when a vocabulary is configured
+  if (!config.context.tokenizer_file.empty()) {
+    Tokenizer::instance().load(config.context.tokenizer_file);
+  }
+
+  // Record provider streams to a cassette, or answer from one offline
+  if (config.replay.mode == "record" || config.replay.mode == "replay") {
+    llm::ReplayOptions options;
+    options.record = config.replay.mode == "record";
+    options.pacing = config.replay.pacing == "max"        ? llm::ReplayPacing::MaxSpeed
+                     : config.replay.pacing == "injected" ? llm::ReplayPacing::Injected
+                                                          : llm::ReplayPacing::Recorded;
+    options.first_token_latency = std::chrono::milliseconds(config.replay.first_token_ms);
+    options.event_interval = std::chrono::milliseconds(config.replay.event_interval_ms);
+    options.jitter = std::chrono::milliseconds(config.replay.jitter_ms);
+    auto cassette = llm::ReplayCassette::open(config.replay.cassette);
+    for (const char* name : {"anthropic", "openai", "ollama"}) llm::register_replay_provider(name, cassette, options);
+  }
+
   skill::SkillRegistry::instance().discover(cwd, config.skill_paths);
 
   // Initialize MCP servers from config
@@ -49,6 +87,9 @@ void init() {
 
 void shutdown() {
   mcp::McpManager::instance().disconnect_all();
+  llm::TraceRecorder::instance().stop();
+  llm::ReplayCassette::save_open();
+  net::TlsSessionCache::instance().flush();
 }
 
 std::string version() {
@@ -3,6 +3,7 @@
 // Core types
 #include "core/config.hpp"
 #include "core/message.hpp"
+#include "core/tokenizer.hpp"
 #include "core/types.hpp"
 #include "core/uuid.hpp"
 
@@ -10,11 +11,23 @@
 #include "bus/bus.hpp"
 
 // Network
+#include "net/dns_cache.hpp"
 #include "net/http_client.hpp"
+#include "net/request_scheduler.hpp"
+#include "net/retry_policy.hpp"
 #include "net/sse_client.hpp"
+#include "net/sse_parser.hpp"
+#include "net/tls_session_cache.hpp"
 
 // LLM providers
+#include "llm/event_stream.hpp"
+#include "llm/hedged.hpp"
+#include "llm/partial_json.hpp"
+#include "llm/prompt_cache.hpp"
 #include "llm/provider.hpp"
+#include "llm/replay.hpp"
+#include "llm/stream_decoder.hpp"
+#include "llm/trace.hpp"
 
 // Tool system
 #include "tool/builtin/builtins.hpp"
@@ -100,6 +100,15 @@ struct ToolCallCompleted {
   bool success;
 };
 
+// The tool calls of one response have all finished
+struct ToolBatchCompleted {
+  std::string session_id;
+  size_t calls;
+  size_t critical_path;  // Longest chain of calls that had to wait for one another
+  size_t max_running;    // Most calls running at once
+  double parallelism;    // Time spent in tools over the batch's wall time
+};
+
 struct StreamDelta {
   std::string session_id;
   std::string text;
@@ -109,6 +118,8 @@ struct TokensUsed {
   std::string session_id;
   int64_t input_tokens;
   int64_t output_tokens;
+  int64_t cache_read_tokens = 0;
+  int64_t cache_write_tokens = 0;
 };
 
 struct ContextCompacted {
@@ -1,5 +1,7 @@
 #include "config.hpp"
 
+#include <spdlog/spdlog.h>
+
 #include <cstdlib>
 #include <fstream>
 #include <set>
@@ -8,6 +10,22 @@ namespace agent {
 
 namespace fs = std::filesystem;
 
+std::string to_string(PruneMode mode) {
+  switch (mode) {
+    case PruneMode::CacheAware:
+      return "cache_aware";
+    case PruneMode::Eager:
+      return "eager";
+  }
+  return "eager";
+}
+
+std::optional<PruneMode> prune_mode_from_string(const std::string& str) {
+  if (str == "cache_aware") return PruneMode::CacheAware;
+  if (str == "eager") return PruneMode::Eager;
+  return std::nullopt;
+}
+
 Config Config::load(const fs::path& path) {
   Config config;
 
@@ -106,6 +124,45 @@ Config Config::load(const fs::path& path) {
       }
     }
 
+    // Load hedging settings
+    if (j.contains("hedge")) {
+      const auto& hedge = j["hedge"];
+      config.hedge.enabled = hedge.value("enabled", false);
+      config.hedge.backup_provider = hedge.value("backup_provider", "");
+      config.hedge.backup_base_url = hedge.value("backup_base_url", "");
+      config.hedge.backup_model = hedge.value("backup_model", "");
+      config.hedge.delay_ms = hedge.value("delay_ms", int64_t{3000});
+      config.hedge.adaptive = hedge.value("adaptive", true);
+    }
+
+    // Load tool execution settings
+    if (j.contains("tools")) {
+      const auto& tools = j["tools"];
+      config.tools.speculative_read_only = tools.value("speculative_read_only", false);
+      // Entries override the defaults one tool at a time
+      if (tools.contains("limits")) {
+        for (const auto& [tool_id, limit] : tools["limits"].items()) {
+          config.tools.limits[tool_id] = limit.get<size_t>();
+        }
+      }
+    }
+
+    // Load prompt cache settings
+    if (j.contains("prompt_cache")) {
+      config.prompt_cache.enabled = j["prompt_cache"].value("enabled", true);
+    }
+
+    // Load record/replay settings
+    if (j.contains("replay")) {
+      const auto& replay = j["replay"];
+      config.replay.mode = replay.value("mode", "");
+      config.replay.cassette = replay.value("cassette", "");
+      config.replay.pacing = replay.value("pacing", "recorded");
+      config.replay.first_token_ms = replay.value("first_token_ms", int64_t{0});
+      config.replay.event_interval_ms = replay.value("event_interval_ms", int64_t{0});
+      config.replay.jitter_ms = replay.value("jitter_ms", int64_t{0});
+    }
+
     // Load context settings
     if (j.contains("context")) {
       const auto& ctx = j["context"];
@@ -113,6 +170,14 @@ Config Config::load(const fs::path& path) {
       config.context.prune_minimum_tokens = ctx.value("prune_minimum_tokens", 20000);
       config.context.truncate_max_lines = ctx.value("truncate_max_lines", 2000);
       config.context.truncate_max_bytes = ctx.value("truncate_max_bytes", 51200);
+      auto prune_mode = ctx.value("prune_mode", "eager");
+      if (auto mode = prune_mode_from_string(prune_mode)) {
+        config.context.prune_mode = *mode;
+      } else {
+        spdlog::warn("[Config] Unknown context.prune_mode \"{}\" in {}, using eager", prune_mode, path.string());
+      }
+      config.context.prune_epoch_tokens = ctx.value("prune_epoch_tokens", 60000);
+      config.context.tokenizer_file = ctx.value("tokenizer_file", "");
     }
 
     // Load instructions
@@ -133,6 +198,9 @@ Config Config::load(const fs::path& path) {
     if (j.contains("log_file")) {
       config.log_file = j["log_file"].get<std::string>();
     }
+    if (j.contains("trace_file")) {
+      config.trace_file = j["trace_file"].get<std::string>();
+    }
 
   } catch (const std::exception& e) {
     // Log error and return default config
@@ -310,11 +378,36 @@ void Config::save(const fs::path& path) const {
   }
   j["agents"] = agents_json;
 
+  // Save hedging settings
+  j["hedge"] = {{"enabled", hedge.enabled},
+                {"backup_provider", hedge.backup_provider},
+                {"backup_base_url", hedge.backup_base_url},
+                {"backup_model", hedge.backup_model},
+                {"delay_ms", hedge.delay_ms},
+                {"adaptive", hedge.adaptive}};
+
+  // Save tool execution settings
+  j["tools"] = {{"speculative_read_only", tools.speculative_read_only}, {"limits", tools.limits}};
+
+  // Save prompt cache settings
+  j["prompt_cache"] = {{"enabled", prompt_cache.enabled}};
+
+  // Save record/replay settings
+  j["replay"] = {{"mode", replay.mode},
+                 {"cassette", replay.cassette},
+                 {"pacing", replay.pacing},
+                 {"first_token_ms", replay.first_token_ms},
+                 {"event_interval_ms", replay.event_interval_ms},
+                 {"jitter_ms", replay.jitter_ms}};
+
   // Save context settings
   j["context"] = {{"prune_protect_tokens", context.prune_protect_tokens},
                   {"prune_minimum_tokens", context.prune_minimum_tokens},
                   {"truncate_max_lines", context.truncate_max_lines},
-                  {"truncate_max_bytes", context.truncate_max_bytes}};
+                  {"truncate_max_bytes", context.truncate_max_bytes},
+                  {"prune_mode", to_string(context.prune_mode)},
+                  {"prune_epoch_tokens", context.prune_epoch_tokens},
+                  {"tokenizer_file", context.tokenizer_file}};
 
   j["instructions"] = instructions;
 
@@ -328,6 +421,9 @@ void Config::save(const fs::path& path) const {
   if (log_file) {
     j["log_file"] = log_file->string();
   }
+  if (trace_file) {
+    j["trace_file"] = trace_file->string();
+  }
 
   // Write to file
   std::ofstream file(path);
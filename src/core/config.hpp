@@ -11,6 +11,17 @@
 
 namespace agent {
 
+// How old tool outputs are cleared from the context (Config::ContextSettings::prune_mode)
+enum class PruneMode {
+  CacheAware,  // Inside the provider's cached prompt prefix only in rare epochs
+  Eager        // After every turn
+};
+
+std::string to_string(PruneMode mode);
+
+// std::nullopt for an unknown name
+std::optional<PruneMode> prune_mode_from_string(const std::string& str);
+
 // Agent configuration
 struct AgentConfig {
   AgentId id;
@@ -81,12 +92,65 @@ struct Config {
     int64_t prune_minimum_tokens = 20000;
     size_t truncate_max_lines = 2000;
     size_t truncate_max_bytes = 51200;
+
+    // "eager": old tool outputs are cleared after every turn; "cache_aware": those inside the provider's
+    // cached prompt prefix are cleared only in rare epochs, once prune_epoch_tokens of them are prunable.
+    // Unknown names in the config file fall back to eager with a warning.
+    PruneMode prune_mode = PruneMode::Eager;
+    int64_t prune_epoch_tokens = 60000;
+
+    // BPE vocabulary in tiktoken format (e.g. cl100k_base.tiktoken) for exact token counts;
+    // without one, tokens are estimated per word and character
+    std::string tokenizer_file;
   } context;
 
+  // Request hedging (opt-in): when the provider is slow to the first token, also send the request
+  // to a backup provider or endpoint serving the same model and keep whichever answers first
+  struct HedgeSettings {
+    bool enabled = false;
+    std::string backup_provider;  // Provider entry for the backup (empty = same provider as the primary)
+    std::string backup_base_url;  // Endpoint override for the backup (empty = that provider's base_url)
+    std::string backup_model;     // Model name on the backup (empty = the session's model)
+    int64_t delay_ms = 3000;      // Hedge threshold until enough time-to-first-token samples exist
+    bool adaptive = true;         // Then hedge at the observed p95
+  } hedge;
+
+  // Tool execution
+  struct ToolSettings {
+    // Speculative execution (opt-in): start read-only tools that are already permitted as soon as
+    // their call completes in the stream, instead of after the whole response
+    bool speculative_read_only = false;
+
+    // Running calls per tool id at most (0 = unlimited); calls over the limit wait in the executor.
+    // Each bash call holds a blocking-lane thread and a shell, and questions reach the user one at a time.
+    std::map<std::string, size_t> limits = {{"bash", 4}, {"question", 1}};
+  } tools;
+
+  // Prompt caching (Anthropic): mark cache breakpoints on the tools, the system prompt and the end of
+  // the history, so each turn reads the unchanged prefix from cache instead of reprocessing it
+  struct PromptCacheSettings {
+    bool enabled = true;
+  } prompt_cache;
+
+  // Record/replay of provider streams (llm::ReplayProvider): "record" saves every stream with its timing
+  // to the cassette file, "replay" answers from it without network access (offline runs and benchmarks)
+  struct ReplaySettings {
+    std::string mode;  // "", "record" or "replay"
+    std::string cassette;
+    std::string pacing = "recorded";  // "recorded", "max" or "injected"
+    int64_t first_token_ms = 0;       // Injected pacing
+    int64_t event_interval_ms = 0;
+    int64_t jitter_ms = 0;
+  } replay;
+
   // Logging
   std::string log_level = "info";
   std::optional<std::filesystem::path> log_file;
 
+  // Raw provider traffic as NDJSON for offline inspection (llm::TraceRecorder); off when unset.
+  // The AGENT_TRACE_FILE environment variable takes precedence.
+  std::optional<std::filesystem::path> trace_file;
+
   // Load from file
   static Config load(const std::filesystem::path& path);
 
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "tokenizer.hpp"
+
 namespace agent {
 
 std::string to_string(Role role) {
@@ -25,7 +27,7 @@ Role role_from_string(const std::string& str) {
 
 Message::Message(Role role, const std::string& content) : role_(role) {
   if (!content.empty()) {
-    parts_.push_back(TextPart{content});
+    own_parts().push_back(TextPart{content});
   }
 }
 
@@ -42,28 +44,33 @@ Message Message::assistant(const std::string& content) {
 }
 
 void Message::add_part(MessagePart part) {
-  parts_.push_back(std::move(part));
+  invalidate_fragments_for_append();
+  own_parts().push_back(std::move(part));
 }
 
 void Message::add_text(const std::string& text) {
-  parts_.push_back(TextPart{text});
+  invalidate_fragments_for_append();
+  own_parts().push_back(TextPart{text});
 }
 
 void Message::add_tool_call(const std::string& id, const std::string& name, const json& args) {
-  parts_.push_back(ToolCallPart{id, name, args, false, false});
+  invalidate_fragments_for_append();
+  own_parts().push_back(ToolCallPart{id, name, args, false, false});
 }
 
 void Message::add_tool_result(const std::string& call_id, const std::string& name, const std::string& output, bool is_error) {
-  parts_.push_back(ToolResultPart{call_id, name, output, is_error, std::nullopt, json::object(), false, std::nullopt});
+  invalidate_fragments_for_append();
+  own_parts().push_back(ToolResultPart{call_id, name, output, is_error, std::nullopt, json::object(), false, std::nullopt});
 }
 
 void Message::add_thinking(const std::string& text) {
-  parts_.push_back(ThinkingPart{text});
+  invalidate_fragments_for_append();
+  own_parts().push_back(ThinkingPart{text});
 }
 
 std::string Message::text() const {
   std::string result;
-  for (const auto& part : parts_) {
+  for (const auto& part : parts()) {
     if (auto* text = std::get_if<TextPart>(&part)) {
       if (!result.empty()) result += "\n";
       result += text->text;
@@ -73,8 +80,9 @@ std::string Message::text() const {
 }
 
 std::vector<ToolCallPart*> Message::tool_calls() {
+  invalidate_fragments();
   std::vector<ToolCallPart*> result;
-  for (auto& part : parts_) {
+  for (auto& part : own_parts()) {
     if (auto* tc = std::get_if<ToolCallPart>(&part)) {
       result.push_back(tc);
     }
@@ -82,9 +90,19 @@ std::vector<ToolCallPart*> Message::tool_calls() {
   return result;
 }
 
+void Message::set_tool_call_state(const std::string& call_id, bool started, bool completed) {
+  for (auto& part : own_parts()) {
+    auto* tc = std::get_if<ToolCallPart>(&part);
+    if (tc && tc->id == call_id) {
+      tc->started = started;
+      tc->completed = completed;
+    }
+  }
+}
+
 std::vector<const ToolCallPart*> Message::tool_calls() const {
   std::vector<const ToolCallPart*> result;
-  for (const auto& part : parts_) {
+  for (const auto& part : parts()) {
     if (auto* tc = std::get_if<ToolCallPart>(&part)) {
       result.push_back(tc);
     }
@@ -93,8 +111,9 @@ std::vector<const ToolCallPart*> Message::tool_calls() const {
 }
 
 std::vector<ToolResultPart*> Message::tool_results() {
+  invalidate_fragments();
   std::vector<ToolResultPart*> result;
-  for (auto& part : parts_) {
+  for (auto& part : own_parts()) {
     if (auto* tr = std::get_if<ToolResultPart>(&part)) {
       result.push_back(tr);
     }
@@ -104,7 +123,7 @@ std::vector<ToolResultPart*> Message::tool_results() {
 
 std::vector<const ToolResultPart*> Message::tool_results() const {
   std::vector<const ToolResultPart*> result;
-  for (const auto& part : parts_) {
+  for (const auto& part : parts()) {
     if (auto* tr = std::get_if<ToolResultPart>(&part)) {
       result.push_back(tr);
     }
@@ -114,7 +133,7 @@ std::vector<const ToolResultPart*> Message::tool_results() const {
 
 json Message::to_json() const {
   json j;
-  j["id"] = id_;
+  j["id"] = id_.str();
   j["role"] = to_string(role_);
   j["finished"] = finished_;
   j["finish_reason"] = to_string(finish_reason_);
@@ -125,10 +144,10 @@ json Message::to_json() const {
     j["parent_id"] = *parent_id_;
   }
 
-  j["session_id"] = session_id_;
+  j["session_id"] = session_id_.str();
 
   json parts_json = json::array();
-  for (const auto& part : parts_) {
+  for (const auto& part : parts()) {
     json part_json;
     if (auto* text = std::get_if<TextPart>(&part)) {
       part_json["type"] = "text";
@@ -167,7 +186,7 @@ json Message::to_json() const {
 
 Message Message::from_json(const json& j) {
   Message msg;
-  msg.id_ = j.value("id", UUID::generate());
+  msg.id_ = SharedString(j.value("id", UUID::generate()));
   msg.role_ = role_from_string(j.value("role", "user"));
   msg.finished_ = j.value("finished", false);
   msg.finish_reason_ = finish_reason_from_string(j.value("finish_reason", "stop"));
@@ -178,20 +197,20 @@ Message Message::from_json(const json& j) {
     msg.parent_id_ = j["parent_id"].get<std::string>();
   }
 
-  msg.session_id_ = j.value("session_id", "");
+  msg.set_session_id(j.value("session_id", ""));
 
   if (j.contains("parts")) {
     for (const auto& part_json : j["parts"]) {
       std::string type = part_json.value("type", "");
       if (type == "text") {
-        msg.parts_.push_back(TextPart{part_json["text"]});
+        msg.own_parts().push_back(TextPart{part_json["text"]});
       } else if (type == "thinking") {
-        msg.parts_.push_back(ThinkingPart{part_json["text"]});
+        msg.own_parts().push_back(ThinkingPart{part_json["text"]});
       } else if (type == "tool_call") {
-        msg.parts_.push_back(ToolCallPart{part_json["id"], part_json["name"], part_json["arguments"], part_json.value("started", false),
+        msg.own_parts().push_back(ToolCallPart{part_json["id"], part_json["name"], part_json["arguments"], part_json.value("started", false),
                                           part_json.value("completed", false)});
       } else if (type == "tool_result") {
-        msg.parts_.push_back(ToolResultPart{part_json["tool_call_id"], part_json["tool_name"], part_json["output"],
+        msg.own_parts().push_back(ToolResultPart{part_json["tool_call_id"], part_json["tool_name"], part_json["output"],
                                             part_json.value("is_error", false), std::nullopt, json::object(), part_json.value("compacted", false),
                                             std::nullopt});
       }
@@ -213,6 +232,81 @@ Message Message::from_json(const json& j) {
   return msg;
 }
 
+const std::string& Message::api_fragment(ApiFormat format, const std::function<std::string(const Message&)>& render) const {
+  auto& cache = fragment_cache();
+  std::lock_guard lock(cache.mutex);
+  auto& fragment = cache.fragments[static_cast<size_t>(format)];
+  if (!fragment) fragment = render(*this);
+  return *fragment;
+}
+
+const std::vector<MessagePart>& Message::no_parts() {
+  static const std::vector<MessagePart> empty;
+  return empty;
+}
+
+std::vector<MessagePart>& Message::own_parts() {
+  if (!parts_) {
+    parts_ = std::make_shared<std::vector<MessagePart>>();
+  } else if (parts_.use_count() > 1) {
+    parts_ = std::make_shared<std::vector<MessagePart>>(*parts_);  // Shared with a copy: take a private one
+  }
+  return *parts_;
+}
+
+Message::FragmentCache& Message::fragment_cache() const {
+  if (!fragments_) fragments_ = std::make_shared<FragmentCache>();
+  return *fragments_;
+}
+
+void Message::invalidate_fragments_for_append() {
+  if (!fragments_) return;
+  if (fragments_.use_count() == 1) {
+    // Not shared: drop the rendered fragments in place
+    std::lock_guard lock(fragments_->mutex);
+    for (auto& fragment : fragments_->fragments) fragment.reset();
+    return;
+  }
+  // Shared with a copy that keeps the old parts: start a cache of our own
+  auto cache = std::make_shared<FragmentCache>();
+  {
+    std::lock_guard lock(fragments_->mutex);
+    cache->part_tokens = fragments_->part_tokens;
+  }
+  fragments_ = std::move(cache);
+}
+
+int64_t Message::part_tokens_locked(size_t index) const {
+  auto& counts = fragments_->part_tokens;
+  if (counts.size() < parts().size()) counts.resize(parts().size(), -1);
+  if (counts[index] >= 0) return counts[index];
+
+  const auto& tokenizer = Tokenizer::instance();
+  const auto& part = parts()[index];
+  int64_t tokens = 0;
+  if (auto* text = std::get_if<TextPart>(&part)) {
+    tokens = tokenizer.count(text->text);
+  } else if (auto* tc = std::get_if<ToolCallPart>(&part)) {
+    tokens = tokenizer.count(tc->name) + tokenizer.count(tc->arguments.dump());
+  } else if (auto* tr = std::get_if<ToolResultPart>(&part)) {
+    tokens = tokenizer.count(tr->output);
+  }
+  counts[index] = tokens;
+  return tokens;
+}
+
+int64_t Message::part_tokens(size_t index) const {
+  std::lock_guard lock(fragment_cache().mutex);
+  return part_tokens_locked(index);
+}
+
+int64_t Message::token_count() const {
+  std::lock_guard lock(fragment_cache().mutex);
+  int64_t total = 0;
+  for (size_t i = 0; i < parts().size(); ++i) total += part_tokens_locked(i);
+  return total;
+}
+
 json Message::to_api_format() const {
   // Convert to OpenAI-style format (also works with Anthropic via adapter)
   json msg;
@@ -222,7 +316,7 @@ json Message::to_api_format() const {
   std::string text_content;
   bool has_tool_calls = false;
 
-  for (const auto& part : parts_) {
+  for (const auto& part : parts()) {
     if (auto* text = std::get_if<TextPart>(&part)) {
       if (!text_content.empty()) {
         text_content += "\n";
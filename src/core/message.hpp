@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -10,6 +12,7 @@
 #include <variant>
 #include <vector>
 
+#include "string_pool.hpp"
 #include "types.hpp"
 #include "uuid.hpp"
 
@@ -100,7 +103,7 @@ class Message {
 
   // Accessors
   const MessageId& id() const {
-    return id_;
+    return id_.str();
   }
 
   Role role() const {
@@ -108,11 +111,13 @@ class Message {
   }
 
   const std::vector<MessagePart>& parts() const {
-    return parts_;
+    return parts_ ? *parts_ : no_parts();
   }
 
+  // Mutable parts: this message's own copy, which drops its cached fragments
   std::vector<MessagePart>& parts() {
-    return parts_;
+    invalidate_fragments();
+    return own_parts();
   }
 
   // Parent message (for threading)
@@ -126,11 +131,12 @@ class Message {
 
   // Session association
   const SessionId& session_id() const {
-    return session_id_;
+    return session_id_.str();
   }
 
+  // Interned: the messages of a session share one copy of its id
   void set_session_id(const SessionId& id) {
-    session_id_ = id;
+    session_id_ = StringPool::instance().intern(id);
   }
 
   // Completion state (for assistant messages)
@@ -201,6 +207,10 @@ class Message {
 
   std::vector<const ToolCallPart*> tool_calls() const;
 
+  // Record a tool call's execution state. No request format carries these flags, so unlike mutable
+  // parts() this keeps the cached fragments and token counts; copies taken earlier keep their flags.
+  void set_tool_call_state(const std::string& call_id, bool started, bool completed);
+
   // Get tool results from this message
   std::vector<ToolResultPart*> tool_results();
 
@@ -214,13 +224,49 @@ class Message {
   // Convert to LLM API format
   json to_api_format() const;
 
+  // Serialized request-body form of this message, rendered on first use and then reused. Copies made once
+  // the cache exists share it (the history is copied into every request); any change to the parts drops it.
+  enum class ApiFormat { Anthropic, OpenAI };
+  const std::string& api_fragment(ApiFormat format, const std::function<std::string(const Message&)>& render) const;
+
+  // Tokens of what is sent to the model (text, tool calls, tool results), counted by Tokenizer::instance()
+  // once per part. Copies share the counts; appending a part keeps those of the parts before it.
+  int64_t token_count() const;
+
+  int64_t part_tokens(size_t index) const;
+
  private:
-  MessageId id_ = UUID::generate();
+  struct FragmentCache {
+    std::mutex mutex;
+    std::array<std::optional<std::string>, 2> fragments;  // By ApiFormat
+    std::vector<int64_t> part_tokens;                     // By part, -1 until counted
+  };
+
+  void invalidate_fragments() {
+    fragments_.reset();
+  }
+
+  // The cache, created on first use
+  FragmentCache& fragment_cache() const;
+
+  // Before appending a part: the existing parts are unchanged, so their token counts carry over
+  void invalidate_fragments_for_append();
+
+  int64_t part_tokens_locked(size_t index) const;
+
+  static const std::vector<MessagePart>& no_parts();
+
+  std::vector<MessagePart>& own_parts();
+
+  // Reference-counted, so copying a message does not copy its ids
+  SharedString id_{UUID::generate()};
   Role role_ = Role::User;
-  std::vector<MessagePart> parts_;
+  // Copies share the parts until one of them changes its own (copy-on-write), so copying a message is
+  // a reference count increment however large its tool outputs are. Null while there are none.
+  std::shared_ptr<std::vector<MessagePart>> parts_;
 
   std::optional<MessageId> parent_id_;
-  SessionId session_id_;
+  SharedString session_id_;
 
   bool finished_ = false;
   FinishReason finish_reason_ = FinishReason::Stop;
@@ -230,6 +276,9 @@ class Message {
   bool is_synthetic_ = false;
 
   Timestamp created_at_ = std::chrono::system_clock::now();
+
+  // Null until a fragment or token count is asked for, so scratch and temporary messages never allocate one
+  mutable std::shared_ptr<FragmentCache> fragments_;
 };
 
 // Message storage interface
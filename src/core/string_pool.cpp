@@ -0,0 +1,43 @@
+#include "string_pool.hpp"
+
+namespace agent {
+
+const std::string& SharedString::empty() {
+  static const std::string value;
+  return value;
+}
+
+StringPool& StringPool::instance() {
+  // Never destroyed: strings released during static destruction still reach it
+  static auto* pool = new StringPool();
+  return *pool;
+}
+
+SharedString StringPool::intern(std::string_view value) {
+  if (value.empty()) return {};
+  std::lock_guard lock(mutex_);
+  if (auto it = entries_.find(value); it != entries_.end()) {
+    if (auto shared = it->second.shared.lock()) return SharedString(std::move(shared));
+    entries_.erase(it);  // Its last reference is being released; that release leaves a new entry alone
+  }
+  auto* stored = new std::string(value);
+  std::shared_ptr<const std::string> shared(stored, [this](const std::string* released) {
+    release(released);
+    delete released;
+  });
+  entries_.emplace(*stored, Entry{stored, shared});
+  return SharedString(std::move(shared));
+}
+
+size_t StringPool::size() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+void StringPool::release(const std::string* value) {
+  std::lock_guard lock(mutex_);
+  auto it = entries_.find(*value);
+  if (it != entries_.end() && it->second.value == value) entries_.erase(it);
+}
+
+}  // namespace agent
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace agent {
+
+// Immutable string held by reference count. Copying one never allocates, so values that are copied with
+// every message (ids) cost one allocation when created rather than one per copy.
+class SharedString {
+ public:
+  SharedString() = default;
+
+  explicit SharedString(std::string value) : value_(std::make_shared<const std::string>(std::move(value))) {}
+
+  const std::string& str() const {
+    return value_ ? *value_ : empty();
+  }
+
+  operator const std::string&() const {
+    return str();
+  }
+
+  // Whether both refer to the same storage (interned equal values do)
+  bool shares_with(const SharedString& other) const {
+    return value_ == other.value_;
+  }
+
+ private:
+  friend class StringPool;
+
+  explicit SharedString(std::shared_ptr<const std::string> value) : value_(std::move(value)) {}
+
+  static const std::string& empty();
+
+  std::shared_ptr<const std::string> value_;
+};
+
+// Interns repeated strings (session ids, which every message of a session carries): equal values share
+// one SharedString. An entry lives as long as a SharedString refers to it, so the pool holds only what is
+// in use. Thread-safe.
+class StringPool {
+ public:
+  static StringPool& instance();
+
+  SharedString intern(std::string_view value);
+
+  // Distinct values in use
+  size_t size() const;
+
+ private:
+  StringPool() = default;
+
+  struct Entry {
+    const std::string* value;  // The key views it
+    std::weak_ptr<const std::string> shared;
+  };
+
+  void release(const std::string* value);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string_view, Entry> entries_;
+};
+
+}  // namespace agent
@@ -0,0 +1,283 @@
+#include "tokenizer.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace agent {
+
+namespace {
+
+constexpr uint32_t kNoRank = std::numeric_limits<uint32_t>::max();
+
+// Longer pieces (minified JSON, base64) are merged in chunks to keep the quadratic merge loop bounded
+constexpr size_t kMaxMergePiece = 512;
+
+// Non-ASCII bytes count as letters: most of them belong to letters (CJK, accented Latin, Cyrillic)
+bool is_letter(unsigned char c) {
+  return c >= 0x80 || static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+}
+
+bool is_digit(unsigned char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool is_newline(unsigned char c) {
+  return c == '\n' || c == '\r';
+}
+
+bool is_space(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool is_punct(unsigned char c) {
+  return !is_space(c) && !is_letter(c) && !is_digit(c);
+}
+
+size_t letter_run_end(std::string_view text, size_t i) {
+  const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+  const size_t n = text.size();
+#if defined(__SSE2__)
+  // A byte is a letter if its high bit is set, or if it is in 'a'..'z' once lowercased: shifting
+  // 'a'..'z' to -128..-103 turns the range check into one signed compare
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  const __m128i shift = _mm_set1_epi8(static_cast<char>(0x80 - 'a'));
+  const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= n) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(_mm_or_si128(v, case_bit), shift), limit);
+    __m128i high = _mm_cmplt_epi8(v, zero);
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(alpha, high)));
+    if (mask != 0xFFFF) return i + __builtin_ctz(~mask);
+    i += 16;
+  }
+#endif
+  while (i < n && is_letter(p[i])) ++i;
+  return i;
+}
+
+// Estimated tokens of one piece when no vocabulary is loaded
+size_t estimate_piece(std::string_view piece) {
+  size_t ascii = 0;
+  size_t wide = 0;    // Lead bytes of 3- and 4-byte sequences: CJK, emoji
+  size_t narrow = 0;  // Lead bytes of 2-byte sequences: accented Latin, Cyrillic, Greek
+  for (unsigned char c : piece) {
+    if (c < 0x80) {
+      ++ascii;
+    } else if (c >= 0xE0) {
+      ++wide;
+    } else if (c >= 0xC0) {
+      ++narrow;
+    }
+  }
+  size_t tokens = wide + (narrow + 1) / 2 + (ascii + 3) / 4;
+  return tokens > 0 ? tokens : 1;
+}
+
+std::string base64_decode(std::string_view in) {
+  auto value = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+  };
+  std::string out;
+  uint32_t bits = 0;
+  int count = 0;
+  for (char c : in) {
+    int v = value(c);
+    if (v < 0) break;  // Padding
+    bits = (bits << 6) | static_cast<uint32_t>(v);
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      out.push_back(static_cast<char>((bits >> count) & 0xFF));
+    }
+  }
+  return out;
+}
+
+// tiktoken's byte-pair merge: repeatedly join the adjacent pair with the lowest rank. Calls
+// token(start, end) for each resulting token.
+template <typename Ranks, typename Token>
+void merge_piece(const Ranks& ranks, std::string_view piece, Token&& token) {
+  auto rank_of = [&ranks](std::string_view bytes) {
+    auto it = ranks.find(bytes);
+    return it != ranks.end() ? it->second : kNoRank;
+  };
+
+  struct Part {
+    size_t start;
+    uint32_t rank;  // Of the pair starting here
+  };
+  thread_local std::vector<Part> parts;
+  parts.clear();
+  for (size_t i = 0; i <= piece.size(); ++i) parts.push_back({i, kNoRank});
+  auto pair_rank = [&](size_t i) {
+    return i + 2 < parts.size() ? rank_of(piece.substr(parts[i].start, parts[i + 2].start - parts[i].start)) : kNoRank;
+  };
+  for (size_t i = 0; i < parts.size(); ++i) parts[i].rank = pair_rank(i);
+
+  while (parts.size() > 2) {
+    size_t best = 0;
+    for (size_t i = 1; i + 1 < parts.size(); ++i) {
+      if (parts[i].rank < parts[best].rank) best = i;
+    }
+    if (parts[best].rank == kNoRank) break;
+    parts.erase(parts.begin() + static_cast<std::ptrdiff_t>(best) + 1);
+    parts[best].rank = pair_rank(best);
+    if (best > 0) parts[best - 1].rank = pair_rank(best - 1);
+  }
+  for (size_t i = 0; i + 1 < parts.size(); ++i) token(parts[i].start, parts[i + 1].start);
+}
+
+// Visit the tokens of piece: the whole piece when it is one token, else merged (in chunks if long)
+template <typename Ranks, typename Token>
+void bpe_piece(const Ranks& ranks, std::string_view piece, Token&& token) {
+  if (auto it = ranks.find(piece); it != ranks.end()) {
+    token(piece, it->second);
+    return;
+  }
+  for (size_t offset = 0; offset < piece.size(); offset += kMaxMergePiece) {
+    auto chunk = piece.substr(offset, kMaxMergePiece);
+    merge_piece(ranks, chunk, [&](size_t start, size_t end) {
+      auto bytes = chunk.substr(start, end - start);
+      auto it = ranks.find(bytes);
+      token(bytes, it != ranks.end() ? it->second : kNoRank);  // Unknown byte: still one token
+    });
+  }
+}
+
+}  // namespace
+
+Tokenizer& Tokenizer::instance() {
+  static Tokenizer instance;
+  return instance;
+}
+
+size_t Tokenizer::piece_end(std::string_view text, size_t i) {
+  const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+  const size_t n = text.size();
+  unsigned char c = p[i];
+
+  // 's 't 're 've 'm 'll 'd
+  if (c == '\'' && i + 1 < n) {
+    unsigned char a = p[i + 1] | 0x20;
+    if (a == 's' || a == 't' || a == 'm' || a == 'd') return i + 2;
+    if (i + 2 < n) {
+      unsigned char b = p[i + 2] | 0x20;
+      if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) return i + 3;
+    }
+  }
+
+  // Letters, with one leading character that is not a letter, digit or newline
+  if (is_letter(c)) return letter_run_end(text, i);
+  if (!is_digit(c) && !is_newline(c) && i + 1 < n && is_letter(p[i + 1])) return letter_run_end(text, i + 1);
+
+  // Up to three digits
+  if (is_digit(c)) {
+    size_t j = i + 1;
+    while (j < n && j < i + 3 && is_digit(p[j])) ++j;
+    return j;
+  }
+
+  // Punctuation, with an optional leading space and any newlines that follow
+  size_t j = i;
+  if (c == ' ' && j + 1 < n && is_punct(p[j + 1])) ++j;
+  if (is_punct(p[j])) {
+    while (j < n && is_punct(p[j])) ++j;
+    while (j < n && is_newline(p[j])) ++j;
+    return j;
+  }
+
+  // Whitespace: through the last newline of the run, else all of it but the space before a word
+  size_t end = i;
+  size_t after_newline = 0;
+  while (end < n && is_space(p[end])) {
+    if (is_newline(p[end])) after_newline = end + 1;
+    ++end;
+  }
+  if (after_newline) return after_newline;
+  if (end < n && end - i > 1) return end - 1;
+  return end;
+}
+
+bool Tokenizer::load(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  if (!file) {
+    spdlog::warn("[Tokenizer] Cannot open vocabulary {}", path.string());
+    return false;
+  }
+  auto vocabulary = std::make_shared<Vocabulary>();
+  std::string line;
+  while (std::getline(file, line)) {
+    auto space = line.find(' ');
+    if (space == std::string::npos) continue;
+    try {
+      vocabulary->ranks.emplace(base64_decode(std::string_view(line).substr(0, space)), static_cast<uint32_t>(std::stoul(line.substr(space + 1))));
+    } catch (const std::exception&) {
+      // Not a rank: skip the line
+    }
+  }
+  if (vocabulary->ranks.empty()) {
+    spdlog::warn("[Tokenizer] No tokens in {}", path.string());
+    return false;
+  }
+  spdlog::info("[Tokenizer] Loaded {} tokens from {}", vocabulary->ranks.size(), path.string());
+  std::lock_guard lock(mutex_);
+  vocabulary_ = std::move(vocabulary);
+  return true;
+}
+
+void Tokenizer::unload() {
+  std::lock_guard lock(mutex_);
+  vocabulary_.reset();
+}
+
+bool Tokenizer::has_vocabulary() const {
+  return vocabulary() != nullptr;
+}
+
+std::shared_ptr<const Tokenizer::Vocabulary> Tokenizer::vocabulary() const {
+  std::lock_guard lock(mutex_);
+  return vocabulary_;
+}
+
+size_t Tokenizer::count(std::string_view text) const {
+  auto vocabulary = this->vocabulary();
+  size_t tokens = 0;
+  if (!vocabulary) {
+    pretokenize(text, [&tokens](std::string_view piece) {
+      tokens += estimate_piece(piece);
+    });
+    return tokens;
+  }
+  pretokenize(text, [&](std::string_view piece) {
+    bpe_piece(vocabulary->ranks, piece, [&tokens](std::string_view, uint32_t) {
+      ++tokens;
+    });
+  });
+  return tokens;
+}
+
+std::vector<uint32_t> Tokenizer::encode(std::string_view text) const {
+  std::vector<uint32_t> ranks;
+  auto vocabulary = this->vocabulary();
+  if (!vocabulary) return ranks;
+  pretokenize(text, [&](std::string_view piece) {
+    bpe_piece(vocabulary->ranks, piece, [&ranks](std::string_view, uint32_t rank) {
+      ranks.push_back(rank);
+    });
+  });
+  return ranks;
+}
+
+}  // namespace agent
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace agent {
+
+// Byte-pair-encoding token counter. With a vocabulary in tiktoken format (one "<base64 bytes> <rank>"
+// line per token, e.g. cl100k_base.tiktoken) it counts what that encoding produces. Without one it
+// estimates per pre-tokenized piece: ASCII words by length, CJK and other wide characters one token
+// each, which tracks real tokenizers far better than bytes / 4 on non-English text.
+//
+// Text is first split the way cl100k splits it (words with their leading space, contractions, runs of
+// up to three digits, punctuation runs, whitespace), treating every non-ASCII character as a letter.
+// Letter runs are scanned 16 bytes at a time where SSE2 is available.
+class Tokenizer {
+ public:
+  static Tokenizer& instance();
+
+  // Replace the vocabulary with the one in path. Returns false (keeping the current one) when the
+  // file cannot be read or holds no tokens.
+  bool load(const std::filesystem::path& path);
+
+  // Back to estimating
+  void unload();
+
+  bool has_vocabulary() const;
+
+  size_t count(std::string_view text) const;
+
+  // Token ranks for text; empty without a vocabulary
+  std::vector<uint32_t> encode(std::string_view text) const;
+
+  // Split text into the pieces BPE runs on independently; callback(std::string_view) for each
+  template <typename Callback>
+  static void pretokenize(std::string_view text, Callback&& callback) {
+    for (size_t i = 0; i < text.size();) {
+      size_t end = piece_end(text, i);
+      callback(text.substr(i, end - i));
+      i = end;
+    }
+  }
+
+  // End of the piece starting at i
+  static size_t piece_end(std::string_view text, size_t i);
+
+ private:
+  Tokenizer() = default;
+
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  struct Vocabulary {
+    std::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> ranks;
+  };
+
+  std::shared_ptr<const Vocabulary> vocabulary() const;
+
+  mutable std::mutex mutex_;  // Guards the pointer; a loaded vocabulary is never modified
+  std::shared_ptr<const Vocabulary> vocabulary_;
+};
+
+}  // namespace agent
@@ -64,6 +64,13 @@ struct TokenUsage {
     return input_tokens + output_tokens;
   }
 
+  // Share of prompt tokens served from the prompt cache. Follows Anthropic's accounting, where
+  // input_tokens excludes the tokens read from or written to the cache.
+  double cache_hit_ratio() const {
+    int64_t prompt = input_tokens + cache_read_tokens + cache_write_tokens;
+    return prompt > 0 ? double(cache_read_tokens) / double(prompt) : 0.0;
+  }
+
   TokenUsage& operator+=(const TokenUsage& other) {
     input_tokens += other.input_tokens;
     output_tokens += other.output_tokens;
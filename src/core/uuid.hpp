@@ -11,9 +11,9 @@ namespace agent {
 class UUID {
  public:
   static std::string generate() {
-    static std::random_device rd;
-    static std::mt19937_64 gen(rd());
-    static std::uniform_int_distribution<uint64_t> dist;
+    // Per thread: sessions create messages concurrently
+    thread_local std::mt19937_64 gen(std::random_device{}());
+    std::uniform_int_distribution<uint64_t> dist;
 
     uint64_t ab = dist(gen);
     uint64_t cd = dist(gen);
@@ -35,9 +35,8 @@ class UUID {
 
   static std::string short_id(size_t length = 8) {
     static const char charset[] = "0123456789abcdefghijklmnopqrstuvwxyz";
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<size_t> dist(0, sizeof(charset) - 2);
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<size_t> dist(0, sizeof(charset) - 2);
 
     std::string result;
     result.reserve(length);
@@ -2,8 +2,23 @@
 
 #include <spdlog/spdlog.h>
 
+#include "net/sse_parser.hpp"
+#include "trace.hpp"
+
 namespace agent::llm {
 
+namespace {
+
+// Fields present in an Anthropic usage object; the rest of usage is left as is
+void read_usage(const json& u, TokenUsage& usage) {
+  usage.input_tokens = u.value("input_tokens", usage.input_tokens);
+  usage.output_tokens = u.value("output_tokens", usage.output_tokens);
+  usage.cache_read_tokens = u.value("cache_read_input_tokens", usage.cache_read_tokens);
+  usage.cache_write_tokens = u.value("cache_creation_input_tokens", usage.cache_write_tokens);
+}
+
+}  // namespace
+
 AnthropicProvider::AnthropicProvider(const ProviderConfig& config, asio::io_context& io_ctx)
     : config_(config), io_ctx_(io_ctx), http_client_(io_ctx) {
   if (!config.base_url.empty()) {
@@ -23,22 +38,26 @@ std::future<LlmResponse> AnthropicProvider::complete(const LlmRequest& request)
   auto promise = std::make_shared<std::promise<LlmResponse>>();
   auto future = promise->get_future();
 
-  auto body = request.to_anthropic_format();
-
   net::HttpOptions options;
   options.method = "POST";
-  options.body = body.dump();
+  options.body = request.to_anthropic_body();
   options.headers = {{"Content-Type", "application/json"}, {"x-api-key", config_.api_key}, {"anthropic-version", api_version_}};
-  options.timeout = std::chrono::seconds(120);            // 增加超时时间到2分钟
-  options.max_retries = 3;                                // 最多重试3次
-  options.retry_delay = std::chrono::milliseconds(2000);  // 重试间隔2秒
+  options.timeout = std::chrono::seconds(120);                 // 增加超时时间到2分钟
+  options.retry.max_retries = 3;                               // 最多重试3次
+  options.retry.base_delay = std::chrono::milliseconds(2000);  // 首次重试退避上限2秒（指数增长，随机抖动）
+  options.priority = request.priority;
 
   // Add any custom headers
   for (const auto& [key, value] : config_.headers) {
     options.headers[key] = value;
   }
 
-  http_client_.request(base_url_ + "/v1/messages", options, [promise](const net::HttpResponse& response) {
+  std::string url = base_url_ + "/v1/messages";
+  uint64_t trace_id = TraceRecorder::enabled() ? TraceRecorder::instance().next_id() : 0;
+  if (trace_id) TraceRecorder::instance().request(trace_id, name(), url, options.body);
+
+  http_client_.request(url, options, [promise, trace_id](const net::HttpResponse& response) {
+    if (trace_id) TraceRecorder::instance().response(trace_id, response.status_code, response.body, response.error);
     LlmResponse result;
 
     if (!response.error.empty()) {
@@ -90,10 +109,7 @@ std::future<LlmResponse> AnthropicProvider::complete(const LlmRequest& request)
 
       // Parse usage
       if (j.contains("usage")) {
-        result.usage.input_tokens = j["usage"].value("input_tokens", 0);
-        result.usage.output_tokens = j["usage"].value("output_tokens", 0);
-        result.usage.cache_read_tokens = j["usage"].value("cache_read_input_tokens", 0);
-        result.usage.cache_write_tokens = j["usage"].value("cache_creation_input_tokens", 0);
+        read_usage(j["usage"], result.usage);
       }
 
       msg.set_finished(true);
@@ -112,9 +128,6 @@ std::future<LlmResponse> AnthropicProvider::complete(const LlmRequest& request)
 }
 
 void AnthropicProvider::stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) {
-  auto body = request.to_anthropic_format();
-  body["stream"] = true;
-
   std::map<std::string, std::string> headers = {
       {"Content-Type", "application/json"}, {"Accept", "text/event-stream"}, {"x-api-key", config_.api_key}, {"anthropic-version", api_version_}};
 
@@ -124,107 +137,82 @@ void AnthropicProvider::stream(const LlmRequest& request, StreamCallback callbac
 
   // Reset state
   tool_calls_.clear();
+  usage_ = {};
 
   net::HttpOptions options;
   options.method = "POST";
-  options.body = body.dump();
+  options.body = request.to_anthropic_body(true);
   options.headers = headers;
-  options.timeout = std::chrono::seconds(180);            // 流式请求更长超时时间（3分钟）
-  options.max_retries = 2;                                // 流式请求重试次数少一些
-  options.retry_delay = std::chrono::milliseconds(3000);  // 重试间隔3秒
+  options.timeout = std::chrono::seconds(180);                 // 流式请求更长超时时间（3分钟）
+  options.retry.max_retries = 2;                               // 流式请求重试次数少一些
+  options.retry.base_delay = std::chrono::milliseconds(3000);  // 首次重试退避上限3秒
+  options.retry.kind = net::RetryKind::Streaming;              // 已输出内容后不再重发
+  options.priority = request.priority;
 
   spdlog::debug("[Anthropic] Request URL: {}/v1/messages", base_url_);
   spdlog::debug("[Anthropic] Request model: {}", request.model);
   spdlog::debug("[Anthropic] Request messages count: {}", request.messages.size());
   spdlog::debug("[Anthropic] Request tools count: {}", request.tools.size());
 
-  // Log full request details at info level for debugging (similar to OpenAI format)
-  spdlog::info("[Anthropic] ===== Full LLM Request =====");
-
-  // Log system prompt
-  if (!request.system_prompt.empty()) {
-    spdlog::info("[Anthropic] System prompt ({} chars):\n{}", request.system_prompt.size(), request.system_prompt);
-  }
-
-  // Log tools with their descriptions
-  if (!request.tools.empty()) {
-    spdlog::info("[Anthropic] Tools ({}):", request.tools.size());
-    for (const auto& tool : request.tools) {
-      spdlog::info("[Anthropic]   - {}: {}", tool->id(), tool->description());
-    }
-  }
-
-  // Log conversation messages
-  spdlog::info("[Anthropic] Messages ({}):", request.messages.size());
-  for (size_t i = 0; i < request.messages.size(); i++) {
-    const auto& msg = request.messages[i];
-    std::string content = msg.text();
-    if (content.size() > 200) {
-      content = content.substr(0, 200) + "... (truncated)";
-    }
-    spdlog::info("[Anthropic]   [{}] {}: {}", i + 1, to_string(msg.role()), content);
-  }
-  // Log complete request body
-  spdlog::info("[Anthropic] Request body ({} bytes):\n{}", options.body.size(), json::parse(options.body).dump(2));
-  spdlog::info("[Anthropic] ===== End Request =====");
+  std::string url = base_url_ + "/v1/messages";
+  uint64_t trace_id = TraceRecorder::enabled() ? TraceRecorder::instance().next_id() : 0;
+  if (trace_id) TraceRecorder::instance().request(trace_id, name(), url, options.body);
 
   auto shared_callback = std::make_shared<StreamCallback>(std::move(callback));
   auto shared_complete = std::make_shared<std::function<void()>>(std::move(on_complete));
-  auto sse_buffer = std::make_shared<std::string>();
+  auto sse_parser = std::make_shared<net::SseParser>([this, shared_callback](const net::SseEventView& event) {
+    parse_sse_event(event.data, *shared_callback);
+  });
 
   // Use streaming HTTP request for real-time SSE processing
-  http_client_.request_stream(
-      base_url_ + "/v1/messages", options,
-      [this, shared_callback, sse_buffer](const std::string& chunk) {
-        // Accumulate chunk into SSE buffer and parse complete events
-        *sse_buffer += chunk;
-
-        // Process complete SSE events (ended by \n\n or \r\n\r\n)
-        size_t pos;
-        while ((pos = sse_buffer->find("\n\n")) != std::string::npos || (pos = sse_buffer->find("\r\n\r\n")) != std::string::npos) {
-          std::string event_block = sse_buffer->substr(0, pos);
-          size_t skip = (sse_buffer->substr(pos, 4) == "\r\n\r\n") ? 4 : 2;
-          *sse_buffer = sse_buffer->substr(pos + skip);
-
-          // Parse SSE event from block
-          std::istringstream stream(event_block);
-          std::string line;
-          std::string event_data;
-
-          while (std::getline(stream, line)) {
-            // Remove \r if present
-            if (!line.empty() && line.back() == '\r') {
-              line.pop_back();
-            }
-
-            if (line.starts_with("data: ")) {
-              if (!event_data.empty()) event_data += "\n";
-              event_data += line.substr(6);
-            }
-          }
-
-          if (!event_data.empty()) {
-            parse_sse_event(event_data, *shared_callback);
-          }
-        }
+  http_client_.request_stream_view(
+      url, options,
+      [sse_parser, trace_id](std::string_view chunk) {
+        if (trace_id) TraceRecorder::instance().chunk(trace_id, chunk);
+        sse_parser->feed(chunk);
       },
-      [shared_callback, shared_complete](int status_code, const std::string& error) {
+      [shared_callback, shared_complete, trace_id](int status_code, const std::string& error, const std::map<std::string, std::string>& headers) {
+        if (trace_id) TraceRecorder::instance().end(trace_id, status_code, error);
         if (!error.empty()) {
           StreamError err;
           err.message = error;
+          err.retryable = net::RetryPolicy::retryable_error(error);
+          err.retry_after = net::RetryPolicy::server_delay(status_code, headers);
           (*shared_callback)(err);
         }
         (*shared_complete)();
       });
 }
 
-void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback& callback) {
+void AnthropicProvider::append_tool_arguments(int index, const std::string& partial_json, StreamCallback& callback) {
+  auto it = tool_calls_.find(index);
+  if (partial_json.empty() || it == tool_calls_.end()) return;
+  spdlog::trace("[Anthropic] Tool call arguments delta (index={}): {}", index, partial_json);
+  auto& tc = it->second;
+  if (!tc.args.failed() && !tc.args.feed(partial_json)) {
+    spdlog::warn("[Anthropic] Malformed arguments for tool call {} ({}): {}", tc.id, tc.name, tc.args.error());
+  }
+  callback(ToolCallDelta{tc.id, tc.name, partial_json});
+}
+
+void AnthropicProvider::parse_sse_event(std::string_view data, StreamCallback& callback) {
   spdlog::debug("[Anthropic] parse_sse_event: {}", data);
   if (data == "[DONE]") {
     spdlog::debug("[Anthropic] Received [DONE] signal");
     return;
   }
 
+  // Text and tool-argument deltas are nearly every event: read their few fields without a DOM
+  if (decode_anthropic_delta(data, delta_)) {
+    if (delta_.kind == AnthropicDelta::Kind::Text) {
+      spdlog::trace("[Anthropic] Text delta: {}", delta_.text);
+      callback(TextDelta{delta_.text});
+    } else if (delta_.kind == AnthropicDelta::Kind::InputJson) {
+      append_tool_arguments(delta_.index, delta_.text, callback);
+    }
+    return;
+  }
+
   try {
     auto j = json::parse(data);
     std::string type = j.value("type", "");
@@ -241,12 +229,7 @@ void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback&
         callback(TextDelta{delta["text"]});
       } else if (delta_type == "input_json_delta") {
         // Accumulate tool call arguments
-        int index = j.value("index", 0);
-        std::string partial_json = delta.value("partial_json", "");
-        if (tool_calls_.count(index)) {
-          spdlog::trace("[Anthropic] Tool call arguments delta (index={}): {}", index, partial_json);
-          tool_calls_[index].args_json += partial_json;
-        }
+        append_tool_arguments(j.value("index", 0), delta.value("partial_json", ""), callback);
       }
     } else if (type == "content_block_start") {
       auto content_block = j["content_block"];
@@ -258,7 +241,7 @@ void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback&
         std::string name = content_block.value("name", "");
 
         // Store tool call info by index
-        tool_calls_[index] = ToolCallInfo{id, name, ""};
+        tool_calls_[index] = ToolCallInfo{id, name, {}};
         spdlog::debug("[Anthropic] New tool call: id={}, name={}, index={}", id, name, index);
 
         callback(ToolCallDelta{id, name, ""});
@@ -269,13 +252,9 @@ void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback&
       // If we have a tool call at this index, emit the complete event
       auto it = tool_calls_.find(index);
       if (it != tool_calls_.end() && !it->second.id.empty()) {
-        try {
-          json args = it->second.args_json.empty() ? json::object() : json::parse(it->second.args_json);
-          callback(ToolCallComplete{it->second.id, it->second.name, args});
-        } catch (...) {
-          // Invalid JSON, emit empty object
-          callback(ToolCallComplete{it->second.id, it->second.name, json::object()});
-        }
+        // Already parsed while streaming; missing or invalid JSON becomes an empty object
+        auto& args = it->second.args;
+        callback(ToolCallComplete{it->second.id, it->second.name, args.finish() ? args.take() : json::object()});
       }
     } else if (type == "message_delta") {
       auto delta = j["delta"];
@@ -290,19 +269,25 @@ void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback&
         finish.reason = FinishReason::Stop;
       }
 
+      // Prompt-side counts come with message_start; later API versions repeat them here
+      finish.usage = usage_;
       if (j.contains("usage")) {
-        finish.usage.output_tokens = j["usage"].value("output_tokens", 0);
+        read_usage(j["usage"], finish.usage);
       }
 
       callback(finish);
     } else if (type == "message_start") {
       if (j.contains("message") && j["message"].contains("usage")) {
-        // Initial usage info (input tokens)
+        // Initial usage info (input and cache tokens)
+        read_usage(j["message"]["usage"], usage_);
       }
     } else if (type == "error") {
       StreamError error;
       if (j.contains("error")) {
         error.message = j["error"].value("message", "Unknown error");
+        // Mid-stream errors that clear on their own
+        auto error_type = j["error"].value("type", "");
+        error.retryable = error_type == "overloaded_error" || error_type == "api_error" || error_type == "rate_limit_error";
       }
       callback(error);
     }
@@ -312,6 +297,7 @@ void AnthropicProvider::parse_sse_event(const std::string& data, StreamCallback&
 }
 
 void AnthropicProvider::cancel() {
+  http_client_.cancel();
   if (sse_client_) {
     sse_client_->stop();
   }
@@ -2,7 +2,9 @@
 
 #include "net/http_client.hpp"
 #include "net/sse_client.hpp"
+#include "partial_json.hpp"
 #include "provider.hpp"
+#include "stream_decoder.hpp"
 
 namespace agent::llm {
 
@@ -24,7 +26,8 @@ class AnthropicProvider : public Provider {
   void cancel() override;
 
  private:
-  void parse_sse_event(const std::string& data, StreamCallback& callback);
+  void parse_sse_event(std::string_view data, StreamCallback& callback);
+  void append_tool_arguments(int index, const std::string& partial_json, StreamCallback& callback);
 
   ProviderConfig config_;
   asio::io_context& io_ctx_;
@@ -38,9 +41,12 @@ class AnthropicProvider : public Provider {
   struct ToolCallInfo {
     std::string id;
     std::string name;
-    std::string args_json;
+    PartialJsonParser args;  // Parsed as the fragments arrive
   };
   std::map<int, ToolCallInfo> tool_calls_;
+
+  TokenUsage usage_;      // From message_start, completed by message_delta
+  AnthropicDelta delta_;  // Reused by the delta fast path
 };
 
 }  // namespace agent::llm
@@ -0,0 +1,81 @@
+#include "event_stream.hpp"
+
+namespace agent::llm {
+
+std::shared_ptr<EventStream> EventStream::open(Provider& provider, const LlmRequest& request) {
+  auto events = std::make_shared<EventStream>();
+  provider.stream(
+      request,
+      [events](const StreamEvent& event) {
+        events->push(event);
+      },
+      [events]() {
+        events->finish();
+      });
+  return events;
+}
+
+asio::awaitable<std::optional<StreamEvent>> EventStream::next() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!events_.empty() || done_) co_return pop_locked();
+  }
+
+  co_await asio::async_initiate<decltype(asio::use_awaitable), void()>(
+      [this](auto handler) {
+        auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+        auto resume = [shared]() {
+          auto executor = asio::get_associated_executor(*shared);
+          asio::post(executor, [shared]() {
+            (*shared)();
+          });
+        };
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!events_.empty() || done_) {
+          lock.unlock();
+          resume();
+          return;
+        }
+        waiter_ = std::move(resume);
+      },
+      asio::use_awaitable);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  co_return pop_locked();
+}
+
+void EventStream::push(StreamEvent event) {
+  std::function<void()> waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back(std::move(event));
+    waiter = std::move(waiter_);
+    waiter_ = nullptr;
+  }
+  if (waiter) waiter();
+}
+
+void EventStream::finish() {
+  std::function<void()> waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    waiter = std::move(waiter_);
+    waiter_ = nullptr;
+  }
+  if (waiter) waiter();
+}
+
+bool EventStream::finished() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return done_ && events_.empty();
+}
+
+std::optional<StreamEvent> EventStream::pop_locked() {
+  if (events_.empty()) return std::nullopt;
+  auto event = std::move(events_.front());
+  events_.pop_front();
+  return event;
+}
+
+}  // namespace agent::llm
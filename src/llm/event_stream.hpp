@@ -0,0 +1,44 @@
+#pragma once
+
+#include <asio.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "provider.hpp"
+
+namespace agent::llm {
+
+// Pull-style view of Provider::stream for coroutines:
+//
+//   auto events = EventStream::open(provider, request);
+//   while (auto event = co_await events->next()) { ... }
+//
+// Events are buffered as the provider delivers them, and next() resumes on the awaiting
+// coroutine's executor. Only one coroutine may wait on a stream at a time.
+class EventStream {
+ public:
+  // Start provider.stream(request) feeding a new EventStream
+  static std::shared_ptr<EventStream> open(Provider& provider, const LlmRequest& request);
+
+  // Next event, or nullopt once the provider completed and every event was consumed
+  asio::awaitable<std::optional<StreamEvent>> next();
+
+  // Producer side (called from the provider callbacks)
+  void push(StreamEvent event);
+  void finish();
+
+  bool finished() const;
+
+ private:
+  std::optional<StreamEvent> pop_locked();
+
+  mutable std::mutex mutex_;
+  std::deque<StreamEvent> events_;
+  bool done_ = false;
+  std::function<void()> waiter_;  // Resumes the suspended next(), if any
+};
+
+}  // namespace agent::llm
@@ -0,0 +1,182 @@
+#include "hedged.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+
+namespace agent::llm {
+
+using Clock = std::chrono::steady_clock;
+
+// One hedged stream. Leg 0 is the primary, leg 1 the backup.
+struct HedgedProvider::Race {
+  Race(asio::io_context& io_ctx, const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete)
+      : request(request), callback(std::move(callback)), on_complete(std::move(on_complete)), timer(io_ctx) {}
+
+  LlmRequest request;
+  LlmRequest backup_request;  // request for HedgeOptions::backup_model, built when the backup starts
+  StreamCallback callback;
+  std::function<void()> on_complete;
+  asio::steady_timer timer;
+
+  std::mutex mutex;
+  std::array<Clock::time_point, 2> started_at;
+  std::array<bool, 2> started{false, false};
+  std::array<bool, 2> done{false, false};
+  std::array<std::vector<StreamError>, 2> errors;  // Held until it is known whether the other leg wins
+  int winner = -1;
+  bool cancelled = false;
+};
+
+HedgedProvider::HedgedProvider(std::shared_ptr<Provider> primary, std::shared_ptr<Provider> backup, asio::io_context& io_ctx, HedgeOptions options)
+    : primary_(std::move(primary)), backup_(std::move(backup)), io_ctx_(io_ctx), options_(options) {
+  stats_.threshold = options_.delay;
+}
+
+void HedgedProvider::stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) {
+  auto race = std::make_shared<Race>(io_ctx_, request, std::move(callback), std::move(on_complete));
+  std::chrono::milliseconds threshold;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.requests++;
+    threshold = threshold_locked();
+    stats_.threshold = threshold;
+    current_ = race;
+  }
+
+  race->timer.expires_after(threshold);
+  race->timer.async_wait([this, race](const asio::error_code& ec) {
+    if (ec) return;
+    {
+      std::lock_guard<std::mutex> lock(race->mutex);
+      if (race->winner != -1 || race->done[0] || race->cancelled) return;
+      race->started[1] = true;
+      race->started_at[1] = Clock::now();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.hedges++;
+    }
+    spdlog::debug("[Hedge] No first token from {} after {}ms, starting {}", primary_->name(),
+                  std::chrono::duration_cast<std::chrono::milliseconds>(race->started_at[1] - race->started_at[0]).count(), backup_->name());
+    start_leg(race, 1);
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(race->mutex);
+    race->started[0] = true;
+    race->started_at[0] = Clock::now();
+  }
+  start_leg(race, 0);
+}
+
+void HedgedProvider::cancel() {
+  std::shared_ptr<Race> race;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    race = current_.lock();
+  }
+  if (race) {
+    std::lock_guard<std::mutex> lock(race->mutex);
+    race->cancelled = true;
+    race->timer.cancel();
+  }
+  primary_->cancel();
+  backup_->cancel();
+}
+
+HedgeStats HedgedProvider::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::chrono::milliseconds HedgedProvider::threshold_locked() const {
+  if (!options_.adaptive || samples_.size() < std::max<size_t>(options_.min_samples, 1)) return options_.delay;
+
+  std::vector<std::chrono::milliseconds> sorted(samples_.begin(), samples_.end());
+  auto rank = static_cast<size_t>(options_.percentile * static_cast<double>(sorted.size() - 1));
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return std::clamp(sorted[rank], options_.min_delay, options_.max_delay);
+}
+
+void HedgedProvider::start_leg(const std::shared_ptr<Race>& race, int leg) {
+  auto& provider = leg == 0 ? primary_ : backup_;
+  const LlmRequest* request = &race->request;
+  if (leg == 1 && !options_.backup_model.empty()) {
+    race->backup_request = race->request;
+    race->backup_request.model = options_.backup_model;
+    request = &race->backup_request;
+  }
+  provider->stream(
+      *request,
+      [this, race, leg](const StreamEvent& event) {
+        on_event(race, leg, event);
+      },
+      [this, race, leg]() {
+        on_leg_complete(race, leg);
+      });
+}
+
+void HedgedProvider::on_event(const std::shared_ptr<Race>& race, int leg, const StreamEvent& event) {
+  bool cancel_loser = false;
+  std::vector<StreamError> loser_errors;
+  {
+    std::lock_guard<std::mutex> lock(race->mutex);
+    if (race->winner == -1) {
+      if (auto error = std::get_if<StreamError>(&event)) {
+        race->errors[leg].push_back(*error);
+        return;
+      }
+
+      // First token: this leg wins the race
+      race->winner = leg;
+      race->timer.cancel();
+      cancel_loser = race->started[1 - leg] && !race->done[1 - leg];
+      loser_errors = std::move(race->errors[1 - leg]);
+
+      // The threshold tracks the primary alone. When the backup wins, a primary still waiting has taken at least
+      // this long; one that already failed says nothing about its latency and leaves the window unchanged.
+      bool sample = leg == 0 || cancel_loser;
+      auto ttft = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - race->started_at[0]);
+      std::lock_guard<std::mutex> stats_lock(mutex_);
+      (leg == 0 ? stats_.primary_wins : stats_.hedge_wins)++;
+      if (sample) {
+        samples_.push_back(ttft);
+        while (samples_.size() > options_.window) samples_.pop_front();
+      }
+    } else if (race->winner != leg) {
+      return;  // Loser still draining before its cancellation lands
+    }
+  }
+
+  if (cancel_loser) (leg == 0 ? backup_ : primary_)->cancel();
+  // Not forwarded, but a backup that keeps failing (e.g. an unknown model) should not go unnoticed
+  for (const auto& error : loser_errors) {
+    spdlog::warn("[Hedge] {} failed while {} answered: {}", (leg == 0 ? backup_ : primary_)->name(), (leg == 0 ? primary_ : backup_)->name(),
+                 error.message);
+  }
+  race->callback(event);
+}
+
+void HedgedProvider::on_leg_complete(const std::shared_ptr<Race>& race, int leg) {
+  std::vector<StreamError> errors;
+  {
+    std::lock_guard<std::mutex> lock(race->mutex);
+    race->done[leg] = true;
+    if (race->winner != -1 && race->winner != leg) return;
+
+    if (race->winner == -1) {
+      // Ended without a token. Wait for the other leg if it is still running.
+      int other = 1 - leg;
+      if (race->started[other] && !race->done[other]) return;
+      race->timer.cancel();
+      errors = std::move(race->errors[leg]);
+    }
+  }
+
+  for (const auto& error : errors) race->callback(error);
+  race->on_complete();
+}
+
+}  // namespace agent::llm
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+#include "provider.hpp"
+
+namespace agent::llm {
+
+struct HedgeOptions {
+  std::chrono::milliseconds delay{3000};     // Start the backup when no first token arrived within this long
+  bool adaptive = true;                      // Once min_samples are known, hedge at the percentile of time-to-first-token
+  double percentile = 0.95;
+  size_t min_samples = 20;
+  size_t window = 200;                       // Most recent time-to-first-token samples kept
+  std::chrono::milliseconds min_delay{250};  // Bounds for the adaptive threshold
+  std::chrono::milliseconds max_delay{10000};
+  std::string backup_model;                  // Model the backup is asked for (empty = the request's model)
+};
+
+struct HedgeStats {
+  uint64_t requests = 0;                   // Streams started
+  uint64_t hedges = 0;                     // Streams where the backup was started
+  uint64_t hedge_wins = 0;                 // Streams where the backup produced the first token
+  uint64_t primary_wins = 0;               // Streams where the primary produced the first token (hedged or not)
+  std::chrono::milliseconds threshold{0};  // Current hedge threshold
+};
+
+// Provider wrapper that hedges slow streams: the request goes to the primary, and if no token has
+// arrived after the threshold the same request (for backup_model, when set) is also started on the backup. Whichever stream
+// delivers the first token is forwarded; the other is cancelled and its events dropped.
+// Providers keep per-stream state, so primary and backup must be separate instances, and only
+// one stream runs through the wrapper at a time (as with any Provider).
+class HedgedProvider : public Provider {
+ public:
+  HedgedProvider(std::shared_ptr<Provider> primary, std::shared_ptr<Provider> backup, asio::io_context& io_ctx, HedgeOptions options = {});
+
+  std::string name() const override {
+    return primary_->name();
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return primary_->models();
+  }
+
+  std::optional<ModelInfo> get_model(const std::string& model_id) const override {
+    return primary_->get_model(model_id);
+  }
+
+  // Non-streaming completions have no first token to race on and go to the primary
+  std::future<LlmResponse> complete(const LlmRequest& request) override {
+    return primary_->complete(request);
+  }
+
+  void stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) override;
+
+  void cancel() override;
+
+  HedgeStats stats() const;
+
+ private:
+  struct Race;
+
+  std::chrono::milliseconds threshold_locked() const;
+  void start_leg(const std::shared_ptr<Race>& race, int leg);
+  void on_event(const std::shared_ptr<Race>& race, int leg, const StreamEvent& event);
+  void on_leg_complete(const std::shared_ptr<Race>& race, int leg);
+
+  std::shared_ptr<Provider> primary_;
+  std::shared_ptr<Provider> backup_;
+  asio::io_context& io_ctx_;
+  HedgeOptions options_;
+
+  mutable std::mutex mutex_;
+  std::deque<std::chrono::milliseconds> samples_;  // Primary time-to-first-token; a lower bound when the backup won
+  HedgeStats stats_;
+  std::weak_ptr<Race> current_;  // Stream that cancel() stops
+};
+
+}  // namespace agent::llm
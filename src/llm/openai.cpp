@@ -2,7 +2,9 @@
 
 #include <spdlog/spdlog.h>
 
+#include "net/sse_parser.hpp"
 #include "plugin/auth_provider.hpp"
+#include "trace.hpp"
 
 namespace agent::llm {
 
@@ -25,18 +27,17 @@ std::future<LlmResponse> OpenAIProvider::complete(const LlmRequest& request) {
   auto promise = std::make_shared<std::promise<LlmResponse>>();
   auto future = promise->get_future();
 
-  auto body = request.to_openai_format();
-
   // Get authorization header via plugin system
   std::string auth_header = plugin::AuthProviderRegistry::instance().get_auth_header(config_.api_key);
 
   net::HttpOptions options;
   options.method = "POST";
-  options.body = body.dump();
+  options.body = request.to_openai_body();
   options.headers = {{"Content-Type", "application/json"}, {"Authorization", auth_header}};
-  options.timeout = std::chrono::seconds(120);            // 增加超时时间到2分钟
-  options.max_retries = 3;                                // 最多重试3次
-  options.retry_delay = std::chrono::milliseconds(2000);  // 重试间隔2秒
+  options.timeout = std::chrono::seconds(120);                 // 增加超时时间到2分钟
+  options.retry.max_retries = 3;                               // 最多重试3次
+  options.retry.base_delay = std::chrono::milliseconds(2000);  // 首次重试退避上限2秒（指数增长，随机抖动）
+  options.priority = request.priority;
 
   // Add organization header if configured
   if (config_.organization && !config_.organization->empty()) {
@@ -48,7 +49,12 @@ std::future<LlmResponse> OpenAIProvider::complete(const LlmRequest& request) {
     options.headers[key] = value;
   }
 
-  http_client_.request(base_url_ + "/v1/chat/completions", options, [promise](net::HttpResponse response) {
+  std::string url = base_url_ + "/v1/chat/completions";
+  uint64_t trace_id = TraceRecorder::enabled() ? TraceRecorder::instance().next_id() : 0;
+  if (trace_id) TraceRecorder::instance().request(trace_id, name(), url, options.body);
+
+  http_client_.request(url, options, [promise, trace_id](net::HttpResponse response) {
+    if (trace_id) TraceRecorder::instance().response(trace_id, response.status_code, response.body, response.error);
     LlmResponse result;
 
     if (!response.error.empty()) {
@@ -160,9 +166,6 @@ std::future<LlmResponse> OpenAIProvider::complete(const LlmRequest& request) {
 }
 
 void OpenAIProvider::stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) {
-  auto body = request.to_openai_format();
-  body["stream"] = true;
-
   // Get authorization header via plugin system
   std::string auth_header = plugin::AuthProviderRegistry::instance().get_auth_header(config_.api_key);
 
@@ -184,114 +187,59 @@ void OpenAIProvider::stream(const LlmRequest& request, StreamCallback callback,
 
   net::HttpOptions options;
   options.method = "POST";
-  options.body = body.dump();
+  options.body = request.to_openai_body(true);
   options.headers = headers;
-  options.timeout = std::chrono::seconds(180);            // 流式请求更长超时时间（3分钟）
-  options.max_retries = 2;                                // 流式请求重试次数少一些
-  options.retry_delay = std::chrono::milliseconds(3000);  // 重试间隔3秒
+  options.timeout = std::chrono::seconds(180);                 // 流式请求更长超时时间（3分钟）
+  options.retry.max_retries = 2;                               // 流式请求重试次数少一些
+  options.retry.base_delay = std::chrono::milliseconds(3000);  // 首次重试退避上限3秒
+  options.retry.kind = net::RetryKind::Streaming;              // 已输出内容后不再重发
+  options.priority = request.priority;
 
   spdlog::debug("[OpenAI] Request URL: {}/v1/chat/completions", base_url_);
   spdlog::debug("[OpenAI] Request model: {}", request.model);
   spdlog::debug("[OpenAI] Request messages count: {}", request.messages.size());
   spdlog::debug("[OpenAI] Request tools count: {}", request.tools.size());
 
-  // Log full request details at info level for debugging (similar to Anthropic format)
-  spdlog::info("[OpenAI] ===== Full LLM Request =====");
-
-  // Log system prompt
-  if (!request.system_prompt.empty()) {
-    spdlog::info("[OpenAI] System prompt ({} chars):\n{}", request.system_prompt.size(), request.system_prompt);
-  }
-
-  // Log tools with their descriptions
-  if (!request.tools.empty()) {
-    spdlog::info("[OpenAI] Tools ({}):", request.tools.size());
-    for (const auto& tool : request.tools) {
-      spdlog::info("[OpenAI]   - {}: {}", tool->id(), tool->description());
-    }
-  }
-
-  // Log conversation messages
-  spdlog::info("[OpenAI] Messages ({}):", request.messages.size());
-  for (size_t i = 0; i < request.messages.size(); i++) {
-    const auto& msg = request.messages[i];
-    std::string content = msg.text();
-    if (content.size() > 200) {
-      content = content.substr(0, 200) + "... (truncated)";
-    }
-    spdlog::info("[OpenAI]   [{}] {}: {}", i + 1, to_string(msg.role()), content);
-  }
-
-  // Log complete request body
-  auto body_json = json::parse(options.body);
-  spdlog::info("[OpenAI] Request body ({} bytes):\n{}", options.body.size(), body_json.dump(2));
-  spdlog::info("[OpenAI] ===== End Request =====");
+  std::string url = base_url_ + "/v1/chat/completions";
+  uint64_t trace_id = TraceRecorder::enabled() ? TraceRecorder::instance().next_id() : 0;
+  if (trace_id) TraceRecorder::instance().request(trace_id, name(), url, options.body);
 
   auto shared_callback = std::make_shared<StreamCallback>(std::move(callback));
   auto shared_complete = std::make_shared<std::function<void()>>(std::move(on_complete));
-  auto sse_buffer = std::make_shared<std::string>();
+  auto sse_parser = std::make_shared<net::SseParser>([this, shared_callback](const net::SseEventView& event) {
+    parse_sse_event(event.data, *shared_callback);
+  });
 
   // Use streaming HTTP request for real-time SSE processing
-  http_client_.request_stream(
-      base_url_ + "/v1/chat/completions", options,
-      [this, shared_callback, sse_buffer](const std::string& chunk) {
-        // Accumulate chunk into SSE buffer and parse complete events
+  http_client_.request_stream_view(
+      url, options,
+      [sse_parser, trace_id](std::string_view chunk) {
+        if (trace_id) TraceRecorder::instance().chunk(trace_id, chunk);
         spdlog::trace("[OpenAI] SSE chunk received ({} bytes): {}", chunk.size(), chunk.substr(0, std::min(chunk.size(), size_t(200))));
-        *sse_buffer += chunk;
-
-        // Process complete SSE events (ended by \n\n or \r\n\r\n)
-        size_t pos;
-        while ((pos = sse_buffer->find("\n\n")) != std::string::npos || (pos = sse_buffer->find("\r\n\r\n")) != std::string::npos) {
-          std::string event_block = sse_buffer->substr(0, pos);
-          size_t skip = (sse_buffer->substr(pos, 4) == "\r\n\r\n") ? 4 : 2;
-          *sse_buffer = sse_buffer->substr(pos + skip);
-
-          // Parse SSE event from block
-          std::istringstream stream(event_block);
-          std::string line;
-          std::string event_data;
-
-          while (std::getline(stream, line)) {
-            // Remove \r if present
-            if (!line.empty() && line.back() == '\r') {
-              line.pop_back();
-            }
-
-            if (line.starts_with("data: ")) {
-              if (!event_data.empty()) event_data += "\n";
-              event_data += line.substr(6);
-            }
-          }
-
-          if (!event_data.empty()) {
-            parse_sse_event(event_data, *shared_callback);
-          }
-        }
+        sse_parser->feed(chunk);
       },
-      [shared_callback, shared_complete](int status_code, const std::string& error) {
+      [shared_callback, shared_complete, trace_id](int status_code, const std::string& error, const std::map<std::string, std::string>& headers) {
         spdlog::debug("[OpenAI] Stream completed: status={}, error={}", status_code, error.empty() ? "(none)" : error);
+        if (trace_id) TraceRecorder::instance().end(trace_id, status_code, error);
         if (!error.empty()) {
           StreamError err;
           err.message = error;
+          err.retryable = net::RetryPolicy::retryable_error(error);
+          err.retry_after = net::RetryPolicy::server_delay(status_code, headers);
           (*shared_callback)(err);
         }
         (*shared_complete)();
       });
 }
 
-void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& callback) {
+void OpenAIProvider::parse_sse_event(std::string_view data, StreamCallback& callback) {
   spdlog::debug("[OpenAI] parse_sse_event: {}", data);
   if (data == "[DONE]") {
     spdlog::debug("[OpenAI] Received [DONE] signal, emitting {} remaining tool call(s)", tool_calls_.size());
     // Emit finish events for any remaining tool calls
     for (auto& [index, tc] : tool_calls_) {
       if (!tc.id.empty()) {
-        try {
-          json args = tc.args_json.empty() ? json::object() : json::parse(tc.args_json);
-          callback(ToolCallComplete{tc.id, tc.name, args});
-        } catch (...) {
-          callback(ToolCallComplete{tc.id, tc.name, json::object()});
-        }
+        callback(ToolCallComplete{tc.id, tc.name, tc.args.finish() ? tc.args.take() : json::object()});
       }
     }
 
@@ -306,6 +254,21 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
     return;
   }
 
+  // Content, reasoning and tool-argument chunks are nearly every event: read their few fields without a DOM
+  if (decode_openai_delta(data, delta_)) {
+    if (delta_.content) emit_content(*delta_.content, callback);
+    if (delta_.reasoning_content && !delta_.reasoning_content->empty()) {
+      spdlog::trace("[OpenAI] Thinking delta (reasoning_content): {}", *delta_.reasoning_content);
+      callback(ThinkingDelta{*delta_.reasoning_content});
+    }
+    if (delta_.reasoning && !delta_.reasoning->empty()) {
+      spdlog::trace("[OpenAI] Thinking delta (reasoning): {}", *delta_.reasoning);
+      callback(ThinkingDelta{*delta_.reasoning});
+    }
+    for (const auto& tc : delta_.tool_arguments) append_tool_arguments(tc.index, tc.arguments, callback);
+    return;
+  }
+
   try {
     auto j = json::parse(data);
 
@@ -360,71 +323,7 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
 
     // Parse text delta
     if (delta.contains("content") && !delta["content"].is_null()) {
-      std::string text = delta["content"].get<std::string>();
-      if (!text.empty()) {
-        // Handle <think>...</think> tags in content (DeepSeek style)
-        // Filter out these tags and their content from the normal output
-        // They should have been handled via reasoning_content, but some models embed them in content
-        std::string filtered_text;
-        size_t pos = 0;
-        while (pos < text.size()) {
-          // Look for <think> tag
-          size_t think_start = text.find("<think>", pos);
-          if (think_start == std::string::npos) {
-            // No more <think> tags, append the rest
-            filtered_text += text.substr(pos);
-            break;
-          }
-          // Append text before <think>
-          if (think_start > pos) {
-            filtered_text += text.substr(pos, think_start - pos);
-          }
-          // Look for </think> tag
-          size_t think_end = text.find("</think>", think_start);
-          if (think_end == std::string::npos) {
-            // No closing tag, skip to end
-            // The thinking content between <think> and end will be sent as ThinkingDelta
-            std::string thinking_content = text.substr(think_start + 7);  // 7 = len("<think>")
-            if (!thinking_content.empty()) {
-              in_thinking_block_ = true;
-              callback(ThinkingDelta{thinking_content});
-            }
-            break;
-          }
-          // Extract thinking content
-          std::string thinking_content = text.substr(think_start + 7, think_end - think_start - 7);
-          if (!thinking_content.empty()) {
-            callback(ThinkingDelta{thinking_content});
-          }
-          in_thinking_block_ = false;
-          pos = think_end + 8;  // 8 = len("</think>")
-        }
-
-        // Also handle standalone </think> tag (closing a block started in previous chunk)
-        if (in_thinking_block_) {
-          size_t close_tag = filtered_text.find("</think>");
-          if (close_tag != std::string::npos) {
-            // Content before </think> is thinking
-            std::string thinking_content = filtered_text.substr(0, close_tag);
-            if (!thinking_content.empty()) {
-              callback(ThinkingDelta{thinking_content});
-            }
-            filtered_text = filtered_text.substr(close_tag + 8);
-            in_thinking_block_ = false;
-          } else {
-            // Still in thinking block, all content is thinking
-            if (!filtered_text.empty()) {
-              callback(ThinkingDelta{filtered_text});
-              filtered_text.clear();
-            }
-          }
-        }
-
-        if (!filtered_text.empty()) {
-          spdlog::trace("[OpenAI] Text delta: {}", filtered_text);
-          callback(TextDelta{filtered_text});
-        }
-      }
+      emit_content(delta["content"].get<std::string>(), callback);
     }
 
     // Parse reasoning content (Qwen/DeepSeek/OpenAI o1 style thinking)
@@ -459,7 +358,7 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
             if (tc.contains("function") && tc["function"].contains("name")) {
               name = tc["function"]["name"].get<std::string>();
             }
-            tool_calls_[index] = ToolCallInfo{id, name, ""};
+            tool_calls_[index] = ToolCallInfo{id, name, {}};
             spdlog::debug("[OpenAI] New tool call: id={}, name={}, index={}", id, name, index);
             callback(ToolCallDelta{id, name, ""});
           }
@@ -467,12 +366,7 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
 
         // Accumulate function arguments
         if (tc.contains("function") && tc["function"].contains("arguments")) {
-          std::string args_delta = tc["function"]["arguments"].get<std::string>();
-          if (!args_delta.empty() && tool_calls_.count(index)) {
-            spdlog::trace("[OpenAI] Tool call arguments delta (index={}): {}", index, args_delta);
-            tool_calls_[index].args_json += args_delta;
-            callback(ToolCallDelta{tool_calls_[index].id, tool_calls_[index].name, args_delta});
-          }
+          append_tool_arguments(index, tc["function"]["arguments"].get<std::string>(), callback);
         }
       }
     }
@@ -492,12 +386,8 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
       if (finish_reason == "tool_calls") {
         for (auto& [index, tc] : tool_calls_) {
           if (!tc.id.empty()) {
-            try {
-              json args = tc.args_json.empty() ? json::object() : json::parse(tc.args_json);
-              callback(ToolCallComplete{tc.id, tc.name, args});
-            } catch (...) {
-              callback(ToolCallComplete{tc.id, tc.name, json::object()});
-            }
+            // Already parsed while streaming; missing or invalid JSON becomes an empty object
+            callback(ToolCallComplete{tc.id, tc.name, tc.args.finish() ? tc.args.take() : json::object()});
           }
         }
         tool_calls_.clear();
@@ -512,7 +402,86 @@ void OpenAIProvider::parse_sse_event(const std::string& data, StreamCallback& ca
   }
 }
 
+void OpenAIProvider::emit_content(const std::string& text, StreamCallback& callback) {
+  if (text.empty()) return;
+
+  // Handle <think>...</think> tags in content (DeepSeek style)
+  // Filter out these tags and their content from the normal output
+  // They should have been handled via reasoning_content, but some models embed them in content
+  std::string filtered_text;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    // Look for <think> tag
+    size_t think_start = text.find("<think>", pos);
+    if (think_start == std::string::npos) {
+      // No more <think> tags, append the rest
+      filtered_text += text.substr(pos);
+      break;
+    }
+    // Append text before <think>
+    if (think_start > pos) {
+      filtered_text += text.substr(pos, think_start - pos);
+    }
+    // Look for </think> tag
+    size_t think_end = text.find("</think>", think_start);
+    if (think_end == std::string::npos) {
+      // No closing tag, skip to end
+      // The thinking content between <think> and end will be sent as ThinkingDelta
+      std::string thinking_content = text.substr(think_start + 7);  // 7 = len("<think>")
+      if (!thinking_content.empty()) {
+        in_thinking_block_ = true;
+        callback(ThinkingDelta{thinking_content});
+      }
+      break;
+    }
+    // Extract thinking content
+    std::string thinking_content = text.substr(think_start + 7, think_end - think_start - 7);
+    if (!thinking_content.empty()) {
+      callback(ThinkingDelta{thinking_content});
+    }
+    in_thinking_block_ = false;
+    pos = think_end + 8;  // 8 = len("</think>")
+  }
+
+  // Also handle standalone </think> tag (closing a block started in previous chunk)
+  if (in_thinking_block_) {
+    size_t close_tag = filtered_text.find("</think>");
+    if (close_tag != std::string::npos) {
+      // Content before </think> is thinking
+      std::string thinking_content = filtered_text.substr(0, close_tag);
+      if (!thinking_content.empty()) {
+        callback(ThinkingDelta{thinking_content});
+      }
+      filtered_text = filtered_text.substr(close_tag + 8);
+      in_thinking_block_ = false;
+    } else {
+      // Still in thinking block, all content is thinking
+      if (!filtered_text.empty()) {
+        callback(ThinkingDelta{filtered_text});
+        filtered_text.clear();
+      }
+    }
+  }
+
+  if (!filtered_text.empty()) {
+    spdlog::trace("[OpenAI] Text delta: {}", filtered_text);
+    callback(TextDelta{filtered_text});
+  }
+}
+
+void OpenAIProvider::append_tool_arguments(int index, const std::string& args_delta, StreamCallback& callback) {
+  auto it = tool_calls_.find(index);
+  if (args_delta.empty() || it == tool_calls_.end()) return;
+  spdlog::trace("[OpenAI] Tool call arguments delta (index={}): {}", index, args_delta);
+  auto& tc = it->second;
+  if (!tc.args.failed() && !tc.args.feed(args_delta)) {
+    spdlog::warn("[OpenAI] Malformed arguments for tool call {} ({}): {}", tc.id, tc.name, tc.args.error());
+  }
+  callback(ToolCallDelta{tc.id, tc.name, args_delta});
+}
+
 void OpenAIProvider::cancel() {
+  http_client_.cancel();
   if (sse_client_) {
     sse_client_->stop();
   }
@@ -2,7 +2,9 @@
 
 #include "net/http_client.hpp"
 #include "net/sse_client.hpp"
+#include "partial_json.hpp"
 #include "provider.hpp"
+#include "stream_decoder.hpp"
 
 namespace agent::llm {
 
@@ -33,7 +35,10 @@ class OpenAIProvider : public Provider {
   net::HttpClient& get_http_client() const {
     return const_cast<net::HttpClient&>(http_client_);
   }
-  void parse_sse_event(const std::string& data, StreamCallback& callback);
+  void parse_sse_event(std::string_view data, StreamCallback& callback);
+  // Emit a content delta, splitting out <think>...</think> sections as thinking
+  void emit_content(const std::string& text, StreamCallback& callback);
+  void append_tool_arguments(int index, const std::string& args_delta, StreamCallback& callback);
 
   ProviderConfig config_;
   std::string base_url_ = "https://api.openai.com";
@@ -42,7 +47,7 @@ class OpenAIProvider : public Provider {
   struct ToolCallInfo {
     std::string id;
     std::string name;
-    std::string args_json;
+    PartialJsonParser args;  // Parsed as the fragments arrive
   };
   std::map<int, ToolCallInfo> tool_calls_;
 
@@ -52,6 +57,8 @@ class OpenAIProvider : public Provider {
   // Track whether we're inside a <think>...</think> block in content
   bool in_thinking_block_ = false;
 
+  OpenAIDelta delta_;  // Reused by the delta fast path
+
  private:
   asio::io_context& io_ctx_;
   net::HttpClient http_client_;
@@ -0,0 +1,378 @@
+#include "partial_json.hpp"
+
+#include <charconv>
+#include <cstdlib>
+
+namespace agent::llm {
+
+namespace {
+
+constexpr std::string_view kTrue = "true";
+constexpr std::string_view kFalse = "false";
+constexpr std::string_view kNull = "null";
+
+bool is_whitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool is_number_char(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+bool valid_number(std::string_view text, bool& integral) {
+  size_t i = 0;
+  auto digits = [&]() {
+    size_t start = i;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9') ++i;
+    return i > start;
+  };
+
+  if (i < text.size() && text[i] == '-') ++i;
+  if (i < text.size() && text[i] == '0') {
+    ++i;
+  } else if (!digits()) {
+    return false;
+  }
+  integral = true;
+  if (i < text.size() && text[i] == '.') {
+    ++i;
+    integral = false;
+    if (!digits()) return false;
+  }
+  if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+    ++i;
+    integral = false;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) ++i;
+    if (!digits()) return false;
+  }
+  return i == text.size();
+}
+
+}  // namespace
+
+PartialJsonParser::PartialJsonParser() {
+  stack_.reserve(8);
+}
+
+void PartialJsonParser::reset() {
+  root_ = nullptr;
+  stack_.clear();
+  expect_ = Expect::Value;
+  token_ = Token::None;
+  in_key_ = false;
+  key_.clear();
+  string_ = nullptr;
+  escape_ = 0;
+  unit_ = 0;
+  high_surrogate_ = 0;
+  number_.clear();
+  literal_ = {};
+  literal_pos_ = 0;
+  offset_ = 0;
+  started_ = false;
+  failed_ = false;
+  error_.clear();
+}
+
+json PartialJsonParser::take() {
+  json value = std::move(root_);
+  reset();
+  return value;
+}
+
+bool PartialJsonParser::feed(std::string_view fragment) {
+  if (failed_) return false;
+
+  size_t i = 0;
+  while (i < fragment.size()) {
+    char c = fragment[i];
+
+    if (token_ == Token::String) {
+      // Copy plain runs in bulk; escapes go one byte at a time
+      if (escape_ == 0) {
+        size_t run = string_chars(fragment.substr(i));
+        i += run;
+        offset_ += run;
+        if (failed_) return false;
+        if (i == fragment.size()) break;
+        c = fragment[i];
+        if (c == '"') {
+          if (high_surrogate_) return fail("unpaired surrogate");
+          token_ = Token::None;
+          if (in_key_) {
+            in_key_ = false;
+            expect_ = Expect::Colon;
+          } else {
+            value_done();
+          }
+        } else if (c == '\\') {
+          escape_ = 1;
+        } else {
+          return fail("control character in string");
+        }
+      } else if (!escape_char(c)) {
+        return false;
+      }
+      ++i;
+      ++offset_;
+      continue;
+    }
+
+    if (token_ == Token::Number) {
+      if (is_number_char(c)) {
+        number_.push_back(c);
+        ++i;
+        ++offset_;
+        continue;
+      }
+      if (!end_number()) return false;
+      // c still needs structural handling below
+    }
+
+    if (token_ == Token::Literal) {
+      if (c != literal_[literal_pos_]) return fail("invalid literal");
+      if (++literal_pos_ == literal_.size()) {
+        token_ = Token::None;
+        insert(literal_ == kTrue ? json(true) : literal_ == kFalse ? json(false) : json(nullptr));
+        value_done();
+      }
+      ++i;
+      ++offset_;
+      continue;
+    }
+
+    if (!structural(c)) return false;
+    ++i;
+    ++offset_;
+  }
+  return true;
+}
+
+bool PartialJsonParser::finish() {
+  if (token_ == Token::Number && stack_.empty()) end_number();
+  return complete();
+}
+
+bool PartialJsonParser::fail(const std::string& what) {
+  failed_ = true;
+  error_ = what + " at offset " + std::to_string(offset_);
+  return false;
+}
+
+bool PartialJsonParser::structural(char c) {
+  if (is_whitespace(c)) return true;
+  started_ = true;
+
+  switch (expect_) {
+    case Expect::ValueOrClose:
+      if (c == ']') break;
+      [[fallthrough]];
+    case Expect::Value:
+      return start_value(c);
+    case Expect::KeyOrClose:
+      if (c == '}') break;
+      [[fallthrough]];
+    case Expect::Key:
+      if (c != '"') return fail("expected object key");
+      key_.clear();
+      in_key_ = true;
+      token_ = Token::String;
+      return true;
+    case Expect::Colon:
+      if (c != ':') return fail("expected ':'");
+      expect_ = Expect::Value;
+      return true;
+    case Expect::CommaOrClose:
+      if (c == ',') {
+        expect_ = stack_.back().is_object ? Expect::Key : Expect::Value;
+        return true;
+      }
+      if (c == (stack_.back().is_object ? '}' : ']')) break;
+      return fail(std::string("unexpected '") + c + "'");
+    case Expect::End:
+      return fail("trailing characters");
+  }
+
+  // Closing bracket
+  stack_.pop_back();
+  value_done();
+  return true;
+}
+
+bool PartialJsonParser::start_value(char c) {
+  if (c == '{' || c == '[') {
+    if (stack_.size() >= kMaxDepth) return fail("nesting too deep");
+    bool is_object = c == '{';
+    json& node = insert(is_object ? json::object() : json::array());
+    stack_.push_back({stack_.empty() ? nullptr : &node, is_object});
+    expect_ = is_object ? Expect::KeyOrClose : Expect::ValueOrClose;
+    return true;
+  }
+  if (c == '"') {
+    // The node's string is heap-allocated by json, so this pointer survives moves of the node and parser
+    string_ = insert(json(std::string())).get_ptr<std::string*>();
+    token_ = Token::String;
+    return true;
+  }
+  if (c == '-' || (c >= '0' && c <= '9')) {
+    number_.assign(1, c);
+    token_ = Token::Number;
+    return true;
+  }
+  literal_ = c == 't' ? kTrue : c == 'f' ? kFalse : c == 'n' ? kNull : std::string_view();
+  if (literal_.empty()) return fail(std::string("unexpected '") + c + "'");
+  literal_pos_ = 1;
+  token_ = Token::Literal;
+  return true;
+}
+
+size_t PartialJsonParser::string_chars(std::string_view text) {
+  size_t n = 0;
+  while (n < text.size()) {
+    auto c = static_cast<unsigned char>(text[n]);
+    if (c == '"' || c == '\\' || c < 0x20) break;
+    ++n;
+  }
+  if (n > 0) {
+    if (high_surrogate_) {
+      fail("unpaired surrogate");
+      return 0;
+    }
+    string_target().append(text.data(), n);
+  }
+  return n;
+}
+
+bool PartialJsonParser::escape_char(char c) {
+  if (escape_ >= 2) {
+    int digit = hex_value(c);
+    if (digit < 0) return fail("invalid \\u escape");
+    unit_ = unit_ * 16 + digit;
+    if (++escape_ == 6) {
+      escape_ = 0;
+      return code_unit();
+    }
+    return true;
+  }
+
+  if (high_surrogate_ && c != 'u') return fail("unpaired surrogate");
+  escape_ = 0;
+  auto& out = string_target();
+  switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      out.push_back(c);
+      return true;
+    case 'b':
+      out.push_back('\b');
+      return true;
+    case 'f':
+      out.push_back('\f');
+      return true;
+    case 'n':
+      out.push_back('\n');
+      return true;
+    case 'r':
+      out.push_back('\r');
+      return true;
+    case 't':
+      out.push_back('\t');
+      return true;
+    case 'u':
+      escape_ = 2;
+      unit_ = 0;
+      return true;
+    default:
+      return fail("invalid escape");
+  }
+}
+
+bool PartialJsonParser::code_unit() {
+  if (high_surrogate_) {
+    if (unit_ < 0xDC00 || unit_ > 0xDFFF) return fail("unpaired surrogate");
+    append_utf8(string_target(), 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (unit_ - 0xDC00));
+    high_surrogate_ = 0;
+    return true;
+  }
+  if (unit_ >= 0xD800 && unit_ <= 0xDBFF) {
+    high_surrogate_ = unit_;  // The low half must follow as another \u escape
+    return true;
+  }
+  if (unit_ >= 0xDC00 && unit_ <= 0xDFFF) return fail("unpaired surrogate");
+  append_utf8(string_target(), unit_);
+  return true;
+}
+
+bool PartialJsonParser::end_number() {
+  token_ = Token::None;
+  bool integral = false;
+  if (!valid_number(number_, integral)) return fail("invalid number");
+
+  // Same representation as json::parse: unsigned if non-negative, signed if negative, double otherwise
+  json value;
+  auto first = number_.data();
+  auto last = first + number_.size();
+  if (integral && number_[0] != '-') {
+    uint64_t u = 0;
+    if (std::from_chars(first, last, u).ec == std::errc()) value = u;
+  } else if (integral) {
+    int64_t s = 0;
+    if (std::from_chars(first, last, s).ec == std::errc()) value = s;
+  }
+  if (value.is_null()) value = std::strtod(number_.c_str(), nullptr);
+
+  insert(std::move(value));
+  value_done();
+  return true;
+}
+
+json& PartialJsonParser::insert(json value) {
+  if (stack_.empty()) {
+    root_ = std::move(value);
+    return root_;
+  }
+  const auto& frame = stack_.back();
+  json& parent = frame.node ? *frame.node : root_;
+  if (frame.is_object) {
+    // Object members live in a std::map, so their addresses stay put as siblings are added
+    json& slot = parent[key_];
+    slot = std::move(value);
+    return slot;
+  }
+  // Earlier elements may move when the array grows, but only the last one is ever still open
+  parent.push_back(std::move(value));
+  return parent.back();
+}
+
+void PartialJsonParser::value_done() {
+  expect_ = stack_.empty() ? Expect::End : Expect::CommaOrClose;
+}
+
+}  // namespace agent::llm
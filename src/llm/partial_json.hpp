@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/types.hpp"
+
+namespace agent::llm {
+
+// Resumable JSON parser for values that arrive in fragments, such as streamed tool-call arguments.
+// Each byte is examined once, whatever the fragment boundaries, and the value is built in place:
+// containers appear as soon as they open, members as soon as their value completes, and a string
+// value grows while it streams. Malformed input is reported at the first bad byte.
+//
+//   PartialJsonParser args;
+//   args.feed(R"({"filePath": "src/ma)");  // value() == {"filePath": "src/ma"}
+//   args.feed(R"(in.cpp", "limit": 10})");  // complete(), value() == {"filePath": "src/main.cpp", "limit": 10}
+class PartialJsonParser {
+ public:
+  PartialJsonParser();
+
+  // Holds pointers into its own value: movable, not copyable
+  PartialJsonParser(const PartialJsonParser&) = delete;
+  PartialJsonParser& operator=(const PartialJsonParser&) = delete;
+  PartialJsonParser(PartialJsonParser&&) = default;
+  PartialJsonParser& operator=(PartialJsonParser&&) = default;
+
+  // Consume the next fragment. Returns false once the input is malformed; later fragments are ignored.
+  bool feed(std::string_view fragment);
+
+  // End of input: completes a trailing top-level number. Returns complete().
+  bool finish();
+
+  // Value built so far (null before any input). Only the last string may still be incomplete.
+  const json& value() const {
+    return root_;
+  }
+
+  // Take the value, leaving the parser reset
+  json take();
+
+  // A whole value has been parsed and nothing but whitespace followed
+  bool complete() const {
+    return expect_ == Expect::End && token_ == Token::None && !failed_;
+  }
+
+  // Some input other than whitespace has been consumed
+  bool started() const {
+    return started_;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+
+  // Why the input is malformed, with the offset of the offending byte
+  const std::string& error() const {
+    return error_;
+  }
+
+  // Bytes consumed so far
+  size_t size() const {
+    return offset_;
+  }
+
+  void reset();
+
+ private:
+  static constexpr size_t kMaxDepth = 64;
+
+  enum class Expect : uint8_t { Value, ValueOrClose, Key, KeyOrClose, Colon, CommaOrClose, End };
+  enum class Token : uint8_t { None, String, Number, Literal };
+
+  struct Frame {
+    json* node;  // nullptr for the root, which moves with the parser
+    bool is_object;
+  };
+
+  bool fail(const std::string& what);
+  bool structural(char c);
+  bool start_value(char c);
+  size_t string_chars(std::string_view text);
+  bool escape_char(char c);
+  bool code_unit();
+  bool end_number();
+  json& insert(json value);
+  void value_done();
+  std::string& string_target() {
+    return in_key_ ? key_ : *string_;
+  }
+
+  json root_;
+  std::vector<Frame> stack_;
+  Expect expect_ = Expect::Value;
+  Token token_ = Token::None;
+
+  // Current string: a key goes to key_, a value straight into its node
+  bool in_key_ = false;
+  std::string key_;
+  std::string* string_ = nullptr;
+  uint8_t escape_ = 0;  // 1 after a backslash, 2-5 while reading \uXXXX digits
+  uint32_t unit_ = 0;
+  uint32_t high_surrogate_ = 0;
+
+  std::string number_;
+  std::string_view literal_;
+  size_t literal_pos_ = 0;
+
+  size_t offset_ = 0;
+  bool started_ = false;
+  bool failed_ = false;
+  std::string error_;
+};
+
+}  // namespace agent::llm
@@ -0,0 +1,32 @@
+#include "prompt_cache.hpp"
+
+namespace agent::llm {
+
+CachePlan plan_cache_breakpoints(const LlmRequest& request) {
+  CachePlan plan;
+  int budget = kMaxCacheBreakpoints;
+  if (!request.tools.empty()) {
+    plan.tools = true;
+    --budget;
+  }
+  if (!request.system_prompt.empty()) {
+    plan.system = true;
+    --budget;
+  }
+
+  // Walk back from the newest message; system messages are not sent and empty ones have no block to mark
+  size_t blocks_since_mark = 0;
+  for (size_t i = request.messages.size(); i-- > 0 && budget > 0;) {
+    const auto& msg = request.messages[i];
+    if (msg.role() == Role::System || msg.parts().empty()) continue;
+    if (plan.messages.empty() || blocks_since_mark >= kCacheLookbackBlocks) {
+      plan.messages.push_back(i);
+      blocks_since_mark = 0;
+      --budget;
+    }
+    blocks_since_mark += msg.parts().size();
+  }
+  return plan;
+}
+
+}  // namespace agent::llm
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "provider.hpp"
+
+namespace agent::llm {
+
+// Anthropic allows at most this many cache_control markers per request
+constexpr int kMaxCacheBreakpoints = 4;
+
+// How far back (in content blocks) the API looks from a breakpoint for an earlier cache entry
+constexpr size_t kCacheLookbackBlocks = 20;
+
+// Where a request's prompt-cache breakpoints go. The cached prefix is tools, then system, then messages.
+struct CachePlan {
+  bool tools = false;            // After the last tool definition
+  bool system = false;           // After the system prompt
+  std::vector<size_t> messages;  // Indices into LlmRequest::messages, marked on their last content block
+};
+
+// Mark the tool list and the system prompt, which rarely change within a session, and spend the
+// remaining breakpoints on rolling points at the end of the history: the last message, so the next
+// request reads everything before its new turn from cache, then one every kCacheLookbackBlocks
+// blocks further back so that turns adding many blocks still reach the previous entry.
+CachePlan plan_cache_breakpoints(const LlmRequest& request);
+
+}  // namespace agent::llm
@@ -1,8 +1,12 @@
 #include "provider.hpp"
 
+#include <algorithm>
+#include <map>
+
 #include "llm/anthropic.hpp"
 #include "llm/ollama.hpp"
 #include "llm/openai.hpp"
+#include "llm/prompt_cache.hpp"
 
 namespace agent::llm {
 
@@ -21,24 +25,28 @@ ProviderFactory& ProviderFactory::instance() {
   return instance;
 }
 
-std::shared_ptr<Provider> ProviderFactory::create(const std::string& name, const ProviderConfig& config, asio::io_context& io_ctx) {
+void ProviderFactory::register_builtins() {
   // Ensure default providers are registered
   static bool initialized = false;
   if (!initialized) {
     initialized = true;
     // Register Anthropic provider
-    instance().register_provider("anthropic", [](const ProviderConfig& cfg, asio::io_context& ctx) {
+    register_provider("anthropic", [](const ProviderConfig& cfg, asio::io_context& ctx) {
       return std::make_shared<AnthropicProvider>(cfg, ctx);
     });
     // Register OpenAI provider
-    instance().register_provider("openai", [](const ProviderConfig& cfg, asio::io_context& ctx) {
+    register_provider("openai", [](const ProviderConfig& cfg, asio::io_context& ctx) {
       return std::make_shared<OpenAIProvider>(cfg, ctx);
     });
     // Register Ollama provider
-    instance().register_provider("ollama", [](const ProviderConfig& cfg, asio::io_context& ctx) {
+    register_provider("ollama", [](const ProviderConfig& cfg, asio::io_context& ctx) {
       return std::make_shared<OllamaProvider>(cfg, ctx);
     });
   }
+}
+
+std::shared_ptr<Provider> ProviderFactory::create(const std::string& name, const ProviderConfig& config, asio::io_context& io_ctx) {
+  register_builtins();
 
   auto it = factories_.find(name);
   if (it != factories_.end()) {
@@ -51,130 +59,140 @@ void ProviderFactory::register_provider(const std::string& name, FactoryFunc fac
   factories_[name] = std::move(factory);
 }
 
-// Helper to convert messages to Anthropic format
-json LlmRequest::to_anthropic_format() const {
-  json request;
-  request["model"] = model;
-  request["max_tokens"] = max_tokens.value_or(8192);
+ProviderFactory::FactoryFunc ProviderFactory::factory(const std::string& name) {
+  register_builtins();
+  auto it = factories_.find(name);
+  return it != factories_.end() ? it->second : nullptr;
+}
 
-  if (!system_prompt.empty()) {
-    request["system"] = system_prompt;
-  }
+namespace {
 
-  if (temperature) {
-    request["temperature"] = *temperature;
-  }
+// One message in Anthropic Messages API form; null for messages that are not sent (system)
+json anthropic_message(const Message& msg) {
+  if (msg.role() == Role::System) return nullptr;  // System handled separately
 
-  if (stop_sequences && !stop_sequences->empty()) {
-    request["stop_sequences"] = *stop_sequences;
-  }
+  json m;
+  m["role"] = msg.role() == Role::User ? "user" : "assistant";
 
-  // Convert messages
-  json msgs = json::array();
-  for (const auto& msg : messages) {
-    if (msg.role() == Role::System) continue;  // System handled separately
-
-    json m;
-    m["role"] = msg.role() == Role::User ? "user" : "assistant";
-
-    json content = json::array();
-    for (const auto& part : msg.parts()) {
-      if (auto* text = std::get_if<TextPart>(&part)) {
-        content.push_back({{"type", "text"}, {"text", text->text}});
-      } else if (auto* tc = std::get_if<ToolCallPart>(&part)) {
-        content.push_back({{"type", "tool_use"}, {"id", tc->id}, {"name", tc->name}, {"input", tc->arguments}});
-      } else if (auto* tr = std::get_if<ToolResultPart>(&part)) {
-        content.push_back({{"type", "tool_result"}, {"tool_use_id", tr->tool_call_id}, {"content", tr->output}, {"is_error", tr->is_error}});
-      } else if (auto* img = std::get_if<ImagePart>(&part)) {
-        // Handle base64 images
-        if (img->url.starts_with("data:")) {
-          auto comma = img->url.find(',');
-          if (comma != std::string::npos) {
-            auto media_type_end = img->url.find(';');
-            std::string media_type = img->url.substr(5, media_type_end - 5);
-            std::string data = img->url.substr(comma + 1);
-            content.push_back({{"type", "image"}, {"source", {{"type", "base64"}, {"media_type", media_type}, {"data", data}}}});
-          }
+  json content = json::array();
+  for (const auto& part : msg.parts()) {
+    if (auto* text = std::get_if<TextPart>(&part)) {
+      content.push_back({{"type", "text"}, {"text", text->text}});
+    } else if (auto* tc = std::get_if<ToolCallPart>(&part)) {
+      content.push_back({{"type", "tool_use"}, {"id", tc->id}, {"name", tc->name}, {"input", tc->arguments}});
+    } else if (auto* tr = std::get_if<ToolResultPart>(&part)) {
+      content.push_back({{"type", "tool_result"}, {"tool_use_id", tr->tool_call_id}, {"content", tr->output}, {"is_error", tr->is_error}});
+    } else if (auto* img = std::get_if<ImagePart>(&part)) {
+      // Handle base64 images
+      if (img->url.starts_with("data:")) {
+        auto comma = img->url.find(',');
+        if (comma != std::string::npos) {
+          auto media_type_end = img->url.find(';');
+          std::string media_type = img->url.substr(5, media_type_end - 5);
+          std::string data = img->url.substr(comma + 1);
+          content.push_back({{"type", "image"}, {"source", {{"type", "base64"}, {"media_type", media_type}, {"data", data}}}});
         }
       }
     }
+  }
 
-    if (content.size() == 1 && content[0]["type"] == "text") {
-      m["content"] = content[0]["text"];
+  if (content.size() == 1 && content[0]["type"] == "text") {
+    m["content"] = content[0]["text"];
+  } else {
+    m["content"] = content;
+  }
+  return m;
+}
+
+// Messages in OpenAI chat form; one history message may become several API messages
+void append_openai_messages(const Message& msg, json& msgs) {
+  if (msg.role() == Role::System) return;
+
+  // OpenAI requires tool results as separate role="tool" messages
+  auto tool_results = msg.tool_results();
+  if (!tool_results.empty()) {
+    // Also include any text content from the message as a user message
+    auto text = msg.text();
+    if (!text.empty()) {
+      msgs.push_back({{"role", "user"}, {"content", text}});
+    }
+
+    for (const auto* tr : tool_results) {
+      json tool_msg;
+      tool_msg["role"] = "tool";
+      tool_msg["tool_call_id"] = tr->tool_call_id;
+      tool_msg["content"] = tr->output;
+      msgs.push_back(tool_msg);
+    }
+  } else {
+    msgs.push_back(msg.to_api_format());
+  }
+}
+
+const json kEphemeral = {{"type", "ephemeral"}};
+
+// Put a cache breakpoint on a message's last content block
+void mark_cache_breakpoint(json& m) {
+  auto& content = m["content"];
+  if (content.is_string()) content = json::array({{{"type", "text"}, {"text", std::move(content)}}});
+  if (!content.empty()) content.back()["cache_control"] = kEphemeral;
+}
+
+// Everything but the messages
+json anthropic_envelope(const LlmRequest& r, const CachePlan& plan) {
+  json request;
+  request["model"] = r.model;
+  request["max_tokens"] = r.max_tokens.value_or(8192);
+
+  if (!r.system_prompt.empty()) {
+    if (plan.system) {
+      request["system"] = json::array({{{"type", "text"}, {"text", r.system_prompt}, {"cache_control", kEphemeral}}});
     } else {
-      m["content"] = content;
+      request["system"] = r.system_prompt;
     }
+  }
 
-    msgs.push_back(m);
+  if (r.temperature) {
+    request["temperature"] = *r.temperature;
+  }
+
+  if (r.stop_sequences && !r.stop_sequences->empty()) {
+    request["stop_sequences"] = *r.stop_sequences;
   }
-  request["messages"] = msgs;
 
   // Convert tools
-  if (!tools.empty()) {
+  if (!r.tools.empty()) {
     json tools_json = json::array();
-    for (const auto& tool : tools) {
+    for (const auto& tool : r.tools) {
       tools_json.push_back(tool->to_json_schema());
     }
+    if (plan.tools) tools_json.back()["cache_control"] = kEphemeral;
     request["tools"] = tools_json;
   }
-
   return request;
 }
 
-// Helper to convert messages to OpenAI format
-json LlmRequest::to_openai_format() const {
+// Everything but the messages (the system prompt travels as the first message)
+json openai_envelope(const LlmRequest& r) {
   json request;
-  request["model"] = model;
-
-  if (max_tokens) {
-    request["max_tokens"] = *max_tokens;
-  }
+  request["model"] = r.model;
 
-  if (temperature) {
-    request["temperature"] = *temperature;
+  if (r.max_tokens) {
+    request["max_tokens"] = *r.max_tokens;
   }
 
-  if (stop_sequences && !stop_sequences->empty()) {
-    request["stop"] = *stop_sequences;
-  }
-
-  // Convert messages
-  json msgs = json::array();
-
-  // Add system message if present
-  if (!system_prompt.empty()) {
-    msgs.push_back({{"role", "system"}, {"content", system_prompt}});
+  if (r.temperature) {
+    request["temperature"] = *r.temperature;
   }
 
-  for (const auto& msg : messages) {
-    if (msg.role() == Role::System) continue;
-
-    // OpenAI requires tool results as separate role="tool" messages
-    auto tool_results = msg.tool_results();
-    if (!tool_results.empty()) {
-      // Also include any text content from the message as a user message
-      auto text = msg.text();
-      if (!text.empty()) {
-        msgs.push_back({{"role", "user"}, {"content", text}});
-      }
-
-      for (const auto* tr : tool_results) {
-        json tool_msg;
-        tool_msg["role"] = "tool";
-        tool_msg["tool_call_id"] = tr->tool_call_id;
-        tool_msg["content"] = tr->output;
-        msgs.push_back(tool_msg);
-      }
-    } else {
-      msgs.push_back(msg.to_api_format());
-    }
+  if (r.stop_sequences && !r.stop_sequences->empty()) {
+    request["stop"] = *r.stop_sequences;
   }
-  request["messages"] = msgs;
 
   // Convert tools
-  if (!tools.empty()) {
+  if (!r.tools.empty()) {
     json tools_json = json::array();
-    for (const auto& tool : tools) {
+    for (const auto& tool : r.tools) {
       auto schema = tool->to_json_schema();
       // OpenAI uses "parameters" instead of "input_schema"
       json func = {{"name", schema["name"]}, {"description", schema["description"]}};
@@ -185,8 +203,110 @@ json LlmRequest::to_openai_format() const {
     }
     request["tools"] = tools_json;
   }
+  return request;
+}
+
+std::string anthropic_fragment(const Message& msg) {
+  auto m = anthropic_message(msg);
+  return m.is_null() ? std::string() : m.dump();
+}
+
+std::string openai_fragment(const Message& msg) {
+  json msgs = json::array();
+  append_openai_messages(msg, msgs);
+  std::string out;
+  for (const auto& m : msgs) {
+    if (!out.empty()) out += ',';
+    out += m.dump();
+  }
+  return out;
+}
+
+// Dump the envelope and splice the messages array in before its closing brace. Messages in marked are
+// sent as given there instead of from their cached fragment.
+std::string splice_body(json envelope, bool stream, const std::string& first, const std::vector<Message>& messages, Message::ApiFormat format,
+                        std::string (*render)(const Message&), const std::map<size_t, std::string>& marked = {}) {
+  if (stream) envelope["stream"] = true;
+  std::string body = envelope.dump();
+  body.pop_back();  // '}'
+
+  std::vector<const std::string*> fragments;
+  fragments.reserve(messages.size());
+  size_t size = body.size() + first.size() + 16;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    auto it = marked.find(i);
+    const auto& fragment = it != marked.end() ? it->second : messages[i].api_fragment(format, render);
+    if (fragment.empty()) continue;
+    fragments.push_back(&fragment);
+    size += fragment.size() + 1;
+  }
+
+  body.reserve(size);
+  body += body.size() > 1 ? ",\"messages\":[" : "\"messages\":[";
+  body += first;
+  for (const auto* fragment : fragments) {
+    if (body.back() != '[') body += ',';
+    body += *fragment;
+  }
+  body += "]}";
+  return body;
+}
 
+}  // namespace
+
+// Helper to convert messages to Anthropic format
+json LlmRequest::to_anthropic_format() const {
+  auto plan = prompt_cache ? plan_cache_breakpoints(*this) : CachePlan{};
+  json request = anthropic_envelope(*this, plan);
+
+  // Convert messages
+  json msgs = json::array();
+  for (size_t i = 0; i < messages.size(); ++i) {
+    auto m = anthropic_message(messages[i]);
+    if (m.is_null()) continue;
+    if (std::find(plan.messages.begin(), plan.messages.end(), i) != plan.messages.end()) mark_cache_breakpoint(m);
+    msgs.push_back(std::move(m));
+  }
+  request["messages"] = msgs;
   return request;
 }
 
+// Helper to convert messages to OpenAI format
+json LlmRequest::to_openai_format() const {
+  json request = openai_envelope(*this);
+
+  // Convert messages
+  json msgs = json::array();
+
+  // Add system message if present
+  if (!system_prompt.empty()) {
+    msgs.push_back({{"role", "system"}, {"content", system_prompt}});
+  }
+
+  for (const auto& msg : messages) {
+    append_openai_messages(msg, msgs);
+  }
+  request["messages"] = msgs;
+  return request;
+}
+
+std::string LlmRequest::to_anthropic_body(bool stream) const {
+  auto plan = prompt_cache ? plan_cache_breakpoints(*this) : CachePlan{};
+
+  // Breakpoints move every turn, so marked messages are rendered here and the cached fragments stay unmarked
+  std::map<size_t, std::string> marked;
+  for (size_t i : plan.messages) {
+    auto m = anthropic_message(messages[i]);
+    mark_cache_breakpoint(m);
+    marked[i] = m.dump();
+  }
+  return splice_body(anthropic_envelope(*this, plan), stream, "", messages, Message::ApiFormat::Anthropic, anthropic_fragment, marked);
+}
+
+std::string LlmRequest::to_openai_body(bool stream) const {
+  std::string system;
+  if (!system_prompt.empty()) system = json{{"role", "system"}, {"content", system_prompt}}.dump();
+  return splice_body(openai_envelope(*this), stream, system, messages, Message::ApiFormat::OpenAI, openai_fragment);
+}
+
 }  // namespace agent::llm
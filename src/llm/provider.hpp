@@ -1,15 +1,18 @@
 #pragma once
 
 #include <asio.hpp>
+#include <chrono>
 #include <functional>
 #include <future>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "core/message.hpp"
 #include "core/types.hpp"
+#include "net/request_scheduler.hpp"
 #include "tool/tool.hpp"
 
 namespace agent::llm {
@@ -45,6 +48,7 @@ struct FinishStep {
 struct StreamError {
   std::string message;
   bool retryable = false;
+  std::optional<std::chrono::milliseconds> retry_after;  // Wait the server asked for (Retry-After or a rate-limit reset)
 };
 
 using StreamEvent = std::variant<TextDelta, ThinkingDelta, ToolCallDelta, ToolCallComplete, FinishStep, StreamError>;
@@ -66,10 +70,22 @@ struct LlmRequest {
   std::optional<int> max_tokens;
   std::optional<std::vector<std::string>> stop_sequences;
 
+  // Queueing class for the HTTP request when the provider host is busy
+  net::RequestPriority priority = net::RequestPriority::Interactive;
+
+  // Mark prompt-cache breakpoints (plan_cache_breakpoints); only the Anthropic format has them
+  bool prompt_cache = false;
+
   // Convert to API-specific format
   json to_anthropic_format() const;
 
   json to_openai_format() const;
+
+  // The same request serialized for sending. Each message's fragment is cached on the message
+  // (Message::api_fragment), so only new or changed messages are converted again.
+  std::string to_anthropic_body(bool stream = false) const;
+
+  std::string to_openai_body(bool stream = false) const;
 };
 
 // LLM response (non-streaming)
@@ -121,7 +137,12 @@ class ProviderFactory {
 
   void register_provider(const std::string& name, FactoryFunc factory);
 
+  // Factory registered under name (nullptr if none), e.g. to wrap it before registering a replacement
+  FactoryFunc factory(const std::string& name);
+
  private:
+  void register_builtins();
+
   std::map<std::string, FactoryFunc> factories_;
 };
 
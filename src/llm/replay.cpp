@@ -0,0 +1,468 @@
+#include "replay.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+namespace agent::llm {
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+uint64_t fnv1a(std::string_view data) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::chrono::microseconds since(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+}
+
+bool ends_stream(const StreamEvent& event) {
+  return std::holds_alternative<FinishStep>(event) || std::holds_alternative<StreamError>(event);
+}
+
+LlmResponse response_from_events(const std::vector<ReplayEvent>& events) {
+  LlmResponse response;
+  response.finish_reason = FinishReason::Stop;
+  Message msg(Role::Assistant, "");
+  std::string thinking;
+  std::string text;
+  std::vector<ToolCallComplete> calls;
+  for (const auto& e : events) {
+    if (auto* t = std::get_if<TextDelta>(&e.event)) {
+      text += t->text;
+    } else if (auto* th = std::get_if<ThinkingDelta>(&e.event)) {
+      thinking += th->text;
+    } else if (auto* tc = std::get_if<ToolCallComplete>(&e.event)) {
+      calls.push_back(*tc);
+    } else if (auto* finish = std::get_if<FinishStep>(&e.event)) {
+      response.finish_reason = finish->reason;
+      response.usage = finish->usage;
+    } else if (auto* error = std::get_if<StreamError>(&e.event)) {
+      response.error = error->message;
+      response.finish_reason = FinishReason::Error;
+    }
+  }
+  if (!thinking.empty()) msg.add_thinking(thinking);
+  if (!text.empty()) msg.add_text(text);
+  for (const auto& tc : calls) msg.add_tool_call(tc.id, tc.name, tc.arguments);
+  response.message = std::move(msg);
+  return response;
+}
+
+json usage_to_json(const TokenUsage& usage) {
+  return {{"input_tokens", usage.input_tokens},
+          {"output_tokens", usage.output_tokens},
+          {"cache_read_tokens", usage.cache_read_tokens},
+          {"cache_write_tokens", usage.cache_write_tokens}};
+}
+
+TokenUsage usage_from_json(const json& j) {
+  TokenUsage usage;
+  usage.input_tokens = j.value("input_tokens", int64_t{0});
+  usage.output_tokens = j.value("output_tokens", int64_t{0});
+  usage.cache_read_tokens = j.value("cache_read_tokens", int64_t{0});
+  usage.cache_write_tokens = j.value("cache_write_tokens", int64_t{0});
+  return usage;
+}
+
+}  // namespace
+
+std::string request_fingerprint(const LlmRequest& request) {
+  LlmRequest canonical = request;  // Messages are copy-on-write, so this shares their cached fragments
+  canonical.prompt_cache = false;
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(fnv1a(canonical.to_anthropic_body(true))));
+  return buf;
+}
+
+json to_json(const StreamEvent& event) {
+  return std::visit(
+      [](const auto& e) -> json {
+        using T = std::decay_t<decltype(e)>;
+        if constexpr (std::is_same_v<T, TextDelta>) {
+          return {{"type", "text"}, {"text", e.text}};
+        } else if constexpr (std::is_same_v<T, ThinkingDelta>) {
+          return {{"type", "thinking"}, {"text", e.text}};
+        } else if constexpr (std::is_same_v<T, ToolCallDelta>) {
+          return {{"type", "tool_call_delta"}, {"id", e.id}, {"name", e.name}, {"arguments", e.arguments_delta}};
+        } else if constexpr (std::is_same_v<T, ToolCallComplete>) {
+          return {{"type", "tool_call"}, {"id", e.id}, {"name", e.name}, {"arguments", e.arguments}};
+        } else if constexpr (std::is_same_v<T, FinishStep>) {
+          return {{"type", "finish"}, {"reason", to_string(e.reason)}, {"usage", usage_to_json(e.usage)}};
+        } else {
+          json j = {{"type", "error"}, {"message", e.message}, {"retryable", e.retryable}};
+          if (e.retry_after) j["retry_after_ms"] = e.retry_after->count();
+          return j;
+        }
+      },
+      event);
+}
+
+StreamEvent stream_event_from_json(const json& j) {
+  auto type = j.value("type", "");
+  if (type == "text") return TextDelta{j.value("text", "")};
+  if (type == "thinking") return ThinkingDelta{j.value("text", "")};
+  if (type == "tool_call_delta") return ToolCallDelta{j.value("id", ""), j.value("name", ""), j.value("arguments", "")};
+  if (type == "tool_call") return ToolCallComplete{j.value("id", ""), j.value("name", ""), j.value("arguments", json::object())};
+  if (type == "finish") return FinishStep{finish_reason_from_string(j.value("reason", "stop")), usage_from_json(j.value("usage", json::object()))};
+  if (type == "error") {
+    std::optional<std::chrono::milliseconds> retry_after;
+    if (j.contains("retry_after_ms")) retry_after = std::chrono::milliseconds(j["retry_after_ms"].get<int64_t>());
+    return StreamError{j.value("message", ""), j.value("retryable", false), retry_after};
+  }
+  return StreamError{"replay: unknown event type '" + type + "'", false, std::nullopt};
+}
+
+// ---- ReplayCassette ----
+
+namespace {
+
+struct OpenCassettes {
+  std::mutex mutex;
+  std::map<std::filesystem::path, std::weak_ptr<ReplayCassette>> by_path;
+};
+
+OpenCassettes& open_cassettes() {
+  static OpenCassettes cassettes;
+  return cassettes;
+}
+
+}  // namespace
+
+std::shared_ptr<ReplayCassette> ReplayCassette::open(const std::filesystem::path& path) {
+  std::error_code ec;
+  auto key = std::filesystem::weakly_canonical(path, ec);
+  if (ec) key = path;
+
+  auto& registry = open_cassettes();
+  std::lock_guard lock(registry.mutex);
+  auto& slot = registry.by_path[key];
+  auto cassette = slot.lock();
+  if (!cassette) {
+    cassette = std::make_shared<ReplayCassette>(path);
+    slot = cassette;
+  }
+  return cassette;
+}
+
+ReplayCassette::ReplayCassette(std::filesystem::path path) : path_(std::move(path)) {
+  std::ifstream file(path_);
+  if (!file) return;
+  try {
+    auto j = json::parse(file);
+    for (const auto& r : j.value("recordings", json::array())) {
+      auto recording = std::make_shared<ReplayRecording>();
+      recording->fingerprint = r.value("fingerprint", "");
+      recording->model = r.value("model", "");
+      for (const auto& e : r.value("events", json::array())) {
+        recording->events.push_back({std::chrono::microseconds(e.value("at_us", int64_t{0})), stream_event_from_json(e)});
+      }
+      recordings_.push_back(std::move(recording));
+    }
+  } catch (const std::exception& e) {
+    spdlog::warn("[Replay] Cannot read cassette {}: {}", path_.string(), e.what());
+    recordings_.clear();
+  }
+  played_.assign(recordings_.size(), false);
+  spdlog::info("[Replay] Loaded {} recordings from {}", recordings_.size(), path_.string());
+}
+
+ReplayCassette::~ReplayCassette() {
+  if (unsaved_ && !path_.empty()) save_locked();
+}
+
+void ReplayCassette::save_open() {
+  std::vector<std::shared_ptr<ReplayCassette>> cassettes;
+  {
+    auto& registry = open_cassettes();
+    std::lock_guard lock(registry.mutex);
+    for (const auto& [path, weak] : registry.by_path) {
+      if (auto cassette = weak.lock()) cassettes.push_back(std::move(cassette));
+    }
+  }
+  for (const auto& cassette : cassettes) {
+    std::lock_guard lock(cassette->mutex_);
+    if (cassette->unsaved_) cassette->save_locked();
+  }
+}
+
+void ReplayCassette::add(ReplayRecording recording) {
+  std::lock_guard lock(mutex_);
+  recordings_.push_back(std::make_shared<const ReplayRecording>(std::move(recording)));
+  played_.push_back(true);  // Recorded in this run, so not replayed in it
+  unsaved_ = true;
+}
+
+std::shared_ptr<const ReplayRecording> ReplayCassette::next(const std::string& fingerprint, bool sequential, bool* exact) {
+  std::lock_guard lock(mutex_);
+  auto take = [&](size_t i, bool by_fingerprint) {
+    played_[i] = true;
+    if (exact) *exact = by_fingerprint;
+    return recordings_[i];
+  };
+
+  std::optional<size_t> last_match;
+  for (size_t i = 0; i < recordings_.size(); ++i) {
+    if (recordings_[i]->fingerprint != fingerprint) continue;
+    if (!played_[i]) return take(i, true);
+    last_match = i;
+  }
+  if (last_match) return take(*last_match, true);
+
+  if (sequential) {
+    for (size_t i = 0; i < recordings_.size(); ++i) {
+      if (!played_[i]) return take(i, false);
+    }
+  }
+  return nullptr;
+}
+
+void ReplayCassette::rewind() {
+  std::lock_guard lock(mutex_);
+  played_.assign(recordings_.size(), false);
+}
+
+size_t ReplayCassette::size() const {
+  std::lock_guard lock(mutex_);
+  return recordings_.size();
+}
+
+bool ReplayCassette::save() const {
+  std::lock_guard lock(mutex_);
+  return save_locked();
+}
+
+bool ReplayCassette::save_locked() const {
+  json recordings = json::array();
+  for (const auto& r : recordings_) {
+    json events = json::array();
+    for (const auto& e : r->events) {
+      json j = to_json(e.event);
+      j["at_us"] = e.at.count();
+      events.push_back(std::move(j));
+    }
+    recordings.push_back({{"fingerprint", r->fingerprint}, {"model", r->model}, {"events", std::move(events)}});
+  }
+
+  // Write a sibling file and rename it over the cassette, so a crash never leaves half a file
+  std::error_code ec;
+  if (path_.has_parent_path()) std::filesystem::create_directories(path_.parent_path(), ec);
+  auto tmp = path_;
+  tmp += ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      spdlog::warn("[Replay] Cannot write cassette {}", path_.string());
+      return false;
+    }
+    file << json{{"version", 1}, {"recordings", std::move(recordings)}}.dump(1, ' ', false, json::error_handler_t::replace);
+  }
+  std::filesystem::rename(tmp, path_, ec);
+  if (!ec) unsaved_ = false;
+  return !ec;
+}
+
+// ---- ReplayProvider ----
+
+struct ReplayProvider::Playback {
+  Playback(asio::io_context& io_ctx, std::shared_ptr<const ReplayRecording> recording, StreamCallback callback, std::function<void()> on_complete)
+      : recording(std::move(recording)), callback(std::move(callback)), on_complete(std::move(on_complete)), timer(io_ctx) {}
+
+  std::shared_ptr<const ReplayRecording> recording;
+  StreamCallback callback;
+  std::function<void()> on_complete;
+  asio::steady_timer timer;
+  Clock::time_point start = Clock::now();
+  Clock::time_point due = start;  // Time of the previous event
+  size_t next = 0;
+  std::atomic<bool> cancelled{false};
+};
+
+ReplayProvider::ReplayProvider(std::shared_ptr<Provider> upstream, std::shared_ptr<ReplayCassette> cassette, asio::io_context& io_ctx,
+                               ReplayOptions options)
+    : upstream_(std::move(upstream)), cassette_(std::move(cassette)), io_ctx_(io_ctx), options_(options), rng_(options.seed) {}
+
+std::shared_ptr<const ReplayRecording> ReplayProvider::find(const LlmRequest& request, std::string& fingerprint) {
+  fingerprint = request_fingerprint(request);
+  bool exact = false;
+  auto recording = cassette_->next(fingerprint, options_.sequential, &exact);
+
+  std::lock_guard lock(mutex_);
+  if (!recording) {
+    stats_.missed++;
+  } else if (exact) {
+    stats_.exact++;
+  } else {
+    stats_.sequential++;
+  }
+  return recording;
+}
+
+std::future<LlmResponse> ReplayProvider::complete(const LlmRequest& request) {
+  if (options_.record && upstream_) {
+    // Built on stream(), which adds the recording when the upstream stream ends, whether or not
+    // the caller ever waits on the future
+    auto promise = std::make_shared<std::promise<LlmResponse>>();
+    auto events = std::make_shared<std::vector<ReplayEvent>>();
+    auto result = promise->get_future();
+    stream(
+        request,
+        [events](const StreamEvent& event) {
+          events->push_back({{}, event});
+        },
+        [promise, events]() {
+          auto response = response_from_events(*events);
+          if (events->empty() || !ends_stream(events->back().event)) {
+            response.finish_reason = FinishReason::Error;
+            response.error = "replay: upstream stream ended without finishing";
+          }
+          promise->set_value(std::move(response));
+        });
+    return result;
+  }
+
+  std::string fingerprint;
+  LlmResponse response;
+  if (auto recording = find(request, fingerprint)) {
+    response = response_from_events(recording->events);
+  } else {
+    response.finish_reason = FinishReason::Error;
+    response.error = "replay: no recording for request " + fingerprint;
+  }
+  std::promise<LlmResponse> promise;
+  promise.set_value(std::move(response));
+  return promise.get_future();
+}
+
+void ReplayProvider::stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) {
+  if (options_.record && upstream_) {
+    auto recording = std::make_shared<ReplayRecording>();
+    recording->fingerprint = request_fingerprint(request);
+    recording->model = request.model;
+    auto start = Clock::now();
+    upstream_->stream(
+        request,
+        [recording, start, callback](const StreamEvent& event) {
+          recording->events.push_back({since(start), event});
+          callback(event);
+        },
+        [this, recording, on_complete]() {
+          // A cancelled stream has no ending and would replay as a truncated answer
+          if (!recording->events.empty() && ends_stream(recording->events.back().event)) {
+            cassette_->add(std::move(*recording));
+            std::lock_guard lock(mutex_);
+            stats_.recorded++;
+          }
+          on_complete();
+        });
+    return;
+  }
+
+  std::string fingerprint;
+  auto recording = find(request, fingerprint);
+  if (!recording) {
+    spdlog::warn("[Replay] No recording for request {} ({} in cassette)", fingerprint, cassette_->size());
+    ReplayRecording missing;
+    missing.events.push_back({{}, StreamError{"replay: no recording for request " + fingerprint, false, std::nullopt}});
+    recording = std::make_shared<const ReplayRecording>(std::move(missing));
+  }
+
+  auto playback = std::make_shared<Playback>(io_ctx_, std::move(recording), std::move(callback), std::move(on_complete));
+  {
+    std::lock_guard lock(mutex_);
+    current_ = playback;
+  }
+  schedule(playback);
+}
+
+void ReplayProvider::schedule(const std::shared_ptr<Playback>& playback) {
+  const auto& events = playback->recording->events;
+  if (playback->next == events.size()) {
+    playback->on_complete();
+    return;
+  }
+
+  Clock::time_point due;
+  switch (options_.pacing) {
+    case ReplayPacing::MaxSpeed:
+      // One handler per event, as a network stream would be, so other work interleaves
+      asio::post(io_ctx_, [this, playback]() {
+        step(playback);
+      });
+      return;
+    case ReplayPacing::Recorded:
+      due = playback->start + events[playback->next].at;
+      break;
+    case ReplayPacing::Injected:
+      due = std::max(playback->due, playback->due + jittered(playback->next == 0 ? options_.first_token_latency : options_.event_interval));
+      break;
+  }
+  playback->due = due;
+  playback->timer.expires_at(due);
+  playback->timer.async_wait([this, playback](const asio::error_code& ec) {
+    if (ec) {
+      playback->on_complete();
+      return;
+    }
+    step(playback);
+  });
+}
+
+void ReplayProvider::step(const std::shared_ptr<Playback>& playback) {
+  if (playback->cancelled.load()) {
+    playback->on_complete();
+    return;
+  }
+  playback->callback(playback->recording->events[playback->next++].event);
+  schedule(playback);
+}
+
+Clock::duration ReplayProvider::jittered(std::chrono::microseconds delay) {
+  if (options_.jitter.count() <= 0) return delay;
+  std::lock_guard lock(mutex_);
+  std::uniform_int_distribution<int64_t> offset(-options_.jitter.count(), options_.jitter.count());
+  return delay + std::chrono::microseconds(offset(rng_));
+}
+
+void ReplayProvider::cancel() {
+  if (options_.record && upstream_) {
+    upstream_->cancel();
+    return;
+  }
+  std::shared_ptr<Playback> playback;
+  {
+    std::lock_guard lock(mutex_);
+    playback = current_.lock();
+  }
+  if (!playback) return;
+  playback->cancelled.store(true);
+  // The timer belongs to the io_context thread; a pending wait ends with operation_aborted
+  asio::post(io_ctx_, [playback]() {
+    playback->timer.cancel();
+  });
+}
+
+ReplayStats ReplayProvider::stats() const {
+  std::lock_guard lock(mutex_);
+  return stats_;
+}
+
+void register_replay_provider(const std::string& name, std::shared_ptr<ReplayCassette> cassette, ReplayOptions options) {
+  auto& factory = ProviderFactory::instance();
+  auto upstream = factory.factory(name);
+  factory.register_provider(name, [upstream, cassette, options](const ProviderConfig& config, asio::io_context& io_ctx) {
+    return std::make_shared<ReplayProvider>(upstream ? upstream(config, io_ctx) : nullptr, cassette, io_ctx, options);
+  });
+}
+
+}  // namespace agent::llm
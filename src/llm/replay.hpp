@@ -0,0 +1,158 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <random>
+
+#include "provider.hpp"
+
+namespace agent::llm {
+
+// One stream event and when it arrived, relative to the start of the request
+struct ReplayEvent {
+  std::chrono::microseconds at{0};
+  StreamEvent event;
+};
+
+struct ReplayRecording {
+  std::string fingerprint;  // request_fingerprint of the request that produced it
+  std::string model;
+  std::vector<ReplayEvent> events;
+};
+
+// Stable hash of everything a provider is sent for request (model, system prompt, tools, messages,
+// generation parameters), independent of transport details such as prompt-cache markers
+std::string request_fingerprint(const LlmRequest& request);
+
+json to_json(const StreamEvent& event);
+StreamEvent stream_event_from_json(const json& j);
+
+// Recorded streams, kept in a JSON file:
+//
+//   {"version": 1, "recordings": [{"fingerprint": "9f2c...", "model": "claude-...",
+//     "events": [{"at_us": 412000, "type": "text", "text": "Hello"}, ..., {"at_us": 980000, "type": "finish", ...}]}]}
+//
+// A request replays the next unplayed recording with its fingerprint; a request that was recorded
+// more than once (a retry, the same prompt in a later run) thus gets its recordings in order.
+class ReplayCassette {
+ public:
+  // Cassettes are shared per path, so every provider of the process (main session, subagents,
+  // several sessions) records into one file and replays from one sequence
+  static std::shared_ptr<ReplayCassette> open(const std::filesystem::path& path);
+
+  ReplayCassette() = default;  // In memory only
+
+  explicit ReplayCassette(std::filesystem::path path);  // Loads path when it exists
+
+  ~ReplayCassette();  // Saves recordings not yet written
+
+  // Save every cassette from open() that has recordings not yet written, e.g. at shutdown
+  static void save_open();
+
+  // Append a recording in memory; it is written by the next save(), or when the cassette is destroyed
+  void add(ReplayRecording recording);
+
+  // Recording to replay for fingerprint: the next unplayed one with that fingerprint, else the last
+  // one with it, else (with sequential set) the next unplayed recording in file order, else nullptr
+  std::shared_ptr<const ReplayRecording> next(const std::string& fingerprint, bool sequential, bool* exact = nullptr);
+
+  // Mark every recording unplayed, e.g. between benchmark iterations
+  void rewind();
+
+  size_t size() const;
+
+  bool save() const;
+
+  const std::filesystem::path& path() const {
+    return path_;
+  }
+
+ private:
+  bool save_locked() const;
+
+  mutable std::mutex mutex_;
+  std::filesystem::path path_;
+  std::vector<std::shared_ptr<const ReplayRecording>> recordings_;
+  std::vector<bool> played_;
+  mutable bool unsaved_ = false;  // Recordings added since the last save
+};
+
+enum class ReplayPacing {
+  Recorded,  // Events at their recorded offsets
+  MaxSpeed,  // Every event as soon as the io_context gets to it
+  Injected,  // first_token_latency, then event_interval between events, each varied by jitter
+};
+
+struct ReplayOptions {
+  bool record = false;  // Record the upstream provider's streams instead of replaying
+  ReplayPacing pacing = ReplayPacing::Recorded;
+  std::chrono::microseconds first_token_latency{0};
+  std::chrono::microseconds event_interval{0};
+  std::chrono::microseconds jitter{0};  // Uniform in [-jitter, +jitter], never before the previous event
+  uint32_t seed = 1;                    // Jitter is reproducible for a given seed
+  bool sequential = true;               // Replay the next recording in order when no fingerprint matches
+};
+
+struct ReplayStats {
+  uint64_t recorded = 0;
+  uint64_t exact = 0;       // Replayed by fingerprint
+  uint64_t sequential = 0;  // Replayed in recording order for lack of a match
+  uint64_t missed = 0;      // Nothing to replay: answered with a StreamError
+};
+
+// Provider that records an upstream provider's streams into a cassette (events with their timing,
+// keyed by request fingerprint), or replays them without network access: at recorded speed, at
+// maximum speed, or with synthetic latency. Sessions, the TUI and tool scheduling run against it
+// unchanged, which makes end-to-end runs reproducible and usable as benchmarks.
+class ReplayProvider : public Provider {
+ public:
+  // upstream is only used when recording (and for model info); it may be null for replay
+  ReplayProvider(std::shared_ptr<Provider> upstream, std::shared_ptr<ReplayCassette> cassette, asio::io_context& io_ctx, ReplayOptions options = {});
+
+  std::string name() const override {
+    return upstream_ ? upstream_->name() : "replay";
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return upstream_ ? upstream_->models() : std::vector<ModelInfo>{};
+  }
+
+  std::optional<ModelInfo> get_model(const std::string& model_id) const override {
+    return upstream_ ? upstream_->get_model(model_id) : std::nullopt;
+  }
+
+  // Replayed completions are assembled from the recorded events and returned without delay;
+  // recorded ones go through stream() and are added to the cassette as the upstream stream ends
+  std::future<LlmResponse> complete(const LlmRequest& request) override;
+
+  void stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) override;
+
+  void cancel() override;
+
+  ReplayStats stats() const;
+
+ private:
+  struct Playback;
+
+  std::shared_ptr<const ReplayRecording> find(const LlmRequest& request, std::string& fingerprint);
+  void schedule(const std::shared_ptr<Playback>& playback);
+  void step(const std::shared_ptr<Playback>& playback);
+  std::chrono::steady_clock::duration jittered(std::chrono::microseconds delay);
+
+  std::shared_ptr<Provider> upstream_;
+  std::shared_ptr<ReplayCassette> cassette_;
+  asio::io_context& io_ctx_;
+  ReplayOptions options_;
+
+  mutable std::mutex mutex_;
+  ReplayStats stats_;
+  std::mt19937 rng_;
+  std::weak_ptr<Playback> current_;  // Stream that cancel() stops
+};
+
+// Route every provider that ProviderFactory creates under name through a ReplayProvider on cassette.
+// When recording, the factory registered under name before supplies the upstream provider.
+void register_replay_provider(const std::string& name, std::shared_ptr<ReplayCassette> cassette, ReplayOptions options = {});
+
+}  // namespace agent::llm
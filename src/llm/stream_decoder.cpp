@@ -0,0 +1,434 @@
+#include "stream_decoder.hpp"
+
+#include <charconv>
+
+namespace agent::llm {
+
+// ---- JsonScanner ----
+
+bool JsonScanner::enter_object() {
+  skip_whitespace();
+  if (failed_ || pos_ >= text_.size() || text_[pos_] != '{') return fail();
+  ++pos_;
+  return push();
+}
+
+std::optional<std::string_view> JsonScanner::next_key() {
+  skip_whitespace();
+  if (failed_ || depth_ == 0 || pos_ >= text_.size()) {
+    fail();
+    return std::nullopt;
+  }
+  if (text_[pos_] == '}') {
+    pop();
+    return std::nullopt;
+  }
+
+  uint64_t bit = uint64_t{1} << (depth_ - 1);
+  if (has_items_ & bit) {
+    if (text_[pos_] != ',') {
+      fail();
+      return std::nullopt;
+    }
+    ++pos_;
+    skip_whitespace();
+  }
+  has_items_ |= bit;
+
+  if (pos_ >= text_.size() || text_[pos_] != '"') {
+    fail();
+    return std::nullopt;
+  }
+  size_t start = pos_ + 1;
+  if (!skip_string()) return std::nullopt;
+  auto key = text_.substr(start, pos_ - 1 - start);
+
+  skip_whitespace();
+  if (pos_ >= text_.size() || text_[pos_] != ':') {
+    fail();
+    return std::nullopt;
+  }
+  ++pos_;
+  return key;
+}
+
+bool JsonScanner::enter_array() {
+  skip_whitespace();
+  if (failed_ || pos_ >= text_.size() || text_[pos_] != '[') return fail();
+  ++pos_;
+  return push();
+}
+
+bool JsonScanner::next_element() {
+  skip_whitespace();
+  if (failed_ || depth_ == 0 || pos_ >= text_.size()) return fail();
+  if (text_[pos_] == ']') {
+    pop();
+    return false;
+  }
+
+  uint64_t bit = uint64_t{1} << (depth_ - 1);
+  if (has_items_ & bit) {
+    if (text_[pos_] != ',') return fail();
+    ++pos_;
+  }
+  has_items_ |= bit;
+  return true;
+}
+
+bool JsonScanner::read_string(std::string& out) {
+  skip_whitespace();
+  if (failed_ || pos_ >= text_.size() || text_[pos_] != '"') return fail();
+  ++pos_;
+  out.clear();
+
+  while (true) {
+    // Copy the run up to the next quote or escape in one go
+    size_t run = pos_;
+    while (run < text_.size() && text_[run] != '"' && text_[run] != '\\') ++run;
+    out.append(text_.data() + pos_, run - pos_);
+    pos_ = run;
+    if (pos_ >= text_.size()) return fail();
+    if (text_[pos_] == '"') {
+      ++pos_;
+      return true;
+    }
+
+    if (pos_ + 1 >= text_.size()) return fail();
+    char escape = text_[pos_ + 1];
+    pos_ += 2;
+    switch (escape) {
+      case '"':
+        out.push_back('"');
+        break;
+      case '\\':
+        out.push_back('\\');
+        break;
+      case '/':
+        out.push_back('/');
+        break;
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'u': {
+        auto hex4 = [this](uint32_t& value) {
+          if (pos_ + 4 > text_.size()) return false;
+          auto [end, ec] = std::from_chars(text_.data() + pos_, text_.data() + pos_ + 4, value, 16);
+          if (ec != std::errc() || end != text_.data() + pos_ + 4) return false;
+          pos_ += 4;
+          return true;
+        };
+        uint32_t code = 0;
+        if (!hex4(code)) return fail();
+        if (code >= 0xD800 && code <= 0xDBFF) {
+          // Surrogate pair; a lone surrogate is left to the full parser to reject
+          uint32_t low = 0;
+          if (text_.substr(pos_, 2) != "\\u") return fail();
+          pos_ += 2;
+          if (!hex4(low) || low < 0xDC00 || low > 0xDFFF) return fail();
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+          return fail();
+        }
+        // UTF-8 encode
+        if (code < 0x80) {
+          out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+          out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+          out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+          out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+          out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+          out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+          out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        break;
+      }
+      default:
+        return fail();
+    }
+  }
+}
+
+bool JsonScanner::read_string_view(std::string_view& out) {
+  skip_whitespace();
+  if (failed_ || pos_ >= text_.size() || text_[pos_] != '"') return fail();
+  size_t start = pos_ + 1;
+  size_t end = start;
+  while (end < text_.size() && text_[end] != '"' && text_[end] != '\\') ++end;
+  if (end >= text_.size() || text_[end] != '"') return fail();
+  out = text_.substr(start, end - start);
+  pos_ = end + 1;
+  return true;
+}
+
+bool JsonScanner::read_int(int64_t& out) {
+  skip_whitespace();
+  if (failed_) return false;
+  auto begin = text_.data() + pos_;
+  auto [end, ec] = std::from_chars(begin, text_.data() + text_.size(), out);
+  if (ec != std::errc()) return fail();
+  pos_ += end - begin;
+  // Fractions and exponents are not integers
+  if (pos_ < text_.size() && (text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E')) return fail();
+  return true;
+}
+
+bool JsonScanner::read_null() {
+  skip_whitespace();
+  if (failed_ || text_.substr(pos_, 4) != "null") return false;
+  pos_ += 4;
+  return true;
+}
+
+bool JsonScanner::skip_value() {
+  skip_whitespace();
+  if (failed_ || pos_ >= text_.size()) return fail();
+
+  char c = text_[pos_];
+  if (c == '"') return skip_string();
+
+  if (c == '{' || c == '[') {
+    // Brackets only need to balance; strings are skipped so their contents cannot confuse the count
+    int nesting = 0;
+    while (pos_ < text_.size()) {
+      c = text_[pos_];
+      if (c == '"') {
+        if (!skip_string()) return false;
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        ++nesting;
+      } else if (c == '}' || c == ']') {
+        if (--nesting == 0) {
+          ++pos_;
+          return true;
+        }
+      }
+      ++pos_;
+    }
+    return fail();
+  }
+
+  // Number or literal
+  size_t start = pos_;
+  while (pos_ < text_.size()) {
+    c = text_[pos_];
+    bool token = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+    if (!token) break;
+    ++pos_;
+  }
+  return pos_ > start || fail();
+}
+
+bool JsonScanner::at_end() {
+  skip_whitespace();
+  return !failed_ && depth_ == 0 && pos_ == text_.size();
+}
+
+bool JsonScanner::fail() {
+  failed_ = true;
+  return false;
+}
+
+void JsonScanner::skip_whitespace() {
+  while (pos_ < text_.size()) {
+    char c = text_[pos_];
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') break;
+    ++pos_;
+  }
+}
+
+bool JsonScanner::skip_string() {
+  ++pos_;  // Opening quote
+  while (pos_ < text_.size()) {
+    char c = text_[pos_];
+    if (c == '\\') {
+      pos_ += 2;
+    } else if (c == '"') {
+      ++pos_;
+      return true;
+    } else {
+      ++pos_;
+    }
+  }
+  return fail();
+}
+
+bool JsonScanner::push() {
+  if (depth_ >= kMaxDepth) return fail();
+  has_items_ &= ~(uint64_t{1} << depth_);
+  ++depth_;
+  return true;
+}
+
+void JsonScanner::pop() {
+  ++pos_;  // Closing bracket
+  --depth_;
+}
+
+// ---- Provider decoders ----
+
+bool decode_anthropic_delta(std::string_view data, AnthropicDelta& out) {
+  JsonScanner scanner(data);
+  std::string_view type;
+  std::string_view delta_type;
+  int64_t index = 0;
+  bool has_text = false;
+
+  if (!scanner.enter_object()) return false;
+  while (auto key = scanner.next_key()) {
+    if (*key == "type") {
+      scanner.read_string_view(type);
+    } else if (*key == "index") {
+      scanner.read_int(index);
+    } else if (*key == "delta") {
+      if (!scanner.enter_object()) return false;
+      while (auto field = scanner.next_key()) {
+        if (*field == "type") {
+          scanner.read_string_view(delta_type);
+        } else if (*field == "text" || *field == "partial_json") {
+          has_text = scanner.read_string(out.text);
+        } else {
+          scanner.skip_value();
+        }
+      }
+    } else {
+      scanner.skip_value();
+    }
+  }
+  if (!scanner.at_end()) return false;
+
+  if (type == "ping") {
+    out.kind = AnthropicDelta::Kind::Ping;
+    return true;
+  }
+  if (type != "content_block_delta" || !has_text) return false;
+
+  out.index = static_cast<int>(index);
+  if (delta_type == "text_delta") {
+    out.kind = AnthropicDelta::Kind::Text;
+  } else if (delta_type == "input_json_delta") {
+    out.kind = AnthropicDelta::Kind::InputJson;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+// null leaves the field unset, as the full parser ignores null deltas
+bool read_optional_string(JsonScanner& scanner, std::optional<std::string>& out) {
+  if (scanner.read_null()) return true;
+  if (!out) out.emplace();
+  return scanner.read_string(*out);
+}
+
+bool decode_tool_arguments(JsonScanner& scanner, OpenAIDelta& out) {
+  if (!scanner.enter_array()) return false;
+  while (scanner.next_element()) {
+    auto& call = out.tool_arguments.emplace_back();
+    if (!scanner.enter_object()) return false;
+    while (auto key = scanner.next_key()) {
+      if (*key == "index") {
+        int64_t index = 0;
+        if (!scanner.read_int(index)) return false;
+        call.index = static_cast<int>(index);
+      } else if (*key == "id") {
+        // A non-empty id starts a new tool call, which the full parser handles
+        std::string_view id;
+        if (!scanner.read_null() && (!scanner.read_string_view(id) || !id.empty())) return false;
+      } else if (*key == "function") {
+        if (!scanner.enter_object()) return false;
+        while (auto field = scanner.next_key()) {
+          if (*field == "arguments") {
+            if (!scanner.read_string(call.arguments)) return false;
+          } else {
+            scanner.skip_value();
+          }
+        }
+      } else {
+        scanner.skip_value();
+      }
+    }
+  }
+  return !scanner.failed();
+}
+
+bool decode_openai_choice(JsonScanner& scanner, OpenAIDelta& out) {
+  bool has_delta = false;
+  if (!scanner.enter_object()) return false;
+  while (auto key = scanner.next_key()) {
+    if (*key == "delta") {
+      has_delta = true;
+      if (!scanner.enter_object()) return false;
+      while (auto field = scanner.next_key()) {
+        bool ok = true;
+        if (*field == "content") {
+          ok = read_optional_string(scanner, out.content);
+        } else if (*field == "reasoning_content") {
+          ok = read_optional_string(scanner, out.reasoning_content);
+        } else if (*field == "reasoning") {
+          ok = read_optional_string(scanner, out.reasoning);
+        } else if (*field == "tool_calls") {
+          ok = decode_tool_arguments(scanner, out);
+        } else {
+          ok = scanner.skip_value();
+        }
+        if (!ok) return false;
+      }
+    } else if (*key == "finish_reason") {
+      if (!scanner.read_null()) return false;
+    } else {
+      scanner.skip_value();
+    }
+  }
+  return has_delta && !scanner.failed();
+}
+
+}  // namespace
+
+bool decode_openai_delta(std::string_view data, OpenAIDelta& out) {
+  out.content.reset();
+  out.reasoning_content.reset();
+  out.reasoning.reset();
+  out.tool_arguments.clear();
+
+  JsonScanner scanner(data);
+  int choices = 0;
+  if (!scanner.enter_object()) return false;
+  while (auto key = scanner.next_key()) {
+    if (*key == "choices") {
+      if (!scanner.enter_array()) return false;
+      while (scanner.next_element()) {
+        if (++choices > 1 || !decode_openai_choice(scanner, out)) return false;
+      }
+    } else if (*key == "usage") {
+      if (!scanner.read_null()) return false;
+    } else if (*key == "error") {
+      return false;
+    } else {
+      scanner.skip_value();
+    }
+  }
+  return scanner.at_end() && choices == 1;
+}
+
+}  // namespace agent::llm
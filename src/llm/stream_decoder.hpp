@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace agent::llm {
+
+// Pull scanner over one JSON document. It decodes only what the caller asks for and skips
+// everything else without building a DOM. Any syntax error sets failed(); all later reads fail.
+//
+//   JsonScanner scanner(text);
+//   if (scanner.enter_object()) {
+//     while (auto key = scanner.next_key()) {
+//       if (*key == "text") scanner.read_string(text); else scanner.skip_value();
+//     }
+//   }
+//   bool ok = scanner.at_end();
+class JsonScanner {
+ public:
+  explicit JsonScanner(std::string_view text) : text_(text) {}
+
+  // Objects: after enter_object(), next_key() returns each key until the closing brace.
+  // Exactly one value must be read or skipped after every key. Keys are returned undecoded.
+  bool enter_object();
+  std::optional<std::string_view> next_key();
+
+  // Arrays: after enter_array(), next_element() is true before each element
+  bool enter_array();
+  bool next_element();
+
+  // Decode a string value into out (escapes resolved)
+  bool read_string(std::string& out);
+
+  // String value without escapes (enum-like fields such as "type"); fails on a backslash
+  bool read_string_view(std::string_view& out);
+
+  bool read_int(int64_t& out);
+
+  // Consume a null; false (consuming nothing) when the next value is not null
+  bool read_null();
+
+  bool skip_value();
+
+  // The document was well formed up to here and only whitespace remains
+  bool at_end();
+
+  bool failed() const {
+    return failed_;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 64;
+
+  bool fail();
+  void skip_whitespace();
+  bool skip_string();
+  bool push();
+  void pop();
+
+  std::string_view text_;
+  size_t pos_ = 0;
+  int depth_ = 0;
+  uint64_t has_items_ = 0;  // Bit per open container: an element was already read, so a comma comes next
+  bool failed_ = false;
+};
+
+// High-rate Anthropic stream events, decoded without a DOM
+struct AnthropicDelta {
+  enum class Kind { Ping, Text, InputJson };
+
+  Kind kind = Kind::Ping;
+  int index = 0;
+  std::string text;  // text_delta text or input_json_delta partial_json
+};
+
+// Decode a content_block_delta (text_delta or input_json_delta) or a ping. Returns false for any
+// other event, or anything unexpected, so the caller falls back to the full parse.
+bool decode_anthropic_delta(std::string_view data, AnthropicDelta& out);
+
+// High-rate OpenAI chat.completion.chunk content, decoded without a DOM
+struct OpenAIDelta {
+  struct ToolArguments {
+    int index = 0;
+    std::string arguments;
+  };
+
+  std::optional<std::string> content;
+  std::optional<std::string> reasoning_content;  // Qwen/DeepSeek/o1 style
+  std::optional<std::string> reasoning;          // Ollama style
+  std::vector<ToolArguments> tool_arguments;     // Argument fragments of tool calls already started
+};
+
+// Decode a chunk with a single choice whose delta carries only content, reasoning and/or tool-call
+// argument fragments, with no finish_reason, usage or error. Returns false for anything else
+// (including a tool call's first chunk, which carries its id and name) so the caller falls back.
+bool decode_openai_delta(std::string_view data, OpenAIDelta& out);
+
+}  // namespace agent::llm
@@ -0,0 +1,306 @@
+#include "trace.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <istream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <ostream>
+
+#include "net/sse_parser.hpp"
+
+namespace agent::llm {
+
+using json = nlohmann::json;
+
+namespace {
+
+int64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Length of the longest prefix of text that does not end inside a UTF-8 sequence
+size_t complete_utf8_prefix(std::string_view text) {
+  size_t n = text.size();
+  for (size_t back = 1; back <= 3 && back <= n; ++back) {
+    auto c = static_cast<unsigned char>(text[n - back]);
+    if ((c & 0xC0) == 0x80) continue;  // Continuation byte: keep looking for the lead byte
+    size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    return length > back ? n - back : n;
+  }
+  return n;
+}
+
+std::string format_time(int64_t time_us) {
+  auto seconds = static_cast<std::time_t>(time_us / 1000000);
+  std::tm tm{};
+#ifdef _WIN32
+  localtime_s(&tm, &seconds);
+#else
+  localtime_r(&seconds, &tm);
+#endif
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  char ms[8];
+  std::snprintf(ms, sizeof(ms), ".%03d", static_cast<int>(time_us / 1000 % 1000));
+  return std::string(buf) + ms;
+}
+
+std::string format_ms(int64_t us) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%+.1f ms", us / 1000.0);
+  return buf;
+}
+
+// Indented JSON when text parses, otherwise text as is
+std::string pretty(std::string_view text) {
+  auto j = json::parse(text, nullptr, false);
+  return j.is_discarded() ? std::string(text) : j.dump(2);
+}
+
+}  // namespace
+
+TraceRecorder& TraceRecorder::instance() {
+  static TraceRecorder instance;
+  return instance;
+}
+
+TraceRecorder::~TraceRecorder() {
+  stop();
+}
+
+bool TraceRecorder::start(const std::filesystem::path& path, size_t max_queued_bytes) {
+  stop();
+  std::lock_guard lock(mutex_);
+  std::error_code ec;
+  if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+  file_.open(path, std::ios::binary | std::ios::app);
+  if (!file_) {
+    spdlog::warn("[Trace] Cannot open trace file {}", path.string());
+    return false;
+  }
+  stopping_ = false;
+  queued_bytes_ = 0;
+  max_queued_bytes_ = max_queued_bytes;
+  dropped_records_ = 0;
+  dropped_bytes_ = 0;
+  dropped_total_.store(0, std::memory_order_relaxed);
+  writer_ = std::thread([this] {
+    writer_loop();
+  });
+  enabled_.store(true, std::memory_order_relaxed);
+  spdlog::info("[Trace] Recording provider traffic to {}", path.string());
+  return true;
+}
+
+void TraceRecorder::stop() {
+  enabled_.store(false, std::memory_order_relaxed);
+  {
+    std::lock_guard lock(mutex_);
+    if (!writer_.joinable()) return;
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  writer_.join();
+  std::lock_guard lock(mutex_);
+  file_.close();
+}
+
+void TraceRecorder::request(uint64_t id, std::string_view provider, std::string_view url, std::string_view body) {
+  push({now_us(), id, Kind::Request, 0, std::string(provider), std::string(url), std::string(body)});
+}
+
+void TraceRecorder::chunk(uint64_t id, std::string_view bytes) {
+  push({now_us(), id, Kind::Chunk, 0, {}, {}, std::string(bytes)});
+}
+
+void TraceRecorder::end(uint64_t id, int status, std::string_view error) {
+  push({now_us(), id, Kind::End, status, {}, {}, std::string(error)});
+}
+
+void TraceRecorder::response(uint64_t id, int status, std::string_view body, std::string_view error) {
+  chunk(id, body);
+  end(id, status, error);
+}
+
+void TraceRecorder::push(Record record) {
+  size_t size = record.provider.size() + record.url.size() + record.data.size();
+  {
+    std::lock_guard lock(mutex_);
+    if (!writer_.joinable() || stopping_) return;
+    if (queued_bytes_ + size > max_queued_bytes_) {
+      // The writer fell behind: count the record instead of growing the queue without bound
+      dropped_records_++;
+      dropped_bytes_ += size;
+      dropped_total_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    queued_bytes_ += size;
+    queue_.push_back(std::move(record));
+  }
+  cv_.notify_one();
+}
+
+void TraceRecorder::writer_loop() {
+  std::vector<Record> batch;
+  std::map<uint64_t, std::string> partial;  // Chunk bytes cut inside a UTF-8 sequence, by request id
+  std::string line;
+  auto write = [this, &line](const json& j) {
+    line = j.dump(-1, ' ', false, json::error_handler_t::replace);  // Invalid UTF-8 becomes U+FFFD
+    line += '\n';
+    file_.write(line.data(), static_cast<std::streamsize>(line.size()));
+  };
+
+  while (true) {
+    uint64_t dropped_records = 0;
+    uint64_t dropped_bytes = 0;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this] {
+        return stopping_ || !queue_.empty();
+      });
+      if (queue_.empty() && dropped_records_ == 0) break;  // Stopping, and everything is written
+      batch.swap(queue_);
+      queued_bytes_ = 0;
+      std::swap(dropped_records, dropped_records_);
+      std::swap(dropped_bytes, dropped_bytes_);
+    }
+
+    for (auto& r : batch) {
+      json j;
+      j["t"] = r.time_us;
+      j["id"] = r.id;
+      switch (r.kind) {
+        case Kind::Request:
+          j["kind"] = "request";
+          j["provider"] = std::move(r.provider);
+          j["url"] = std::move(r.url);
+          j["data"] = std::move(r.data);
+          break;
+        case Kind::Chunk: {
+          // JSON strings hold whole characters: a sequence split by the network waits for its next chunk
+          auto& carry = partial[r.id];
+          carry += r.data;
+          size_t n = complete_utf8_prefix(carry);
+          j["kind"] = "chunk";
+          j["data"] = carry.substr(0, n);
+          carry.erase(0, n);
+          break;
+        }
+        case Kind::End:
+          if (auto it = partial.find(r.id); it != partial.end()) {
+            if (!it->second.empty()) write({{"t", r.time_us}, {"id", r.id}, {"kind", "chunk"}, {"data", it->second}});
+            partial.erase(it);
+          }
+          j["kind"] = "end";
+          j["status"] = r.status;
+          j["error"] = std::move(r.data);
+          break;
+      }
+      write(j);
+    }
+    // Records that did not fit came after those queued before them
+    if (dropped_records > 0) {
+      write({{"t", now_us()}, {"id", 0}, {"kind", "dropped"}, {"records", dropped_records}, {"bytes", dropped_bytes}});
+    }
+    batch.clear();
+    file_.flush();
+  }
+}
+
+void print_trace(std::istream& in, std::ostream& out) {
+  struct Exchange {
+    json request;
+    std::vector<json> chunks;
+    json end;
+  };
+  std::map<uint64_t, Exchange> exchanges;
+  std::vector<uint64_t> order;
+  uint64_t dropped_records = 0;
+  uint64_t dropped_bytes = 0;
+
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    if (line.empty()) continue;
+    auto j = json::parse(line, nullptr, false);
+    if (j.is_discarded() || !j.contains("id")) {
+      out << "(line " << line_number << ": not a trace record)\n";
+      continue;
+    }
+    auto id = j["id"].get<uint64_t>();
+    auto kind = j.value("kind", "");
+    if (kind == "dropped") {
+      dropped_records += j.value("records", uint64_t{0});
+      dropped_bytes += j.value("bytes", uint64_t{0});
+      continue;
+    }
+    auto [it, inserted] = exchanges.try_emplace(id);
+    if (inserted) order.push_back(id);
+    if (kind == "request") {
+      it->second.request = std::move(j);
+    } else if (kind == "chunk") {
+      it->second.chunks.push_back(std::move(j));
+    } else if (kind == "end") {
+      it->second.end = std::move(j);
+    }
+  }
+
+  if (dropped_records > 0) {
+    out << "(" << dropped_records << " records, " << dropped_bytes << " bytes dropped while the trace writer fell behind;"
+        << " exchanges may be incomplete)\n\n";
+  }
+
+  for (auto id : order) {
+    const auto& ex = exchanges[id];
+    int64_t start = ex.request.is_null() ? (ex.chunks.empty() ? 0 : ex.chunks.front().value("t", int64_t{0})) : ex.request.value("t", int64_t{0});
+
+    out << "=== #" << id;
+    if (!ex.request.is_null()) {
+      auto body = ex.request.value("data", "");
+      out << " " << ex.request.value("provider", "") << " " << ex.request.value("url", "") << " (" << body.size() << " bytes) at "
+          << format_time(start) << "\n"
+          << pretty(body) << "\n";
+    } else {
+      out << " (request not recorded)\n";
+    }
+
+    std::string body;
+    for (const auto& c : ex.chunks) body += c.value("data", "");
+
+    out << "--- response";
+    if (!ex.end.is_null()) {
+      out << " (status " << ex.end.value("status", 0) << ", " << format_ms(ex.end.value("t", start) - start);
+      auto error = ex.end.value("error", "");
+      if (!error.empty()) out << ", error: " << error;
+      out << ")";
+    } else {
+      out << " (incomplete)";
+    }
+    out << ", " << ex.chunks.size() << " chunks, " << body.size() << " bytes\n";
+
+    // Server-sent events, each stamped with the arrival of the chunk that completed it
+    size_t events = 0;
+    int64_t chunk_time = start;
+    net::SseParser parser([&](const net::SseEventView& event) {
+      ++events;
+      out << format_ms(chunk_time - start);
+      if (!event.event.empty()) out << "  event: " << event.event;
+      out << "\n" << pretty(event.data) << "\n";
+    });
+    for (const auto& c : ex.chunks) {
+      chunk_time = c.value("t", start);
+      parser.feed(c.value("data", ""));
+    }
+
+    // Not an event stream (e.g. a non-streaming completion): the whole body
+    if (events == 0 && !body.empty()) out << pretty(body) << "\n";
+    out << "\n";
+  }
+}
+
+}  // namespace agent::llm
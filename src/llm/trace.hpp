@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace agent::llm {
+
+// Records raw provider traffic to an NDJSON file for offline inspection (print_trace). Off by default;
+// providers test enabled() before building any record, so a disabled recorder costs one relaxed load.
+// While on, the calling thread only copies the bytes into a queue; a background thread encodes and
+// writes them. The queue is bounded: when the writer falls behind, records are dropped and a "dropped"
+// line with their count takes their place. One line per record:
+//
+//   {"t":1700000000123456,"id":3,"kind":"request","provider":"anthropic","url":"...","data":"<raw body>"}
+//   {"t":1700000000456789,"id":3,"kind":"chunk","data":"event: message_start\ndata: {...}\n\n"}
+//   {"t":1700000000987654,"id":3,"kind":"end","status":200,"error":""}
+//   {"t":1700000000999999,"id":0,"kind":"dropped","records":12,"bytes":48120}
+//
+// t is microseconds since the Unix epoch; id ties a request to its response chunks.
+class TraceRecorder {
+ public:
+  static TraceRecorder& instance();
+
+  ~TraceRecorder();
+
+  static constexpr size_t kDefaultMaxQueuedBytes = 64 << 20;
+
+  // Append to path (created if missing). Returns false if the file cannot be opened.
+  // At most max_queued_bytes of record data wait for the writer; records beyond that are dropped.
+  bool start(const std::filesystem::path& path, size_t max_queued_bytes = kDefaultMaxQueuedBytes);
+
+  // Write out everything queued, then close the file
+  void stop();
+
+  static bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Id for a new request; its chunks and end record carry the same id
+  uint64_t next_id() {
+    return next_id_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void request(uint64_t id, std::string_view provider, std::string_view url, std::string_view body);
+  void chunk(uint64_t id, std::string_view bytes);
+  void end(uint64_t id, int status, std::string_view error);
+
+  // Records dropped since start() because the queue was full
+  uint64_t dropped() const {
+    return dropped_total_.load(std::memory_order_relaxed);
+  }
+
+  // Non-streaming responses: the whole body as one chunk, then the end record
+  void response(uint64_t id, int status, std::string_view body, std::string_view error);
+
+ private:
+  TraceRecorder() = default;
+
+  enum class Kind : uint8_t { Request, Chunk, End };
+
+  struct Record {
+    int64_t time_us;
+    uint64_t id;
+    Kind kind;
+    int status = 0;
+    std::string provider;
+    std::string url;
+    std::string data;  // Body, chunk bytes or error text
+  };
+
+  void push(Record record);
+  void writer_loop();
+
+  static inline std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> next_id_{1};
+
+  std::mutex mutex_;  // Guards the queue and its counters, stopping_ and the start/stop lifecycle
+  std::condition_variable cv_;
+  std::vector<Record> queue_;
+  size_t queued_bytes_ = 0;
+  size_t max_queued_bytes_ = kDefaultMaxQueuedBytes;
+  uint64_t dropped_records_ = 0;  // Dropped since the writer last took the queue
+  uint64_t dropped_bytes_ = 0;
+  std::atomic<uint64_t> dropped_total_{0};
+  bool stopping_ = false;
+  std::ofstream file_;
+  std::thread writer_;
+};
+
+// Pretty-print a trace: each request with its headers and indented JSON body, then its response
+// split back into SSE events (JSON payloads indented), with times relative to the request.
+void print_trace(std::istream& in, std::ostream& out);
+
+}  // namespace agent::llm
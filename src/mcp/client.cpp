@@ -187,34 +187,32 @@ std::vector<McpToolInfo> McpClient::list_tools() {
   return tools;
 }
 
-std::future<json> McpClient::call_tool(const std::string& name, const json& arguments) {
-  return std::async(std::launch::async, [this, name, arguments]() -> json {
-    if (state_ != ClientState::Ready) {
-      return json{{"error", "MCP server not ready"}};
-    }
-
-    JsonRpcRequest req;
-    req.method = "tools/call";
-    req.id = next_request_id_++;
-    req.params = json{{"name", name}, {"arguments", arguments}};
+json McpClient::call_tool(const std::string& name, const json& arguments) {
+  if (state_ != ClientState::Ready) {
+    return json{{"error", "MCP server not ready"}};
+  }
 
-    auto future = transport_->send_request(req);
+  JsonRpcRequest req;
+  req.method = "tools/call";
+  req.id = next_request_id_++;
+  req.params = json{{"name", name}, {"arguments", arguments}};
 
-    try {
-      auto resp = future.get();
-      if (!resp.ok()) {
-        return json{{"isError", true}, {"content", json::array({json{{"type", "text"}, {"text", resp.error_message()}}})}};
-      }
+  auto future = transport_->send_request(req);
 
-      if (resp.result.has_value()) {
-        return resp.result.value();
-      }
+  try {
+    auto resp = future.get();
+    if (!resp.ok()) {
+      return json{{"isError", true}, {"content", json::array({json{{"type", "text"}, {"text", resp.error_message()}}})}};
+    }
 
-      return json{{"content", json::array()}};
-    } catch (const std::exception& e) {
-      return json{{"isError", true}, {"content", json::array({json{{"type", "text"}, {"text", std::string("Exception: ") + e.what()}}})}};
+    if (resp.result.has_value()) {
+      return resp.result.value();
     }
-  });
+
+    return json{{"content", json::array()}};
+  } catch (const std::exception& e) {
+    return json{{"isError", true}, {"content", json::array({json{{"type", "text"}, {"text", std::string("Exception: ") + e.what()}}})}};
+  }
 }
 
 // ============================================================
@@ -270,14 +268,16 @@ std::vector<ParameterSchema> McpToolBridge::parameters() const {
 }
 
 std::future<ToolResult> McpToolBridge::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [this, args]() -> ToolResult {
-    if (!client_ || !client_->is_ready()) {
+  return ctx.run(id_, ToolLane::Blocking, [this, args]() -> ToolResult {
+    if (!client_) {
+      return ToolResult::error("MCP server is not available");
+    }
+    if (!client_->is_ready()) {
       return ToolResult::error("MCP server '" + client_->server_name() + "' is not ready");
     }
 
     try {
-      auto result_future = client_->call_tool(tool_info_.name, args);
-      auto result = result_future.get();
+      auto result = client_->call_tool(tool_info_.name, args);
 
       // Extract text content from MCP tool result
       bool is_error = result.value("isError", false);
@@ -58,7 +58,8 @@ class McpClient {
 
   // Tool operations
   std::vector<McpToolInfo> list_tools();
-  std::future<json> call_tool(const std::string& name, const json& arguments);
+  // Blocks until the server answers; McpToolBridge calls it from the executor's Blocking lane
+  json call_tool(const std::string& name, const json& arguments);
 
   // Server info
   const ServerCapabilities& capabilities() const {
@@ -13,6 +13,8 @@
 #include <unordered_map>
 
 #include "net/http_client.hpp"
+#include "net/http_framing.hpp"
+#include "net/sse_parser.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -524,7 +526,10 @@ class SseTransport::Impl {
         opts.method = "POST";
         opts.headers = headers_;
         opts.headers["Content-Type"] = "application/json";
+        opts.headers.emplace("Accept", "application/json, text/event-stream");
         opts.body = request.to_json().dump();
+        // The io_context lives for this request only: a pooled connection would keep run() from returning
+        opts.keep_alive = false;
 
         auto response_future = http->request(url_, opts);
         io_ctx.run();
@@ -544,16 +549,32 @@ class SseTransport::Impl {
           return;
         }
 
-        // Parse response body as JSON-RPC
-        auto msg = json::parse(response.body);
-        auto resp = JsonRpcResponse::from_json(msg);
+        // Streamable HTTP servers may answer with an event stream carrying the response and any notifications
+        auto content_type = agent::net::find_header(response.headers, "content-type");
+        if (content_type && content_type->find("text/event-stream") != std::string::npos) {
+          agent::net::SseParser parser([this](const agent::net::SseEventView& event) {
+            try {
+              handle_incoming(json::parse(event.data));
+            } catch (const std::exception& e) {
+              spdlog::warn("[MCP] Failed to parse SSE message: {}", e.what());
+            }
+          });
+          parser.feed(response.body);
 
-        std::lock_guard<std::mutex> lock(pending_mutex_);
-        auto it = pending_requests_.find(resp.id);
-        if (it != pending_requests_.end()) {
-          it->second.set_value(std::move(resp));
-          pending_requests_.erase(it);
+          std::lock_guard<std::mutex> lock(pending_mutex_);
+          auto it = pending_requests_.find(request.id);
+          if (it != pending_requests_.end()) {
+            JsonRpcResponse err_resp;
+            err_resp.id = request.id;
+            err_resp.error = json{{"code", -32000}, {"message", "No response in event stream"}};
+            it->second.set_value(std::move(err_resp));
+            pending_requests_.erase(it);
+          }
+          return;
         }
+
+        // Parse response body as JSON-RPC
+        handle_incoming(json::parse(response.body));
       } catch (const std::exception& e) {
         std::lock_guard<std::mutex> lock(pending_mutex_);
         auto it = pending_requests_.find(request.id);
@@ -584,6 +605,7 @@ class SseTransport::Impl {
         opts.headers = headers_;
         opts.headers["Content-Type"] = "application/json";
         opts.body = notification.to_json().dump();
+        opts.keep_alive = false;
 
         http->request(url_, opts);
         io_ctx.run();
@@ -603,6 +625,31 @@ class SseTransport::Impl {
   }
 
  private:
+  void handle_incoming(const json& msg) {
+    // Response: resolve the pending request with the same id
+    if (msg.contains("id") && !msg["id"].is_null() && (msg.contains("result") || msg.contains("error"))) {
+      auto resp = JsonRpcResponse::from_json(msg);
+      std::lock_guard<std::mutex> lock(pending_mutex_);
+      auto it = pending_requests_.find(resp.id);
+      if (it != pending_requests_.end()) {
+        it->second.set_value(std::move(resp));
+        pending_requests_.erase(it);
+      }
+      return;
+    }
+
+    // Notification sent alongside the response
+    if (msg.contains("method")) {
+      std::string method = msg["method"].get<std::string>();
+      json params = msg.value("params", json::object());
+
+      std::lock_guard<std::mutex> lock(handler_mutex_);
+      if (notification_handler_) {
+        notification_handler_(method, params);
+      }
+    }
+  }
+
   std::string url_;
   std::map<std::string, std::string> headers_;
 
@@ -0,0 +1,107 @@
+#include "content_decoder.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace agent::net {
+
+namespace {
+
+constexpr size_t kOutputBufferSize = 16 * 1024;
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+}  // namespace
+
+struct ContentDecoder::Stream {
+  z_stream zs{};
+};
+
+std::unique_ptr<ContentDecoder> ContentDecoder::create(std::string_view content_encoding) {
+  while (!content_encoding.empty() && (content_encoding.front() == ' ' || content_encoding.front() == '\t')) content_encoding.remove_prefix(1);
+  while (!content_encoding.empty() && (content_encoding.back() == ' ' || content_encoding.back() == '\t')) content_encoding.remove_suffix(1);
+
+  // Stacked encodings ("gzip, br") are passed through untouched
+  if (iequals(content_encoding, "gzip") || iequals(content_encoding, "x-gzip")) {
+    return std::unique_ptr<ContentDecoder>(new ContentDecoder(Format::Gzip));
+  }
+  if (iequals(content_encoding, "deflate")) {
+    return std::unique_ptr<ContentDecoder>(new ContentDecoder(Format::Deflate));
+  }
+  return nullptr;
+}
+
+ContentDecoder::ContentDecoder(Format format) : format_(format), stream_(std::make_unique<Stream>()), output_(kOutputBufferSize, '\0') {}
+
+ContentDecoder::~ContentDecoder() {
+  if (initialized_) inflateEnd(&stream_->zs);
+}
+
+bool ContentDecoder::init(int window_bits) {
+  if (inflateInit2(&stream_->zs, window_bits) != Z_OK) {
+    error_ = "inflateInit failed";
+    return false;
+  }
+  initialized_ = true;
+  return true;
+}
+
+bool ContentDecoder::decode(std::string_view input, const DataCallback& on_data) {
+  if (failed()) return false;
+
+  std::string buffered;
+  if (!initialized_) {
+    if (format_ == Format::Gzip) {
+      if (!init(15 + 16)) return false;
+    } else {
+      // "deflate" should be zlib-wrapped (RFC 9110 section 8.4.1.2), but some servers send a raw
+      // deflate stream. Look at the first two bytes to tell them apart.
+      pending_.append(input);
+      if (pending_.size() < 2) return true;
+      auto b0 = static_cast<uint8_t>(pending_[0]);
+      auto b1 = static_cast<uint8_t>(pending_[1]);
+      bool zlib_header = (b0 & 0x0f) == Z_DEFLATED && ((b0 << 8) | b1) % 31 == 0;
+      if (!init(zlib_header ? 15 : -15)) return false;
+      buffered.swap(pending_);
+      input = buffered;
+    }
+  }
+
+  auto& zs = stream_->zs;
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  zs.avail_in = static_cast<uInt>(input.size());
+
+  for (;;) {
+    if (finished_) {
+      // Concatenated gzip members continue the body; anything after a deflate stream is ignored
+      if (zs.avail_in == 0 || format_ != Format::Gzip) break;
+      inflateReset(&zs);
+      finished_ = false;
+    }
+
+    zs.next_out = reinterpret_cast<Bytef*>(output_.data());
+    zs.avail_out = static_cast<uInt>(output_.size());
+    int ret = inflate(&zs, Z_NO_FLUSH);
+    size_t produced = output_.size() - zs.avail_out;
+    if (produced > 0) on_data(std::string_view(output_.data(), produced));
+
+    if (ret == Z_STREAM_END) {
+      finished_ = true;
+      continue;
+    }
+    if (ret == Z_BUF_ERROR || (ret == Z_OK && zs.avail_in == 0 && zs.avail_out != 0)) break;  // Needs more input
+    if (ret != Z_OK) {
+      error_ = zs.msg ? zs.msg : "inflate failed (" + std::to_string(ret) + ")";
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace agent::net
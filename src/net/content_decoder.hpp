@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace agent::net {
+
+// Value sent in Accept-Encoding when response decompression is enabled
+constexpr std::string_view kAcceptEncoding = "gzip, deflate";
+
+// Streaming inflater for "Content-Encoding: gzip" and "deflate" bodies (zlib).
+// Input may be split at arbitrary points. Decoded bytes are handed out as views into an internal
+// buffer that is reused between calls, so a long stream is inflated without per-chunk allocations.
+class ContentDecoder {
+ public:
+  using DataCallback = std::function<void(std::string_view data)>;
+
+  // Decoder for a Content-Encoding value, or nullptr for identity and encodings we do not handle
+  static std::unique_ptr<ContentDecoder> create(std::string_view content_encoding);
+
+  ~ContentDecoder();
+
+  // Inflate input, calling on_data for each run of decoded bytes. Returns false once the stream is corrupt.
+  bool decode(std::string_view input, const DataCallback& on_data);
+
+  // Whether the compressed stream reached its end marker (a body cut short is not finished)
+  bool finished() const {
+    return finished_;
+  }
+
+  bool failed() const {
+    return !error_.empty();
+  }
+
+  const std::string& error() const {
+    return error_;
+  }
+
+ private:
+  enum class Format { Gzip, Deflate };
+
+  struct Stream;
+
+  explicit ContentDecoder(Format format);
+
+  bool init(int window_bits);
+
+  Format format_;
+  std::unique_ptr<Stream> stream_;
+  std::string output_;   // Reused inflate buffer
+  std::string pending_;  // First bytes of a deflate body, held until the zlib header can be checked
+  bool initialized_ = false;
+  bool finished_ = false;
+  std::string error_;
+};
+
+}  // namespace agent::net
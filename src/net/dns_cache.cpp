@@ -0,0 +1,181 @@
+#include "dns_cache.hpp"
+
+namespace agent::net {
+
+namespace {
+
+void system_resolve(asio::io_context& io_ctx, const std::string& host, const std::string& port, ResolveCallback callback) {
+  auto resolver = std::make_shared<asio::ip::tcp::resolver>(io_ctx);
+  resolver->async_resolve(host, port, [resolver, callback](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
+    Endpoints endpoints;
+    for (const auto& result : results) {
+      endpoints.push_back(result.endpoint());
+    }
+    callback(ec, std::move(endpoints));
+  });
+}
+
+}  // namespace
+
+DnsCache& DnsCache::instance() {
+  static DnsCache cache;
+  return cache;
+}
+
+DnsCache::DnsCache() : resolver_(system_resolve), lookup_work_(asio::make_work_guard(lookup_ctx_)) {
+  lookup_thread_ = std::thread([this]() {
+    lookup_ctx_.run();
+  });
+}
+
+DnsCache::~DnsCache() {
+  lookup_work_.reset();
+  lookup_ctx_.stop();
+  if (lookup_thread_.joinable()) lookup_thread_.join();
+}
+
+void DnsCache::resolve(asio::io_context& io_ctx, const std::string& host, const std::string& port, ResolveCallback callback) {
+  auto key = host + ":" + port;
+  auto now = Clock::now();
+  bool start_lookup = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = entries_[key];
+
+    if (entry.resolved && usable_locked(entry, now)) {
+      if (entry.error) {
+        stats_.negative_hits++;
+      } else if (now - entry.resolved_at < options_.ttl) {
+        stats_.hits++;
+      } else {
+        // Stale: answer now, refresh in the background
+        stats_.stale_hits++;
+        if (!entry.in_flight) {
+          entry.in_flight = true;
+          start_lookup = true;
+        }
+      }
+      asio::post(io_ctx, [callback = std::move(callback), ec = entry.error, endpoints = entry.endpoints]() mutable {
+        callback(ec, std::move(endpoints));
+      });
+    } else {
+      stats_.misses++;
+      entry.waiters.push_back({&io_ctx, asio::make_work_guard(io_ctx), std::move(callback)});
+      if (!entry.in_flight) {
+        entry.in_flight = true;
+        start_lookup = true;
+      }
+    }
+  }
+
+  if (start_lookup) lookup(key, host, port);
+}
+
+void DnsCache::lookup(const std::string& key, const std::string& host, const std::string& port) {
+  ResolverFunction resolver;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookups++;
+    resolver = resolver_;
+  }
+  resolver(lookup_ctx_, host, port, [this, key](const asio::error_code& ec, Endpoints endpoints) {
+    on_lookup_done(key, ec, std::move(endpoints));
+  });
+}
+
+void DnsCache::on_lookup_done(const std::string& key, asio::error_code ec, Endpoints endpoints) {
+  if (!ec && endpoints.empty()) ec = asio::error::host_not_found;
+
+  std::vector<Waiter> waiters;
+  auto now = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = entries_[key];
+    entry.in_flight = false;
+    waiters = std::move(entry.waiters);
+    entry.waiters.clear();
+
+    if (!ec) {
+      entry.resolved = true;
+      entry.error = {};
+      entry.endpoints = endpoints;
+      entry.resolved_at = now;
+    } else if (entry.resolved && !entry.error && usable_locked(entry, now)) {
+      // Refresh failed: keep serving the stale answer until its window closes
+      ec = {};
+      endpoints = entry.endpoints;
+    } else {
+      entry.resolved = true;
+      entry.error = ec;
+      entry.endpoints.clear();
+      entry.resolved_at = now;
+    }
+    evict_locked(now);
+  }
+
+  for (auto& waiter : waiters) {
+    asio::post(*waiter.io_ctx, [callback = std::move(waiter.callback), work = std::move(waiter.work), ec, endpoints]() mutable {
+      callback(ec, std::move(endpoints));
+    });
+  }
+}
+
+void DnsCache::invalidate(const std::string& host, const std::string& port) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(host + ":" + port);
+  if (it != entries_.end() && !it->second.in_flight) {
+    entries_.erase(it);
+  }
+}
+
+void DnsCache::set_options(const DnsCacheOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+  evict_locked(Clock::now());
+}
+
+void DnsCache::set_resolver(ResolverFunction resolver) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resolver_ = resolver ? std::move(resolver) : ResolverFunction(system_resolve);
+}
+
+DnsCacheStats DnsCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
+
+void DnsCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Entries with a lookup in flight stay so their waiters still get answered
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    it = it->second.in_flight ? std::next(it) : entries_.erase(it);
+  }
+  stats_ = {};
+}
+
+bool DnsCache::usable_locked(const Entry& entry, Clock::time_point now) const {
+  auto age = now - entry.resolved_at;
+  return entry.error ? age < options_.negative_ttl : age < options_.ttl + options_.stale_ttl;
+}
+
+void DnsCache::evict_locked(Clock::time_point now) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    bool expired = !it->second.in_flight && (!it->second.resolved || !usable_locked(it->second, now));
+    it = expired ? entries_.erase(it) : std::next(it);
+  }
+  while (entries_.size() > options_.max_entries) {
+    // Drop the least recently resolved idle entry
+    auto oldest = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.in_flight) continue;
+      if (oldest == entries_.end() || it->second.resolved_at < oldest->second.resolved_at) oldest = it;
+    }
+    if (oldest == entries_.end()) break;
+    entries_.erase(oldest);
+  }
+}
+
+}  // namespace agent::net
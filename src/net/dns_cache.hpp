@@ -0,0 +1,100 @@
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace agent::net {
+
+using Endpoints = std::vector<asio::ip::tcp::endpoint>;
+
+using ResolveCallback = std::function<void(const asio::error_code& ec, Endpoints endpoints)>;
+
+// Performs the actual lookup on the cache's own io_context. The default uses asio::ip::tcp::resolver;
+// tests install a stub.
+using ResolverFunction = std::function<void(asio::io_context& io_ctx, const std::string& host, const std::string& port, ResolveCallback callback)>;
+
+struct DnsCacheOptions {
+  std::chrono::seconds ttl{60};          // Entries younger than this are served without a lookup
+  std::chrono::seconds stale_ttl{300};   // After ttl, serve the old answer for this long while refreshing in the background
+  std::chrono::seconds negative_ttl{5};  // Failed lookups are remembered for this long
+  size_t max_entries = 256;
+};
+
+struct DnsCacheStats {
+  uint64_t hits = 0;           // Served from a fresh entry
+  uint64_t stale_hits = 0;     // Served from an expired entry while a refresh ran
+  uint64_t negative_hits = 0;  // Served a cached resolution failure
+  uint64_t misses = 0;         // Callers that had to wait for a lookup
+  uint64_t lookups = 0;        // Lookups issued to the resolver (foreground and background)
+  size_t entries = 0;
+};
+
+// Process-wide host:port resolution cache shared by HttpClient and SseClient.
+// Concurrent misses for the same key share a single lookup. Lookups run on a cache-owned thread, so
+// an entry never stays in flight because the io_context of whoever started it stopped or went away.
+class DnsCache {
+ public:
+  static DnsCache& instance();
+
+  // Resolve host:port. The callback always runs asynchronously on io_ctx, which is kept from running
+  // out of work while a lookup for it is pending.
+  void resolve(asio::io_context& io_ctx, const std::string& host, const std::string& port, ResolveCallback callback);
+
+  // Drop the entry for host:port, e.g. after connecting to every cached endpoint failed
+  void invalidate(const std::string& host, const std::string& port);
+
+  void set_options(const DnsCacheOptions& options);
+
+  // Replace the resolver (nullptr restores the system resolver)
+  void set_resolver(ResolverFunction resolver);
+
+  DnsCacheStats stats() const;
+
+  void clear();
+
+ private:
+  DnsCache();
+  ~DnsCache();
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Waiter {
+    asio::io_context* io_ctx;
+    asio::executor_work_guard<asio::io_context::executor_type> work;
+    ResolveCallback callback;
+  };
+
+  struct Entry {
+    bool resolved = false;   // Holds an answer (positive or negative)
+    asio::error_code error;  // Set for a negative entry
+    Endpoints endpoints;
+    Clock::time_point resolved_at;
+    bool in_flight = false;       // A lookup for this key is running
+    std::vector<Waiter> waiters;  // Callers waiting for that lookup
+  };
+
+  void lookup(const std::string& key, const std::string& host, const std::string& port);
+  void on_lookup_done(const std::string& key, asio::error_code ec, Endpoints endpoints);
+  bool usable_locked(const Entry& entry, Clock::time_point now) const;
+  void evict_locked(Clock::time_point now);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  DnsCacheOptions options_;
+  ResolverFunction resolver_;
+  DnsCacheStats stats_;
+
+  asio::io_context lookup_ctx_;
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> lookup_work_;
+  std::thread lookup_thread_;
+};
+
+}  // namespace agent::net
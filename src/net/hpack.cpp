@@ -0,0 +1,433 @@
+#include "hpack.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace agent::net::hpack {
+
+namespace {
+
+struct StaticEntry {
+  std::string_view name;
+  std::string_view value;
+};
+
+// Appendix A
+constexpr std::array<StaticEntry, 61> kStaticTable = {{
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+}};
+
+struct HuffmanCode {
+  uint32_t code;
+  uint8_t bits;
+};
+
+// Appendix B, indexed by symbol (256 = EOS)
+constexpr std::array<HuffmanCode, 257> kHuffmanCodes = {{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+}};
+
+constexpr int kEos = 256;
+
+// Binary decoding tree built from kHuffmanCodes
+struct HuffmanTree {
+  struct Node {
+    int child[2] = {-1, -1};
+    int symbol = -1;
+  };
+  std::vector<Node> nodes;
+
+  HuffmanTree() {
+    nodes.emplace_back();
+    for (int symbol = 0; symbol <= kEos; ++symbol) {
+      const auto& code = kHuffmanCodes[symbol];
+      int node = 0;
+      for (int bit = code.bits - 1; bit >= 0; --bit) {
+        int b = (code.code >> bit) & 1;
+        if (nodes[node].child[b] < 0) {
+          nodes[node].child[b] = static_cast<int>(nodes.size());
+          nodes.emplace_back();
+        }
+        node = nodes[node].child[b];
+      }
+      nodes[node].symbol = symbol;
+    }
+  }
+};
+
+const HuffmanTree& huffman_tree() {
+  static const HuffmanTree tree;
+  return tree;
+}
+
+// Header values that must not enter any compression table (section 7.1.3)
+bool is_sensitive(std::string_view name) {
+  return name == "authorization" || name == "proxy-authorization" || name == "cookie" || name == "set-cookie" || name == "x-api-key";
+}
+
+}  // namespace
+
+// ---- Primitives ----
+
+void encode_integer(std::string& out, uint64_t value, int prefix_bits, uint8_t flags) {
+  const uint64_t max_prefix = (1u << prefix_bits) - 1;
+  if (value < max_prefix) {
+    out += static_cast<char>(flags | value);
+    return;
+  }
+  out += static_cast<char>(flags | max_prefix);
+  value -= max_prefix;
+  while (value >= 128) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+bool decode_integer(std::string_view& in, int prefix_bits, uint64_t& value) {
+  if (in.empty()) return false;
+  const uint64_t max_prefix = (1u << prefix_bits) - 1;
+  value = static_cast<uint8_t>(in[0]) & max_prefix;
+  in.remove_prefix(1);
+  if (value < max_prefix) return true;
+
+  for (int shift = 0; !in.empty(); shift += 7) {
+    if (shift > 56) return false;  // Overflow
+    auto byte = static_cast<uint8_t>(in[0]);
+    in.remove_prefix(1);
+    value += static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+size_t huffman_encoded_size(std::string_view data) {
+  size_t bits = 0;
+  for (unsigned char c : data) bits += kHuffmanCodes[c].bits;
+  return (bits + 7) / 8;
+}
+
+std::string huffman_encode(std::string_view data) {
+  std::string out;
+  out.reserve(huffman_encoded_size(data));
+  uint64_t acc = 0;
+  int acc_bits = 0;
+  for (unsigned char c : data) {
+    const auto& code = kHuffmanCodes[c];
+    acc = (acc << code.bits) | code.code;
+    acc_bits += code.bits;
+    while (acc_bits >= 8) {
+      acc_bits -= 8;
+      out += static_cast<char>(acc >> acc_bits);
+    }
+    acc &= (uint64_t(1) << acc_bits) - 1;
+  }
+  if (acc_bits > 0) {
+    // Pad with the most significant bits of EOS (all ones)
+    out += static_cast<char>((acc << (8 - acc_bits)) | ((1u << (8 - acc_bits)) - 1));
+  }
+  return out;
+}
+
+bool huffman_decode(std::string_view data, std::string& out) {
+  const auto& tree = huffman_tree();
+  int node = 0;
+  int pending_bits = 0;      // Bits read since the last complete symbol
+  bool pending_ones = true;  // Whether those bits are all ones (valid padding)
+
+  for (unsigned char c : data) {
+    for (int bit = 7; bit >= 0; --bit) {
+      int b = (c >> bit) & 1;
+      node = tree.nodes[node].child[b];
+      if (node < 0) return false;
+      pending_bits++;
+      pending_ones = pending_ones && b == 1;
+
+      int symbol = tree.nodes[node].symbol;
+      if (symbol >= 0) {
+        if (symbol == kEos) return false;
+        out += static_cast<char>(symbol);
+        node = 0;
+        pending_bits = 0;
+        pending_ones = true;
+      }
+    }
+  }
+  // Padding must be shorter than 8 bits and consist of ones
+  return pending_bits < 8 && pending_ones;
+}
+
+// ---- Dynamic table ----
+
+void DynamicTable::add(HeaderField field) {
+  size_t size = entry_size(field);
+  if (size > max_size_) {
+    // An entry larger than the table empties it
+    entries_.clear();
+    size_ = 0;
+    return;
+  }
+  size_ += size;
+  entries_.push_front(std::move(field));
+  evict();
+}
+
+const HeaderField* DynamicTable::get(size_t index) const {
+  if (index == 0 || index > entries_.size()) return nullptr;
+  return &entries_[index - 1];
+}
+
+void DynamicTable::set_max_size(size_t max_size) {
+  max_size_ = max_size;
+  evict();
+}
+
+void DynamicTable::evict() {
+  while (size_ > max_size_ && !entries_.empty()) {
+    size_ -= entry_size(entries_.back());
+    entries_.pop_back();
+  }
+}
+
+// ---- Encoder ----
+
+void Encoder::set_max_table_size(size_t max_size) {
+  // Never grow beyond the default; a smaller peer limit must be acknowledged with a size update
+  size_t size = std::min<size_t>(max_size, 4096);
+  if (size == table_.max_size()) return;
+  min_pending_size_ = pending_size_update_ ? std::min(min_pending_size_, size) : size;
+  pending_size_update_ = true;
+  table_.set_max_size(size);
+}
+
+void Encoder::encode_string(std::string& out, std::string_view value) const {
+  size_t huffman_size = huffman_encoded_size(value);
+  if (huffman_size < value.size()) {
+    encode_integer(out, huffman_size, 7, 0x80);
+    out += huffman_encode(value);
+  } else {
+    encode_integer(out, value.size(), 7, 0x00);
+    out.append(value);
+  }
+}
+
+std::string Encoder::encode(const HeaderList& headers) {
+  std::string out;
+
+  if (pending_size_update_) {
+    if (min_pending_size_ < table_.max_size()) encode_integer(out, min_pending_size_, 5, 0x20);
+    encode_integer(out, table_.max_size(), 5, 0x20);
+    pending_size_update_ = false;
+  }
+
+  for (const auto& header : headers) {
+    size_t full_index = 0;
+    size_t name_index = 0;
+    for (size_t i = 0; i < kStaticTable.size() && full_index == 0; ++i) {
+      if (kStaticTable[i].name != header.name) continue;
+      if (name_index == 0) name_index = i + 1;
+      if (kStaticTable[i].value == header.value) full_index = i + 1;
+    }
+    for (size_t i = 1; i <= table_.count() && full_index == 0; ++i) {
+      const auto* entry = table_.get(i);
+      if (entry->name != header.name) continue;
+      if (name_index == 0) name_index = kStaticTable.size() + i;
+      if (entry->value == header.value) full_index = kStaticTable.size() + i;
+    }
+
+    bool sensitive = is_sensitive(header.name);
+    if (full_index != 0 && !sensitive) {
+      encode_integer(out, full_index, 7, 0x80);
+      continue;
+    }
+
+    if (sensitive) {
+      encode_integer(out, name_index, 4, 0x10);  // Literal never indexed
+    } else if (header.name != "content-length") {
+      encode_integer(out, name_index, 6, 0x40);  // Literal with incremental indexing
+      table_.add(header);
+    } else {
+      encode_integer(out, name_index, 4, 0x00);  // Literal without indexing (value changes every request)
+    }
+    if (name_index == 0) encode_string(out, header.name);
+    encode_string(out, header.value);
+  }
+  return out;
+}
+
+// ---- Decoder ----
+
+void Decoder::set_max_table_size(size_t max_size) {
+  settings_max_size_ = max_size;
+  if (table_.max_size() > max_size) table_.set_max_size(max_size);
+}
+
+bool Decoder::lookup(uint64_t index, HeaderField& field) const {
+  if (index == 0) return false;
+  if (index <= kStaticTable.size()) {
+    field.name = kStaticTable[index - 1].name;
+    field.value = kStaticTable[index - 1].value;
+    return true;
+  }
+  const auto* entry = table_.get(index - kStaticTable.size());
+  if (!entry) return false;
+  field = *entry;
+  return true;
+}
+
+bool Decoder::decode_string(std::string_view& in, std::string& out) {
+  if (in.empty()) return false;
+  bool huffman = static_cast<uint8_t>(in[0]) & 0x80;
+  uint64_t length = 0;
+  if (!decode_integer(in, 7, length) || length > in.size()) return false;
+
+  auto data = in.substr(0, length);
+  in.remove_prefix(length);
+  out.clear();
+  if (huffman) return huffman_decode(data, out);
+  out.assign(data);
+  return true;
+}
+
+bool Decoder::decode(std::string_view block, HeaderList& headers) {
+  while (!block.empty()) {
+    auto first = static_cast<uint8_t>(block[0]);
+    uint64_t index = 0;
+
+    if (first & 0x80) {
+      // Indexed header field
+      HeaderField field;
+      if (!decode_integer(block, 7, index) || !lookup(index, field)) return false;
+      headers.push_back(std::move(field));
+      continue;
+    }
+
+    if ((first & 0xe0) == 0x20) {
+      // Dynamic table size update
+      uint64_t size = 0;
+      if (!decode_integer(block, 5, size) || size > settings_max_size_) return false;
+      table_.set_max_size(size);
+      continue;
+    }
+
+    // Literal header field: with incremental indexing (01), without indexing (0000) or never indexed (0001)
+    bool indexing = (first & 0xc0) == 0x40;
+    if (!decode_integer(block, indexing ? 6 : 4, index)) return false;
+
+    HeaderField field;
+    if (index != 0) {
+      if (!lookup(index, field)) return false;
+    } else if (!decode_string(block, field.name)) {
+      return false;
+    }
+    if (!decode_string(block, field.value)) return false;
+
+    if (indexing) table_.add(field);
+    headers.push_back(std::move(field));
+  }
+  return true;
+}
+
+}  // namespace agent::net::hpack
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HPACK header compression for HTTP/2 (RFC 7541)
+namespace agent::net::hpack {
+
+struct HeaderField {
+  std::string name;
+  std::string value;
+
+  bool operator==(const HeaderField& other) const {
+    return name == other.name && value == other.value;
+  }
+};
+
+using HeaderList = std::vector<HeaderField>;
+
+// Primitive encodings (RFC 7541 section 5)
+void encode_integer(std::string& out, uint64_t value, int prefix_bits, uint8_t flags);
+bool decode_integer(std::string_view& in, int prefix_bits, uint64_t& value);
+
+std::string huffman_encode(std::string_view data);
+bool huffman_decode(std::string_view data, std::string& out);
+size_t huffman_encoded_size(std::string_view data);
+
+// Dynamic table shared in shape by encoder and decoder (section 2.3.2)
+class DynamicTable {
+ public:
+  explicit DynamicTable(size_t max_size = 4096) : max_size_(max_size) {}
+
+  void add(HeaderField field);
+
+  // 1-based index into the dynamic table (static table entries come first on the wire)
+  const HeaderField* get(size_t index) const;
+
+  void set_max_size(size_t max_size);
+
+  size_t max_size() const {
+    return max_size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t count() const {
+    return entries_.size();
+  }
+
+ private:
+  static size_t entry_size(const HeaderField& field) {
+    return field.name.size() + field.value.size() + 32;
+  }
+
+  void evict();
+
+  std::deque<HeaderField> entries_;  // Newest first
+  size_t size_ = 0;
+  size_t max_size_;
+};
+
+class Encoder {
+ public:
+  // Encode a header list into a header block fragment.
+  // Names must be lowercase. Credentials (authorization, cookie, api keys) are never indexed.
+  std::string encode(const HeaderList& headers);
+
+  // Peer's SETTINGS_HEADER_TABLE_SIZE; a size update is emitted at the start of the next block
+  void set_max_table_size(size_t max_size);
+
+ private:
+  void encode_string(std::string& out, std::string_view value) const;
+
+  DynamicTable table_;
+  bool pending_size_update_ = false;
+  size_t min_pending_size_ = 0;
+};
+
+class Decoder {
+ public:
+  // Decode a complete header block. Returns false on a compression error (the connection must then be closed).
+  bool decode(std::string_view block, HeaderList& headers);
+
+  // Upper bound the peer's encoder may use (our SETTINGS_HEADER_TABLE_SIZE)
+  void set_max_table_size(size_t max_size);
+
+ private:
+  bool lookup(uint64_t index, HeaderField& field) const;
+  static bool decode_string(std::string_view& in, std::string& out);
+
+  DynamicTable table_;
+  size_t settings_max_size_ = 4096;
+};
+
+}  // namespace agent::net::hpack
@@ -0,0 +1,634 @@
+#include "http2.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace agent::net {
+
+namespace http2 {
+
+void append_uint32(std::string& out, uint32_t value) {
+  out += static_cast<char>((value >> 24) & 0xff);
+  out += static_cast<char>((value >> 16) & 0xff);
+  out += static_cast<char>((value >> 8) & 0xff);
+  out += static_cast<char>(value & 0xff);
+}
+
+uint32_t read_uint32(const uint8_t* data) {
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+void append_frame(std::string& out, FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload) {
+  auto length = static_cast<uint32_t>(payload.size());
+  out += static_cast<char>((length >> 16) & 0xff);
+  out += static_cast<char>((length >> 8) & 0xff);
+  out += static_cast<char>(length & 0xff);
+  out += static_cast<char>(type);
+  out += static_cast<char>(flags);
+  append_uint32(out, stream_id & 0x7fffffff);
+  out.append(payload);
+}
+
+FrameHeader parse_frame_header(const uint8_t* data) {
+  FrameHeader header;
+  header.length = (uint32_t(data[0]) << 16) | (uint32_t(data[1]) << 8) | uint32_t(data[2]);
+  header.type = static_cast<FrameType>(data[3]);
+  header.flags = data[4];
+  header.stream_id = read_uint32(data + 5) & 0x7fffffff;
+  return header;
+}
+
+bool strip_padding(const FrameHeader& header, std::string_view& payload) {
+  size_t padding = 0;
+  if (header.flags & flags::kPadded) {
+    if (payload.empty()) return false;
+    padding = static_cast<uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+  }
+  if (header.type == FrameType::Headers && (header.flags & flags::kPriority)) {
+    if (payload.size() < 5) return false;
+    payload.remove_prefix(5);  // Stream dependency + weight, ignored
+  }
+  if (padding > payload.size()) return false;
+  payload.remove_suffix(padding);
+  return true;
+}
+
+}  // namespace http2
+
+using namespace http2;
+
+namespace {
+
+// Receive windows we advertise. Large enough that a streaming completion never waits on us.
+constexpr uint32_t kStreamWindow = 1 << 20;
+constexpr uint32_t kConnectionWindow = 1 << 24;
+constexpr size_t kReadBufferSize = 64 * 1024;
+
+std::string uint32_payload(uint32_t value) {
+  std::string payload;
+  append_uint32(payload, value);
+  return payload;
+}
+
+}  // namespace
+
+struct Http2Connection::Stream {
+  uint64_t request_id = 0;
+  uint32_t id = 0;  // 0 until opened
+  hpack::HeaderList headers;
+  std::string body;
+  size_t body_offset = 0;
+  bool end_stream_sent = false;
+  int64_t send_window = 0;
+  uint32_t recv_unacked = 0;
+  bool response_started = false;  // Final (non-1xx) response headers received
+  Http2StreamHandler handler;
+};
+
+Http2Connection::Http2Connection(asio::io_context& io_ctx, ReadFunction read, WriteFunction write, std::function<void()> close)
+    : strand_(asio::make_strand(io_ctx)),
+      read_(std::move(read)),
+      write_(std::move(write)),
+      close_socket_(std::move(close)),
+      read_buffer_(kReadBufferSize) {}
+
+Http2Connection::~Http2Connection() = default;
+
+void Http2Connection::start() {
+  asio::post(strand_, [self = shared_from_this()]() {
+    self->output_.append(kClientPreface);
+
+    std::string settings;
+    auto add_setting = [&settings](SettingId id, uint32_t value) {
+      settings += static_cast<char>(static_cast<uint16_t>(id) >> 8);
+      settings += static_cast<char>(static_cast<uint16_t>(id) & 0xff);
+      append_uint32(settings, value);
+    };
+    add_setting(SettingId::EnablePush, 0);
+    add_setting(SettingId::InitialWindowSize, kStreamWindow);
+    self->queue_frame(FrameType::Settings, 0, 0, settings);
+    self->queue_frame(FrameType::WindowUpdate, 0, 0, uint32_payload(kConnectionWindow - kDefaultWindowSize));
+
+    self->flush();
+    self->do_read();
+  });
+}
+
+uint64_t Http2Connection::submit(hpack::HeaderList headers, std::string body, Http2StreamHandler handler) {
+  auto stream = std::make_shared<Stream>();
+  stream->request_id = next_request_id_++;
+  stream->headers = std::move(headers);
+  stream->body = std::move(body);
+  stream->handler = std::move(handler);
+
+  asio::post(strand_, [self = shared_from_this(), stream]() {
+    if (self->closed_ || self->goaway_received_) {
+      // Nothing was sent, so the caller may safely retry elsewhere
+      if (stream->handler.on_close) stream->handler.on_close("HTTP/2 connection is closed", true);
+      return;
+    }
+    self->requests_[stream->request_id] = stream;
+    self->pending_.push_back(stream);
+    if (self->streams_.size() >= self->peer_max_concurrent_) {
+      std::lock_guard<std::mutex> lock(self->stats_mutex_);
+      self->stats_.streams_queued++;
+    }
+    self->open_pending_streams();
+    self->flush();
+  });
+  return stream->request_id;
+}
+
+void Http2Connection::cancel(uint64_t request_id) {
+  asio::post(strand_, [self = shared_from_this(), request_id]() {
+    auto it = self->requests_.find(request_id);
+    if (it == self->requests_.end()) return;
+    auto stream = it->second;
+    if (stream->id != 0) {
+      self->queue_frame(FrameType::RstStream, 0, stream->id, uint32_payload(static_cast<uint32_t>(ErrorCode::Cancel)));
+    }
+    stream->handler = {};
+    self->close_stream(stream, "", false);
+    self->flush();
+  });
+}
+
+void Http2Connection::close() {
+  asio::post(strand_, [self = shared_from_this()]() {
+    if (self->closed_) return;
+    std::string payload;
+    append_uint32(payload, 0);
+    append_uint32(payload, static_cast<uint32_t>(ErrorCode::NoError));
+    self->queue_frame(FrameType::GoAway, 0, 0, payload);
+    self->shutdown("HTTP/2 connection closed");
+  });
+}
+
+bool Http2Connection::usable() const {
+  return usable_.load();
+}
+
+void Http2Connection::set_on_closed(std::function<void()> on_closed) {
+  on_closed_ = std::move(on_closed);
+}
+
+Http2Stats Http2Connection::stats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_;
+}
+
+// ---- Reading ----
+
+void Http2Connection::do_read() {
+  auto self = shared_from_this();
+  read_(asio::buffer(read_buffer_), [self](const asio::error_code& ec, size_t bytes) {
+    asio::dispatch(self->strand_, [self, ec, bytes]() {
+      if (self->closed_) return;
+      if (ec) {
+        self->shutdown(ec == asio::error::eof ? "HTTP/2 connection closed by server" : "Read failed: " + ec.message());
+        return;
+      }
+      self->input_.append(reinterpret_cast<const char*>(self->read_buffer_.data()), bytes);
+      self->process_input();
+      if (!self->closed_) self->do_read();
+    });
+  });
+}
+
+void Http2Connection::process_input() {
+  size_t pos = 0;
+  while (!closed_ && input_.size() - pos >= kFrameHeaderSize) {
+    auto header = parse_frame_header(reinterpret_cast<const uint8_t*>(input_.data() + pos));
+    if (header.length > kDefaultMaxFrameSize) {
+      connection_error(ErrorCode::FrameSizeError, "HTTP/2 frame too large");
+      return;
+    }
+    if (input_.size() - pos < kFrameHeaderSize + header.length) break;
+
+    std::string_view payload(input_.data() + pos + kFrameHeaderSize, header.length);
+    pos += kFrameHeaderSize + header.length;
+    if (!handle_frame(header, payload)) return;
+  }
+  input_.erase(0, pos);
+  flush();
+}
+
+bool Http2Connection::handle_frame(const FrameHeader& header, std::string_view payload) {
+  if (continuation_stream_ != 0 && (header.type != FrameType::Continuation || header.stream_id != continuation_stream_)) {
+    connection_error(ErrorCode::ProtocolError, "HTTP/2 header block interrupted");
+    return false;
+  }
+
+  switch (header.type) {
+    case FrameType::Data:
+      return handle_data(header, payload);
+
+    case FrameType::Headers:
+      if (header.stream_id == 0 || !strip_padding(header, payload)) {
+        connection_error(ErrorCode::ProtocolError, "Invalid HTTP/2 HEADERS frame");
+        return false;
+      }
+      header_block_.assign(payload);
+      continuation_flags_ = header.flags;
+      if (header.flags & flags::kEndHeaders) return handle_headers_block(header.stream_id, header.flags);
+      continuation_stream_ = header.stream_id;
+      return true;
+
+    case FrameType::Continuation:
+      if (continuation_stream_ == 0) {
+        connection_error(ErrorCode::ProtocolError, "Unexpected HTTP/2 CONTINUATION frame");
+        return false;
+      }
+      header_block_.append(payload);
+      if (header.flags & flags::kEndHeaders) {
+        continuation_stream_ = 0;
+        return handle_headers_block(header.stream_id, continuation_flags_);
+      }
+      return true;
+
+    case FrameType::RstStream: {
+      if (payload.size() != 4) {
+        connection_error(ErrorCode::FrameSizeError, "Invalid HTTP/2 RST_STREAM frame");
+        return false;
+      }
+      auto code = read_uint32(reinterpret_cast<const uint8_t*>(payload.data()));
+      auto it = streams_.find(header.stream_id);
+      if (it != streams_.end()) {
+        bool refused = code == static_cast<uint32_t>(ErrorCode::RefusedStream) && !it->second->response_started;
+        close_stream(it->second, "Stream reset by server (code " + std::to_string(code) + ")", refused);
+      }
+      return true;
+    }
+
+    case FrameType::Settings:
+      return handle_settings(header, payload);
+
+    case FrameType::PushPromise:
+      // Push is disabled in our SETTINGS
+      connection_error(ErrorCode::ProtocolError, "Unexpected HTTP/2 PUSH_PROMISE");
+      return false;
+
+    case FrameType::Ping:
+      if (payload.size() != 8 || header.stream_id != 0) {
+        connection_error(ErrorCode::FrameSizeError, "Invalid HTTP/2 PING frame");
+        return false;
+      }
+      if (!(header.flags & flags::kAck)) queue_frame(FrameType::Ping, flags::kAck, 0, payload);
+      return true;
+
+    case FrameType::GoAway:
+      if (payload.size() < 8) {
+        connection_error(ErrorCode::FrameSizeError, "Invalid HTTP/2 GOAWAY frame");
+        return false;
+      }
+      handle_goaway(payload);
+      return !closed_;
+
+    case FrameType::WindowUpdate:
+      return handle_window_update(header, payload);
+
+    default:
+      // PRIORITY and unknown frame types are ignored
+      return true;
+  }
+}
+
+bool Http2Connection::handle_data(const FrameHeader& header, std::string_view payload) {
+  if (header.stream_id == 0 || !strip_padding(header, payload)) {
+    connection_error(ErrorCode::ProtocolError, "Invalid HTTP/2 DATA frame");
+    return false;
+  }
+
+  // Flow control counts the whole frame, padding included
+  conn_recv_unacked_ += header.length;
+  if (conn_recv_unacked_ >= kConnectionWindow / 2) {
+    queue_frame(FrameType::WindowUpdate, 0, 0, uint32_payload(conn_recv_unacked_));
+    conn_recv_unacked_ = 0;
+  }
+
+  auto it = streams_.find(header.stream_id);
+  if (it == streams_.end()) return true;  // Cancelled or already closed
+  auto stream = it->second;
+
+  if (!stream->response_started) {
+    queue_frame(FrameType::RstStream, 0, stream->id, uint32_payload(static_cast<uint32_t>(ErrorCode::ProtocolError)));
+    close_stream(stream, "HTTP/2 DATA before response headers", false);
+    return true;
+  }
+
+  if (!payload.empty() && stream->handler.on_data) stream->handler.on_data(payload);
+
+  if (header.flags & flags::kEndStream) {
+    close_stream(stream, "", false);
+    return true;
+  }
+
+  stream->recv_unacked += header.length;
+  if (stream->recv_unacked >= kStreamWindow / 2) {
+    queue_frame(FrameType::WindowUpdate, 0, stream->id, uint32_payload(stream->recv_unacked));
+    stream->recv_unacked = 0;
+  }
+  return true;
+}
+
+bool Http2Connection::handle_headers_block(uint32_t stream_id, uint8_t frame_flags) {
+  // Always decode, even for streams we no longer track, to keep the HPACK state in sync
+  hpack::HeaderList headers;
+  bool decoded = decoder_.decode(header_block_, headers);
+  header_block_.clear();
+  if (!decoded) {
+    connection_error(ErrorCode::CompressionError, "HTTP/2 header decompression failed");
+    return false;
+  }
+
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end()) return true;
+  auto stream = it->second;
+
+  if (!stream->response_started) {
+    int status = 0;
+    for (const auto& field : headers) {
+      if (field.name == ":status") {
+        try {
+          status = std::stoi(field.value);
+        } catch (const std::exception&) {
+          status = 0;
+        }
+      }
+    }
+    if (status == 0) {
+      queue_frame(FrameType::RstStream, 0, stream->id, uint32_payload(static_cast<uint32_t>(ErrorCode::ProtocolError)));
+      close_stream(stream, "Invalid HTTP/2 response headers", false);
+      return true;
+    }
+    if (status >= 200) {
+      stream->response_started = true;
+      if (stream->handler.on_headers) stream->handler.on_headers(status, headers);
+    }
+  }
+  // Later header blocks are trailers, which we do not use
+
+  if (frame_flags & flags::kEndStream) {
+    close_stream(stream, stream->response_started ? "" : "HTTP/2 stream ended without a response", false);
+  }
+  return true;
+}
+
+bool Http2Connection::handle_settings(const FrameHeader& header, std::string_view payload) {
+  if (header.stream_id != 0) {
+    connection_error(ErrorCode::ProtocolError, "Invalid HTTP/2 SETTINGS frame");
+    return false;
+  }
+  if (header.flags & flags::kAck) return true;
+  if (payload.size() % 6 != 0) {
+    connection_error(ErrorCode::FrameSizeError, "Invalid HTTP/2 SETTINGS frame");
+    return false;
+  }
+
+  for (size_t i = 0; i < payload.size(); i += 6) {
+    const auto* data = reinterpret_cast<const uint8_t*>(payload.data() + i);
+    auto id = static_cast<SettingId>((uint16_t(data[0]) << 8) | data[1]);
+    auto value = read_uint32(data + 2);
+
+    switch (id) {
+      case SettingId::HeaderTableSize:
+        encoder_.set_max_table_size(value);
+        break;
+      case SettingId::MaxConcurrentStreams:
+        peer_max_concurrent_ = value;
+        break;
+      case SettingId::InitialWindowSize: {
+        if (value > kMaxWindowSize) {
+          connection_error(ErrorCode::FlowControlError, "Invalid HTTP/2 initial window size");
+          return false;
+        }
+        // Applies retroactively to every open stream
+        int64_t delta = int64_t(value) - int64_t(peer_initial_window_);
+        for (auto& [stream_id, stream] : streams_) stream->send_window += delta;
+        peer_initial_window_ = value;
+        break;
+      }
+      case SettingId::MaxFrameSize:
+        if (value < kDefaultMaxFrameSize || value > 0xffffff) {
+          connection_error(ErrorCode::ProtocolError, "Invalid HTTP/2 max frame size");
+          return false;
+        }
+        peer_max_frame_size_ = value;
+        break;
+      default:
+        break;
+    }
+  }
+
+  queue_frame(FrameType::Settings, flags::kAck, 0, {});
+  open_pending_streams();
+  send_bodies();
+  return true;
+}
+
+void Http2Connection::handle_goaway(std::string_view payload) {
+  const auto* data = reinterpret_cast<const uint8_t*>(payload.data());
+  uint32_t last_stream_id = read_uint32(data) & 0x7fffffff;
+  uint32_t code = read_uint32(data + 4);
+  if (code != static_cast<uint32_t>(ErrorCode::NoError)) {
+    spdlog::warn("[HTTP/2] GOAWAY received (code {})", code);
+  }
+
+  goaway_received_ = true;
+  update_usable();
+
+  // Streams the server never processed can be retried on another connection
+  std::vector<std::shared_ptr<Stream>> refused(pending_.begin(), pending_.end());
+  for (auto& [stream_id, stream] : streams_) {
+    if (stream_id > last_stream_id) refused.push_back(stream);
+  }
+  for (auto& stream : refused) {
+    close_stream(stream, "HTTP/2 connection going away", true);
+  }
+
+  if (streams_.empty()) shutdown("HTTP/2 connection going away");
+}
+
+bool Http2Connection::handle_window_update(const FrameHeader& header, std::string_view payload) {
+  if (payload.size() != 4) {
+    connection_error(ErrorCode::FrameSizeError, "Invalid HTTP/2 WINDOW_UPDATE frame");
+    return false;
+  }
+  uint32_t increment = read_uint32(reinterpret_cast<const uint8_t*>(payload.data())) & 0x7fffffff;
+
+  if (header.stream_id == 0) {
+    if (increment == 0 || conn_send_window_ + increment > kMaxWindowSize) {
+      connection_error(ErrorCode::FlowControlError, "Invalid HTTP/2 connection window update");
+      return false;
+    }
+    conn_send_window_ += increment;
+  } else {
+    auto it = streams_.find(header.stream_id);
+    if (it == streams_.end()) return true;
+    auto stream = it->second;
+    if (increment == 0 || stream->send_window + increment > kMaxWindowSize) {
+      queue_frame(FrameType::RstStream, 0, stream->id, uint32_payload(static_cast<uint32_t>(ErrorCode::FlowControlError)));
+      close_stream(stream, "HTTP/2 flow control error", false);
+      return true;
+    }
+    stream->send_window += increment;
+  }
+
+  send_bodies();
+  return true;
+}
+
+// ---- Writing ----
+
+void Http2Connection::open_pending_streams() {
+  while (!pending_.empty() && streams_.size() < peer_max_concurrent_ && !closed_ && !goaway_received_) {
+    auto stream = pending_.front();
+    pending_.pop_front();
+
+    if (next_stream_id_ > kMaxWindowSize) {
+      // Stream ids exhausted; the caller retries on a new connection
+      close_stream(stream, "HTTP/2 stream ids exhausted", true);
+      continue;
+    }
+
+    stream->id = next_stream_id_;
+    next_stream_id_ += 2;
+    stream->send_window = peer_initial_window_;
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.streams_opened++;
+      if (!streams_.empty()) stats_.streams_multiplexed++;
+      stats_.active_streams = streams_.size() + 1;
+    }
+    streams_[stream->id] = stream;
+
+    // HPACK state depends on block order, so encode right before queueing
+    std::string block = encoder_.encode(stream->headers);
+    stream->headers.clear();
+    bool end_stream = stream->body.empty();
+    stream->end_stream_sent = end_stream;
+
+    std::string_view rest(block);
+    bool first = true;
+    do {
+      auto fragment = rest.substr(0, peer_max_frame_size_);
+      rest.remove_prefix(fragment.size());
+      uint8_t frame_flags = rest.empty() ? flags::kEndHeaders : 0;
+      if (first && end_stream) frame_flags |= flags::kEndStream;
+      queue_frame(first ? FrameType::Headers : FrameType::Continuation, frame_flags, stream->id, fragment);
+      first = false;
+    } while (!rest.empty());
+  }
+  update_usable();
+  send_bodies();
+}
+
+void Http2Connection::send_bodies() {
+  for (auto& [stream_id, stream] : streams_) {
+    while (!stream->end_stream_sent && conn_send_window_ > 0 && stream->send_window > 0) {
+      size_t remaining = stream->body.size() - stream->body_offset;
+      auto window = static_cast<size_t>(std::min(conn_send_window_, stream->send_window));
+      size_t n = std::min({remaining, window, static_cast<size_t>(peer_max_frame_size_)});
+      bool last = n == remaining;
+
+      queue_frame(FrameType::Data, last ? flags::kEndStream : 0, stream_id, std::string_view(stream->body).substr(stream->body_offset, n));
+      stream->body_offset += n;
+      stream->send_window -= static_cast<int64_t>(n);
+      conn_send_window_ -= static_cast<int64_t>(n);
+      if (last) {
+        stream->end_stream_sent = true;
+        stream->body.clear();
+        stream->body.shrink_to_fit();
+      }
+    }
+  }
+}
+
+void Http2Connection::queue_frame(FrameType type, uint8_t frame_flags, uint32_t stream_id, std::string_view payload) {
+  append_frame(output_, type, frame_flags, stream_id, payload);
+}
+
+void Http2Connection::flush() {
+  if (write_in_flight_) return;
+  if (output_.empty()) {
+    if (closed_) close_socket_();
+    return;
+  }
+
+  writing_.swap(output_);
+  output_.clear();
+  write_in_flight_ = true;
+  auto self = shared_from_this();
+  write_(asio::buffer(writing_), [self](const asio::error_code& ec, size_t) {
+    asio::dispatch(self->strand_, [self, ec]() {
+      self->write_in_flight_ = false;
+      self->writing_.clear();
+      if (ec) {
+        self->output_.clear();
+        self->shutdown("Write failed: " + ec.message());
+        self->close_socket_();
+        return;
+      }
+      self->flush();
+    });
+  });
+}
+
+// ---- Teardown ----
+
+void Http2Connection::close_stream(const std::shared_ptr<Stream>& stream, const std::string& error, bool retryable) {
+  if (stream->id != 0) streams_.erase(stream->id);
+  requests_.erase(stream->request_id);
+  pending_.erase(std::remove(pending_.begin(), pending_.end(), stream), pending_.end());
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.active_streams = streams_.size();
+  }
+
+  auto handler = std::move(stream->handler);
+  stream->handler = {};
+  if (handler.on_close) handler.on_close(error, retryable);
+
+  if (goaway_received_ && streams_.empty() && !closed_) {
+    shutdown("HTTP/2 connection going away");
+  } else {
+    open_pending_streams();
+  }
+}
+
+void Http2Connection::connection_error(ErrorCode code, const std::string& message) {
+  spdlog::warn("[HTTP/2] Connection error: {}", message);
+  std::string payload;
+  append_uint32(payload, next_stream_id_ > 1 ? next_stream_id_ - 2 : 0);
+  append_uint32(payload, static_cast<uint32_t>(code));
+  queue_frame(FrameType::GoAway, 0, 0, payload);
+  shutdown(message);
+}
+
+void Http2Connection::shutdown(const std::string& error) {
+  if (closed_) return;
+  closed_ = true;
+  update_usable();
+
+  // Streams that never reached the server can be retried elsewhere
+  std::vector<std::shared_ptr<Stream>> streams;
+  for (auto& [request_id, stream] : requests_) streams.push_back(stream);
+  for (auto& stream : streams) {
+    close_stream(stream, error, stream->id == 0);
+  }
+
+  // Send whatever is queued (e.g. GOAWAY), then close the socket
+  flush();
+}
+
+void Http2Connection::update_usable() {
+  bool usable = !closed_ && !goaway_received_ && next_stream_id_ <= kMaxWindowSize;
+  if (usable_.load() && !usable) {
+    usable_ = false;
+    if (on_closed_) on_closed_();
+  }
+}
+
+}  // namespace agent::net
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hpack.hpp"
+
+namespace agent::net {
+
+// HTTP/2 wire format (RFC 9113)
+namespace http2 {
+
+constexpr std::string_view kClientPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr size_t kFrameHeaderSize = 9;
+constexpr uint32_t kDefaultWindowSize = 65535;
+constexpr uint32_t kDefaultMaxFrameSize = 16384;
+constexpr uint32_t kMaxWindowSize = 0x7fffffff;
+
+enum class FrameType : uint8_t {
+  Data = 0x0,
+  Headers = 0x1,
+  Priority = 0x2,
+  RstStream = 0x3,
+  Settings = 0x4,
+  PushPromise = 0x5,
+  Ping = 0x6,
+  GoAway = 0x7,
+  WindowUpdate = 0x8,
+  Continuation = 0x9
+};
+
+namespace flags {
+constexpr uint8_t kEndStream = 0x1;
+constexpr uint8_t kAck = 0x1;
+constexpr uint8_t kEndHeaders = 0x4;
+constexpr uint8_t kPadded = 0x8;
+constexpr uint8_t kPriority = 0x20;
+}  // namespace flags
+
+enum class SettingId : uint16_t {
+  HeaderTableSize = 0x1,
+  EnablePush = 0x2,
+  MaxConcurrentStreams = 0x3,
+  InitialWindowSize = 0x4,
+  MaxFrameSize = 0x5,
+  MaxHeaderListSize = 0x6
+};
+
+enum class ErrorCode : uint32_t {
+  NoError = 0x0,
+  ProtocolError = 0x1,
+  InternalError = 0x2,
+  FlowControlError = 0x3,
+  SettingsTimeout = 0x4,
+  StreamClosed = 0x5,
+  FrameSizeError = 0x6,
+  RefusedStream = 0x7,
+  Cancel = 0x8,
+  CompressionError = 0x9
+};
+
+struct FrameHeader {
+  uint32_t length = 0;
+  FrameType type = FrameType::Data;
+  uint8_t flags = 0;
+  uint32_t stream_id = 0;
+};
+
+// Append a frame (header + payload) to out
+void append_frame(std::string& out, FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload);
+
+// Parse a 9-byte frame header
+FrameHeader parse_frame_header(const uint8_t* data);
+
+void append_uint32(std::string& out, uint32_t value);
+uint32_t read_uint32(const uint8_t* data);
+
+// Remove padding (and the priority block on HEADERS) from a frame payload. Returns false if malformed.
+bool strip_padding(const FrameHeader& header, std::string_view& payload);
+
+}  // namespace http2
+
+// Callbacks for one request stream. All run on the connection's strand.
+struct Http2StreamHandler {
+  std::function<void(int status_code, const hpack::HeaderList& headers)> on_headers;
+  std::function<void(std::string_view data)> on_data;
+  // Called exactly once. error is empty when the response ended normally; retryable is set when the
+  // server refused the stream before processing it (RST_STREAM REFUSED_STREAM or beyond GOAWAY)
+  std::function<void(const std::string& error, bool retryable)> on_close;
+};
+
+// HTTP/2 counters
+struct Http2Stats {
+  uint64_t streams_opened = 0;
+  uint64_t streams_multiplexed = 0;  // Opened while another stream was active on the same connection
+  uint64_t streams_queued = 0;       // Waited for the server's MAX_CONCURRENT_STREAMS
+  size_t active_streams = 0;
+};
+
+// Client side of one HTTP/2 connection, multiplexing request streams over a single socket.
+// Thread-safe: all state lives on an internal strand.
+class Http2Connection : public std::enable_shared_from_this<Http2Connection> {
+ public:
+  // Type-erased transport operations so one implementation serves TCP and TLS sockets
+  using ReadFunction = std::function<void(asio::mutable_buffer, std::function<void(const asio::error_code&, size_t)>)>;
+  using WriteFunction = std::function<void(asio::const_buffer, std::function<void(const asio::error_code&, size_t)>)>;
+
+  template <typename Stream>
+  static std::shared_ptr<Http2Connection> create(asio::io_context& io_ctx, std::shared_ptr<Stream> stream) {
+    auto read = [stream](asio::mutable_buffer buffer, std::function<void(const asio::error_code&, size_t)> handler) {
+      stream->async_read_some(buffer, std::move(handler));
+    };
+    auto write = [stream](asio::const_buffer buffer, std::function<void(const asio::error_code&, size_t)> handler) {
+      asio::async_write(*stream, buffer, std::move(handler));
+    };
+    auto close = [stream]() {
+      asio::error_code ignored;
+      stream->lowest_layer().close(ignored);
+    };
+    return std::shared_ptr<Http2Connection>(new Http2Connection(io_ctx, std::move(read), std::move(write), std::move(close)));
+  }
+
+  ~Http2Connection();
+
+  // Send the connection preface and our SETTINGS, then start reading
+  void start();
+
+  // Open a request stream. headers must contain the pseudo-headers (:method, :scheme, :authority, :path) first
+  // and lowercase names. Returns an id for cancel().
+  uint64_t submit(hpack::HeaderList headers, std::string body, Http2StreamHandler handler);
+
+  // Reset a stream (RST_STREAM CANCEL); its on_close is not called afterwards
+  void cancel(uint64_t request_id);
+
+  // Fail all streams and close the socket
+  void close();
+
+  // Whether new streams may be submitted (open, no GOAWAY received, stream ids left)
+  bool usable() const;
+
+  // Invoked once when the connection becomes unusable
+  void set_on_closed(std::function<void()> on_closed);
+
+  Http2Stats stats() const;
+
+ private:
+  struct Stream;
+
+  Http2Connection(asio::io_context& io_ctx, ReadFunction read, WriteFunction write, std::function<void()> close);
+
+  void do_read();
+  void process_input();
+  bool handle_frame(const http2::FrameHeader& header, std::string_view payload);
+  bool handle_data(const http2::FrameHeader& header, std::string_view payload);
+  bool handle_headers_block(uint32_t stream_id, uint8_t flags);
+  bool handle_settings(const http2::FrameHeader& header, std::string_view payload);
+  void handle_goaway(std::string_view payload);
+  bool handle_window_update(const http2::FrameHeader& header, std::string_view payload);
+
+  void open_pending_streams();
+  void send_bodies();
+  void queue_frame(http2::FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload);
+  void flush();
+  void close_stream(const std::shared_ptr<Stream>& stream, const std::string& error, bool retryable);
+  void connection_error(http2::ErrorCode code, const std::string& message);
+  void shutdown(const std::string& error);
+  void update_usable();
+
+  asio::strand<asio::io_context::executor_type> strand_;
+  ReadFunction read_;
+  WriteFunction write_;
+  std::function<void()> close_socket_;
+  std::function<void()> on_closed_;
+
+  std::atomic<bool> usable_{true};
+  std::atomic<uint64_t> next_request_id_{1};
+  bool closed_ = false;
+  bool goaway_received_ = false;
+  uint32_t next_stream_id_ = 1;
+
+  // Peer settings
+  uint32_t peer_max_concurrent_ = 100;
+  uint32_t peer_initial_window_ = http2::kDefaultWindowSize;
+  uint32_t peer_max_frame_size_ = http2::kDefaultMaxFrameSize;
+
+  // Flow control. Send windows may go negative after a SETTINGS change.
+  int64_t conn_send_window_ = http2::kDefaultWindowSize;
+  uint32_t conn_recv_unacked_ = 0;
+
+  hpack::Encoder encoder_;
+  hpack::Decoder decoder_;
+
+  std::map<uint32_t, std::shared_ptr<Stream>> streams_;   // Open streams by stream id
+  std::deque<std::shared_ptr<Stream>> pending_;           // Waiting for a concurrency slot
+  std::map<uint64_t, std::shared_ptr<Stream>> requests_;  // All live streams by request id
+
+  // Header block being assembled from HEADERS + CONTINUATION
+  uint32_t continuation_stream_ = 0;
+  uint8_t continuation_flags_ = 0;
+  std::string header_block_;
+
+  std::vector<uint8_t> read_buffer_;
+  std::string input_;
+  std::string output_;   // Frames queued while a write is in flight
+  std::string writing_;  // Buffer of the write in flight
+  bool write_in_flight_ = false;
+
+  mutable std::mutex stats_mutex_;
+  Http2Stats stats_;
+};
+
+}  // namespace agent::net
@@ -4,16 +4,29 @@
 #include <openssl/ssl.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <mutex>
 #include <regex>
 #include <sstream>
-#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "content_decoder.hpp"
+#include "dns_cache.hpp"
+#include "http2.hpp"
+#include "http_framing.hpp"
+#include "retry_policy.hpp"
+#include "tls_session_cache.hpp"
 
 namespace agent::net {
 
 // URL parsing
 std::optional<ParsedUrl> ParsedUrl::parse(const std::string& url) {
   // Simple regex-based URL parser
-  std::regex url_regex(R"(^(https?):\/\/([^:\/\s]+)(?::(\d+))?(\/[^\?\s]*)?(\?[^\s]*)?)");
+  static const std::regex url_regex(R"(^(https?):\/\/([^:\/\s]+)(?::(\d+))?(\/[^\?\s]*)?(\?[^\s]*)?)");
   std::smatch match;
 
   if (!std::regex_match(url, match, url_regex)) {
@@ -35,12 +48,120 @@ std::string ParsedUrl::port_or_default() const {
   return is_https() ? "443" : "80";
 }
 
-// HTTP Client implementation
-class HttpClient::Impl {
+namespace {
+
+// HTTP/2 connections are shared by every HttpClient on the same io_context, so concurrent sessions
+// (subagents, compaction, title generation) multiplex their calls over one connection per host
+struct Http2Pool {
+  // Receives the connection, or nullptr with an empty error when the host only speaks HTTP/1.1
+  using Waiter = std::function<void(std::shared_ptr<Http2Connection> conn, const std::string& error)>;
+
+  // A connect in progress and the requests waiting for it, which may come from different clients
+  struct Connect {
+    uint64_t id = 0;
+    std::function<void()> close;         // Closes the socket, once the connect has one
+    std::map<uint64_t, Waiter> waiters;  // By waiter id, in arrival order
+  };
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<Http2Connection>> connections;
+  std::unordered_map<std::string, Connect> connecting;  // By host
+  std::unordered_set<std::string> http1_hosts;          // Hosts that chose HTTP/1.1 during ALPN
+  uint64_t next_id = 0;                                 // Connect and waiter ids
+
+  ~Http2Pool() {
+    for (auto& [key, conn] : connections) conn->close();
+  }
+
+  // Take a waiter back out of the connect to key, or nullptr once the connect has handed it a result.
+  // The last waiter to leave abandons the connect and closes its socket.
+  Waiter leave(const std::string& key, uint64_t waiter_id) {
+    Waiter waiter;
+    std::function<void()> close;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = connecting.find(key);
+      if (it == connecting.end()) return nullptr;
+      auto node = it->second.waiters.extract(waiter_id);
+      if (node.empty()) return nullptr;
+      waiter = std::move(node.mapped());
+      if (it->second.waiters.empty()) {
+        close = std::move(it->second.close);
+        connecting.erase(it);
+      }
+    }
+    if (close) close();
+    return waiter;
+  }
+
+  static std::shared_ptr<Http2Pool> for_context(asio::io_context& io_ctx) {
+    static std::mutex registry_mutex;
+    static std::map<asio::io_context*, std::weak_ptr<Http2Pool>> registry;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto it = registry.begin(); it != registry.end();) {
+      it = it->second.expired() ? registry.erase(it) : std::next(it);
+    }
+    auto& weak = registry[&io_ctx];
+    auto pool = weak.lock();
+    if (!pool) {
+      pool = std::make_shared<Http2Pool>();
+      weak = pool;
+    }
+    return pool;
+  }
+};
+
+// Error reported for requests ended by HttpClient::cancel()
+constexpr const char* kCancelledError = "Request cancelled";
+
+// ALPN protocol list offered on TLS connections that may use HTTP/2
+constexpr unsigned char kAlpnProtocols[] = {2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+
+// Adapt a completion that has no use for the response headers
+StreamHeadersCompletion without_headers(std::function<void(int, const std::string&)> on_complete) {
+  return [on_complete = std::move(on_complete)](int status_code, const std::string& error, const std::map<std::string, std::string>&) {
+    on_complete(status_code, error);
+  };
+}
+
+}  // namespace
+
+// HTTP Client implementation. Shared so that queued requests and retry timers, which may outlive the client,
+// hold it by weak reference and find it gone instead of touching freed memory; those requests then report
+// cancellation. Requests already dispatched hold it strongly: their completions still untrack, check in and
+// retry, so the client lives until they end.
+class HttpClient::Impl : public std::enable_shared_from_this<Impl> {
  public:
-  explicit Impl(asio::io_context& io_ctx) : io_ctx_(io_ctx), ssl_ctx_(asio::ssl::context::tlsv12_client), resolver_(io_ctx) {
+  using TcpSocket = asio::ip::tcp::socket;
+  using SslSocket = asio::ssl::stream<asio::ip::tcp::socket>;
+
+  // Completion of one streaming attempt. Headers of an error response are kept so a retry can honour Retry-After.
+  struct StreamCompletion {
+    std::function<void(int, const std::string&)> callback;
+    std::map<std::string, std::string> headers;
+
+    void operator()(int status_code, const std::string& error) const {
+      callback(status_code, error);
+    }
+  };
+
+  explicit Impl(asio::io_context& io_ctx) : io_ctx_(io_ctx), ssl_ctx_(asio::ssl::context::tls_client), h2_pool_(Http2Pool::for_context(io_ctx)) {
     ssl_ctx_.set_default_verify_paths();
     ssl_ctx_.set_verify_mode(asio::ssl::verify_peer);
+    // TLS 1.2 or newer (1.3 enables ticket-based resumption)
+    SSL_CTX_set_min_proto_version(ssl_ctx_.native_handle(), TLS1_2_VERSION);
+    TlsSessionCache::instance().attach(ssl_ctx_.native_handle());
+  }
+
+  ~Impl() {
+    // Cut backoffs short so their timers do not keep io_ctx_ busy; the handlers then find the client gone
+    for (auto& [id, timer] : retry_timers_) {
+      asio::post(io_ctx_, [timer = timer]() {
+        timer->cancel();
+      });
+    }
+    clear_pool();
   }
 
   void request(const std::string& url, const HttpOptions& options, std::function<void(HttpResponse)> callback) {
@@ -49,42 +170,299 @@ class HttpClient::Impl {
       callback(HttpResponse{0, {}, "", "Invalid URL"});
       return;
     }
-
-    if (parsed->is_https()) {
-      request_https(*parsed, options, std::move(callback));
-    } else {
-      request_http(*parsed, options, std::move(callback));
-    }
+    attempt_request(*parsed, options, std::move(callback), 0, generation());
   }
 
-  void request_stream(const std::string& url, const HttpOptions& options, StreamDataCallback on_data,
-                      std::function<void(int, const std::string&)> on_complete) {
+  void request_stream(const std::string& url, const HttpOptions& options, StreamViewCallback on_data, StreamHeadersCompletion on_complete) {
     auto parsed = ParsedUrl::parse(url);
     if (!parsed) {
-      on_complete(0, "Invalid URL");
+      on_complete(0, "Invalid URL", {});
       return;
     }
+    attempt_stream(*parsed, options, std::make_shared<StreamViewCallback>(std::move(on_data)), std::move(on_complete), 0, generation());
+  }
+
+  // ---- Scheduling and retries ----
+
+  // Each attempt takes its own scheduler slot, so a request backing off does not hold up others.
+  // generation is the cancel() count when the request started; once it moves on the request reports cancellation.
+  void attempt_request(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback, int attempt,
+                       uint64_t generation) {
+    RequestScheduler::instance().submit(
+        io_ctx_, pool_key(url), options.priority,
+        [this, weak = weak_from_this(), url, options, callback, attempt, generation](RequestScheduler::Release release) {
+          auto self = weak.lock();
+          if (!self) {
+            release();  // The client was destroyed while this waited for a slot
+            callback(HttpResponse{0, {}, "", kCancelledError});
+            return;
+          }
+          if (cancelled_since(generation)) {
+            release();
+            callback(HttpResponse{0, {}, "", kCancelledError});
+            return;
+          }
+          dispatch_request(url, options, [this, self, url, options, callback, attempt, generation, release](HttpResponse response) {
+            release();
+            if (cancelled_since(generation)) {
+              callback(HttpResponse{0, {}, "", kCancelledError});
+              return;
+            }
+            auto delay = next_retry(options, attempt, response.status_code, response.status_code ? response.body : response.error, response.headers,
+                                    response.ok() && response.error.empty(), false);
+            if (!delay) {
+              callback(std::move(response));
+              return;
+            }
+            spdlog::warn("HTTP request to {}{} failed (status={}, error={}), retrying {}/{} in {}ms", pool_key(url), url.path, response.status_code,
+                         response.error, attempt + 1, options.retry.max_retries, delay->count());
+            retry_after(
+                *delay,
+                [this, url, options, callback, attempt, generation]() {
+                  attempt_request(url, options, callback, attempt + 1, generation);
+                },
+                [callback]() {
+                  callback(HttpResponse{0, {}, "", kCancelledError});
+                });
+          });
+        });
+  }
+
+  void attempt_stream(const ParsedUrl& url, const HttpOptions& options, std::shared_ptr<StreamViewCallback> on_data,
+                      StreamHeadersCompletion on_complete, int attempt, uint64_t generation) {
+    RequestScheduler::instance().submit(
+        io_ctx_, pool_key(url), options.priority,
+        [this, weak = weak_from_this(), url, options, on_data, on_complete, attempt, generation](RequestScheduler::Release release) {
+          auto self = weak.lock();
+          if (!self) {
+            release();
+            on_complete(0, kCancelledError, {});
+            return;
+          }
+          if (cancelled_since(generation)) {
+            release();
+            on_complete(0, kCancelledError, {});
+            return;
+          }
+          // Once a byte has reached the caller a Streaming request can no longer be replayed
+          auto body_started = std::make_shared<bool>(false);
+          auto tracked = std::make_shared<StreamViewCallback>([on_data, body_started](std::string_view chunk) {
+            *body_started = true;
+            (*on_data)(chunk);
+          });
+          auto completion = std::make_shared<StreamCompletion>();
+          completion->callback = [this, self, url, options, on_data, on_complete, attempt, generation, release, body_started,
+                                  completion = completion.get()](int status_code, const std::string& error) {
+            release();
+            if (cancelled_since(generation)) {
+              on_complete(0, kCancelledError, {});
+              return;
+            }
+            bool succeeded = status_code >= 200 && status_code < 300 && error.empty();
+            auto delay = next_retry(options, attempt, status_code, error, completion->headers, succeeded, *body_started);
+            if (!delay) {
+              on_complete(status_code, error, completion->headers);
+              return;
+            }
+            spdlog::warn("HTTP stream to {}{} failed (status={}, error={}), retrying {}/{} in {}ms", pool_key(url), url.path, status_code, error,
+                         attempt + 1, options.retry.max_retries, delay->count());
+            retry_after(
+                *delay,
+                [this, url, options, on_data, on_complete, attempt, generation]() {
+                  attempt_stream(url, options, on_data, on_complete, attempt + 1, generation);
+                },
+                [on_complete]() {
+                  on_complete(0, kCancelledError, {});
+                });
+          };
+          dispatch_stream(url, options, tracked, completion);
+        });
+  }
+
+  // Delay before retrying a finished attempt, or nullopt to report it. Successes refill the retry budget.
+  static std::optional<std::chrono::milliseconds> next_retry(const HttpOptions& options, int attempt, int status_code, std::string_view body,
+                                                             const std::map<std::string, std::string>& headers, bool succeeded, bool body_started) {
+    if (succeeded) {
+      RetryBudget::instance().record_success();
+      return std::nullopt;
+    }
+    auto delay = options.retry.next_delay(attempt, status_code, body, headers, body_started);
+    if (delay && options.retry.use_budget && !RetryBudget::instance().try_acquire()) {
+      spdlog::warn("HTTP retry budget exhausted, not retrying (status={})", status_code);
+      return std::nullopt;
+    }
+    return delay;
+  }
 
-    if (parsed->is_https()) {
-      request_stream_https(*parsed, options, std::move(on_data), std::move(on_complete));
+  // cancel() cuts the wait short; the next attempt then sees the new generation and reports cancellation.
+  // If the client is destroyed during the wait, gone reports cancellation instead of retrying.
+  void retry_after(std::chrono::milliseconds delay, std::function<void()> retry, std::function<void()> gone) {
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, delay);
+    auto active_id = track([timer]() {
+      timer->cancel();
+    });
+    {
+      std::lock_guard<std::mutex> lock(active_mutex_);
+      retry_timers_[active_id] = timer;
+    }
+    timer->async_wait([weak = weak_from_this(), timer, active_id, retry = std::move(retry), gone = std::move(gone)](const asio::error_code&) {
+      auto self = weak.lock();
+      if (!self) {
+        gone();
+        return;
+      }
+      self->untrack(active_id);
+      retry();
+    });
+  }
+
+  // ---- Cancellation ----
+
+  void cancel() {
+    std::vector<std::function<void()>> aborts;
+    {
+      std::lock_guard<std::mutex> lock(active_mutex_);
+      generation_++;
+      for (auto& [id, abort] : active_) aborts.push_back(std::move(abort));
+      active_.clear();
+    }
+    for (auto& abort : aborts) asio::post(io_ctx_, std::move(abort));
+  }
+
+  uint64_t generation() const {
+    std::lock_guard<std::mutex> lock(active_mutex_);
+    return generation_;
+  }
+
+  bool cancelled_since(uint64_t generation) const {
+    return this->generation() != generation;
+  }
+
+  // Register how to abort a request on the wire (run on io_ctx_). Returns an id for untrack().
+  uint64_t track(std::function<void()> abort) {
+    std::lock_guard<std::mutex> lock(active_mutex_);
+    auto id = ++next_active_id_;
+    active_[id] = std::move(abort);
+    return id;
+  }
+
+  void untrack(uint64_t id) {
+    std::lock_guard<std::mutex> lock(active_mutex_);
+    active_.erase(id);
+    retry_timers_.erase(id);
+  }
+
+  // ---- Dispatch (holding a scheduler slot) ----
+
+  void dispatch_request(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback) {
+    if (url.is_https()) {
+      if (use_http2(url, options)) {
+        start_http2_request<SslSocket>(url, options, std::move(callback), false);
+      } else {
+        start_request<SslSocket>(url, options, std::move(callback), true);
+      }
     } else {
-      request_stream_http(*parsed, options, std::move(on_data), std::move(on_complete));
+      if (use_http2(url, options)) {
+        start_http2_request<TcpSocket>(url, options, std::move(callback), false);
+      } else {
+        start_request<TcpSocket>(url, options, std::move(callback), true);
+      }
     }
   }
 
+  void dispatch_stream(const ParsedUrl& url, const HttpOptions& options, std::shared_ptr<StreamViewCallback> shared_on_data,
+                       std::shared_ptr<StreamCompletion> shared_on_complete) {
+
+    if (url.is_https()) {
+      if (use_http2(url, options)) {
+        start_http2_stream<SslSocket>(url, options, shared_on_data, shared_on_complete, false);
+      } else {
+        start_stream<SslSocket>(url, options, shared_on_data, shared_on_complete, true);
+      }
+    } else {
+      if (use_http2(url, options)) {
+        start_http2_stream<TcpSocket>(url, options, shared_on_data, shared_on_complete, false);
+      } else {
+        start_stream<TcpSocket>(url, options, shared_on_data, shared_on_complete, true);
+      }
+    }
+  }
+
+  void set_pool_options(const ConnectionPoolOptions& options) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    pool_options_ = options;
+    evict_expired_locked(std::chrono::steady_clock::now());
+    while (idle_count_locked() > pool_options_.max_idle_total) {
+      evict_oldest_locked();
+    }
+  }
+
+  ConnectionPoolStats pool_stats() const {
+    ConnectionPoolStats stats;
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      stats = pool_stats_;
+      stats.idle = idle_count_locked();
+    }
+    std::lock_guard<std::mutex> lock(h2_pool_->mutex);
+    stats.h2_connections = h2_pool_->connections.size();
+    return stats;
+  }
+
+  void clear_pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    for_each_idle_map([](auto& idle) {
+      for (auto& [key, connections] : idle) {
+        for (auto& conn : connections) close_socket(conn.socket);
+      }
+      idle.clear();
+    });
+  }
+
  private:
+  // Status line and headers of a response
+  struct ResponseHead {
+    int status_code = 0;
+    int http_minor_version = 1;
+    std::map<std::string, std::string> headers;
+  };
+
+  // Progress through a response body
+  struct BodyReader {
+    ResponseFraming framing;
+    uint64_t remaining = 0;  // Bytes left for Content-Length framing
+    ChunkedDecoder chunked;
+    std::unique_ptr<ContentDecoder> content;  // Set when a compressed body is being inflated
+
+    explicit BodyReader(const ResponseFraming& f) : framing(f), remaining(f.content_length) {}
+  };
+
+  // State of one streaming exchange, shared by its read handlers
+  struct StreamContext {
+    int status_code = 0;
+    std::unique_ptr<BodyReader> body;
+    std::shared_ptr<StreamViewCallback> on_data;  // Receives views straight into the read buffer
+    bool decompress = false;                      // Accept-Encoding was sent; inflate compressed bodies
+    std::function<void(int, const std::string&, bool reusable)> finish;
+    std::shared_ptr<StreamCompletion> completion;  // Receives the headers of an error response
+  };
+
+  template <typename Socket>
+  struct IdleConnection {
+    std::shared_ptr<Socket> socket;
+    std::chrono::steady_clock::time_point idle_since;
+  };
+
+  template <typename Socket>
+  using IdleMap = std::unordered_map<std::string, std::deque<IdleConnection<Socket>>>;
+
   // Helper: close the lowest-layer socket, ignoring errors
   template <typename Socket>
-  static void close_socket(std::shared_ptr<Socket> socket) {
+  static void close_socket(const std::shared_ptr<Socket>& socket) {
     asio::error_code ignored;
     socket->lowest_layer().close(ignored);
   }
 
-  static void close_socket(std::shared_ptr<asio::ip::tcp::socket> socket) {
-    asio::error_code ignored;
-    socket->close(ignored);
-  }
-
   // Start a timeout timer. When it fires, set the timed_out flag and close the socket.
   template <typename Socket>
   static std::shared_ptr<asio::steady_timer> start_timeout(asio::io_context& io_ctx, std::chrono::seconds timeout, std::shared_ptr<Socket> socket,
@@ -101,31 +479,41 @@ class HttpClient::Impl {
     return timer;
   }
 
-  void request_https(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback) {
-    auto socket = std::make_shared<asio::ssl::stream<asio::ip::tcp::socket>>(io_ctx_, ssl_ctx_);
-    auto response = std::make_shared<HttpResponse>();
-    auto request_str = std::make_shared<std::string>();
-    auto buffer = std::make_shared<asio::streambuf>();
-    auto timed_out = std::make_shared<bool>(false);
+  // Abort hook for track(): behave as if the timeout fired, unless the request already finished
+  template <typename Socket>
+  static std::function<void()> abort_on_timeout(std::shared_ptr<asio::steady_timer> timer, std::shared_ptr<Socket> socket,
+                                                std::shared_ptr<bool> timed_out) {
+    return [timer, socket, timed_out]() {
+      if (timer->cancel() == 0) return;
+      *timed_out = true;
+      close_socket(socket);
+    };
+  }
 
-    // Start timeout timer
-    auto timer = start_timeout(io_ctx_, options.timeout, socket, timed_out);
+  // SSL connections may return various errors on close
+  // Treat any SSL category error as potential EOF
+  static bool is_eof(const asio::error_code& ec) {
+    return (ec == asio::error::eof) || (ec.category() == asio::error::get_ssl_category()) || ec == asio::ssl::error::stream_truncated;
+  }
 
-    // Wrap callback to cancel timer and check timeout
-    auto guarded_callback = [timer, timed_out, callback](HttpResponse resp) {
-      timer->cancel();
-      if (*timed_out) {
-        resp.error = "Request timed out";
-        resp.status_code = 0;
-      }
-      callback(std::move(resp));
-    };
+  static std::string pool_key(const ParsedUrl& url) {
+    return url.scheme + "://" + url.host + ":" + url.port_or_default();
+  }
 
-    // Build HTTP request
+  // Whether to advertise Accept-Encoding and inflate the response (callers that set their own
+  // Accept-Encoding get the body exactly as sent)
+  static bool negotiates_compression(const HttpOptions& options) {
+    return options.decompress && !find_header(options.headers, "Accept-Encoding");
+  }
+
+  static std::string build_request(const ParsedUrl& url, const HttpOptions& options) {
     std::ostringstream req;
     req << options.method << " " << url.path << url.query << " HTTP/1.1\r\n";
     req << "Host: " << url.host << "\r\n";
-    req << "Connection: close\r\n";
+    req << "Connection: " << (options.keep_alive ? "keep-alive" : "close") << "\r\n";
+    if (negotiates_compression(options)) {
+      req << "Accept-Encoding: " << kAcceptEncoding << "\r\n";
+    }
 
     for (const auto& [key, value] : options.headers) {
       req << key << ": " << value << "\r\n";
@@ -137,495 +525,952 @@ class HttpClient::Impl {
 
     req << "\r\n";
     req << options.body;
-    *request_str = req.str();
-
-    // Set SNI hostname
-    SSL_set_tlsext_host_name(socket->native_handle(), url.host.c_str());
-
-    // Resolve and connect
-    resolver_.async_resolve(
-        url.host, url.port_or_default(),
-        [this, socket, request_str, response, buffer, guarded_callback, url](const asio::error_code& ec,
-                                                                             asio::ip::tcp::resolver::results_type results) {
-          if (ec) {
-            response->error = "DNS resolution failed: " + ec.message();
-            guarded_callback(*response);
-            return;
-          }
+    return req.str();
+  }
 
-          asio::async_connect(
-              socket->lowest_layer(), results,
-              [this, socket, request_str, response, buffer, guarded_callback](const asio::error_code& ec, const asio::ip::tcp::endpoint&) {
-                if (ec) {
-                  response->error = "Connection failed: " + ec.message();
-                  guarded_callback(*response);
-                  return;
-                }
-
-                // SSL handshake
-                socket->async_handshake(asio::ssl::stream_base::client,
-                                        [this, socket, request_str, response, buffer, guarded_callback](const asio::error_code& ec) {
-                                          if (ec) {
-                                            response->error = "SSL handshake failed: " + ec.message();
-                                            guarded_callback(*response);
-                                            return;
-                                          }
-
-                                          // Send request
-                                          asio::async_write(*socket, asio::buffer(*request_str),
-                                                            [this, socket, response, buffer, guarded_callback](const asio::error_code& ec, size_t) {
-                                                              if (ec) {
-                                                                response->error = "Write failed: " + ec.message();
-                                                                guarded_callback(*response);
-                                                                return;
-                                                              }
-
-                                                              // Read response
-                                                              read_response(socket, response, buffer, guarded_callback);
-                                                            });
-                                        });
-              });
-        });
+  // ---- Connection management ----
+
+  template <typename Socket>
+  std::shared_ptr<Socket> make_socket(const ParsedUrl& url) {
+    if constexpr (std::is_same_v<Socket, SslSocket>) {
+      auto socket = std::make_shared<SslSocket>(io_ctx_, ssl_ctx_);
+      // Set SNI hostname
+      SSL_set_tlsext_host_name(socket->native_handle(), url.host.c_str());
+      TlsSessionCache::instance().prepare(socket->native_handle(), url.host + ":" + url.port_or_default());
+      return socket;
+    } else {
+      return std::make_shared<TcpSocket>(io_ctx_);
+    }
+  }
+
+  // Resolve, connect and (for TLS) handshake. on_connected receives an empty string on success.
+  template <typename Socket>
+  void connect(const ParsedUrl& url, std::shared_ptr<Socket> socket, std::function<void(const std::string& error)> on_connected) {
+    auto host = url.host;
+    auto port = url.port_or_default();
+    DnsCache::instance().resolve(io_ctx_, host, port, [socket, on_connected, host, port](const asio::error_code& ec, Endpoints endpoints) {
+      if (ec) {
+        on_connected("DNS resolution failed: " + ec.message());
+        return;
+      }
+
+      asio::async_connect(socket->lowest_layer(), endpoints, [socket, on_connected, host, port](const asio::error_code& ec, auto) {
+        if (ec) {
+          // The cached addresses may be outdated; resolve again next time
+          DnsCache::instance().invalidate(host, port);
+          on_connected("Connection failed: " + ec.message());
+          return;
+        }
+
+        asio::error_code ignored;
+        socket->lowest_layer().set_option(asio::ip::tcp::no_delay(true), ignored);
+
+        if constexpr (std::is_same_v<Socket, SslSocket>) {
+          // SSL handshake
+          socket->async_handshake(asio::ssl::stream_base::client, [socket, on_connected](const asio::error_code& ec) {
+            if (ec) {
+              on_connected("SSL handshake failed: " + ec.message());
+              return;
+            }
+            TlsSessionCache::instance().record_handshake(socket->native_handle());
+            on_connected("");
+          });
+        } else {
+          on_connected("");
+        }
+      });
+    });
+  }
+
+  template <typename Socket>
+  IdleMap<Socket>& idle_map() {
+    if constexpr (std::is_same_v<Socket, SslSocket>) {
+      return ssl_idle_;
+    } else {
+      return tcp_idle_;
+    }
+  }
+
+  template <typename F>
+  void for_each_idle_map(F&& f) {
+    f(tcp_idle_);
+    f(ssl_idle_);
+  }
+
+  template <typename F>
+  void for_each_idle_map(F&& f) const {
+    f(tcp_idle_);
+    f(ssl_idle_);
+  }
+
+  size_t idle_count_locked() const {
+    size_t count = 0;
+    for_each_idle_map([&count](const auto& idle) {
+      for (const auto& [key, connections] : idle) count += connections.size();
+    });
+    return count;
+  }
+
+  void evict_expired_locked(std::chrono::steady_clock::time_point now) {
+    for_each_idle_map([this, now](auto& idle) {
+      for (auto it = idle.begin(); it != idle.end();) {
+        auto& connections = it->second;
+        while (!connections.empty() && now - connections.front().idle_since >= pool_options_.idle_timeout) {
+          close_socket(connections.front().socket);
+          connections.pop_front();
+          pool_stats_.evictions++;
+        }
+        it = connections.empty() ? idle.erase(it) : std::next(it);
+      }
+    });
+  }
+
+  // Drop the connection that has been idle the longest, across all hosts
+  void evict_oldest_locked() {
+    std::optional<std::chrono::steady_clock::time_point> oldest;
+    for_each_idle_map([&oldest](const auto& idle) {
+      for (const auto& [key, connections] : idle) {
+        if (!connections.empty() && (!oldest || connections.front().idle_since < *oldest)) oldest = connections.front().idle_since;
+      }
+    });
+    if (!oldest) return;
+
+    bool evicted = false;
+    for_each_idle_map([this, &oldest, &evicted](auto& idle) {
+      for (auto it = idle.begin(); it != idle.end() && !evicted; ++it) {
+        auto& connections = it->second;
+        if (!connections.empty() && connections.front().idle_since == *oldest) {
+          close_socket(connections.front().socket);
+          connections.pop_front();
+          if (connections.empty()) idle.erase(it);
+          pool_stats_.evictions++;
+          evicted = true;
+          break;
+        }
+      }
+    });
+  }
+
+  // A pooled connection is reusable unless the server closed it while it sat idle
+  template <typename Socket>
+  static bool is_alive(Socket& socket) {
+    TcpSocket* tcp = nullptr;
+    if constexpr (std::is_same_v<Socket, SslSocket>) {
+      tcp = &socket.next_layer();
+    } else {
+      tcp = &socket;
+    }
+    if (!tcp->is_open()) return false;
+
+    asio::error_code ec;
+    char byte;
+    tcp->non_blocking(true, ec);
+    tcp->receive(asio::buffer(&byte, 1), asio::socket_base::message_peek, ec);
+    asio::error_code ignored;
+    tcp->non_blocking(false, ignored);
+
+    if (ec == asio::error::would_block || ec == asio::error::try_again) return true;
+    if (ec) return false;  // EOF or reset
+    // Unread bytes on an idle plain connection mean the stream is out of sync. For TLS they are
+    // usually post-handshake records (session tickets) that OpenSSL consumes on the next read.
+    return std::is_same_v<Socket, SslSocket>;
+  }
+
+  // An HTTP/1.1 request that found no idle connection to reuse. HTTP/2 connects are not misses:
+  // their streams are counted as h2_streams instead.
+  void count_reuse_miss() {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    pool_stats_.reuse_misses++;
+  }
+
+  // Take the most recently used live connection for key, or nullptr
+  template <typename Socket>
+  std::shared_ptr<Socket> checkout(const std::string& key) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    auto& idle = idle_map<Socket>();
+    auto it = idle.find(key);
+    if (it == idle.end()) return nullptr;
+
+    auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<Socket> result;
+    auto& connections = it->second;
+    while (!connections.empty() && !result) {
+      auto conn = std::move(connections.back());
+      connections.pop_back();
+      if (now - conn.idle_since < pool_options_.idle_timeout && is_alive(*conn.socket)) {
+        pool_stats_.reuse_hits++;
+        result = conn.socket;
+      } else {
+        close_socket(conn.socket);
+        pool_stats_.evictions++;
+      }
+    }
+    if (connections.empty()) idle.erase(it);
+    return result;
+  }
+
+  // Return a connection whose response was fully read to the idle pool
+  template <typename Socket>
+  void checkin(const std::string& key, std::shared_ptr<Socket> socket) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    evict_expired_locked(now);
+
+    if (pool_options_.max_idle_per_host == 0 || pool_options_.max_idle_total == 0) {
+      close_socket(socket);
+      pool_stats_.evictions++;
+      return;
+    }
+
+    auto& connections = idle_map<Socket>()[key];
+    if (connections.size() >= pool_options_.max_idle_per_host) {
+      close_socket(connections.front().socket);
+      connections.pop_front();
+      pool_stats_.evictions++;
+    }
+    connections.push_back({std::move(socket), now});
+
+    while (idle_count_locked() > pool_options_.max_idle_total) {
+      evict_oldest_locked();
+    }
+  }
+
+  // ---- Response parsing ----
+
+  // Parse status line and headers, consuming them from the buffer (body bytes stay buffered)
+  static bool parse_head(asio::streambuf& buffer, ResponseHead& head) {
+    std::istream stream(&buffer);
+    std::string status_line;
+    std::getline(stream, status_line);
+
+    // Parse status code
+    static const std::regex status_regex(R"(HTTP/(\d)(?:\.(\d))? (\d+))");
+    std::smatch match;
+    if (std::regex_search(status_line, match, status_regex)) {
+      try {
+        head.status_code = std::stoi(match[3].str());
+      } catch (const std::exception&) {
+        return false;
+      }
+      head.http_minor_version = (match[1].str() == "1" && match[2].matched) ? std::stoi(match[2].str()) : 1;
+    }
+
+    // Parse headers
+    std::string header_line;
+    while (std::getline(stream, header_line) && header_line != "\r") {
+      auto colon = header_line.find(':');
+      if (colon != std::string::npos) {
+        std::string key = header_line.substr(0, colon);
+        std::string value = header_line.substr(colon + 1);
+        // Trim whitespace
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+        head.headers[key] = value;
+      }
+    }
+    return true;
+  }
+
+  static std::unique_ptr<BodyReader> make_body_reader(const std::string& method, bool decompress, int status_code, int http_minor_version,
+                                                      const std::map<std::string, std::string>& headers) {
+    auto body = std::make_unique<BodyReader>(response_framing(method, status_code, http_minor_version, headers));
+    if (decompress) {
+      if (const auto* encoding = find_header(headers, "Content-Encoding")) body->content = ContentDecoder::create(*encoding);
+    }
+    return body;
+  }
+
+  // Feed buffered bytes to the body reader. Returns true once the body is complete (or malformed).
+  static bool consume_body(asio::streambuf& buffer, BodyReader& body, const ChunkedDecoder::DataCallback& on_data) {
+    std::string_view available(static_cast<const char*>(buffer.data().data()), buffer.size());
+
+    // Compressed payload is inflated before it reaches on_data
+    ChunkedDecoder::DataCallback inflate;
+    if (body.content) {
+      inflate = [&body, &on_data](std::string_view data) {
+        body.content->decode(data, on_data);
+      };
+    }
+    const auto& emit = body.content ? inflate : on_data;
+
+    bool complete = false;
+    switch (body.framing.framing) {
+      case BodyFraming::None:
+        complete = true;
+        break;
+
+      case BodyFraming::ContentLength: {
+        auto n = static_cast<size_t>(std::min<uint64_t>(body.remaining, available.size()));
+        if (n > 0) {
+          emit(available.substr(0, n));
+          buffer.consume(n);
+          body.remaining -= n;
+        }
+        complete = body.remaining == 0;
+        break;
+      }
+
+      case BodyFraming::Chunked: {
+        size_t used = body.chunked.decode(available, emit);
+        buffer.consume(used);
+        complete = body.chunked.done() || body.chunked.failed();
+        break;
+      }
+
+      case BodyFraming::UntilClose:
+        if (!available.empty()) {
+          emit(available);
+          buffer.consume(available.size());
+        }
+        break;
+    }
+    return complete || (body.content && body.content->failed());
+  }
+
+  // Error for a malformed body (empty when the body was read cleanly)
+  static std::string body_error(const BodyReader& body) {
+    if (body.chunked.failed()) return "Invalid chunked encoding";
+    if (body.content && body.content->failed()) return "Invalid compressed body: " + body.content->error();
+    return "";
   }
 
-  void request_http(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback) {
-    auto socket = std::make_shared<asio::ip::tcp::socket>(io_ctx_);
+  // Whether the connection can carry another request once the body reader is complete
+  static bool reusable(const BodyReader& body, const asio::streambuf& buffer) {
+    return body.framing.keep_alive && body_error(body).empty() && buffer.size() == 0;
+  }
+
+  // ---- Buffered requests ----
+
+  template <typename Socket>
+  void start_request(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback, bool allow_pooled) {
+    auto key = pool_key(url);
+    std::shared_ptr<Socket> socket = (options.keep_alive && allow_pooled) ? checkout<Socket>(key) : nullptr;
+    bool reused = socket != nullptr;
+    if (!socket) {
+      count_reuse_miss();
+      socket = make_socket<Socket>(url);
+    }
+
     auto response = std::make_shared<HttpResponse>();
-    auto request_str = std::make_shared<std::string>();
+    auto request_str = std::make_shared<std::string>(build_request(url, options));
     auto buffer = std::make_shared<asio::streambuf>();
     auto timed_out = std::make_shared<bool>(false);
 
-    // Start timeout timer
+    // Start timeout timer; cancel() ends the request the same way
     auto timer = start_timeout(io_ctx_, options.timeout, socket, timed_out);
+    auto active_id = track(abort_on_timeout(timer, socket, timed_out));
 
-    // Wrap callback to cancel timer and check timeout
-    auto guarded_callback = [timer, timed_out, callback](HttpResponse resp) {
-      timer->cancel();
+    // Wrap callback to cancel timer, check timeout and hand the connection back to the pool
+    auto guarded_callback = [this, self = shared_from_this(), timer, timed_out, callback, socket, key, active_id,
+                             keep_alive = options.keep_alive](HttpResponse resp, bool can_reuse) {
+      untrack(active_id);
+      bool cancelled = timer->cancel() > 0;
       if (*timed_out) {
         resp.error = "Request timed out";
         resp.status_code = 0;
+      } else if (keep_alive && can_reuse && cancelled) {
+        checkin<Socket>(key, socket);
+      } else {
+        close_socket(socket);
       }
       callback(std::move(resp));
     };
 
-    // Build HTTP request
-    std::ostringstream req;
-    req << options.method << " " << url.path << url.query << " HTTP/1.1\r\n";
-    req << "Host: " << url.host << "\r\n";
-    req << "Connection: close\r\n";
-
-    for (const auto& [key, value] : options.headers) {
-      req << key << ": " << value << "\r\n";
+    // A pooled connection the server has already closed fails before any response byte arrives;
+    // replay the request once on a fresh connection in that case
+    std::function<bool()> retry_fresh;
+    if (reused) {
+      retry_fresh = [this, url, options, callback, timer, timed_out, socket, active_id]() {
+        if (*timed_out) return false;
+        untrack(active_id);
+        timer->cancel();
+        close_socket(socket);
+        {
+          std::lock_guard<std::mutex> lock(pool_mutex_);
+          pool_stats_.stale_retries++;
+        }
+        start_request<Socket>(url, options, callback, false);
+        return true;
+      };
     }
 
-    if (!options.body.empty()) {
-      req << "Content-Length: " << options.body.size() << "\r\n";
-    }
+    auto send = [this, socket, request_str, response, buffer, guarded_callback, retry_fresh, method = options.method,
+                 decompress = negotiates_compression(options)]() {
+      asio::async_write(*socket, asio::buffer(*request_str),
+                        [this, socket, response, buffer, guarded_callback, retry_fresh, method, decompress](const asio::error_code& ec, size_t) {
+                          if (ec) {
+                            if (retry_fresh && retry_fresh()) return;
+                            response->error = "Write failed: " + ec.message();
+                            guarded_callback(*response, false);
+                            return;
+                          }
+
+                          // Read response
+                          read_response(socket, response, buffer, method, decompress, retry_fresh, guarded_callback);
+                        });
+    };
 
-    req << "\r\n";
-    req << options.body;
-    *request_str = req.str();
-
-    resolver_.async_resolve(
-        url.host, url.port_or_default(),
-        [this, socket, request_str, response, buffer, guarded_callback](const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
-          if (ec) {
-            response->error = "DNS resolution failed: " + ec.message();
-            guarded_callback(*response);
-            return;
-          }
+    if (reused) {
+      send();
+      return;
+    }
 
-          asio::async_connect(
-              *socket, results,
-              [this, socket, request_str, response, buffer, guarded_callback](const asio::error_code& ec, const asio::ip::tcp::endpoint&) {
-                if (ec) {
-                  response->error = "Connection failed: " + ec.message();
-                  guarded_callback(*response);
-                  return;
-                }
-
-                asio::async_write(*socket, asio::buffer(*request_str),
-                                  [this, socket, response, buffer, guarded_callback](const asio::error_code& ec, size_t) {
-                                    if (ec) {
-                                      response->error = "Write failed: " + ec.message();
-                                      guarded_callback(*response);
-                                      return;
-                                    }
-
-                                    read_response(socket, response, buffer, guarded_callback);
-                                  });
-              });
-        });
+    connect(url, socket, [response, guarded_callback, send](const std::string& error) {
+      if (!error.empty()) {
+        response->error = error;
+        guarded_callback(*response, false);
+        return;
+      }
+      send();
+    });
   }
 
   template <typename Socket>
   void read_response(std::shared_ptr<Socket> socket, std::shared_ptr<HttpResponse> response, std::shared_ptr<asio::streambuf> buffer,
-                     std::function<void(HttpResponse)> callback) {
+                     const std::string& method, bool decompress, std::function<bool()> retry_fresh,
+                     std::function<void(HttpResponse, bool)> callback) {
     asio::async_read_until(*socket, *buffer, "\r\n\r\n",
-                           [this, socket, response, buffer, callback](const asio::error_code& ec, size_t bytes_transferred) {
-                             if (ec && ec != asio::error::eof) {
+                           [this, socket, response, buffer, method, decompress, retry_fresh, callback](const asio::error_code& ec, size_t) {
+                             if (ec && buffer->size() == 0 && retry_fresh && retry_fresh()) return;
+
+                             if (ec && (ec != asio::error::eof || buffer->size() == 0)) {
                                response->error = "Read headers failed: " + ec.message();
-                               callback(*response);
+                               callback(*response, false);
                                return;
                              }
 
                              // Parse status line and headers
-                             std::istream stream(buffer.get());
-                             std::string status_line;
-                             std::getline(stream, status_line);
-
-                             // Parse status code
-                             std::regex status_regex(R"(HTTP/[\d.]+ (\d+))");
-                             std::smatch match;
-                             if (std::regex_search(status_line, match, status_regex)) {
-                               try {
-                                 response->status_code = std::stoi(match[1].str());
-                               } catch (const std::exception&) {
-                                 response->error = "Invalid HTTP response: cannot parse status code";
-                                 callback(*response);
-                                 return;
-                               }
-                             }
-
-                             // Parse headers
-                             std::string header_line;
-                             while (std::getline(stream, header_line) && header_line != "\r") {
-                               auto colon = header_line.find(':');
-                               if (colon != std::string::npos) {
-                                 std::string key = header_line.substr(0, colon);
-                                 std::string value = header_line.substr(colon + 1);
-                                 // Trim whitespace
-                                 value.erase(0, value.find_first_not_of(" \t"));
-                                 value.erase(value.find_last_not_of(" \t\r\n") + 1);
-                                 response->headers[key] = value;
-                               }
+                             ResponseHead head;
+                             if (!parse_head(*buffer, head)) {
+                               response->error = "Invalid HTTP response: cannot parse status code";
+                               callback(*response, false);
+                               return;
                              }
+                             response->status_code = head.status_code;
+                             response->headers = std::move(head.headers);
 
                              // Read body
-                             read_body(socket, response, buffer, callback);
+                             auto body = std::shared_ptr<BodyReader>(
+                                 make_body_reader(method, decompress, response->status_code, head.http_minor_version, response->headers));
+                             auto on_data = std::make_shared<ChunkedDecoder::DataCallback>([response](std::string_view data) {
+                               response->body.append(data);
+                             });
+                             read_body(socket, buffer, body, on_data, [response, callback](const std::string& error, bool can_reuse) {
+                               if (!error.empty()) response->error = error;
+                               callback(*response, can_reuse);
+                             });
                            });
   }
 
+  // Read a complete body according to its framing. on_done receives an error (empty on success)
+  // and whether the connection can be reused. A connection closed mid-body keeps the partial data.
   template <typename Socket>
-  void read_body(std::shared_ptr<Socket> socket, std::shared_ptr<HttpResponse> response, std::shared_ptr<asio::streambuf> buffer,
-                 std::function<void(HttpResponse)> callback) {
-    // First, add any remaining data in buffer to body
-    if (buffer->size() > 0) {
-      std::istream stream(buffer.get());
-      std::ostringstream body;
-      body << stream.rdbuf();
-      response->body += body.str();
-    }
-
-    // Check if we have Content-Length and already have all data
-    auto it = response->headers.find("Content-Length");
-    if (it != response->headers.end()) {
-      try {
-        size_t content_length = std::stoull(it->second);
-        if (response->body.size() >= content_length) {
-          // We have all the data
-          callback(*response);
-          return;
-        }
-      } catch (const std::exception&) {
-        // Invalid Content-Length, ignore and continue reading
-      }
+  void read_body(std::shared_ptr<Socket> socket, std::shared_ptr<asio::streambuf> buffer, std::shared_ptr<BodyReader> body,
+                 std::shared_ptr<ChunkedDecoder::DataCallback> on_data, std::function<void(const std::string&, bool)> on_done) {
+    if (consume_body(*buffer, *body, *on_data)) {
+      on_done(body_error(*body), reusable(*body, *buffer));
+      return;
     }
 
-    // Continue reading until EOF or we have all data
+    // Continue reading until the body is complete or the server closes the connection
     asio::async_read(*socket, *buffer, asio::transfer_at_least(1),
-                     [this, socket, response, buffer, callback](const asio::error_code& ec, size_t bytes_transferred) {
-                       // SSL connections may return various errors on close
-                       // Treat any SSL category error as potential EOF
-                       bool is_eof =
-                           (ec == asio::error::eof) || (ec.category() == asio::error::get_ssl_category()) || ec == asio::ssl::error::stream_truncated;
-
-                       if (ec && !is_eof) {
+                     [this, socket, buffer, body, on_data, on_done](const asio::error_code& ec, size_t) {
+                       if (ec && !is_eof(ec)) {
                          // Some error, but we may have partial data
-                         callback(*response);
+                         on_done("", false);
                          return;
                        }
 
-                       // Append to body
-                       if (buffer->size() > 0) {
-                         std::istream stream(buffer.get());
-                         std::ostringstream more;
-                         more << stream.rdbuf();
-                         response->body += more.str();
+                       if (ec) {
+                         consume_body(*buffer, *body, *on_data);
+                         on_done("", false);
+                         return;
                        }
 
-                       if (is_eof) {
-                         callback(*response);
-                       } else {
-                         // Check Content-Length again
-                         auto it = response->headers.find("Content-Length");
-                         if (it != response->headers.end()) {
-                           try {
-                             size_t content_length = std::stoull(it->second);
-                             if (response->body.size() >= content_length) {
-                               callback(*response);
-                               return;
-                             }
-                           } catch (const std::exception&) {
-                             // Invalid Content-Length, ignore and continue reading
-                           }
-                         }
-                         read_body(socket, response, buffer, callback);
-                       }
+                       read_body(socket, buffer, body, on_data, on_done);
                      });
   }
 
-  // Streaming request implementations
-  void request_stream_https(const ParsedUrl& url, const HttpOptions& options, StreamDataCallback on_data,
-                            std::function<void(int, const std::string&)> on_complete) {
-    auto socket = std::make_shared<asio::ssl::stream<asio::ip::tcp::socket>>(io_ctx_, ssl_ctx_);
-    auto request_str = std::make_shared<std::string>();
+  // ---- Streaming requests ----
+
+  template <typename Socket>
+  void start_stream(const ParsedUrl& url, const HttpOptions& options, std::shared_ptr<StreamViewCallback> on_data,
+                    std::shared_ptr<StreamCompletion> on_complete, bool allow_pooled) {
+    auto key = pool_key(url);
+    std::shared_ptr<Socket> socket = (options.keep_alive && allow_pooled) ? checkout<Socket>(key) : nullptr;
+    bool reused = socket != nullptr;
+    if (!socket) {
+      count_reuse_miss();
+      socket = make_socket<Socket>(url);
+    }
+
+    auto request_str = std::make_shared<std::string>(build_request(url, options));
     auto buffer = std::make_shared<asio::streambuf>();
-    auto status_code = std::make_shared<int>(0);
-    auto shared_on_data = std::make_shared<StreamDataCallback>(std::move(on_data));
     auto timed_out = std::make_shared<bool>(false);
 
-    // Start timeout timer
+    // Start timeout timer; cancel() ends the stream the same way
     auto timer = start_timeout(io_ctx_, options.timeout, socket, timed_out);
+    auto active_id = track(abort_on_timeout(timer, socket, timed_out));
+
+    auto ctx = std::make_shared<StreamContext>();
+    ctx->on_data = on_data;
+    ctx->decompress = negotiates_compression(options);
+    ctx->completion = on_complete;
+
+    // Wrap on_complete to cancel timer, check timeout and hand the connection back to the pool
+    ctx->finish = [this, self = shared_from_this(), timer, timed_out, on_complete, socket, key, active_id,
+                   keep_alive = options.keep_alive](int code, const std::string& err, bool can_reuse) {
+      untrack(active_id);
+      bool cancelled = timer->cancel() > 0;
+      if (*timed_out) {
+        (*on_complete)(0, "Request timed out");
+        return;
+      }
+      if (keep_alive && can_reuse && cancelled) {
+        checkin<Socket>(key, socket);
+      } else {
+        close_socket(socket);
+      }
+      (*on_complete)(code, err);
+    };
 
-    // Wrap on_complete to cancel timer and check timeout
-    auto shared_on_complete = std::make_shared<std::function<void(int, const std::string&)>>(
-        [timer, timed_out, on_complete = std::move(on_complete)](int code, const std::string& err) {
-          timer->cancel();
-          if (*timed_out) {
-            on_complete(0, "Request timed out");
-          } else {
-            on_complete(code, err);
-          }
-        });
+    std::function<bool()> retry_fresh;
+    if (reused) {
+      retry_fresh = [this, url, options, on_data, on_complete, timer, timed_out, socket, active_id]() {
+        if (*timed_out) return false;
+        untrack(active_id);
+        timer->cancel();
+        close_socket(socket);
+        {
+          std::lock_guard<std::mutex> lock(pool_mutex_);
+          pool_stats_.stale_retries++;
+        }
+        start_stream<Socket>(url, options, on_data, on_complete, false);
+        return true;
+      };
+    }
 
-    // Build HTTP request
-    std::ostringstream req;
-    req << options.method << " " << url.path << url.query << " HTTP/1.1\r\n";
-    req << "Host: " << url.host << "\r\n";
-    req << "Connection: close\r\n";
+    auto send = [this, socket, request_str, buffer, ctx, retry_fresh, method = options.method]() {
+      asio::async_write(*socket, asio::buffer(*request_str), [this, socket, buffer, ctx, retry_fresh, method](const asio::error_code& ec, size_t) {
+        if (ec) {
+          if (retry_fresh && retry_fresh()) return;
+          ctx->finish(0, "Write failed: " + ec.message(), false);
+          return;
+        }
 
-    for (const auto& [key, value] : options.headers) {
-      req << key << ": " << value << "\r\n";
-    }
+        read_stream_headers(socket, buffer, ctx, method, retry_fresh);
+      });
+    };
 
-    if (!options.body.empty()) {
-      req << "Content-Length: " << options.body.size() << "\r\n";
+    if (reused) {
+      send();
+      return;
     }
 
-    req << "\r\n";
-    req << options.body;
-    *request_str = req.str();
-
-    // Set SNI hostname
-    SSL_set_tlsext_host_name(socket->native_handle(), url.host.c_str());
-
-    // Resolve and connect
-    resolver_.async_resolve(
-        url.host, url.port_or_default(),
-        [this, socket, request_str, buffer, status_code, shared_on_data, shared_on_complete](const asio::error_code& ec,
-                                                                                             asio::ip::tcp::resolver::results_type results) {
-          if (ec) {
-            (*shared_on_complete)(0, "DNS resolution failed: " + ec.message());
-            return;
-          }
+    connect(url, socket, [ctx, send](const std::string& error) {
+      if (!error.empty()) {
+        ctx->finish(0, error, false);
+        return;
+      }
+      send();
+    });
+  }
 
-          asio::async_connect(
-              socket->lowest_layer(), results,
-              [this, socket, request_str, buffer, status_code, shared_on_data, shared_on_complete](const asio::error_code& ec,
-                                                                                                   const asio::ip::tcp::endpoint&) {
-                if (ec) {
-                  (*shared_on_complete)(0, "Connection failed: " + ec.message());
-                  return;
-                }
-
-                socket->async_handshake(asio::ssl::stream_base::client, [this, socket, request_str, buffer, status_code, shared_on_data,
-                                                                         shared_on_complete](const asio::error_code& ec) {
-                  if (ec) {
-                    (*shared_on_complete)(0, "SSL handshake failed: " + ec.message());
-                    return;
-                  }
-
-                  asio::async_write(*socket, asio::buffer(*request_str),
-                                    [this, socket, buffer, status_code, shared_on_data, shared_on_complete](const asio::error_code& ec, size_t) {
-                                      if (ec) {
-                                        (*shared_on_complete)(0, "Write failed: " + ec.message());
-                                        return;
-                                      }
-
-                                      read_stream_headers(socket, buffer, status_code, shared_on_data, shared_on_complete);
-                                    });
-                });
-              });
+  template <typename Socket>
+  void read_stream_headers(std::shared_ptr<Socket> socket, std::shared_ptr<asio::streambuf> buffer, std::shared_ptr<StreamContext> ctx,
+                           const std::string& method, std::function<bool()> retry_fresh) {
+    asio::async_read_until(*socket, *buffer, "\r\n\r\n", [this, socket, buffer, ctx, method, retry_fresh](const asio::error_code& ec, size_t) {
+      if (ec && buffer->size() == 0 && retry_fresh && retry_fresh()) return;
+
+      if (ec && (ec != asio::error::eof || buffer->size() == 0)) {
+        ctx->finish(0, "Read headers failed: " + ec.message(), false);
+        return;
+      }
+
+      // Parse status line and headers
+      ResponseHead head;
+      if (!parse_head(*buffer, head)) {
+        ctx->finish(0, "Invalid HTTP response: cannot parse status code", false);
+        return;
+      }
+      ctx->status_code = head.status_code;
+      ctx->body = make_body_reader(method, ctx->decompress, head.status_code, head.http_minor_version, head.headers);
+
+      // Check status code
+      if (ctx->status_code < 200 || ctx->status_code >= 300) {
+        // Read the whole error body so the message is complete and the connection stays reusable
+        ctx->completion->headers = std::move(head.headers);
+        auto body = std::shared_ptr<BodyReader>(std::move(ctx->body));
+        auto error_body = std::make_shared<std::string>();
+        auto on_data = std::make_shared<ChunkedDecoder::DataCallback>([error_body](std::string_view data) {
+          error_body->append(data);
+        });
+        read_body(socket, buffer, body, on_data, [ctx, error_body](const std::string&, bool can_reuse) {
+          ctx->finish(ctx->status_code, "HTTP error " + std::to_string(ctx->status_code) + ": " + *error_body, can_reuse);
         });
+        return;
+      }
+
+      // Continue reading stream data
+      read_stream_data(socket, buffer, ctx);
+    });
   }
 
-  void request_stream_http(const ParsedUrl& url, const HttpOptions& options, StreamDataCallback on_data,
-                           std::function<void(int, const std::string&)> on_complete) {
-    auto socket = std::make_shared<asio::ip::tcp::socket>(io_ctx_);
-    auto request_str = std::make_shared<std::string>();
-    auto buffer = std::make_shared<asio::streambuf>();
-    auto status_code = std::make_shared<int>(0);
-    auto shared_on_data = std::make_shared<StreamDataCallback>(std::move(on_data));
-    auto timed_out = std::make_shared<bool>(false);
+  template <typename Socket>
+  void read_stream_data(std::shared_ptr<Socket> socket, std::shared_ptr<asio::streambuf> buffer, std::shared_ptr<StreamContext> ctx) {
+    bool complete = consume_body(*buffer, *ctx->body, *ctx->on_data);
+    if (complete) {
+      auto error = body_error(*ctx->body);
+      ctx->finish(ctx->status_code, error, error.empty() && reusable(*ctx->body, *buffer));
+      return;
+    }
 
-    // Start timeout timer
-    auto timer = start_timeout(io_ctx_, options.timeout, socket, timed_out);
+    asio::async_read(*socket, *buffer, asio::transfer_at_least(1), [this, socket, buffer, ctx](const asio::error_code& ec, size_t) {
+      if (ec && !is_eof(ec)) {
+        ctx->finish(ctx->status_code, "Read failed: " + ec.message(), false);
+        return;
+      }
 
-    // Wrap on_complete to cancel timer and check timeout
-    auto shared_on_complete = std::make_shared<std::function<void(int, const std::string&)>>(
-        [timer, timed_out, on_complete = std::move(on_complete)](int code, const std::string& err) {
-          timer->cancel();
-          if (*timed_out) {
-            on_complete(0, "Request timed out");
-          } else {
-            on_complete(code, err);
-          }
-        });
+      if (ec) {
+        consume_body(*buffer, *ctx->body, *ctx->on_data);
+        ctx->finish(ctx->status_code, "", false);
+        return;
+      }
 
-    // Build HTTP request
-    std::ostringstream req;
-    req << options.method << " " << url.path << url.query << " HTTP/1.1\r\n";
-    req << "Host: " << url.host << "\r\n";
-    req << "Connection: close\r\n";
+      read_stream_data(socket, buffer, ctx);
+    });
+  }
+
+  // ---- HTTP/2 ----
+
+  static bool use_http2(const ParsedUrl& url, const HttpOptions& options) {
+    if (!options.keep_alive) return false;
+    return options.version == HttpVersion::Http2PriorKnowledge || (options.version == HttpVersion::Auto && url.is_https());
+  }
 
+  static hpack::HeaderList http2_headers(const ParsedUrl& url, const HttpOptions& options) {
+    hpack::HeaderList headers = {
+        {":method", options.method},
+        {":scheme", url.scheme},
+        {":authority", url.port.empty() ? url.host : url.host + ":" + url.port},
+        {":path", url.path + url.query},
+    };
     for (const auto& [key, value] : options.headers) {
-      req << key << ": " << value << "\r\n";
+      std::string name = key;
+      std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return std::tolower(c);
+      });
+      // Connection-specific fields are not allowed in HTTP/2; Content-Length is derived from the body
+      if (name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade" ||
+          name == "host" || name == "content-length") {
+        continue;
+      }
+      headers.push_back({std::move(name), value});
     }
-
     if (!options.body.empty()) {
-      req << "Content-Length: " << options.body.size() << "\r\n";
+      headers.push_back({"content-length", std::to_string(options.body.size())});
     }
+    if (negotiates_compression(options)) {
+      headers.push_back({"accept-encoding", std::string(kAcceptEncoding)});
+    }
+    return headers;
+  }
 
-    req << "\r\n";
-    req << options.body;
-    *request_str = req.str();
-
-    resolver_.async_resolve(url.host, url.port_or_default(),
-                            [this, socket, request_str, buffer, status_code, shared_on_data, shared_on_complete](
-                                const asio::error_code& ec, asio::ip::tcp::resolver::results_type results) {
-                              if (ec) {
-                                (*shared_on_complete)(0, "DNS resolution failed: " + ec.message());
-                                return;
-                              }
-
-                              asio::async_connect(
-                                  *socket, results,
-                                  [this, socket, request_str, buffer, status_code, shared_on_data, shared_on_complete](
-                                      const asio::error_code& ec, const asio::ip::tcp::endpoint&) {
-                                    if (ec) {
-                                      (*shared_on_complete)(0, "Connection failed: " + ec.message());
-                                      return;
-                                    }
-
-                                    asio::async_write(
-                                        *socket, asio::buffer(*request_str),
-                                        [this, socket, buffer, status_code, shared_on_data, shared_on_complete](const asio::error_code& ec, size_t) {
-                                          if (ec) {
-                                            (*shared_on_complete)(0, "Write failed: " + ec.message());
-                                            return;
-                                          }
-
-                                          read_stream_headers(socket, buffer, status_code, shared_on_data, shared_on_complete);
-                                        });
-                                  });
-                            });
+  // Inflater for an HTTP/2 response, or nullptr when the body is not compressed
+  static std::unique_ptr<ContentDecoder> http2_content_decoder(const hpack::HeaderList& headers) {
+    for (const auto& field : headers) {
+      if (field.name == "content-encoding") return ContentDecoder::create(field.value);
+    }
+    return nullptr;
   }
 
+  // Hand waiter a shared HTTP/2 connection for url, connecting (and negotiating ALPN) if needed.
+  // Concurrent callers for the same host, from any client on io_ctx_, wait for a single connection attempt.
   template <typename Socket>
-  void read_stream_headers(std::shared_ptr<Socket> socket, std::shared_ptr<asio::streambuf> buffer, std::shared_ptr<int> status_code,
-                           std::shared_ptr<StreamDataCallback> on_data, std::shared_ptr<std::function<void(int, const std::string&)>> on_complete) {
-    asio::async_read_until(*socket, *buffer, "\r\n\r\n",
-                           [this, socket, buffer, status_code, on_data, on_complete](const asio::error_code& ec, size_t bytes_transferred) {
-                             if (ec && ec != asio::error::eof) {
-                               (*on_complete)(0, "Read headers failed: " + ec.message());
-                               return;
-                             }
+  void acquire_http2(const ParsedUrl& url, std::chrono::seconds timeout, Http2Pool::Waiter waiter) {
+    auto key = pool_key(url);
+    std::shared_ptr<Http2Connection> conn;
+    bool ready = false;
+    bool start = false;
+    uint64_t connect_id = 0;
+    {
+      std::lock_guard<std::mutex> lock(h2_pool_->mutex);
+      auto it = h2_pool_->connections.find(key);
+      if (it != h2_pool_->connections.end() && it->second->usable()) {
+        conn = it->second;
+        ready = true;
+      } else if (h2_pool_->http1_hosts.count(key)) {
+        ready = true;
+      } else {
+        auto& pending = h2_pool_->connecting[key];
+        start = pending.waiters.empty();  // Otherwise a connect is already in progress
+        if (start) pending.id = ++h2_pool_->next_id;
+        connect_id = pending.id;
+        auto waiter_id = ++h2_pool_->next_id;
+        pending.waiters.emplace(waiter_id, wait_for_connect(key, waiter_id, timeout, std::move(waiter)));
+      }
+    }
+    if (ready) {
+      waiter(conn, "");
+      return;
+    }
+    if (!start) return;
 
-                             // Parse status line
-                             std::istream stream(buffer.get());
-                             std::string status_line;
-                             std::getline(stream, status_line);
-
-                             std::regex status_regex(R"(HTTP/[\d.]+ (\d+))");
-                             std::smatch match;
-                             if (std::regex_search(status_line, match, status_regex)) {
-                               try {
-                                 *status_code = std::stoi(match[1].str());
-                               } catch (const std::exception&) {
-                                 (*on_complete)(0, "Invalid HTTP response: cannot parse status code");
-                                 return;
-                               }
-                             }
+    auto socket = make_socket<Socket>(url);
+    if constexpr (std::is_same_v<Socket, SslSocket>) {
+      SSL_set_alpn_protos(socket->native_handle(), kAlpnProtocols, sizeof(kAlpnProtocols));
+    }
+    {
+      std::lock_guard<std::mutex> lock(h2_pool_->mutex);
+      auto it = h2_pool_->connecting.find(key);
+      if (it == h2_pool_->connecting.end() || it->second.id != connect_id) return;  // Every waiter already left
+      it->second.close = [socket]() {
+        close_socket(socket);
+      };
+    }
 
-                             // Skip headers
-                             std::string header_line;
-                             while (std::getline(stream, header_line) && header_line != "\r") {
-                               // Just consume headers
-                             }
+    connect(url, socket, [self = shared_from_this(), pool = h2_pool_, key, connect_id, socket](const std::string& error) {
+      bool http2 = error.empty();
+      if constexpr (std::is_same_v<Socket, SslSocket>) {
+        const unsigned char* protocol = nullptr;
+        unsigned int length = 0;
+        SSL_get0_alpn_selected(socket->native_handle(), &protocol, &length);
+        http2 = http2 && std::string_view(reinterpret_cast<const char*>(protocol), length) == "h2";
+      }
 
-                             // Check status code
-                             if (*status_code < 200 || *status_code >= 300) {
-                               // Read error body
-                               std::ostringstream error_body;
-                               error_body << stream.rdbuf();
-                               (*on_complete)(*status_code, "HTTP error " + std::to_string(*status_code) + ": " + error_body.str());
-                               return;
-                             }
+      std::shared_ptr<Http2Connection> conn;
+      std::map<uint64_t, Http2Pool::Waiter> waiters;
+      {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        auto it = pool->connecting.find(key);
+        if (it == pool->connecting.end() || it->second.id != connect_id) return;  // Abandoned: every waiter left
+        waiters = std::move(it->second.waiters);
+        pool->connecting.erase(it);
+        if (http2) {
+          conn = Http2Connection::create(self->io_ctx_, socket);
+          pool->connections[key] = conn;
+        } else if (error.empty()) {
+          pool->http1_hosts.insert(key);
+        }
+      }
 
-                             // Process any remaining data in buffer as first chunk
-                             if (buffer->size() > 0) {
-                               std::ostringstream chunk;
-                               chunk << stream.rdbuf();
-                               std::string chunk_str = chunk.str();
-                               if (!chunk_str.empty()) {
-                                 (*on_data)(chunk_str);
-                               }
-                             }
+      if (conn) {
+        std::weak_ptr<Http2Pool> weak_pool = pool;
+        conn->set_on_closed([weak_pool, key, raw = conn.get()]() {
+          auto pool = weak_pool.lock();
+          if (!pool) return;
+          std::lock_guard<std::mutex> lock(pool->mutex);
+          auto it = pool->connections.find(key);
+          if (it != pool->connections.end() && it->second.get() == raw) pool->connections.erase(it);
+        });
+        conn->start();
+      } else if (error.empty()) {
+        // The server chose HTTP/1.1: the fresh connection serves the first request from the keep-alive pool
+        self->checkin<Socket>(key, socket);
+      }
 
-                             // Continue reading stream data
-                             read_stream_data(socket, buffer, status_code, on_data, on_complete);
-                           });
+      for (auto& [id, waiter] : waiters) waiter(conn, error);
+    });
+  }
+
+  // Wrap waiter for the connect to key. It leaves the connect on its own request's timeout or on this client's
+  // cancel(), failing alone while other waiters keep waiting. Called with the pool mutex held, so the connect
+  // cannot hand it a result before its timer and cancellation are registered.
+  Http2Pool::Waiter wait_for_connect(const std::string& key, uint64_t waiter_id, std::chrono::seconds timeout, Http2Pool::Waiter waiter) {
+    auto leave = [pool = h2_pool_, key, waiter_id](const std::string& error) {
+      if (auto waiter = pool->leave(key, waiter_id)) waiter(nullptr, error);
+    };
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, timeout);
+    timer->async_wait([leave](const asio::error_code& ec) {
+      if (!ec) leave("Request timed out");
+    });
+    auto active_id = track([leave]() {
+      leave(kCancelledError);
+    });
+    return [self = shared_from_this(), timer, active_id, waiter = std::move(waiter)](std::shared_ptr<Http2Connection> conn,
+                                                                                        const std::string& error) {
+      self->untrack(active_id);
+      timer->cancel();
+      waiter(std::move(conn), error);
+    };
   }
 
   template <typename Socket>
-  void read_stream_data(std::shared_ptr<Socket> socket, std::shared_ptr<asio::streambuf> buffer, std::shared_ptr<int> status_code,
-                        std::shared_ptr<StreamDataCallback> on_data, std::shared_ptr<std::function<void(int, const std::string&)>> on_complete) {
-    asio::async_read(*socket, *buffer, asio::transfer_at_least(1),
-                     [this, socket, buffer, status_code, on_data, on_complete](const asio::error_code& ec, size_t bytes_transferred) {
-                       bool is_eof =
-                           (ec == asio::error::eof) || (ec.category() == asio::error::get_ssl_category()) || ec == asio::ssl::error::stream_truncated;
+  void start_http2_request(const ParsedUrl& url, const HttpOptions& options, std::function<void(HttpResponse)> callback, bool retried) {
+    auto self = shared_from_this();
+    acquire_http2<Socket>(
+        url, options.timeout, [this, self, url, options, callback, retried](std::shared_ptr<Http2Connection> conn, const std::string& error) {
+          if (!error.empty()) {
+            callback(HttpResponse{0, {}, "", error});
+            return;
+          }
+          if (!conn) {
+            start_request<Socket>(url, options, callback, true);
+            return;
+          }
+          {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            pool_stats_.h2_streams++;
+          }
 
-                       if (ec && !is_eof) {
-                         (*on_complete)(*status_code, "Read failed: " + ec.message());
-                         return;
-                       }
+          auto response = std::make_shared<HttpResponse>();
+          auto request_id = std::make_shared<uint64_t>(0);
+          auto timer = std::make_shared<asio::steady_timer>(io_ctx_);
+          timer->expires_after(options.timeout);
+          auto active_id = track([timer, conn, request_id, callback]() {
+            if (timer->cancel() == 0) return;  // Already finished
+            conn->cancel(*request_id);
+            callback(HttpResponse{0, {}, "", kCancelledError});
+          });
+          // Cancelling the stream drops its handler, so on_close will not untrack it
+          timer->async_wait([this, self, conn, request_id, callback, active_id](const asio::error_code& ec) {
+            if (ec) return;
+            untrack(active_id);
+            conn->cancel(*request_id);
+            callback(HttpResponse{0, {}, "", "Request timed out"});
+          });
+
+          auto content = std::make_shared<std::unique_ptr<ContentDecoder>>();
+          Http2StreamHandler handler;
+          handler.on_headers = [response, content, decompress = negotiates_compression(options)](int status_code, const hpack::HeaderList& headers) {
+            response->status_code = status_code;
+            for (const auto& field : headers) {
+              if (!field.name.empty() && field.name[0] != ':') response->headers[field.name] = field.value;
+            }
+            if (decompress) *content = http2_content_decoder(headers);
+          };
+          handler.on_data = [response, content](std::string_view data) {
+            if (!*content) {
+              response->body.append(data);
+              return;
+            }
+            (*content)->decode(data, [body = &response->body](std::string_view decoded) {
+              body->append(decoded);
+            });
+          };
+          handler.on_close = [this, self, timer, response, content, callback, url, options, retried, active_id](
+                                 const std::string& error, bool retryable) {
+            untrack(active_id);
+            if (timer->cancel() == 0) return;  // Timed out or cancelled, already reported
+            if (retryable && !retried) {
+              // Refused before processing (GOAWAY / REFUSED_STREAM): replay once on a new connection
+              start_http2_request<Socket>(url, options, callback, true);
+              return;
+            }
+            if (!error.empty()) {
+              response->error = error;
+            } else if (*content && (*content)->failed()) {
+              response->error = "Invalid compressed body: " + (*content)->error();
+            }
+            callback(*response);
+          };
+          *request_id = conn->submit(http2_headers(url, options), options.body, std::move(handler));
+        });
+  }
 
-                       // Send chunk to callback
-                       if (buffer->size() > 0) {
-                         std::istream stream(buffer.get());
-                         std::ostringstream chunk;
-                         chunk << stream.rdbuf();
-                         std::string chunk_str = chunk.str();
-                         if (!chunk_str.empty()) {
-                           (*on_data)(chunk_str);
-                         }
-                       }
+  template <typename Socket>
+  void start_http2_stream(const ParsedUrl& url, const HttpOptions& options, std::shared_ptr<StreamViewCallback> on_data,
+                          std::shared_ptr<StreamCompletion> on_complete, bool retried) {
+    auto self = shared_from_this();
+    acquire_http2<Socket>(
+        url, options.timeout,
+        [this, self, url, options, on_data, on_complete, retried](std::shared_ptr<Http2Connection> conn, const std::string& error) {
+          if (!error.empty()) {
+            (*on_complete)(0, error);
+            return;
+          }
+          if (!conn) {
+            start_stream<Socket>(url, options, on_data, on_complete, true);
+            return;
+          }
+          {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            pool_stats_.h2_streams++;
+          }
 
-                       if (is_eof) {
-                         (*on_complete)(*status_code, "");
-                       } else {
-                         read_stream_data(socket, buffer, status_code, on_data, on_complete);
-                       }
-                     });
+          auto status = std::make_shared<int>(0);
+          auto error_body = std::make_shared<std::string>();
+          auto request_id = std::make_shared<uint64_t>(0);
+          auto timer = std::make_shared<asio::steady_timer>(io_ctx_);
+          timer->expires_after(options.timeout);
+          auto active_id = track([timer, conn, request_id, on_complete]() {
+            if (timer->cancel() == 0) return;  // Already finished
+            conn->cancel(*request_id);
+            (*on_complete)(0, kCancelledError);
+          });
+          timer->async_wait([this, self, conn, request_id, on_complete, active_id](const asio::error_code& ec) {
+            if (ec) return;
+            untrack(active_id);
+            conn->cancel(*request_id);
+            (*on_complete)(0, "Request timed out");
+          });
+
+          auto content = std::make_shared<std::unique_ptr<ContentDecoder>>();
+          auto collect_error = std::make_shared<StreamViewCallback>([body = error_body.get()](std::string_view data) {
+            body->append(data);
+          });
+          Http2StreamHandler handler;
+          handler.on_headers = [status, content, on_complete, decompress = negotiates_compression(options)](int status_code,
+                                                                                                           const hpack::HeaderList& headers) {
+            *status = status_code;
+            if (decompress) *content = http2_content_decoder(headers);
+            if (status_code < 200 || status_code >= 300) {
+              for (const auto& field : headers) {
+                if (!field.name.empty() && field.name[0] != ':') on_complete->headers[field.name] = field.value;
+              }
+            }
+          };
+          handler.on_data = [status, content, collect_error, on_data](std::string_view data) {
+            const auto& sink = (*status >= 200 && *status < 300) ? *on_data : *collect_error;
+            if (*content) {
+              (*content)->decode(data, sink);
+            } else {
+              sink(data);
+            }
+          };
+          handler.on_close = [this, self, timer, status, error_body, content, url, options, on_data, on_complete, retried, active_id](
+                                 const std::string& error, bool retryable) {
+            untrack(active_id);
+            if (timer->cancel() == 0) return;  // Timed out or cancelled, already reported
+            if (retryable && !retried) {
+              start_http2_stream<Socket>(url, options, on_data, on_complete, true);
+              return;
+            }
+            if (*status != 0 && (*status < 200 || *status >= 300)) {
+              (*on_complete)(*status, "HTTP error " + std::to_string(*status) + ": " + *error_body);
+              return;
+            }
+            if (error.empty() && *content && (*content)->failed()) {
+              (*on_complete)(*status, "Invalid compressed body: " + (*content)->error());
+              return;
+            }
+            (*on_complete)(*status, error);
+          };
+          *request_id = conn->submit(http2_headers(url, options), options.body, std::move(handler));
+        });
   }
 
   asio::io_context& io_ctx_;
   asio::ssl::context ssl_ctx_;
-  asio::ip::tcp::resolver resolver_;
+
+  // Keep-alive pool, keyed by "scheme://host:port"
+  mutable std::mutex pool_mutex_;
+  ConnectionPoolOptions pool_options_;
+  ConnectionPoolStats pool_stats_;
+  IdleMap<TcpSocket> tcp_idle_;
+  IdleMap<SslSocket> ssl_idle_;
+
+  std::shared_ptr<Http2Pool> h2_pool_;
+
+  // In-flight requests that cancel() can abort
+  mutable std::mutex active_mutex_;
+  std::unordered_map<uint64_t, std::function<void()>> active_;
+  std::unordered_map<uint64_t, std::shared_ptr<asio::steady_timer>> retry_timers_;  // Backoffs among active_, by the same id
+  uint64_t next_active_id_ = 0;
+  uint64_t generation_ = 0;  // Incremented by cancel()
 };
 
-HttpClient::HttpClient(asio::io_context& io_ctx) : impl_(std::make_unique<Impl>(io_ctx)) {}
+HttpClient::HttpClient(asio::io_context& io_ctx) : impl_(std::make_shared<Impl>(io_ctx)) {}
 
 HttpClient::~HttpClient() = default;
 
@@ -634,77 +1479,66 @@ void HttpClient::request(const std::string& url, const HttpOptions& options, std
 }
 
 std::future<HttpResponse> HttpClient::request(const std::string& url, const HttpOptions& options) {
-  if (options.max_retries <= 0) {
-    // No retry — preserve original behavior
-    auto promise = std::make_shared<std::promise<HttpResponse>>();
-    auto future = promise->get_future();
+  auto promise = std::make_shared<std::promise<HttpResponse>>();
+  auto future = promise->get_future();
 
-    impl_->request(url, options, [promise](HttpResponse response) {
-      promise->set_value(std::move(response));
-    });
-
-    return future;
-  }
-
-  // With retry — use std::async to drive the retry loop
-  return std::async(std::launch::async, [this, url, options]() -> HttpResponse {
-    auto is_retryable = [](const HttpResponse& resp) -> bool {
-      // Connection/timeout errors (status_code == 0 means no HTTP response received)
-      if (resp.status_code == 0) return true;
-      // 429 Too Many Requests — but not for quota exhaustion
-      if (resp.status_code == 429) {
-        // Check if this is a quota exhaustion error (not retryable)
-        if (resp.body.find("insufficient_quota") != std::string::npos) return false;
-        if (resp.body.find("quota_exceeded") != std::string::npos) return false;
-        if (resp.body.find("billing") != std::string::npos) return false;
-        // Rate limit errors are retryable
-        return true;
-      }
-      // 5xx server errors worth retrying
-      if (resp.status_code == 500 || resp.status_code == 502 || resp.status_code == 503 || resp.status_code == 504) return true;
-      return false;
-    };
-
-    HttpResponse last_response;
-    int max_attempts = 1 + options.max_retries;
+  impl_->request(url, options, [promise](HttpResponse response) {
+    promise->set_value(std::move(response));
+  });
 
-    for (int attempt = 0; attempt < max_attempts; ++attempt) {
-      auto promise = std::make_shared<std::promise<HttpResponse>>();
-      auto future = promise->get_future();
+  return future;
+}
 
-      impl_->request(url, options, [promise](HttpResponse response) {
-        promise->set_value(std::move(response));
-      });
+asio::awaitable<HttpResponse> HttpClient::async_request(std::string url, HttpOptions options) {
+  co_return co_await asio::async_initiate<decltype(asio::use_awaitable), void(HttpResponse)>(
+      [this, &url, &options](auto handler) {
+        // The coroutine handler is move-only; keep it behind a pointer for the std::function chain
+        auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+        impl_->request(url, options, [shared](HttpResponse response) {
+          auto executor = asio::get_associated_executor(*shared);
+          asio::post(executor, [shared, response = std::move(response)]() mutable {
+            (*shared)(std::move(response));
+          });
+        });
+      },
+      asio::use_awaitable);
+}
 
-      last_response = future.get();
+void HttpClient::request_stream(const std::string& url, const HttpOptions& options, StreamDataCallback on_data,
+                                std::function<void(int status_code, const std::string& error)> on_complete) {
+  // Copy each view into one reusable string for callers that want std::string chunks
+  auto chunk = std::make_shared<std::string>();
+  auto adapter = [on_data = std::move(on_data), chunk](std::string_view data) {
+    chunk->assign(data);
+    on_data(*chunk);
+  };
+  impl_->request_stream(url, options, std::move(adapter), without_headers(std::move(on_complete)));
+}
 
-      // Success — return immediately
-      if (last_response.ok()) {
-        return last_response;
-      }
+void HttpClient::request_stream_view(const std::string& url, const HttpOptions& options, StreamViewCallback on_data,
+                                     std::function<void(int status_code, const std::string& error)> on_complete) {
+  impl_->request_stream(url, options, std::move(on_data), without_headers(std::move(on_complete)));
+}
 
-      // Not retryable — return immediately
-      if (!is_retryable(last_response)) {
-        return last_response;
-      }
+void HttpClient::request_stream_view(const std::string& url, const HttpOptions& options, StreamViewCallback on_data,
+                                     StreamHeadersCompletion on_complete) {
+  impl_->request_stream(url, options, std::move(on_data), std::move(on_complete));
+}
 
-      // Last attempt — don't sleep, just return
-      if (attempt + 1 >= max_attempts) {
-        break;
-      }
+void HttpClient::cancel() {
+  impl_->cancel();
+}
 
-      spdlog::warn("HTTP request to {} failed (status={}, error={}), retrying {}/{}...", url, last_response.status_code, last_response.error,
-                   attempt + 1, options.max_retries);
-      std::this_thread::sleep_for(options.retry_delay);
-    }
+void HttpClient::set_pool_options(const ConnectionPoolOptions& options) {
+  impl_->set_pool_options(options);
+}
 
-    return last_response;
-  });
+ConnectionPoolStats HttpClient::pool_stats() const {
+  return impl_->pool_stats();
 }
 
-void HttpClient::request_stream(const std::string& url, const HttpOptions& options, StreamDataCallback on_data,
-                                std::function<void(int status_code, const std::string& error)> on_complete) {
-  impl_->request_stream(url, options, std::move(on_data), std::move(on_complete));
+void HttpClient::clear_pool() {
+  impl_->clear_pool();
 }
 
 std::future<HttpResponse> HttpClient::get(const std::string& url, const std::map<std::string, std::string>& headers) {
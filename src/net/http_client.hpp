@@ -3,12 +3,17 @@
 #include <asio.hpp>
 #include <asio/ssl.hpp>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <map>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+
+#include "request_scheduler.hpp"
+#include "retry_policy.hpp"
 
 namespace agent::net {
 
@@ -24,19 +29,55 @@ struct HttpResponse {
   }
 };
 
+// HTTP protocol selection
+enum class HttpVersion {
+  Http1,                // HTTP/1.1 only
+  Auto,                 // Offer HTTP/2 via ALPN on https, fall back to HTTP/1.1
+  Http2PriorKnowledge,  // Speak HTTP/2 without negotiation, including cleartext (h2c)
+};
+
 // HTTP request options
 struct HttpOptions {
   std::string method = "GET";
   std::map<std::string, std::string> headers;
   std::string body;
   std::chrono::seconds timeout{30};
-  int max_retries = 0;                          // Number of retries (0 = no retry)
-  std::chrono::milliseconds retry_delay{1000};  // Delay between retries
+  RetryPolicy retry;                            // Backoff, Retry-After and retry budget (no retries by default)
+  bool keep_alive = true;                       // Reuse pooled connections (false = one connection per request, HTTP/1.1)
+  HttpVersion version = HttpVersion::Auto;
+  bool decompress = true;                       // Send Accept-Encoding: gzip, deflate and inflate compressed responses
+  // Queueing class when the host is at its in-flight cap (see RequestScheduler)
+  RequestPriority priority = RequestPriority::Interactive;
+};
+
+// Keep-alive connection pool limits (per HttpClient)
+struct ConnectionPoolOptions {
+  size_t max_idle_per_host = 4;           // Idle connections kept per (scheme, host, port)
+  size_t max_idle_total = 16;             // Idle connections kept across all hosts
+  std::chrono::seconds idle_timeout{30};  // Idle connections older than this are closed instead of reused
+};
+
+// Keep-alive connection pool counters
+struct ConnectionPoolStats {
+  uint64_t reuse_hits = 0;     // Requests sent on a pooled connection
+  uint64_t reuse_misses = 0;   // Requests that had to open a new connection
+  uint64_t stale_retries = 0;  // Pooled connections found closed by the server and replaced
+  uint64_t evictions = 0;      // Idle connections dropped (expired, over a cap, or closed by the server)
+  size_t idle = 0;             // Connections currently idle in the pool
+  uint64_t h2_streams = 0;     // Requests sent as streams on a shared HTTP/2 connection
+  size_t h2_connections = 0;   // Open HTTP/2 connections (shared by all HttpClients on the io_context)
 };
 
 // Streaming data callback
 using StreamDataCallback = std::function<void(const std::string& chunk)>;
 
+// Zero-copy streaming callback. The view points into the client's receive buffer and is only valid during the call.
+using StreamViewCallback = std::function<void(std::string_view chunk)>;
+
+// Stream completion that also receives the response headers (empty when no response arrived), e.g. to honour Retry-After
+using StreamHeadersCompletion =
+    std::function<void(int status_code, const std::string& error, const std::map<std::string, std::string>& headers)>;
+
 // Async HTTP client using ASIO
 class HttpClient {
  public:
@@ -50,19 +91,42 @@ class HttpClient {
   // Async request returning future
   std::future<HttpResponse> request(const std::string& url, const HttpOptions& options);
 
+  // Coroutine request: co_await client.async_request(url, options). Resumes on the awaiting coroutine's executor.
+  // Arguments are taken by value so the awaitable may outlive them.
+  asio::awaitable<HttpResponse> async_request(std::string url, HttpOptions options);
+
   // Streaming request - calls on_data for each chunk received
   void request_stream(const std::string& url, const HttpOptions& options, StreamDataCallback on_data,
                       std::function<void(int status_code, const std::string& error)> on_complete);
 
+  // Streaming request without per-chunk copies - calls on_data with each run of decoded body bytes
+  // (chunked framing already removed) as a view into the receive buffer
+  void request_stream_view(const std::string& url, const HttpOptions& options, StreamViewCallback on_data,
+                           std::function<void(int status_code, const std::string& error)> on_complete);
+
+  // As above, with the headers of the final response passed to on_complete
+  void request_stream_view(const std::string& url, const HttpOptions& options, StreamViewCallback on_data, StreamHeadersCompletion on_complete);
+
   // Convenience methods
   std::future<HttpResponse> get(const std::string& url, const std::map<std::string, std::string>& headers = {});
 
   std::future<HttpResponse> post(const std::string& url, const std::string& body, const std::map<std::string, std::string>& headers = {});
 
+  // Abort every request this client has in flight, queued or waiting to retry. Each completes with "Request cancelled".
+  void cancel();
+
+  // Keep-alive connection pool
+  void set_pool_options(const ConnectionPoolOptions& options);
+
+  ConnectionPoolStats pool_stats() const;
+
+  // Close all idle pooled connections
+  void clear_pool();
+
  private:
   class Impl;
 
-  std::unique_ptr<Impl> impl_;
+  std::shared_ptr<Impl> impl_;
 };
 
 // URL parsing helper
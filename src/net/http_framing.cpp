@@ -0,0 +1,212 @@
+#include "http_framing.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace agent::net {
+
+namespace {
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+  return s;
+}
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+}  // namespace
+
+const std::string* find_header(const std::map<std::string, std::string>& headers, std::string_view name) {
+  for (const auto& [key, value] : headers) {
+    if (iequals(key, name)) return &value;
+  }
+  return nullptr;
+}
+
+bool header_has_token(std::string_view value, std::string_view token) {
+  while (!value.empty()) {
+    auto comma = value.find(',');
+    auto item = trim(value.substr(0, comma));
+    if (iequals(item, token)) return true;
+    if (comma == std::string_view::npos) break;
+    value.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+ResponseFraming response_framing(const std::string& method, int status_code, int http_minor_version,
+                                 const std::map<std::string, std::string>& headers) {
+  ResponseFraming result;
+
+  // HTTP/1.1 connections persist unless told otherwise; HTTP/1.0 only with an explicit keep-alive
+  const auto* connection = find_header(headers, "Connection");
+  if (http_minor_version >= 1) {
+    result.keep_alive = !(connection && header_has_token(*connection, "close"));
+  } else {
+    result.keep_alive = connection && header_has_token(*connection, "keep-alive");
+  }
+
+  if (method == "HEAD" || (status_code >= 100 && status_code < 200) || status_code == 204 || status_code == 304) {
+    result.framing = BodyFraming::None;
+    return result;
+  }
+
+  const auto* transfer_encoding = find_header(headers, "Transfer-Encoding");
+  if (transfer_encoding && header_has_token(*transfer_encoding, "chunked")) {
+    result.framing = BodyFraming::Chunked;
+    return result;
+  }
+
+  const auto* content_length = find_header(headers, "Content-Length");
+  if (content_length) {
+    try {
+      result.content_length = std::stoull(*content_length);
+      result.framing = result.content_length == 0 ? BodyFraming::None : BodyFraming::ContentLength;
+      return result;
+    } catch (const std::exception&) {
+      // Invalid Content-Length, fall back to reading until close
+    }
+  }
+
+  result.framing = BodyFraming::UntilClose;
+  result.keep_alive = false;
+  return result;
+}
+
+size_t ChunkedDecoder::decode(std::string_view input, const DataCallback& on_data) {
+  size_t pos = 0;
+
+  while (pos < input.size() && state_ != State::Done && state_ != State::Error) {
+    char c = input[pos];
+
+    switch (state_) {
+      case State::Size: {
+        int digit = hex_value(c);
+        if (digit >= 0) {
+          if (remaining_ > (UINT64_MAX >> 4)) {
+            state_ = State::Error;
+            break;
+          }
+          remaining_ = (remaining_ << 4) | static_cast<uint64_t>(digit);
+          size_digits_ = true;
+          pos++;
+        } else if (!size_digits_) {
+          state_ = State::Error;
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          state_ = State::Extension;
+          pos++;
+        } else if (c == '\r') {
+          state_ = State::SizeLf;
+          pos++;
+        } else if (c == '\n') {
+          state_ = remaining_ == 0 ? State::Trailer : State::Data;
+          pos++;
+        } else {
+          state_ = State::Error;
+        }
+        break;
+      }
+
+      case State::Extension:
+        // Chunk extensions are ignored
+        if (c == '\n') {
+          state_ = remaining_ == 0 ? State::Trailer : State::Data;
+        }
+        pos++;
+        break;
+
+      case State::SizeLf:
+        if (c != '\n') {
+          state_ = State::Error;
+          break;
+        }
+        state_ = remaining_ == 0 ? State::Trailer : State::Data;
+        pos++;
+        break;
+
+      case State::Data: {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(remaining_, input.size() - pos));
+        on_data(input.substr(pos, n));
+        pos += n;
+        remaining_ -= n;
+        if (remaining_ == 0) state_ = State::DataCr;
+        break;
+      }
+
+      case State::DataCr:
+        if (c == '\r') {
+          state_ = State::DataLf;
+        } else if (c == '\n') {
+          state_ = State::Size;
+          size_digits_ = false;
+        } else {
+          state_ = State::Error;
+          break;
+        }
+        pos++;
+        break;
+
+      case State::DataLf:
+        if (c != '\n') {
+          state_ = State::Error;
+          break;
+        }
+        state_ = State::Size;
+        size_digits_ = false;
+        pos++;
+        break;
+
+      case State::Trailer:
+        // Start of a trailer line; an empty line ends the body
+        if (c == '\r') {
+          state_ = State::TrailerLf;
+        } else if (c == '\n') {
+          state_ = State::Done;
+        } else {
+          state_ = State::TrailerLine;
+        }
+        pos++;
+        break;
+
+      case State::TrailerLine:
+        if (c == '\n') state_ = State::Trailer;
+        pos++;
+        break;
+
+      case State::TrailerLf:
+        if (c != '\n') {
+          state_ = State::Error;
+          break;
+        }
+        state_ = State::Done;
+        pos++;
+        break;
+
+      case State::Done:
+      case State::Error:
+        break;
+    }
+  }
+
+  return pos;
+}
+
+void ChunkedDecoder::reset() {
+  state_ = State::Size;
+  remaining_ = 0;
+  size_digits_ = false;
+}
+
+}  // namespace agent::net
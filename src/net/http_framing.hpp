@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace agent::net {
+
+// Case-insensitive header lookup (HTTP field names are case-insensitive)
+const std::string* find_header(const std::map<std::string, std::string>& headers, std::string_view name);
+
+// Whether a comma-separated header value contains the given token (case-insensitive), e.g. "Connection: keep-alive, Upgrade"
+bool header_has_token(std::string_view value, std::string_view token);
+
+// How the end of a response body is delimited (RFC 9112 section 6.3)
+enum class BodyFraming {
+  None,           // No body (HEAD, 1xx, 204, 304)
+  ContentLength,  // Exactly Content-Length bytes follow
+  Chunked,        // Transfer-Encoding: chunked
+  UntilClose      // Body ends when the server closes the connection
+};
+
+struct ResponseFraming {
+  BodyFraming framing = BodyFraming::UntilClose;
+  uint64_t content_length = 0;
+  bool keep_alive = false;  // Server allows the connection to be reused after this response
+};
+
+// Determine body framing and connection persistence from a parsed response head
+ResponseFraming response_framing(const std::string& method, int status_code, int http_minor_version,
+                                 const std::map<std::string, std::string>& headers);
+
+// Incremental decoder for "Transfer-Encoding: chunked" bodies.
+// Input may be split at arbitrary points; payload bytes are handed out as views into the input, so nothing is copied.
+class ChunkedDecoder {
+ public:
+  using DataCallback = std::function<void(std::string_view data)>;
+
+  // Decode as much of `input` as possible, calling `on_data` for each run of payload bytes.
+  // Returns the number of input bytes consumed. Stops right after the terminating chunk and trailers,
+  // so any bytes beyond the end of the body are left unconsumed.
+  size_t decode(std::string_view input, const DataCallback& on_data);
+
+  bool done() const {
+    return state_ == State::Done;
+  }
+
+  bool failed() const {
+    return state_ == State::Error;
+  }
+
+  void reset();
+
+ private:
+  enum class State { Size, Extension, SizeLf, Data, DataCr, DataLf, Trailer, TrailerLine, TrailerLf, Done, Error };
+
+  State state_ = State::Size;
+  uint64_t remaining_ = 0;
+  bool size_digits_ = false;
+};
+
+}  // namespace agent::net
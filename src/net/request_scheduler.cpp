@@ -0,0 +1,150 @@
+#include "request_scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace agent::net {
+
+RequestScheduler& RequestScheduler::instance() {
+  static RequestScheduler scheduler;
+  return scheduler;
+}
+
+void RequestScheduler::submit(asio::io_context& io_ctx, const std::string& host, RequestPriority priority, StartFunction start) {
+  auto index = static_cast<size_t>(priority);
+  Release release;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& state = hosts_[host];
+    auto& cls = stats_.classes[index];
+    cls.submitted++;
+
+    // FIFO within a class, and never ahead of a class that is already waiting
+    bool waiting_ahead = std::any_of(state.queues.begin(), state.queues.begin() + index + 1, [](const auto& queue) {
+      return !queue.empty();
+    });
+    if (waiting_ahead || !admits_locked(host, state, priority)) {
+      state.queues[index].push_back({&io_ctx, asio::make_work_guard(io_ctx), std::move(start), Clock::now()});
+      cls.queued_total++;
+      cls.queued++;
+      cls.max_queued = std::max(cls.max_queued, cls.queued);
+      stats_.hosts = hosts_.size();
+      return;
+    }
+
+    state.in_flight++;
+    if (priority != RequestPriority::Interactive) state.shared_in_flight++;
+    cls.dispatched++;
+    cls.in_flight++;
+    stats_.hosts = hosts_.size();
+    release = make_release(host, priority);
+  }
+
+  start(std::move(release));
+}
+
+void RequestScheduler::set_options(const RequestSchedulerOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+}
+
+void RequestScheduler::set_host_limit(const std::string& host, size_t max_in_flight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  host_limits_[host] = max_in_flight;
+}
+
+RequestSchedulerStats RequestScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void RequestScheduler::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = {};
+  host_limits_.clear();
+  for (size_t i = 0; i < kRequestPriorityCount; ++i) {
+    // Keep the live gauges so later releases still balance
+    PriorityClassStats fresh;
+    fresh.queued = stats_.classes[i].queued;
+    fresh.in_flight = stats_.classes[i].in_flight;
+    stats_.classes[i] = fresh;
+  }
+}
+
+size_t RequestScheduler::limit_locked(const std::string& host) const {
+  auto it = host_limits_.find(host);
+  return it != host_limits_.end() ? it->second : options_.max_in_flight_per_host;
+}
+
+bool RequestScheduler::admits_locked(const std::string& host, const Host& state, RequestPriority priority) const {
+  size_t limit = limit_locked(host);
+  if (limit == 0) return true;
+  if (state.in_flight >= limit) return false;
+  // The reserve only applies when it leaves at least one slot for the other classes
+  if (priority != RequestPriority::Interactive && limit > options_.interactive_reserve) {
+    return state.shared_in_flight < limit - options_.interactive_reserve;
+  }
+  return true;
+}
+
+RequestScheduler::Release RequestScheduler::make_release(const std::string& host, RequestPriority priority) {
+  auto released = std::make_shared<std::atomic<bool>>(false);
+  return [this, host, priority, released]() {
+    if (released->exchange(true)) return;
+    on_release(host, priority);
+  };
+}
+
+void RequestScheduler::on_release(const std::string& host, RequestPriority priority) {
+  std::vector<Dispatch> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.classes[static_cast<size_t>(priority)].in_flight--;
+
+    auto it = hosts_.find(host);
+    if (it == hosts_.end()) return;
+    auto& state = it->second;
+    state.in_flight--;
+    if (priority != RequestPriority::Interactive) state.shared_in_flight--;
+
+    // Hand freed slots to the highest class first. A class that does not fit stops the scan:
+    // lower classes have the same or a smaller share of the host.
+    auto now = Clock::now();
+    for (size_t index = 0; index < kRequestPriorityCount; ++index) {
+      auto cls_priority = static_cast<RequestPriority>(index);
+      auto& queue = state.queues[index];
+      while (!queue.empty() && admits_locked(host, state, cls_priority)) {
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - queue.front().queued_at);
+        auto& cls = stats_.classes[index];
+        cls.queued--;
+        cls.dispatched++;
+        cls.in_flight++;
+        cls.total_wait += wait;
+        cls.max_wait = std::max(cls.max_wait, wait);
+        state.in_flight++;
+        if (cls_priority != RequestPriority::Interactive) state.shared_in_flight++;
+        ready.push_back({std::move(queue.front()), make_release(host, cls_priority)});
+        queue.pop_front();
+      }
+      if (!queue.empty()) break;
+    }
+
+    bool idle = state.in_flight == 0 && std::all_of(state.queues.begin(), state.queues.end(), [](const auto& queue) {
+                  return queue.empty();
+                });
+    if (idle) hosts_.erase(it);
+    stats_.hosts = hosts_.size();
+  }
+
+  for (auto& dispatch : ready) {
+    asio::post(*dispatch.waiter.io_ctx, [start = std::move(dispatch.waiter.start), release = std::move(dispatch.release),
+                                         work = std::move(dispatch.waiter.work)]() mutable {
+      start(std::move(release));
+    });
+  }
+}
+
+}  // namespace agent::net
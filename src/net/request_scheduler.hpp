@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace agent::net {
+
+// Scheduling class of an HTTP request. Lower values are dispatched first.
+enum class RequestPriority {
+  Interactive = 0,  // Turn the user is waiting on
+  Subagent = 1,     // Child sessions (TaskTool)
+  Background = 2,   // Compaction and other housekeeping
+};
+
+constexpr size_t kRequestPriorityCount = 3;
+
+struct RequestSchedulerOptions {
+  size_t max_in_flight_per_host = 8;  // Requests running at once per (scheme, host, port); 0 = unlimited
+  size_t interactive_reserve = 1;     // Of those, slots other classes may never fill
+};
+
+struct PriorityClassStats {
+  uint64_t submitted = 0;
+  uint64_t dispatched = 0;
+  uint64_t queued_total = 0;  // Requests that had to wait for a slot
+  size_t queued = 0;          // Currently waiting
+  size_t max_queued = 0;      // High-water mark of queued
+  size_t in_flight = 0;
+  std::chrono::microseconds total_wait{0};
+  std::chrono::microseconds max_wait{0};
+
+  std::chrono::microseconds average_wait() const {
+    return dispatched ? total_wait / static_cast<int64_t>(dispatched) : std::chrono::microseconds{0};
+  }
+};
+
+struct RequestSchedulerStats {
+  std::array<PriorityClassStats, kRequestPriorityCount> classes;
+  size_t hosts = 0;  // Hosts with queued or running requests
+
+  const PriorityClassStats& operator[](RequestPriority priority) const {
+    return classes[static_cast<size_t>(priority)];
+  }
+};
+
+// Process-wide admission control in front of HttpClient. Each host has a cap on in-flight requests;
+// when it is reached, requests wait in one FIFO queue per priority class and a freed slot goes to
+// the highest non-empty class. interactive_reserve keeps slots free for the user's own turn while
+// subagents and compaction saturate a host.
+class RequestScheduler {
+ public:
+  // Hands the slot back. Safe to call more than once; only the first call counts.
+  using Release = std::function<void()>;
+  using StartFunction = std::function<void(Release release)>;
+
+  static RequestScheduler& instance();
+
+  // Run start once a slot for host is free. It is called inline when a slot is available now,
+  // otherwise posted to io_ctx (which is kept from running out of work meanwhile).
+  void submit(asio::io_context& io_ctx, const std::string& host, RequestPriority priority, StartFunction start);
+
+  void set_options(const RequestSchedulerOptions& options);
+
+  // Per-host cap overriding max_in_flight_per_host (0 = unlimited)
+  void set_host_limit(const std::string& host, size_t max_in_flight);
+
+  RequestSchedulerStats stats() const;
+
+  // Reset counters, options and host limits. Queued and running requests are unaffected.
+  void clear();
+
+ private:
+  RequestScheduler() = default;
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Waiter {
+    asio::io_context* io_ctx;
+    asio::executor_work_guard<asio::io_context::executor_type> work;
+    StartFunction start;
+    Clock::time_point queued_at;
+  };
+
+  struct Host {
+    size_t in_flight = 0;
+    size_t shared_in_flight = 0;  // Non-interactive requests, capped at the limit minus the reserve
+    std::array<std::deque<Waiter>, kRequestPriorityCount> queues;
+  };
+
+  struct Dispatch {
+    Waiter waiter;
+    Release release;
+  };
+
+  size_t limit_locked(const std::string& host) const;
+  bool admits_locked(const std::string& host, const Host& state, RequestPriority priority) const;
+  Release make_release(const std::string& host, RequestPriority priority);
+  void on_release(const std::string& host, RequestPriority priority);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Host> hosts_;
+  std::map<std::string, size_t> host_limits_;
+  RequestSchedulerOptions options_;
+  RequestSchedulerStats stats_;
+};
+
+}  // namespace agent::net
@@ -0,0 +1,238 @@
+#include "retry_policy.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "http_framing.hpp"
+
+namespace agent::net {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+std::optional<double> parse_number(std::string_view text) {
+  try {
+    size_t used = 0;
+    double value = std::stod(std::string(text), &used);
+    if (used != text.size() || value < 0) return std::nullopt;
+    return value;
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
+// A UTC time parsed with the given format. The epoch comes from the calendar fields directly
+// (timegm is POSIX-only, and mktime would apply the local time zone).
+std::optional<std::chrono::system_clock::time_point> parse_utc(const std::string& text, const char* format) {
+  using namespace std::chrono;
+  std::tm tm{};
+  std::istringstream in(text);
+  in.imbue(std::locale::classic());
+  in >> std::get_time(&tm, format);
+  if (in.fail()) return std::nullopt;
+  year_month_day date{year{tm.tm_year + 1900}, month{static_cast<unsigned>(tm.tm_mon + 1)}, day{static_cast<unsigned>(tm.tm_mday)}};
+  if (!date.ok()) return std::nullopt;
+  return sys_days{date} + hours{tm.tm_hour} + minutes{tm.tm_min} + seconds{tm.tm_sec};
+}
+
+milliseconds until(std::chrono::system_clock::time_point when, std::chrono::system_clock::time_point now) {
+  return when > now ? std::chrono::duration_cast<milliseconds>(when - now) : milliseconds{0};
+}
+
+// OpenAI reset durations: "20ms", "1s", "6m0s", "1h2m3.5s"
+std::optional<milliseconds> parse_go_duration(std::string_view text) {
+  double total_ms = 0;
+  size_t i = 0;
+  if (text.empty()) return std::nullopt;
+  while (i < text.size()) {
+    size_t start = i;
+    while (i < text.size() && (std::isdigit(static_cast<unsigned char>(text[i])) || text[i] == '.')) ++i;
+    auto value = parse_number(text.substr(start, i - start));
+    if (!value) return std::nullopt;
+    if (text.substr(i, 2) == "ms") {
+      total_ms += *value;
+      i += 2;
+    } else if (i < text.size() && text[i] == 's') {
+      total_ms += *value * 1000;
+      ++i;
+    } else if (i < text.size() && text[i] == 'm') {
+      total_ms += *value * 60 * 1000;
+      ++i;
+    } else if (i < text.size() && text[i] == 'h') {
+      total_ms += *value * 3600 * 1000;
+      ++i;
+    } else {
+      return std::nullopt;
+    }
+  }
+  return milliseconds(static_cast<int64_t>(total_ms));
+}
+
+// Latest reset among the rate limits a 429 reports as exhausted
+std::optional<milliseconds> rate_limit_reset(const std::map<std::string, std::string>& headers, std::chrono::system_clock::time_point now) {
+  std::optional<milliseconds> delay;
+  auto take = [&delay](milliseconds value) {
+    delay = delay ? std::max(*delay, value) : value;
+  };
+
+  for (const char* limit : {"requests", "tokens", "input-tokens", "output-tokens"}) {
+    auto prefix = std::string("anthropic-ratelimit-") + limit;
+    auto remaining = find_header(headers, prefix + "-remaining");
+    auto reset = find_header(headers, prefix + "-reset");
+    if (!remaining || !reset || *remaining != "0") continue;
+    if (auto when = parse_utc(*reset, "%Y-%m-%dT%H:%M:%S")) take(until(*when, now));
+  }
+
+  for (const char* limit : {"requests", "tokens"}) {
+    auto remaining = find_header(headers, std::string("x-ratelimit-remaining-") + limit);
+    auto reset = find_header(headers, std::string("x-ratelimit-reset-") + limit);
+    if (!remaining || !reset || *remaining != "0") continue;
+    if (auto value = parse_go_duration(*reset)) take(*value);
+  }
+  return delay;
+}
+
+std::optional<int> status_from_error(std::string_view error) {
+  // "HTTP error 429: ..." (HttpClient streams) or "HTTP error: 429" (providers)
+  auto pos = error.find("HTTP error");
+  if (pos == std::string_view::npos) return std::nullopt;
+  pos += 10;
+  while (pos < error.size() && (error[pos] == ' ' || error[pos] == ':')) ++pos;
+  int status = 0;
+  size_t digits = 0;
+  while (pos < error.size() && std::isdigit(static_cast<unsigned char>(error[pos])) && digits < 3) {
+    status = status * 10 + (error[pos++] - '0');
+    ++digits;
+  }
+  if (digits != 3) return std::nullopt;
+  return status;
+}
+
+}  // namespace
+
+bool RetryPolicy::retryable_status(int status_code, std::string_view body) {
+  switch (status_code) {
+    case 0:
+    case 408:
+    case 500:
+    case 502:
+    case 503:
+    case 504:
+    case 529:  // Anthropic: overloaded
+      return true;
+    case 429:
+      // Rate limits clear on their own; an exhausted quota or billing problem does not
+      return body.find("insufficient_quota") == std::string_view::npos && body.find("quota_exceeded") == std::string_view::npos &&
+             body.find("billing") == std::string_view::npos;
+    default:
+      return false;
+  }
+}
+
+bool RetryPolicy::retryable_error(std::string_view error) {
+  if (auto status = status_from_error(error)) return retryable_status(*status, error);
+  for (std::string_view transient : {"timed out", "Network error", "Connection", "Connect failed", "Read failed", "Write failed",
+                                     "Read headers failed", "overloaded"}) {
+    if (error.find(transient) != std::string_view::npos) return true;
+  }
+  return false;
+}
+
+milliseconds RetryPolicy::backoff(int attempt) const {
+  auto ceiling = max_delay;
+  if (attempt < 30) ceiling = std::min(max_delay, base_delay * (int64_t{1} << attempt));
+  if (ceiling.count() <= 0) return milliseconds{0};
+
+  thread_local std::mt19937_64 rng{std::random_device{}()};
+  std::uniform_int_distribution<int64_t> dist(0, ceiling.count());
+  return milliseconds(dist(rng));
+}
+
+std::optional<milliseconds> RetryPolicy::server_delay(int status_code, const std::map<std::string, std::string>& headers,
+                                                      std::chrono::system_clock::time_point now) {
+  if (auto value = find_header(headers, "retry-after-ms")) {
+    if (auto ms = parse_number(*value)) return milliseconds(static_cast<int64_t>(*ms));
+  }
+  if (auto value = find_header(headers, "retry-after")) {
+    // Delay in seconds or an HTTP-date (RFC 9110 section 10.2.3)
+    if (auto seconds = parse_number(*value)) return milliseconds(static_cast<int64_t>(*seconds * 1000));
+    if (auto when = parse_utc(*value, "%a, %d %b %Y %H:%M:%S")) return until(*when, now);
+  }
+  if (status_code == 429) return rate_limit_reset(headers, now);
+  return std::nullopt;
+}
+
+std::optional<milliseconds> RetryPolicy::next_delay(int attempt, int status_code, std::string_view body,
+                                                    const std::map<std::string, std::string>& headers, bool body_started) const {
+  if (attempt >= max_retries) return std::nullopt;
+  if (kind == RetryKind::Streaming && body_started) return std::nullopt;
+  if (!retryable_status(status_code, body)) return std::nullopt;
+
+  auto delay = backoff(attempt);
+  if (auto requested = server_delay(status_code, headers)) {
+    if (*requested > max_server_delay) return std::nullopt;
+    delay = std::max(delay, *requested);
+  }
+  return delay;
+}
+
+RetryBudget& RetryBudget::instance() {
+  static RetryBudget budget;
+  return budget;
+}
+
+RetryBudget::RetryBudget() : refilled_at_(Clock::now()) {
+  stats_.tokens = options_.capacity;
+}
+
+bool RetryBudget::try_acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refill_locked(Clock::now());
+  if (stats_.tokens < 1) {
+    stats_.denied++;
+    return false;
+  }
+  stats_.tokens -= 1;
+  stats_.granted++;
+  return true;
+}
+
+void RetryBudget::record_success() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refill_locked(Clock::now());
+  stats_.tokens = std::min(options_.capacity, stats_.tokens + options_.deposit_per_success);
+}
+
+void RetryBudget::set_options(const RetryBudgetOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+  stats_.tokens = std::min(stats_.tokens, options_.capacity);
+}
+
+RetryBudgetStats RetryBudget::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto stats = stats_;
+  auto elapsed = std::chrono::duration<double>(Clock::now() - refilled_at_).count();
+  stats.tokens = std::min(options_.capacity, stats.tokens + elapsed * options_.refill_per_second);
+  return stats;
+}
+
+void RetryBudget::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_ = {};
+  stats_.tokens = options_.capacity;
+  refilled_at_ = Clock::now();
+}
+
+void RetryBudget::refill_locked(Clock::time_point now) {
+  auto elapsed = std::chrono::duration<double>(now - refilled_at_).count();
+  stats_.tokens = std::min(options_.capacity, stats_.tokens + elapsed * options_.refill_per_second);
+  refilled_at_ = now;
+}
+
+}  // namespace agent::net
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace agent::net {
+
+// What may be resent after a failure
+enum class RetryKind {
+  Idempotent,  // The whole request can be replayed at any point
+  Streaming,   // Replayed only while no body bytes have reached the caller (tokens must not be delivered twice)
+};
+
+// When and how long to wait before retrying a failed HTTP attempt.
+// Backoff uses full jitter: attempt n waits a uniform random time in [0, min(max_delay, base_delay * 2^n)].
+// A delay the server asks for (Retry-After, retry-after-ms, or a rate-limit reset header on 429) takes
+// precedence when it is longer.
+struct RetryPolicy {
+  int max_retries = 0;                                // Number of retries (0 = no retry)
+  std::chrono::milliseconds base_delay{1000};         // Backoff ceiling for the first retry, doubled per attempt
+  std::chrono::milliseconds max_delay{30000};         // Backoff ceiling
+  std::chrono::milliseconds max_server_delay{60000};  // Give up rather than honour a longer server-requested wait
+  RetryKind kind = RetryKind::Idempotent;
+  bool use_budget = true;                             // Draw each retry from the process-wide RetryBudget
+
+  // Status codes worth retrying: transport failures (0), 408, 429 (unless the quota is exhausted), 500, 502, 503, 504, 529
+  static bool retryable_status(int status_code, std::string_view body);
+
+  // Classify an error message such as "HTTP error 429: ..." or "Request timed out"
+  static bool retryable_error(std::string_view error);
+
+  // Random backoff for the given 0-based retry attempt
+  std::chrono::milliseconds backoff(int attempt) const;
+
+  // Wait requested by the server, if any. Rate-limit reset headers are only consulted on 429,
+  // and only for limits reported as exhausted.
+  static std::optional<std::chrono::milliseconds> server_delay(int status_code, const std::map<std::string, std::string>& headers,
+                                                               std::chrono::system_clock::time_point now = std::chrono::system_clock::now());
+
+  // Delay before retrying a failed attempt, or nullopt to give up. body_started: response bytes already reached the caller.
+  // Does not consult the retry budget.
+  std::optional<std::chrono::milliseconds> next_delay(int attempt, int status_code, std::string_view body,
+                                                      const std::map<std::string, std::string>& headers, bool body_started) const;
+};
+
+struct RetryBudgetOptions {
+  double capacity = 20;              // Maximum tokens; one retry spends one token
+  double refill_per_second = 0.5;    // Steady refill
+  double deposit_per_success = 0.1;  // Extra refill per successful request, so retries stay a fraction of traffic
+};
+
+struct RetryBudgetStats {
+  uint64_t granted = 0;  // Retries allowed
+  uint64_t denied = 0;   // Retries refused because the bucket was empty
+  double tokens = 0;
+};
+
+// Process-wide token bucket shared by every retry loop, so an outage is not amplified by
+// each layer retrying on its own.
+class RetryBudget {
+ public:
+  static RetryBudget& instance();
+
+  // Spend one token; false when the budget is exhausted
+  bool try_acquire();
+
+  void record_success();
+
+  void set_options(const RetryBudgetOptions& options);
+
+  RetryBudgetStats stats() const;
+
+  // Reset counters and refill the bucket
+  void clear();
+
+ private:
+  RetryBudget();
+
+  using Clock = std::chrono::steady_clock;
+
+  void refill_locked(Clock::time_point now);
+
+  mutable std::mutex mutex_;
+  RetryBudgetOptions options_;
+  RetryBudgetStats stats_;
+  Clock::time_point refilled_at_;
+};
+
+}  // namespace agent::net
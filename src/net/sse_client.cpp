@@ -3,12 +3,18 @@
 #include <regex>
 #include <sstream>
 
+#include "dns_cache.hpp"
+#include "sse_parser.hpp"
+#include "tls_session_cache.hpp"
+
 namespace agent::net {
 
 class SseClient::Impl {
  public:
-  explicit Impl(asio::io_context& io_ctx) : io_ctx_(io_ctx), ssl_ctx_(asio::ssl::context::tlsv12_client), resolver_(io_ctx) {
+  explicit Impl(asio::io_context& io_ctx) : io_ctx_(io_ctx), ssl_ctx_(asio::ssl::context::tls_client) {
     ssl_ctx_.set_default_verify_paths();
+    SSL_CTX_set_min_proto_version(ssl_ctx_.native_handle(), TLS1_2_VERSION);
+    TlsSessionCache::instance().attach(ssl_ctx_.native_handle());
   }
 
   void connect(const std::string& url, const std::map<std::string, std::string>& headers, std::function<void(const SseEvent&)> on_event,
@@ -77,14 +83,16 @@ class SseClient::Impl {
     ssl_socket_ = std::make_unique<asio::ssl::stream<asio::ip::tcp::socket>>(io_ctx_, ssl_ctx_);
 
     SSL_set_tlsext_host_name(ssl_socket_->native_handle(), host.c_str());
+    TlsSessionCache::instance().prepare(ssl_socket_->native_handle(), host + ":" + port);
 
-    resolver_.async_resolve(host, port, [this](const asio::error_code& ec, auto results) {
+    DnsCache::instance().resolve(io_ctx_, host, port, [this, host, port](const asio::error_code& ec, Endpoints endpoints) {
       if (ec || stopped_) {
         if (on_error_) on_error_("DNS resolution failed: " + ec.message());
         return;
       }
 
-      asio::async_connect(ssl_socket_->lowest_layer(), results, [this](const asio::error_code& ec, auto) {
+      asio::async_connect(ssl_socket_->lowest_layer(), endpoints, [this, host, port](const asio::error_code& ec, auto) {
+        if (ec) DnsCache::instance().invalidate(host, port);
         if (ec || stopped_) {
           if (on_error_) on_error_("Connection failed: " + ec.message());
           return;
@@ -96,6 +104,7 @@ class SseClient::Impl {
             return;
           }
 
+          TlsSessionCache::instance().record_handshake(ssl_socket_->native_handle());
           connected_ = true;
           send_request_ssl();
         });
@@ -106,13 +115,14 @@ class SseClient::Impl {
   void connect_http(const std::string& host, const std::string& port) {
     tcp_socket_ = std::make_unique<asio::ip::tcp::socket>(io_ctx_);
 
-    resolver_.async_resolve(host, port, [this](const asio::error_code& ec, auto results) {
+    DnsCache::instance().resolve(io_ctx_, host, port, [this, host, port](const asio::error_code& ec, Endpoints endpoints) {
       if (ec || stopped_) {
         if (on_error_) on_error_("DNS resolution failed: " + ec.message());
         return;
       }
 
-      asio::async_connect(*tcp_socket_, results, [this](const asio::error_code& ec, auto) {
+      asio::async_connect(*tcp_socket_, endpoints, [this, host, port](const asio::error_code& ec, auto) {
+        if (ec) DnsCache::instance().invalidate(host, port);
         if (ec || stopped_) {
           if (on_error_) on_error_("Connection failed: " + ec.message());
           return;
@@ -175,7 +185,8 @@ class SseClient::Impl {
   }
 
   void read_events_ssl() {
-    asio::async_read_until(*ssl_socket_, buffer_, "\n\n", [this](const asio::error_code& ec, size_t bytes) {
+    feed_buffered();
+    ssl_socket_->async_read_some(buffer_.prepare(kReadSize), [this](const asio::error_code& ec, size_t bytes) {
       if (stopped_) return;
 
       if (ec == asio::error::eof) {
@@ -188,13 +199,14 @@ class SseClient::Impl {
         return;
       }
 
-      process_event();
+      buffer_.commit(bytes);
       read_events_ssl();
     });
   }
 
   void read_events_tcp() {
-    asio::async_read_until(*tcp_socket_, buffer_, "\n\n", [this](const asio::error_code& ec, size_t bytes) {
+    feed_buffered();
+    tcp_socket_->async_read_some(buffer_.prepare(kReadSize), [this](const asio::error_code& ec, size_t bytes) {
       if (stopped_) return;
 
       if (ec == asio::error::eof) {
@@ -207,66 +219,35 @@ class SseClient::Impl {
         return;
       }
 
-      process_event();
+      buffer_.commit(bytes);
       read_events_tcp();
     });
   }
 
-  void process_event() {
-    std::istream stream(&buffer_);
-    SseEvent event;
-    std::string line;
-    std::ostringstream data;
-
-    while (std::getline(stream, line)) {
-      if (line.empty() || line == "\r") {
-        // End of event
-        if (!data.str().empty()) {
-          event.data = data.str();
-          // Remove trailing newline
-          if (!event.data.empty() && event.data.back() == '\n') {
-            event.data.pop_back();
-          }
-          if (on_event_) on_event_(event);
-        }
-        break;
-      }
-
-      // Remove carriage return if present
-      if (!line.empty() && line.back() == '\r') {
-        line.pop_back();
-      }
+  // Hand everything received so far to the parser, which keeps any partial line itself
+  void feed_buffered() {
+    auto data = buffer_.data();
+    parser_.feed(std::string_view(static_cast<const char*>(data.data()), data.size()));
+    buffer_.consume(data.size());
+  }
 
-      if (line.starts_with("event:")) {
-        event.event = line.substr(6);
-        // Trim leading space
-        if (!event.event.empty() && event.event[0] == ' ') {
-          event.event = event.event.substr(1);
-        }
-      } else if (line.starts_with("data:")) {
-        std::string d = line.substr(5);
-        if (!d.empty() && d[0] == ' ') {
-          d = d.substr(1);
-        }
-        data << d << "\n";
-      } else if (line.starts_with("id:")) {
-        event.id = line.substr(3);
-        if (!event.id.empty() && event.id[0] == ' ') {
-          event.id = event.id.substr(1);
-        }
-      }
-    }
+  void on_parsed(const SseEventView& view) {
+    if (on_event_) on_event_(SseEvent{std::string(view.event), std::string(view.data), std::string(view.id)});
   }
 
+  static constexpr size_t kReadSize = 16 * 1024;
+
   asio::io_context& io_ctx_;
   asio::ssl::context ssl_ctx_;
-  asio::ip::tcp::resolver resolver_;
 
   std::unique_ptr<asio::ssl::stream<asio::ip::tcp::socket>> ssl_socket_;
   std::unique_ptr<asio::ip::tcp::socket> tcp_socket_;
 
   asio::streambuf buffer_;
   std::string request_;
+  SseParser parser_{[this](const SseEventView& view) {
+    on_parsed(view);
+  }};
 
   std::function<void(const SseEvent&)> on_event_;
   std::function<void(const std::string&)> on_error_;
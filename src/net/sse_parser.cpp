@@ -0,0 +1,127 @@
+#include "sse_parser.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace agent::net {
+
+namespace {
+
+constexpr std::string_view kBom = "\xEF\xBB\xBF";
+
+// Offset of the first CR or LF. Two memchr passes beat find_first_of's per-byte set lookup.
+size_t find_line_end(std::string_view text) {
+  auto begin = text.data();
+  auto lf = static_cast<const char*>(std::memchr(begin, '\n', text.size()));
+  size_t limit = lf ? static_cast<size_t>(lf - begin) : text.size();
+  if (auto cr = static_cast<const char*>(std::memchr(begin, '\r', limit))) return cr - begin;
+  return lf ? limit : std::string_view::npos;
+}
+
+}  // namespace
+
+SseParser::SseParser(EventCallback on_event) : on_event_(std::move(on_event)) {}
+
+void SseParser::feed(std::string_view chunk) {
+  if (!bom_checked_) {
+    // The stream may open with a UTF-8 BOM, itself split across chunks
+    size_t take = std::min(kBom.size() - line_.size(), chunk.size());
+    line_.append(chunk.substr(0, take));
+    chunk.remove_prefix(take);
+    if (line_.size() < kBom.size() && kBom.starts_with(line_)) return;
+
+    bom_checked_ = true;
+    std::string held = std::move(line_);
+    line_.clear();
+    if (held != kBom) feed(held);
+  }
+
+  while (!chunk.empty()) {
+    if (skip_lf_) {
+      skip_lf_ = false;
+      if (chunk.front() == '\n') {
+        chunk.remove_prefix(1);
+        continue;
+      }
+    }
+
+    auto end = find_line_end(chunk);
+    if (end == std::string_view::npos) {
+      line_.append(chunk);
+      return;
+    }
+
+    if (line_.empty()) {
+      process_line(chunk.substr(0, end));
+    } else {
+      line_.append(chunk.substr(0, end));
+      process_line(line_);
+      line_.clear();
+    }
+
+    // CRLF counts as one line ending, even when the LF arrives in the next chunk
+    if (chunk[end] == '\r') {
+      if (end + 1 == chunk.size()) {
+        skip_lf_ = true;
+      } else if (chunk[end + 1] == '\n') {
+        ++end;
+      }
+    }
+    chunk.remove_prefix(end + 1);
+  }
+}
+
+void SseParser::reset() {
+  line_.clear();
+  skip_lf_ = false;
+  bom_checked_ = false;
+  event_.clear();
+  data_.clear();
+}
+
+void SseParser::process_line(std::string_view line) {
+  if (line.empty()) {
+    dispatch();
+    return;
+  }
+  if (line.front() == ':') return;  // Comment (often a keep-alive)
+
+  auto colon = line.find(':');
+  auto field = line.substr(0, colon);
+  std::string_view value;
+  if (colon != std::string_view::npos) {
+    value = line.substr(colon + 1);
+    if (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+  }
+
+  if (field == "data") {
+    data_.append(value);
+    data_.push_back('\n');
+  } else if (field == "event") {
+    event_.assign(value);
+  } else if (field == "id") {
+    if (value.find('\0') == std::string_view::npos) last_event_id_.assign(value);
+  } else if (field == "retry") {
+    uint64_t ms = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), ms);
+    if (!value.empty() && ec == std::errc() && end == value.data() + value.size()) retry_ = std::chrono::milliseconds(ms);
+  }
+  // Other fields are ignored
+}
+
+void SseParser::dispatch() {
+  // An event without data lines is not dispatched
+  if (data_.empty()) {
+    event_.clear();
+    return;
+  }
+
+  std::string_view data(data_);
+  data.remove_suffix(1);  // Trailing '\n' of the last data line
+  on_event_(SseEventView{event_, data, last_event_id_});
+  event_.clear();
+  data_.clear();
+}
+
+}  // namespace agent::net
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace agent::net {
+
+// One dispatched server-sent event. The views are only valid during the callback.
+struct SseEventView {
+  std::string_view event;  // Event type (empty for the default "message")
+  std::string_view data;   // data: lines joined with '\n'
+  std::string_view id;     // Last event ID, which carries over to later events
+};
+
+// Incremental text/event-stream parser (WHATWG HTML, "Server-sent events", event stream interpretation).
+// Handles LF, CRLF and CR line endings split anywhere across chunks, multi-line data, comments,
+// id/retry fields and a leading BOM. Complete lines are parsed in place; only a line cut by a chunk
+// boundary is copied, and all buffers keep their capacity, so a long stream parses without allocating.
+class SseParser {
+ public:
+  using EventCallback = std::function<void(const SseEventView& event)>;
+
+  explicit SseParser(EventCallback on_event);
+
+  // Parse the next run of body bytes, calling on_event for every event it completes
+  void feed(std::string_view chunk);
+
+  // Forget any partial line or event (e.g. before reconnecting). The last event ID is kept.
+  void reset();
+
+  // Last "id:" seen, for Last-Event-ID on reconnect
+  const std::string& last_event_id() const {
+    return last_event_id_;
+  }
+
+  // Reconnection time from the last valid "retry:" field
+  std::optional<std::chrono::milliseconds> retry() const {
+    return retry_;
+  }
+
+ private:
+  void process_line(std::string_view line);
+  void dispatch();
+
+  EventCallback on_event_;
+
+  std::string line_;      // Line cut by a chunk boundary
+  bool skip_lf_ = false;  // Last chunk ended with CR; a leading LF belongs to that line ending
+  bool bom_checked_ = false;
+
+  std::string event_;  // Pending event type
+  std::string data_;   // Pending data, each line followed by '\n'
+  std::string last_event_id_;
+  std::optional<std::chrono::milliseconds> retry_;
+};
+
+}  // namespace agent::net
@@ -0,0 +1,276 @@
+#include "tls_session_cache.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace agent::net {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int64_t unix_now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string to_hex(const std::string& bytes) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  out.reserve(bytes.size() * 2);
+  for (unsigned char c : bytes) {
+    out += digits[c >> 4];
+    out += digits[c & 0x0f];
+  }
+  return out;
+}
+
+std::string from_hex(const std::string& hex) {
+  auto value = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  if (hex.size() % 2 != 0) return "";
+  std::string out;
+  out.reserve(hex.size() / 2);
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    int hi = value(hex[i]);
+    int lo = value(hex[i + 1]);
+    if (hi < 0 || lo < 0) return "";
+    out += static_cast<char>((hi << 4) | lo);
+  }
+  return out;
+}
+
+// Sessions carry resumption secrets: owner-only file, replaced atomically
+void write_sessions(const fs::path& path, const nlohmann::json& j) {
+  std::error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::trunc);
+    if (!file.is_open()) return;
+    fs::permissions(tmp, fs::perms::owner_read | fs::perms::owner_write, ec);
+    file << j.dump();
+  }
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    spdlog::warn("[TLS] Failed to save session cache {}: {}", path.string(), ec.message());
+  }
+}
+
+}  // namespace
+
+TlsSessionCache& TlsSessionCache::instance() {
+  static TlsSessionCache cache;
+  return cache;
+}
+
+TlsSessionCache::TlsSessionCache() {
+  tag_index_ = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, [](void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+    delete static_cast<ConnectionTag*>(ptr);
+  });
+}
+
+TlsSessionCache::~TlsSessionCache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  writer_cv_.notify_one();
+  if (writer_.joinable()) writer_.join();
+  flush();
+}
+
+void TlsSessionCache::attach(SSL_CTX* ctx) {
+  // Keep sessions out of OpenSSL's internal store; the new-session callback hands them to us.
+  // With TLS 1.3 the callback fires when the server's NewSessionTicket arrives after the handshake.
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, &TlsSessionCache::on_new_session);
+}
+
+void TlsSessionCache::prepare(SSL* ssl, const std::string& key) {
+  auto* tag = new ConnectionTag{key, false};
+  SSL_set_ex_data(ssl, tag_index_, tag);
+
+  SSL_SESSION* session = lookup(key);
+  if (session) {
+    tag->offered = SSL_set_session(ssl, session) == 1;
+    SSL_SESSION_free(session);
+  }
+}
+
+void TlsSessionCache::record_handshake(SSL* ssl) {
+  auto* tag = static_cast<ConnectionTag*>(SSL_get_ex_data(ssl, tag_index_));
+  bool reused = SSL_session_reused(ssl) == 1;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (reused) {
+    stats_.hits++;
+    return;
+  }
+  stats_.misses++;
+  if (tag && tag->offered) {
+    // The server no longer accepts this session; its replacement arrives via the new-session callback
+    stats_.rejected++;
+  }
+}
+
+int TlsSessionCache::on_new_session(SSL* ssl, SSL_SESSION* session) {
+  auto& cache = instance();
+  auto* tag = static_cast<ConnectionTag*>(SSL_get_ex_data(ssl, cache.tag_index_));
+  if (tag) {
+    cache.store(tag->key, session);
+  }
+  return 0;  // We keep a serialized copy, not a reference
+}
+
+void TlsSessionCache::store(const std::string& key, SSL_SESSION* session) {
+  if (!SSL_SESSION_is_resumable(session)) return;
+
+  int length = i2d_SSL_SESSION(session, nullptr);
+  if (length <= 0) return;
+  std::string der(static_cast<size_t>(length), '\0');
+  auto* out = reinterpret_cast<unsigned char*>(der.data());
+  i2d_SSL_SESSION(session, &out);
+
+  int64_t lifetime = static_cast<int64_t>(SSL_SESSION_get_timeout(session));
+  auto hint = static_cast<int64_t>(SSL_SESSION_get_ticket_lifetime_hint(session));
+  if (hint > 0 && hint < lifetime) lifetime = hint;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = unix_now();
+  entries_[key] = Entry{std::move(der), static_cast<int64_t>(SSL_SESSION_get_time(session)) + lifetime};
+  stats_.stored++;
+  evict_locked(now);
+  mark_dirty_locked();
+}
+
+SSL_SESSION* TlsSessionCache::lookup(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return nullptr;
+
+  if (it->second.expires_at <= unix_now()) {
+    entries_.erase(it);
+    return nullptr;
+  }
+
+  const auto* in = reinterpret_cast<const unsigned char*>(it->second.der.data());
+  SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &in, static_cast<long>(it->second.der.size()));
+  if (!session) {
+    entries_.erase(it);
+  }
+  return session;
+}
+
+void TlsSessionCache::set_persist_path(const fs::path& path) {
+  flush();
+  std::lock_guard<std::mutex> lock(mutex_);
+  persist_path_ = path;
+  if (!persist_path_.empty()) load_locked();
+}
+
+void TlsSessionCache::set_max_entries(size_t max_entries) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_entries_ = max_entries;
+  evict_locked(unix_now());
+}
+
+TlsSessionStats TlsSessionCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
+
+void TlsSessionCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  stats_ = {};
+  mark_dirty_locked();
+}
+
+void TlsSessionCache::flush() {
+  std::lock_guard<std::mutex> save_lock(save_mutex_);
+  fs::path path;
+  nlohmann::json j = nlohmann::json::object();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dirty_ || persist_path_.empty()) return;
+    dirty_ = false;
+    path = persist_path_;
+    for (const auto& [key, entry] : entries_) {
+      j[key] = {{"session", to_hex(entry.der)}, {"expires_at", entry.expires_at}};
+    }
+  }
+  write_sessions(path, j);
+}
+
+void TlsSessionCache::load_locked() {
+  if (!fs::exists(persist_path_)) return;
+
+  try {
+    std::ifstream file(persist_path_);
+    auto j = nlohmann::json::parse(file);
+    auto now = unix_now();
+    for (const auto& [key, value] : j.items()) {
+      Entry entry{from_hex(value.value("session", "")), value.value("expires_at", int64_t(0))};
+      if (!entry.der.empty() && entry.expires_at > now) {
+        entries_[key] = std::move(entry);
+      }
+    }
+    evict_locked(now);
+  } catch (const std::exception& e) {
+    spdlog::warn("[TLS] Failed to load session cache {}: {}", persist_path_.string(), e.what());
+  }
+}
+
+void TlsSessionCache::mark_dirty_locked() {
+  if (persist_path_.empty()) return;
+  dirty_ = true;
+  if (!writer_.joinable() && !stopping_) {
+    writer_ = std::thread([this]() {
+      write_loop();
+    });
+  }
+  writer_cv_.notify_one();
+}
+
+void TlsSessionCache::write_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    writer_cv_.wait(lock, [this]() {
+      return dirty_ || stopping_;
+    });
+    if (writer_cv_.wait_for(lock, kSaveDelay, [this]() {
+          return stopping_;
+        })) {
+      break;  // The destructor flushes
+    }
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+void TlsSessionCache::evict_locked(int64_t now) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    it = it->second.expires_at <= now ? entries_.erase(it) : std::next(it);
+  }
+  while (entries_.size() > max_entries_) {
+    // Drop the session closest to expiry
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.expires_at < oldest->second.expires_at) oldest = it;
+    }
+    entries_.erase(oldest);
+  }
+}
+
+}  // namespace agent::net
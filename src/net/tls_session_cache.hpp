@@ -0,0 +1,102 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace agent::net {
+
+// TLS session resumption counters
+struct TlsSessionStats {
+  uint64_t hits = 0;      // Handshakes that resumed a cached session (abbreviated handshake)
+  uint64_t misses = 0;    // Full handshakes
+  uint64_t rejected = 0;  // Full handshakes where a cached session was offered but not accepted by the server
+  uint64_t stored = 0;    // Sessions/tickets received from servers
+  size_t entries = 0;     // Hosts currently holding a resumable session
+};
+
+// Process-wide client TLS session cache, keyed by "host:port".
+// Holds the most recent session (TLS 1.2 session ID or TLS 1.3 ticket) per host in serialized form,
+// and optionally persists it to disk so new processes can resume too. Updates arrive on the io
+// thread inside OpenSSL's new-session callback, so they only mark the cache dirty; a writer thread
+// saves it shortly after, and flush() saves it at once.
+class TlsSessionCache {
+ public:
+  static TlsSessionCache& instance();
+  ~TlsSessionCache();
+
+  // Enable client-side session caching on a context and route new sessions into this cache
+  void attach(SSL_CTX* ctx);
+
+  // Tag a connection with its cache key and offer the cached session for that host, if any.
+  // Call before the handshake.
+  void prepare(SSL* ssl, const std::string& key);
+
+  // Count a completed handshake as a hit or miss
+  void record_handshake(SSL* ssl);
+
+  // Store a session for key (normally called from the new-session callback)
+  void store(const std::string& key, SSL_SESSION* session);
+
+  // Cached session for key, or nullptr. Caller owns the returned session (SSL_SESSION_free).
+  SSL_SESSION* lookup(const std::string& key);
+
+  // Load sessions from path and write updates back to it (empty path disables persistence).
+  // Updates still pending for the previous path are written there first.
+  void set_persist_path(const std::filesystem::path& path);
+
+  // Write pending updates to the persist path now (call at shutdown)
+  void flush();
+
+  void set_max_entries(size_t max_entries);
+
+  TlsSessionStats stats() const;
+
+  void clear();
+
+ private:
+  TlsSessionCache();
+
+  struct Entry {
+    std::string der;         // i2d_SSL_SESSION encoding
+    int64_t expires_at = 0;  // Unix seconds
+  };
+
+  // Per-connection data attached to SSL objects via ex_data
+  struct ConnectionTag {
+    std::string key;
+    bool offered = false;  // A cached session was set before the handshake
+  };
+
+  static int on_new_session(SSL* ssl, SSL_SESSION* session);
+
+  // Delay between the first unsaved update and the write, so a burst of tickets costs one write
+  static constexpr std::chrono::milliseconds kSaveDelay{1000};
+
+  void load_locked();
+  void mark_dirty_locked();
+  void write_loop();
+  void evict_locked(int64_t now);
+
+  int tag_index_ = -1;  // SSL ex_data slot holding the ConnectionTag
+  mutable std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  std::filesystem::path persist_path_;
+  size_t max_entries_ = 64;
+  TlsSessionStats stats_;
+
+  bool dirty_ = false;  // Entries changed since the last write
+  bool stopping_ = false;
+  std::condition_variable writer_cv_;
+  std::thread writer_;     // Started by the first update that needs saving
+  std::mutex save_mutex_;  // Serializes file writes; taken before mutex_
+};
+
+}  // namespace agent::net
@@ -4,7 +4,6 @@
 #include <spdlog/spdlog.h>
 
 #include <asio.hpp>
-#include <asio/ssl.hpp>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -13,6 +12,7 @@
 #include <thread>
 
 #include "core/config.hpp"
+#include "net/http_client.hpp"
 
 namespace agent::plugin::qwen {
 
@@ -137,111 +137,29 @@ std::string build_form_body(const std::map<std::string, std::string>& params) {
   return body.str();
 }
 
-// Parse URL into host, port, path
-struct UrlParts {
-  std::string host;
-  std::string port;
-  std::string path;
-  bool is_https;
-};
-
-std::optional<UrlParts> parse_url(const std::string& url) {
-  UrlParts parts;
-
-  size_t scheme_end = url.find("://");
-  if (scheme_end == std::string::npos) return std::nullopt;
-
-  std::string scheme = url.substr(0, scheme_end);
-  parts.is_https = (scheme == "https");
-  parts.port = parts.is_https ? "443" : "80";
-
-  size_t host_start = scheme_end + 3;
-  size_t path_start = url.find('/', host_start);
-
-  std::string host_port;
-  if (path_start == std::string::npos) {
-    host_port = url.substr(host_start);
-    parts.path = "/";
-  } else {
-    host_port = url.substr(host_start, path_start - host_start);
-    parts.path = url.substr(path_start);
-  }
-
-  size_t colon_pos = host_port.find(':');
-  if (colon_pos != std::string::npos) {
-    parts.host = host_port.substr(0, colon_pos);
-    parts.port = host_port.substr(colon_pos + 1);
-  } else {
-    parts.host = host_port;
-  }
-
-  return parts;
-}
-
-// Synchronous HTTP POST with SSL
+// Synchronous HTTP POST (runs a private io_context until the response arrives)
 std::optional<std::pair<int, std::string>> http_post_sync(const std::string& url, const std::string& body,
                                                           const std::string& content_type = "application/x-www-form-urlencoded") {
-  auto url_parts = parse_url(url);
-  if (!url_parts) {
-    spdlog::error("[QwenOAuth] Failed to parse URL: {}", url);
-    return std::nullopt;
-  }
-
-  try {
-    asio::io_context io_ctx;
-    asio::ssl::context ssl_ctx(asio::ssl::context::tlsv12_client);
-    ssl_ctx.set_default_verify_paths();
-
-    asio::ip::tcp::resolver resolver(io_ctx);
-    auto endpoints = resolver.resolve(url_parts->host, url_parts->port);
-
-    asio::ssl::stream<asio::ip::tcp::socket> socket(io_ctx, ssl_ctx);
-
-    // Set SNI hostname
-    SSL_set_tlsext_host_name(socket.native_handle(), url_parts->host.c_str());
-
-    asio::connect(socket.lowest_layer(), endpoints);
-    socket.handshake(asio::ssl::stream_base::client);
-
-    // Build HTTP request
-    std::ostringstream request;
-    request << "POST " << url_parts->path << " HTTP/1.1\r\n";
-    request << "Host: " << url_parts->host << "\r\n";
-    request << "Content-Type: " << content_type << "\r\n";
-    request << "Content-Length: " << body.size() << "\r\n";
-    request << "Connection: close\r\n";
-    request << "\r\n";
-    request << body;
-
-    std::string request_str = request.str();
-    asio::write(socket, asio::buffer(request_str));
-
-    // Read response
-    asio::streambuf response_buf;
-    asio::error_code ec;
-    asio::read(socket, response_buf, ec);
-
-    std::string response_str((std::istreambuf_iterator<char>(&response_buf)), std::istreambuf_iterator<char>());
-
-    // Parse status code
-    int status_code = 0;
-    size_t status_start = response_str.find(' ');
-    if (status_start != std::string::npos) {
-      status_code = std::stoi(response_str.substr(status_start + 1, 3));
-    }
-
-    // Find body (after \r\n\r\n)
-    size_t body_start = response_str.find("\r\n\r\n");
-    std::string response_body;
-    if (body_start != std::string::npos) {
-      response_body = response_str.substr(body_start + 4);
-    }
+  asio::io_context io_ctx;
+  net::HttpClient client(io_ctx);
+
+  net::HttpOptions options;
+  options.method = "POST";
+  options.body = body;
+  options.headers["Content-Type"] = content_type;
+  options.keep_alive = false;  // One-shot request: nothing should keep the io_context busy afterwards
+
+  std::optional<net::HttpResponse> response;
+  client.request(url, options, [&response](net::HttpResponse result) {
+    response = std::move(result);
+  });
+  io_ctx.run();
 
-    return std::make_pair(status_code, response_body);
-  } catch (const std::exception& e) {
-    spdlog::error("[QwenOAuth] HTTP POST failed: {}", e.what());
+  if (!response || !response->error.empty()) {
+    spdlog::error("[QwenOAuth] HTTP POST failed: {}", response ? response->error : "no response");
     return std::nullopt;
   }
+  return std::make_pair(response->status_code, std::move(response->body));
 }
 
 }  // namespace
@@ -2,15 +2,21 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <fstream>
 #include <functional>
+#include <memory_resource>
 #include <sstream>
-#include <thread>
+#include <utility>
 
 #include "bus/bus.hpp"
 #include "llm/anthropic.hpp"
+#include "llm/hedged.hpp"
+#include "llm/partial_json.hpp"
 #include "tool/permission.hpp"
+#include "tool/scheduler.hpp"
 
 namespace agent {
 
@@ -57,11 +63,37 @@ Session::Session(asio::io_context& io_ctx, const Config& config, AgentType agent
     provider_order = {"ollama", "anthropic", "openai"};
   }
 
+  std::string primary_name;
   for (const auto& provider_name : provider_order) {
     auto provider_config = config.get_provider(provider_name);
     if (provider_config) {
       provider_ = llm::ProviderFactory::instance().create(provider_name, *provider_config, io_ctx);
-      if (provider_) break;
+      if (provider_) {
+        primary_name = provider_name;
+        break;
+      }
+    }
+  }
+
+  // Opt-in hedging: race a slow first token against a second provider or endpoint
+  if (provider_ && config.hedge.enabled) {
+    auto backup_name = config.hedge.backup_provider.empty() ? primary_name : config.hedge.backup_provider;
+    auto backup_config = config.get_provider(backup_name);
+    if (backup_config) {
+      if (!config.hedge.backup_base_url.empty()) backup_config->base_url = config.hedge.backup_base_url;
+      if (auto backup = llm::ProviderFactory::instance().create(backup_name, *backup_config, io_ctx)) {
+        llm::HedgeOptions options;
+        options.delay = std::chrono::milliseconds(config.hedge.delay_ms);
+        options.adaptive = config.hedge.adaptive;
+        options.backup_model = config.hedge.backup_model;
+        if (backup_name != primary_name && options.backup_model.empty()) {
+          spdlog::warn("[Session {}] Hedging to provider '{}' without hedge.backup_model: the backup is asked for '{}'", id_, backup_name,
+                       model_name);
+        }
+        provider_ = std::make_shared<llm::HedgedProvider>(provider_, std::move(backup), io_ctx, options);
+      }
+    } else {
+      spdlog::warn("[Session {}] Hedging enabled but backup provider '{}' is not configured", id_, backup_name);
     }
   }
 
@@ -126,6 +158,13 @@ void Session::add_message(Message msg) {
 
   const auto& added = messages_.back();
 
+  // A summary starts a new context; anything else extends it
+  if (added.is_summary() && added.is_finished()) {
+    context_tokens_ = added.token_count();
+  } else {
+    context_tokens_ += added.token_count();
+  }
+
   // Persist to store
   if (store_) {
     store_->save(added);
@@ -148,39 +187,31 @@ void Session::add_message(Message msg) {
   }
 }
 
-std::vector<Message> Session::get_context_messages() const {
-  // Find most recent summary, return summary + everything after it
-  int summary_index = -1;
-  for (int i = static_cast<int>(messages_.size()) - 1; i >= 0; --i) {
+size_t Session::context_start() const {
+  // Most recent summary, or the beginning
+  for (size_t i = messages_.size(); i-- > 0;) {
     if (messages_[i].is_summary() && messages_[i].is_finished()) {
-      summary_index = i;
-      break;
+      return i;
     }
   }
+  return 0;
+}
 
-  if (summary_index < 0) {
-    // No summary found, return all messages
-    return messages_;
-  }
+std::span<const Message> Session::context_messages() const {
+  // Summary + all messages after it (all messages if there is none)
+  return std::span<const Message>(messages_).subspan(context_start());
+}
 
-  // Return summary + all messages after it
-  return std::vector<Message>(messages_.begin() + summary_index, messages_.end());
+std::vector<Message> Session::get_context_messages() const {
+  auto context = context_messages();
+  return std::vector<Message>(context.begin(), context.end());
 }
 
-int64_t Session::estimated_context_tokens() const {
-  // Rough estimation: 4 chars per token
-  int64_t total = 0;
-  for (const auto& msg : messages_) {
-    total += msg.text().size() / 4;
-    for (const auto& part : msg.parts()) {
-      if (auto* tr = std::get_if<ToolResultPart>(&part)) {
-        if (!tr->compacted) {
-          total += tr->output.size() / 4;
-        }
-      }
-    }
+void Session::recount_context_tokens() {
+  context_tokens_ = 0;
+  for (size_t m = context_start(); m < messages_.size(); ++m) {
+    context_tokens_ += messages_[m].token_count();
   }
-  return total;
 }
 
 int64_t Session::context_window() const {
@@ -193,9 +224,32 @@ void Session::prompt(const std::string& text) {
 }
 
 void Session::prompt(Message user_msg) {
+  if (running_.exchange(true)) {
+    spdlog::warn("[Session {}] Already running; prompt ignored", id_);
+    return;
+  }
   spdlog::debug("[Session {}] User input: {}", id_, user_msg.text());
   add_message(std::move(user_msg));
-  run_loop();
+
+  // The run's steps are queued here and run on this thread until it ends; streams and timers started by
+  // it still complete on io_ctx_
+  asio::io_context caller_ctx;
+  run_loop(caller_ctx.get_executor());
+  caller_ctx.run();
+}
+
+void Session::prompt_async(const std::string& text) {
+  prompt_async(Message::user(text));
+}
+
+void Session::prompt_async(Message user_msg) {
+  if (running_.exchange(true)) {
+    spdlog::warn("[Session {}] Already running; prompt ignored", id_);
+    return;
+  }
+  spdlog::debug("[Session {}] User input: {}", id_, user_msg.text());
+  add_message(std::move(user_msg));
+  run_loop(asio::make_strand(io_ctx_));  // Steps of one session never run concurrently
 }
 
 void Session::cancel() {
@@ -206,6 +260,26 @@ void Session::cancel() {
     provider_->cancel();
   }
 
+  // Stop waiting for a permission answer
+  std::shared_ptr<std::function<void(bool)>> permission_wait;
+  {
+    std::lock_guard<std::mutex> lock(permission_mutex_);
+    permission_wait = std::move(permission_wait_);
+  }
+  if (permission_wait) (*permission_wait)(false);
+
+  // Stop waiting to retry; the timer is cancelled on its own executor, where its handler runs
+  std::shared_ptr<asio::steady_timer> retry_timer;
+  {
+    std::lock_guard<std::mutex> lock(retry_mutex_);
+    retry_timer = std::move(retry_timer_);
+  }
+  if (retry_timer) {
+    asio::post(retry_timer->get_executor(), [retry_timer]() {
+      retry_timer->cancel();
+    });
+  }
+
   // Cancel child sessions
   for (auto& weak_child : children_) {
     if (auto child = weak_child.lock()) {
@@ -214,72 +288,103 @@ void Session::cancel() {
   }
 }
 
-void Session::run_loop() {
+void Session::run_loop(asio::any_io_executor executor) {
+  executor_ = asio::prefer(std::move(executor), asio::execution::outstanding_work.tracked);
+  run_wake_ = std::make_shared<const asio::any_io_executor>(executor_);
+
   // Reset abort signal for new run
   abort_signal_->store(false);
   state_ = SessionState::Running;
 
   // Reset retry state for new run
   retry_state_.current_attempt = 0;
+  step_ = 0;
 
   spdlog::debug("[Session {}] Starting run loop", id_);
+  schedule([self = shared_from_this()]() {
+    self->run_step();
+  });
+}
 
-  int step = 0;
+void Session::run_step() {
   const int max_steps = 100;  // Prevent infinite loops
 
-  while (!abort_signal_->load() && step < max_steps && state_ != SessionState::Failed) {
-    step++;
+  if (abort_signal_->load() || step_ >= max_steps || state_ == SessionState::Failed) {
+    finish_run();
+    return;
+  }
+  step_++;
 
-    spdlog::debug("[Session {}] Step {} - State: {}", id_, step, to_string(state_));
+  spdlog::debug("[Session {}] Step {} - State: {}", id_, step_, to_string(state_));
 
-    auto context_msgs = get_context_messages();
+  auto context_msgs = context_messages();
 
-    // Find last assistant message
-    const Message* last_assistant = nullptr;
-    for (auto it = context_msgs.rbegin(); it != context_msgs.rend(); ++it) {
-      if (it->role() == Role::Assistant) {
-        last_assistant = &(*it);
-        break;
-      }
+  // Find last assistant message
+  const Message* last_assistant = nullptr;
+  for (auto it = context_msgs.rbegin(); it != context_msgs.rend(); ++it) {
+    if (it->role() == Role::Assistant) {
+      last_assistant = &(*it);
+      break;
     }
+  }
 
-    // Check if the last message is from user (needs response)
-    bool needs_response = !context_msgs.empty() && context_msgs.back().role() == Role::User;
+  // Check if the last message is from user (needs response)
+  bool needs_response = !context_msgs.empty() && context_msgs.back().role() == Role::User;
 
-    // Check exit condition - stop if assistant has finished without requesting tools
-    // AND there's no pending user message that needs a response
-    if (!needs_response && last_assistant && last_assistant->is_finished() && last_assistant->finish_reason() != FinishReason::ToolCalls) {
-      spdlog::debug("Session {} completed after {} steps", id_, step);
-      break;
-    }
+  // Check exit condition - stop if assistant has finished without requesting tools
+  // AND there's no pending user message that needs a response
+  if (!needs_response && last_assistant && last_assistant->is_finished() && last_assistant->finish_reason() != FinishReason::ToolCalls) {
+    spdlog::debug("Session {} completed after {} steps", id_, step_);
+    finish_run();
+    return;
+  }
 
-    // Check for context overflow
-    if (needs_compaction()) {
-      spdlog::debug("[Session {}] Context needs compaction, triggering...", id_);
-      handle_compaction();
-      continue;
-    }
+  // Read before anything is added: the view points into messages_
+  bool pending_tool_calls = last_assistant && last_assistant->finish_reason() == FinishReason::ToolCalls;
 
-    // If we have pending tool calls, execute them first
-    if (last_assistant && last_assistant->finish_reason() == FinishReason::ToolCalls) {
-      spdlog::debug("[Session {}] Executing pending tool calls", id_);
-      execute_tool_calls();
-    }
+  auto self = shared_from_this();
+  Continuation next_step = [self]() {
+    self->run_step();
+  };
 
-    // Process LLM - get next response
-    spdlog::debug("[Session {}] Processing LLM stream", id_);
-    process_stream();
+  // Check for context overflow
+  if (needs_compaction()) {
+    spdlog::debug("[Session {}] Context needs compaction, triggering...", id_);
+    handle_compaction(next_step);
+    return;
+  }
 
-    // Check if the new response has tool calls
-    if (!messages_.empty() && messages_.back().role() == Role::Assistant) {
-      auto& new_assistant = messages_.back();
-      if (new_assistant.finish_reason() == FinishReason::ToolCalls) {
-        spdlog::debug("[Session {}] LLM response contains tool calls, executing...", id_);
-        execute_tool_calls();
-      }
+  // Check if the new response has tool calls
+  Continuation after_response = [self, next_step]() {
+    if (!self->messages_.empty() && self->messages_.back().role() == Role::Assistant &&
+        self->messages_.back().finish_reason() == FinishReason::ToolCalls) {
+      spdlog::debug("[Session {}] LLM response contains tool calls, executing...", self->id_);
+      self->execute_tool_calls(next_step);
+    } else {
+      next_step();
     }
+  };
+
+  // If we have pending tool calls, execute them first
+  if (pending_tool_calls) {
+    spdlog::debug("[Session {}] Executing pending tool calls", id_);
+    execute_tool_calls([self, after_response]() {
+      self->process_stream(after_response);
+    });
+    return;
   }
 
+  // Process LLM - get next response
+  spdlog::debug("[Session {}] Processing LLM stream", id_);
+  process_stream(after_response);
+}
+
+void Session::finish_run() {
+  // Keeps the executor's context running until this returns; a new run may start from on_complete
+  auto executor = std::move(executor_);
+  executor_ = {};
+  run_wake_.reset();
+
   if (abort_signal_->load()) {
     state_ = SessionState::Cancelled;
     spdlog::debug("[Session {}] Session cancelled", id_);
@@ -291,12 +396,17 @@ void Session::run_loop() {
     spdlog::debug("[Session {}] Session completed", id_);
   }
 
+  // Speculative results not joined by now (e.g. the response did not finish with tool calls) are discarded
+  speculative_tools_.clear();
+
   // Prune old outputs
   prune_old_outputs();
 
   // Sync final usage to store
   sync_to_store();
 
+  running_ = false;
+
   if (on_complete_) {
     on_complete_(FinishReason::Stop);
   }
@@ -304,8 +414,55 @@ void Session::run_loop() {
   Bus::instance().publish(events::SessionEnded{id_});
 }
 
-void Session::process_stream() {
+void Session::schedule(Continuation next) {
+  asio::post(executor_, std::move(next));
+}
+
+std::function<void(Session::Continuation)> Session::run_poster() const {
+  return [wake = std::weak_ptr<const asio::any_io_executor>(run_wake_)](Continuation next) {
+    // Holding the run's tracked executor keeps its context from stopping while this posts
+    if (auto executor = wake.lock()) asio::post(*executor, std::move(next));
+  };
+}
+
+void Session::on_tool_result_ready() {
+  if (auto batch = std::exchange(waiting_batch_, nullptr)) collect_tool_results(batch);
+}
+
+// State of one model call, from the request to the finished message
+struct Session::StreamTurn {
+  // The response is accumulated in an arena released with the turn: deltas regrow these strings many
+  // times, and only the final, exactly sized copies reach the message and the heap
+  std::array<std::byte, 16 * 1024> scratch;
+  std::pmr::monotonic_buffer_resource arena{scratch.data(), scratch.size()};
+
+  llm::LlmRequest request;  // Kept until the stream completes
+
+  // Build message as we receive stream events
+  std::pmr::string accumulated_text{&arena};
+  std::pmr::string accumulated_thinking{&arena};
+  TokenUsage usage;
+  FinishReason finish_reason = FinishReason::Stop;
+  std::optional<std::string> error_message;
+  bool error_retryable = false;
+  std::optional<std::chrono::milliseconds> error_retry_after;
+
+  // Track tool calls being built
+  struct ToolCallBuilder {
+    std::string id;
+    std::string name;
+    llm::PartialJsonParser partial;  // Arguments parsed from the deltas so far
+    std::optional<json> args;        // Complete arguments from ToolCallComplete
+  };
+  std::pmr::vector<ToolCallBuilder> tool_call_builders{&arena};
+
+  // Created up front so tools started speculatively can refer to it
+  Message msg{Role::Assistant, ""};
+};
+
+void Session::process_stream(Continuation then) {
   if (!provider_) {
+    spdlog::error("No provider available for session {}", id_);
     if (on_error_) {
       std::string error_msg =
           "No LLM provider configured.\n\n"
@@ -317,14 +474,23 @@ void Session::process_stream() {
       on_error_(error_msg);
     }
     state_ = SessionState::Failed;
+    schedule(std::move(then));
     return;
   }
 
+  auto turn = std::make_shared<StreamTurn>();
+  auto self = shared_from_this();
+
   // Build request
-  llm::LlmRequest request;
+  auto& request = turn->request;
   request.model = agent_config_.model;
   request.system_prompt = agent_config_.system_prompt;
-  request.messages = get_context_messages();
+  auto context = context_messages();
+  request.messages.assign(context.begin(), context.end());  // Shares each message's parts
+  request.prompt_cache = config_.prompt_cache.enabled;
+  cache_boundary_ = messages_.size();
+  // Subagent turns yield to the user's own session when the provider is saturated
+  request.priority = parent_id_ ? net::RequestPriority::Subagent : net::RequestPriority::Interactive;
 
   // Get available tools
   for (const auto& tool : ToolRegistry::instance().for_agent(agent_config_)) {
@@ -333,65 +499,55 @@ void Session::process_stream() {
 
   spdlog::debug("[Session {}] LLM request: model={}, messages={}, tools={}", id_, request.model, request.messages.size(), request.tools.size());
 
-  // Use streaming API for real-time output
-  std::promise<void> stream_complete;
-  auto stream_future = stream_complete.get_future();
-
-  // Build message as we receive stream events
-  std::string accumulated_text;
-  std::string accumulated_thinking;
-  TokenUsage usage;
-  FinishReason finish_reason = FinishReason::Stop;
-  std::optional<std::string> error_message;
-
-  // Track tool calls being built
-  struct ToolCallBuilder {
-    std::string id;
-    std::string name;
-    std::string args_json;
-  };
-  std::vector<ToolCallBuilder> tool_call_builders;
+  speculative_tools_.clear();
 
+  // Use streaming API for real-time output. Events arrive in order on the provider's thread while this run
+  // waits for the stream; its completion schedules the rest of the turn.
   provider_->stream(
       request,
-      [this, &accumulated_text, &accumulated_thinking, &usage, &finish_reason, &error_message, &tool_call_builders](const llm::StreamEvent& event) {
+      [this, self, turn, message_id = turn->msg.id()](const llm::StreamEvent& event) {
         std::visit(
-            [this, &accumulated_text, &accumulated_thinking, &usage, &finish_reason, &error_message, &tool_call_builders](auto&& e) {
+            [this, turn = turn.get(), &message_id](auto&& e) {
               using T = std::decay_t<decltype(e)>;
+              auto& tool_call_builders = turn->tool_call_builders;
 
               if constexpr (std::is_same_v<T, llm::TextDelta>) {
                 // Stream text to callback immediately
                 if (on_stream_) {
                   on_stream_(e.text);
                 }
-                accumulated_text += e.text;
+                turn->accumulated_text += e.text;
                 spdlog::trace("[Session {}] Text delta: {}", id_, e.text);
               } else if constexpr (std::is_same_v<T, llm::ThinkingDelta>) {
                 // Stream thinking/reasoning content to callback
                 if (on_thinking_) {
                   on_thinking_(e.text);
                 }
-                accumulated_thinking += e.text;
+                turn->accumulated_thinking += e.text;
                 spdlog::trace("[Session {}] Thinking delta: {}", id_, e.text);
               } else if constexpr (std::is_same_v<T, llm::ToolCallDelta>) {
                 // Find existing builder by id and accumulate, or create new
-                // Only create new builder if id is non-empty (first delta has the real id)
-                bool found_builder = false;
+                // Deltas without an id cannot be attributed; the provider's ToolCallComplete carries the full args
                 if (!e.id.empty()) {
-                  for (auto& builder : tool_call_builders) {
-                    if (builder.id == e.id) {
-                      builder.args_json += e.arguments_delta;
-                      found_builder = true;
-                      break;
-                    }
-                  }
-                  if (!found_builder) {
+                  auto builder = std::find_if(tool_call_builders.begin(), tool_call_builders.end(), [&e](const StreamTurn::ToolCallBuilder& b) {
+                    return b.id == e.id;
+                  });
+                  if (builder == tool_call_builders.end()) {
                     spdlog::debug("[Session {}] New tool call builder: id={}, name={}", id_, e.id, e.name);
-                    tool_call_builders.push_back({e.id, e.name, e.arguments_delta});
+                    builder = tool_call_builders.insert(tool_call_builders.end(), StreamTurn::ToolCallBuilder{e.id, e.name, {}, std::nullopt});
+                  }
+
+                  // Parse as the arguments stream so callers can act on fields before the call completes
+                  if (!e.arguments_delta.empty() && !builder->partial.failed()) {
+                    if (builder->partial.feed(e.arguments_delta)) {
+                      if (on_tool_call_progress_) {
+                        on_tool_call_progress_(builder->id, builder->name, builder->partial.value());
+                      }
+                    } else {
+                      spdlog::warn("[Session {}] Malformed arguments streaming for {}: {}", id_, builder->name, builder->partial.error());
+                    }
                   }
                 }
-                // If id is empty, this is a continuation delta - ignore it as OpenAI provider
-                // handles accumulation internally and will send ToolCallComplete with full args
               } else if constexpr (std::is_same_v<T, llm::ToolCallComplete>) {
                 // Tool call arguments completed
                 // Find matching builder by id and update with complete args
@@ -399,7 +555,7 @@ void Session::process_stream() {
                 for (auto& builder : tool_call_builders) {
                   if (!e.id.empty() && builder.id == e.id) {
                     // Update with complete args
-                    builder.args_json = e.arguments.dump();
+                    builder.args = e.arguments;
 
                     spdlog::debug("[Session {}] Tool call complete: name={}, args={}", id_, builder.name, e.arguments.dump());
 
@@ -413,123 +569,202 @@ void Session::process_stream() {
                 }
                 // Handle case where we get ToolCallComplete without a prior ToolCallDelta
                 if (!found && !e.id.empty()) {
-                  tool_call_builders.push_back({e.id, e.name, e.arguments.dump()});
+                  tool_call_builders.push_back({e.id, e.name, {}, e.arguments});
                   spdlog::debug("[Session {}] Tool call complete (no prior delta): name={}, args={}", id_, e.name, e.arguments.dump());
                   if (on_tool_call_) {
                     on_tool_call_(e.id, e.name, e.arguments);
                   }
                   Bus::instance().publish(events::ToolCallStarted{id_, e.id, e.name});
                 }
+
+                if (!e.id.empty() && config_.tools.speculative_read_only) {
+                  start_speculative_tool(e.id, e.name, e.arguments, message_id);
+                }
               } else if constexpr (std::is_same_v<T, llm::FinishStep>) {
-                finish_reason = e.reason;
-                usage = e.usage;
-                spdlog::debug("[Session {}] LLM finish step: reason={}, input_tokens={}, output_tokens={}", id_, to_string(finish_reason),
-                              usage.input_tokens, usage.output_tokens);
+                turn->finish_reason = e.reason;
+                turn->usage = e.usage;
+                spdlog::debug("[Session {}] LLM finish step: reason={}, input_tokens={}, output_tokens={}", id_, to_string(turn->finish_reason),
+                              turn->usage.input_tokens, turn->usage.output_tokens);
               } else if constexpr (std::is_same_v<T, llm::StreamError>) {
-                error_message = e.message;
+                turn->error_message = e.message;
+                turn->error_retryable = e.retryable;
+                turn->error_retry_after = e.retry_after;
               }
             },
             event);
       },
-      [&stream_complete]() {
-        stream_complete.set_value();
-        spdlog::debug("[Session {}] LLM stream completed", static_cast<void*>(&stream_complete));
+      [self, turn, then, executor = executor_]() {
+        spdlog::debug("[Session {}] LLM stream completed", self->id_);
+        asio::post(executor, [self, turn, then]() {
+          self->finish_stream(turn, then);
+        });
       });
+}
 
-  // Wait for stream to complete
-  stream_future.wait();
-
+void Session::finish_stream(const std::shared_ptr<StreamTurn>& turn, Continuation then) {
   // Check for errors
-  if (error_message) {
-    spdlog::error("[Session {}] LLM stream error: {}", id_, *error_message);
+  if (turn->error_message) {
+    // Any speculative results belong to a response that will not be used
+    speculative_tools_.clear();
+  }
+  if (turn->error_message && abort_signal_->load()) {
+    schedule(std::move(then));  // Cancelled by cancel(); the aborted stream's error is expected
+    return;
+  }
+  if (turn->error_message) {
+    const auto& error_message = *turn->error_message;
+    spdlog::error("[Session {}] LLM stream error: {}", id_, error_message);
 
     // 检查是否应该重试
-    if (should_retry_on_error(*error_message)) {
-      if (retry_on_error(*error_message)) {
-        return;  // 重试成功，继续执行
-      }
+    if (should_retry_on_error(error_message, turn->error_retryable, turn->error_retry_after)) {
+      retry_on_error(error_message, turn->error_retry_after, std::move(then));
+      return;
     }
 
     // 重试失败或不应重试，设置错误状态
     if (on_error_) {
-      on_error_(*error_message);
+      on_error_(error_message);
     }
     state_ = SessionState::Failed;
+    schedule(std::move(then));
     return;
   }
 
+  // A response got through: later errors get the full number of retries again
+  retry_state_.current_attempt = 0;
+
   // Finalize message - build from accumulated data
-  Message msg(Role::Assistant, "");
+  auto& msg = turn->msg;
 
   // Add accumulated thinking
-  if (!accumulated_thinking.empty()) {
-    spdlog::debug("[Session {}] LLM response thinking: {} chars", id_, accumulated_thinking.size());
-    msg.add_thinking(accumulated_thinking);
+  if (!turn->accumulated_thinking.empty()) {
+    spdlog::debug("[Session {}] LLM response thinking: {} chars", id_, turn->accumulated_thinking.size());
+    msg.add_part(ThinkingPart{std::string(turn->accumulated_thinking)});
   }
 
   // Add accumulated text
-  if (!accumulated_text.empty()) {
-    spdlog::debug("[Session {}] LLM response text: {} chars", id_, accumulated_text.size());
-    msg.add_text(accumulated_text);
+  if (!turn->accumulated_text.empty()) {
+    spdlog::debug("[Session {}] LLM response text: {} chars", id_, turn->accumulated_text.size());
+    msg.add_part(TextPart{std::string(turn->accumulated_text)});
   }
 
   // Add all tool calls
-  for (const auto& builder : tool_call_builders) {
-    try {
-      json args = json::parse(builder.args_json);
-      if (!args.is_object()) {
-        spdlog::warn("Tool call args is not an object for {}, skipping", builder.name);
-        continue;
-      }
-      spdlog::debug("[Session {}] Adding tool call: name={}, args={}", id_, builder.name, args.dump());
-      msg.add_tool_call(builder.id, builder.name, args);
-    } catch (...) {
+  for (auto& builder : turn->tool_call_builders) {
+    // Without a ToolCallComplete, fall back to what the deltas parsed to
+    if (!builder.args && builder.partial.finish()) builder.args = builder.partial.take();
+    if (!builder.args) {
       // Skip invalid tool calls
       spdlog::warn("[Session {}] Failed to parse tool call args for {}", id_, builder.name);
+      continue;
+    }
+    if (!builder.args->is_object()) {
+      spdlog::warn("Tool call args is not an object for {}, skipping", builder.name);
+      continue;
     }
+    spdlog::debug("[Session {}] Adding tool call: name={}, args={}", id_, builder.name, builder.args->dump());
+    msg.add_tool_call(builder.id, builder.name, *builder.args);
   }
 
+  const auto& usage = turn->usage;
   msg.set_finished(true);
-  msg.set_finish_reason(finish_reason);
+  msg.set_finish_reason(turn->finish_reason);
   msg.set_usage(usage);
 
   total_usage_ += usage;
+  spdlog::debug("[Session {}] Prompt cache: read={}, write={}, session hit ratio={:.1f}%", id_, usage.cache_read_tokens, usage.cache_write_tokens,
+                total_usage_.cache_hit_ratio() * 100);
 
-  Bus::instance().publish(events::TokensUsed{id_, usage.input_tokens, usage.output_tokens});
+  Bus::instance().publish(events::TokensUsed{id_, usage.input_tokens, usage.output_tokens, usage.cache_read_tokens, usage.cache_write_tokens});
 
   // Add the completed message
   add_message(std::move(msg));
+  then();
 }
 
-void Session::execute_tool_calls() {
-  if (messages_.empty()) return;
-
-  auto& last_msg = messages_.back();
-  if (last_msg.role() != Role::Assistant) return;
-
-  auto tool_calls = last_msg.tool_calls();
-  if (tool_calls.empty()) return;
+// Tool calls of one assistant message, from permission checks to the message with their results
+struct Session::ToolBatch {
+  using Clock = std::chrono::steady_clock;
 
-  spdlog::debug("[Session {}] Executing {} tool call(s) concurrently", id_, tool_calls.size());
-
-  state_ = SessionState::WaitingForTool;
-
-  // Create user message for tool results
-  Message result_msg(Role::User, "");
-
-  // Structure to hold tool execution state
-  struct ToolExecution {
-    ToolCallPart* tool_call;
+  struct Execution {
+    ToolCallPart* tool_call;  // In tool_calls
     std::shared_ptr<Tool> tool;
     ToolContext context;
     std::future<ToolResult> future;
     bool started = false;
+    bool finished = false;  // output and is_error are set
+    std::string output;
+    bool is_error = false;
+    Clock::time_point started_at;
+    Clock::time_point finished_at;
   };
 
-  std::vector<ToolExecution> executions;
+  // Copies of the assistant message's calls. Their started and completed flags are kept here and written
+  // back with mark_tool_call, never through pointers into parts the message may share with its copies.
+  std::vector<ToolCallPart> tool_calls;
+  MessageId message_id;
+  std::vector<Execution> executions;
+
+  // Which executions wait for which, by what they read and write
+  std::optional<ToolCallSchedule> schedule;
+  Clock::time_point launched_at;
+  size_t reported = 0;  // Executions whose results are in result_msg, which keeps call order
+
+  // Create user message for tool results
+  Message result_msg{Role::User, ""};
+  Continuation then;
+};
+
+namespace {
+
+// A deferred or invalid future is ready too: get() runs it or throws
+template <typename T>
+bool future_ready(const std::future<T>& future) {
+  return !future.valid() || future.wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+}
+
+// Tool name of the Waiting-lane tasks that wait on a future for the session; never limited
+constexpr const char* kResultWaiter = "session.result_waiter";
+
+}  // namespace
+
+void Session::watch_tool_result(std::future<ToolResult>& future, const ToolContext& context) {
+  if (future_ready(future) || !context.completion || context.completion->claimed) return;
+  future = context.tool_executor().run(
+      kResultWaiter, ToolLane::Waiting,
+      [result = std::move(future)]() mutable {
+        return result.get();
+      },
+      context.completion->notify);
+}
+
+void Session::execute_tool_calls(Continuation then) {
+  if (messages_.empty() || messages_.back().role() != Role::Assistant) {
+    schedule(std::move(then));
+    return;
+  }
+
+  const auto& last_msg = messages_.back();
+  auto batch = std::make_shared<ToolBatch>();
+  for (const auto* tc : last_msg.tool_calls()) batch->tool_calls.push_back(*tc);
+  if (batch->tool_calls.empty()) {
+    schedule(std::move(then));
+    return;
+  }
+  batch->message_id = last_msg.id();
+  batch->then = std::move(then);
+
+  spdlog::debug("[Session {}] Executing {} tool call(s) concurrently", id_, batch->tool_calls.size());
+
+  state_ = SessionState::WaitingForTool;
 
   // Phase 1: Validate and prepare all tool executions
-  for (auto* tc : tool_calls) {
+  prepare_tool_calls(batch, 0);
+}
+
+void Session::prepare_tool_calls(const std::shared_ptr<ToolBatch>& batch, size_t index) {
+  auto& result_msg = batch->result_msg;
+  for (; index < batch->tool_calls.size(); ++index) {
+    auto* tc = &batch->tool_calls[index];
     if (tc->completed) continue;
 
     spdlog::debug("[Session {}] Preparing tool call: name={}, args={}", id_, tc->name, tc->arguments.dump());
@@ -545,6 +780,21 @@ void Session::execute_tool_calls() {
       spdlog::error("[Session {}] Tool not found: {}", id_, tc->name);
       result_msg.add_tool_result(tc->id, tc->name, "Tool not found: " + tc->name, true);
       tc->completed = true;
+      mark_tool_call(batch->message_id, *tc);
+      continue;
+    }
+
+    // Already running: it was started speculatively while the response streamed
+    if (auto spec = speculative_tools_.find(tc->id); spec != speculative_tools_.end()) {
+      spdlog::debug("[Session {}] Joining speculative tool: {}", id_, tc->name);
+      batch->executions.emplace_back();
+      auto& execution = batch->executions.back();
+      execution.tool_call = tc;
+      execution.tool = tool;
+      execution.context = std::move(spec->second.context);
+      execution.future = std::move(spec->second.future);
+      execution.started = true;
+      speculative_tools_.erase(spec);
       continue;
     }
 
@@ -554,117 +804,250 @@ void Session::execute_tool_calls() {
       spdlog::info("[Session {}] Permission denied for tool: {}", id_, tc->name);
       result_msg.add_tool_result(tc->id, tc->name, "Permission denied: tool '" + tc->name + "' is not allowed", true);
       tc->completed = true;
+      mark_tool_call(batch->message_id, *tc);
       continue;
     }
-    if (perm == Permission::Ask) {
-      bool allowed = true;  // Default allow for non-interactive mode
-      if (permission_handler_) {
+    if (perm == Permission::Ask && permission_handler_) {
+      std::shared_ptr<std::future<bool>> answer;
+      try {
+        answer = std::make_shared<std::future<bool>>(permission_handler_(tc->name, "Tool '" + tc->name + "' requires permission to execute"));
+      } catch (const std::exception& e) {
+        spdlog::warn("Permission handler error for tool {}: {}", tc->name, e.what());
+      }
+
+      auto get_answer = [name = tc->name](std::future<bool>& answer) {
         try {
-          auto future = permission_handler_(tc->name, "Tool '" + tc->name + "' requires permission to execute");
-          allowed = future.get();
+          return answer.get();
         } catch (const std::exception& e) {
-          spdlog::warn("Permission handler error for tool {}: {}", tc->name, e.what());
-          allowed = false;
+          spdlog::warn("Permission handler error for tool {}: {}", name, e.what());
+          return false;
         }
+      };
+      auto decide = [self = shared_from_this(), batch, index, tool](bool allowed) {
+        {
+          std::lock_guard<std::mutex> lock(self->permission_mutex_);
+          self->permission_wait_.reset();
+        }
+        auto* tc = &batch->tool_calls[index];
+        if (self->abort_signal_->load()) {
+          // Not an answer: record no decision, and ask about none of the calls left
+          self->cancel_tool_calls(*batch, index);
+          self->launch_tool_calls(batch);
+          return;
+        }
+        if (!allowed) {
+          spdlog::info("[Session {}] User denied permission for tool: {}", self->id_, tc->name);
+          PermissionManager::instance().deny(tc->name);
+          batch->result_msg.add_tool_result(tc->id, tc->name, "Permission denied: tool '" + tc->name + "' is not allowed", true);
+          tc->completed = true;
+          self->mark_tool_call(batch->message_id, *tc);
+        } else {
+          PermissionManager::instance().grant(tc->name);
+          self->add_tool_execution(*batch, tc, tool);
+        }
+        self->prepare_tool_calls(batch, index + 1);
+      };
+      if (!answer || future_ready(*answer)) {
+        decide(answer && get_answer(*answer));
+        return;
       }
-      if (!allowed) {
-        spdlog::info("[Session {}] User denied permission for tool: {}", id_, tc->name);
-        PermissionManager::instance().deny(tc->name);
-        result_msg.add_tool_result(tc->id, tc->name, "Permission denied: tool '" + tc->name + "' is not allowed", true);
-        tc->completed = true;
-        continue;
-      }
-      PermissionManager::instance().grant(tc->name);
-    }
 
-    // Build context for each tool call
-    ToolContext ctx;
-    ctx.session_id = id_;
-    ctx.message_id = last_msg.id();
-    ctx.working_dir = config_.working_dir.string();
-    ctx.abort_signal = abort_signal_;
-    ctx.ask_permission = permission_handler_;
-    ctx.question_handler = question_handler_;
-
-    // Provide child session creation callback for Task tool
-    auto self = shared_from_this();
-    ctx.create_child_session = [self](AgentType agent_type) {
-      return self->create_child(agent_type);
-    };
-
-    // Provide subagent event callback for Task tool progress reporting
-    std::string tool_call_id = tc->id;
-    ctx.on_subagent_event = [self, tool_call_id](const SubagentEvent& event) {
-      if (self->subagent_event_handler_) {
-        self->subagent_event_handler_(tool_call_id, event);
+      // The user may take a while to answer: a Waiting-lane thread waits for the answer and resumes the
+      // run with it. A cancel resumes it at once instead; whichever comes first decides.
+      auto resume = std::make_shared<std::function<void(bool)>>(
+          [post = run_poster(), decide, decided = std::make_shared<std::atomic<bool>>(false)](bool allowed) {
+            if (decided->exchange(true)) return;
+            post([decide, allowed]() {
+              decide(allowed);
+            });
+          });
+      {
+        std::lock_guard<std::mutex> lock(permission_mutex_);
+        permission_wait_ = resume;
       }
-    };
+      ToolExecutor::instance().submit(kResultWaiter, ToolLane::Waiting, [answer, get_answer, weak = std::weak_ptr(resume)]() {
+        bool allowed = get_answer(*answer);
+        if (auto resume = weak.lock()) (*resume)(allowed);
+      });
+      if (abort_signal_->load()) (*resume)(false);  // Cancelled before the wait was registered
+      return;
+    }
+    if (perm == Permission::Ask) {
+      PermissionManager::instance().grant(tc->name);  // Default allow for non-interactive mode
+    }
 
     // Add to execution list for concurrent processing
-    executions.emplace_back();
-    auto& execution = executions.back();
-    execution.tool_call = tc;
-    execution.tool = tool;
-    execution.context = std::move(ctx);
+    add_tool_execution(*batch, tc, tool);
   }
 
-  // Phase 2: Launch all tool executions concurrently
-  spdlog::debug("[Session {}] Launching {} tool execution(s) concurrently", id_, executions.size());
-  for (auto& exec : executions) {
+  launch_tool_calls(batch);
+}
+
+void Session::cancel_tool_calls(ToolBatch& batch, size_t index) {
+  for (; index < batch.tool_calls.size(); ++index) {
+    auto& tc = batch.tool_calls[index];
+    if (tc.completed) continue;
+    batch.result_msg.add_tool_result(tc.id, tc.name, "Cancelled", true);
+    tc.completed = true;
+    mark_tool_call(batch.message_id, tc);
+  }
+}
+
+void Session::add_tool_execution(ToolBatch& batch, ToolCallPart* tool_call, std::shared_ptr<Tool> tool) {
+  batch.executions.emplace_back();
+  auto& execution = batch.executions.back();
+  execution.tool_call = tool_call;
+  execution.tool = std::move(tool);
+  execution.context = make_tool_context(tool_call->id, batch.message_id);
+}
+
+void Session::launch_tool_calls(const std::shared_ptr<ToolBatch>& batch) {
+  // Calls dropped from the final message (e.g. invalid arguments) have nothing to join
+  speculative_tools_.clear();
+
+  // Phase 2: Order the calls by what they read and write
+  std::vector<ToolAccess> accesses;
+  accesses.reserve(batch->executions.size());
+  for (auto& exec : batch->executions) {
     try {
-      spdlog::debug("[Session {}] Starting concurrent tool: {}", id_, exec.tool_call->name);
-      exec.future = exec.tool->execute(exec.tool_call->arguments, exec.context);
-      exec.tool_call->started = true;
-      exec.started = true;
-    } catch (const std::exception& e) {
-      spdlog::error("[Session {}] Failed to start tool {}: {}", id_, exec.tool_call->name, e.what());
-      // Handle as immediate error result
-      std::string error_msg = std::string("Failed to start: ") + e.what();
-      result_msg.add_tool_result(exec.tool_call->id, exec.tool_call->name, error_msg, true);
-      exec.tool_call->completed = true;
+      accesses.push_back(exec.tool->access(exec.tool_call->arguments, exec.context));
+    } catch (const std::exception&) {
+      // Arguments of the wrong type: the call itself reports them
+      accesses.push_back(ToolAccess::unknown());
+    }
+  }
+  auto& schedule = batch->schedule.emplace(accesses);
+  batch->launched_at = ToolBatch::Clock::now();
+
+  for (size_t i = 0; i < batch->executions.size(); ++i) {
+    auto& exec = batch->executions[i];
+    if (!exec.started) continue;
+    exec.started_at = batch->launched_at;
+    if (!schedule.dependencies(i).empty()) {
+      // Started while streaming, before an earlier call that changes what it reads: run it again in order
+      spdlog::debug("[Session {}] Restarting speculative tool {} after the calls it depends on", id_, exec.tool_call->name);
+      exec.future = {};
+      exec.started = false;
     }
   }
 
-  // Phase 3: Collect all results as they complete
-  for (auto& exec : executions) {
-    if (!exec.started) continue;  // Skip tools that failed to start
+  spdlog::debug("[Session {}] Launching {} tool execution(s), critical path {}", id_, batch->executions.size(), schedule.critical_path());
+  start_ready_tools(*batch);
 
-    try {
-      spdlog::debug("[Session {}] Waiting for tool result: {}", id_, exec.tool_call->name);
-      auto result = exec.future.get();
+  // Phase 3: Collect results as they complete, starting the calls that waited for them
+  collect_tool_results(batch);
+}
 
-      spdlog::debug("[Session {}] Tool {} completed, is_error={}, output length={}", id_, exec.tool_call->name, result.is_error,
-                    result.output.size());
+void Session::start_ready_tools(ToolBatch& batch) {
+  // A call that fails to start finishes at once, which may make more calls ready
+  for (auto ready = batch.schedule->take_ready(); !ready.empty(); ready = batch.schedule->take_ready()) {
+    for (size_t index : ready) {
+      auto& exec = batch.executions[index];
+      if (exec.started) continue;  // Speculative
+      exec.started_at = ToolBatch::Clock::now();
+      if (abort_signal_->load()) {
+        finish_tool_call(batch, index, "Cancelled", true);
+        continue;
+      }
+      try {
+        spdlog::debug("[Session {}] Starting tool: {}", id_, exec.tool_call->name);
+        exec.future = exec.tool->execute(exec.tool_call->arguments, exec.context);
+        watch_tool_result(exec.future, exec.context);
+        exec.tool_call->started = true;
+        exec.started = true;
+        mark_tool_call(batch.message_id, *exec.tool_call);
+      } catch (const std::exception& e) {
+        spdlog::error("[Session {}] Failed to start tool {}: {}", id_, exec.tool_call->name, e.what());
+        finish_tool_call(batch, index, std::string("Failed to start: ") + e.what(), true);
+      }
+    }
+  }
+}
 
-      // Truncate if needed
-      auto truncated = Truncate::save_and_truncate(result.output, exec.tool_call->name);
+void Session::finish_tool_call(ToolBatch& batch, size_t index, std::string output, bool is_error) {
+  auto& exec = batch.executions[index];
+  exec.output = std::move(output);
+  exec.is_error = is_error;
+  exec.finished = true;
+  exec.finished_at = ToolBatch::Clock::now();
+  batch.schedule->finish(index);
+}
 
-      // Sanitize invalid UTF-8 bytes to prevent JSON serialization errors
-      auto safe_content = sanitize_utf8(truncated.content);
+void Session::collect_tool_results(const std::shared_ptr<ToolBatch>& batch) {
+  auto completed = [](const ToolBatch::Execution& exec) {
+    return exec.started && !exec.finished && future_ready(exec.future);
+  };
 
-      result_msg.add_tool_result(exec.tool_call->id, exec.tool_call->name, safe_content, result.is_error);
+  for (bool progress = true; progress;) {
+    progress = false;
+    for (size_t index = 0; index < batch->executions.size(); ++index) {
+      auto& exec = batch->executions[index];
+      if (!completed(exec)) continue;
+      progress = true;
 
-      // Notify tool result callback
-      if (on_tool_result_) {
-        on_tool_result_(exec.tool_call->id, exec.tool_call->name, safe_content, result.is_error);
-      }
+      try {
+        auto result = exec.future.get();
 
-      Bus::instance().publish(events::ToolCallCompleted{id_, exec.tool_call->id, exec.tool_call->name, !result.is_error});
+        spdlog::debug("[Session {}] Tool {} completed, is_error={}, output length={}", id_, exec.tool_call->name, result.is_error,
+                      result.output.size());
 
-    } catch (const std::exception& e) {
-      std::string error_msg = std::string("Error: ") + e.what();
-      spdlog::error("[Session {}] Tool {} exception: {}", id_, exec.tool_call->name, e.what());
-      result_msg.add_tool_result(exec.tool_call->id, exec.tool_call->name, error_msg, true);
+        // Truncate if needed
+        auto truncated = Truncate::save_and_truncate(result.output, exec.tool_call->name);
 
-      // Notify tool result callback
-      if (on_tool_result_) {
-        on_tool_result_(exec.tool_call->id, exec.tool_call->name, error_msg, true);
+        // Sanitize invalid UTF-8 bytes to prevent JSON serialization errors
+        finish_tool_call(*batch, index, sanitize_utf8(truncated.content), result.is_error);
+      } catch (const std::exception& e) {
+        spdlog::error("[Session {}] Tool {} exception: {}", id_, exec.tool_call->name, e.what());
+        finish_tool_call(*batch, index, std::string("Error: ") + e.what(), true);
       }
+    }
+    if (progress) start_ready_tools(*batch);
+  }
+  report_tool_results(*batch);
 
-      Bus::instance().publish(events::ToolCallCompleted{id_, exec.tool_call->id, exec.tool_call->name, false});
+  if (!batch->schedule->finished()) {
+    // Each call's completion notifies on_tool_result_ready, which collects again
+    waiting_batch_ = batch;
+    return;
+  }
+
+  if (!batch->executions.empty()) {
+    // Parallelism achieved: time spent in tools over the time the batch took
+    std::chrono::duration<double> busy{0};
+    for (const auto& exec : batch->executions) busy += exec.finished_at - exec.started_at;
+    std::chrono::duration<double> wall = ToolBatch::Clock::now() - batch->launched_at;
+    double parallelism = wall.count() > 0 ? busy / wall : 1.0;
+    const auto& schedule = *batch->schedule;
+    spdlog::debug("[Session {}] {} tool call(s): critical path {}, up to {} at once, parallelism {:.2f}", id_, schedule.size(),
+                  schedule.critical_path(), schedule.max_running(), parallelism);
+    Bus::instance().publish(events::ToolBatchCompleted{id_, schedule.size(), schedule.critical_path(), schedule.max_running(), parallelism});
+  }
+
+  // Add tool results
+  auto& result_msg = batch->result_msg;
+  if (!result_msg.tool_results().empty()) {
+    spdlog::debug("[Session {}] Adding {} tool result(s) to messages", id_, result_msg.tool_results().size());
+    add_message(std::move(result_msg));
+  }
+
+  state_ = SessionState::Running;
+  schedule(std::move(batch->then));
+}
+
+void Session::report_tool_results(ToolBatch& batch) {
+  for (; batch.reported < batch.executions.size() && batch.executions[batch.reported].finished; ++batch.reported) {
+    auto& exec = batch.executions[batch.reported];
+    batch.result_msg.add_tool_result(exec.tool_call->id, exec.tool_call->name, exec.output, exec.is_error);
+
+    // Notify tool result callback
+    if (on_tool_result_) {
+      on_tool_result_(exec.tool_call->id, exec.tool_call->name, exec.output, exec.is_error);
     }
 
+    Bus::instance().publish(events::ToolCallCompleted{id_, exec.tool_call->id, exec.tool_call->name, !exec.is_error});
+
     exec.tool_call->completed = true;
+    mark_tool_call(batch.message_id, *exec.tool_call);
     spdlog::debug("[Session {}] Tool call completed: {}", id_, exec.tool_call->name);
 
     // Track for doom loop detection
@@ -673,14 +1056,66 @@ void Session::execute_tool_calls() {
       recent_tool_calls_.erase(recent_tool_calls_.begin());
     }
   }
+}
 
-  // Add tool results
-  if (!result_msg.tool_results().empty()) {
-    spdlog::debug("[Session {}] Adding {} tool result(s) to messages", id_, result_msg.tool_results().size());
-    add_message(std::move(result_msg));
+void Session::mark_tool_call(const MessageId& message_id, const ToolCallPart& call) {
+  for (auto it = messages_.rbegin(); it != messages_.rend(); ++it) {
+    if (it->id() != message_id) continue;
+    it->set_tool_call_state(call.id, call.started, call.completed);
+    return;
   }
+}
 
-  state_ = SessionState::Running;
+ToolContext Session::make_tool_context(const std::string& tool_call_id, const MessageId& message_id) {
+  ToolContext ctx;
+  ctx.session_id = id_;
+  ctx.message_id = message_id;
+  ctx.working_dir = config_.working_dir.string();
+  ctx.abort_signal = abort_signal_;
+  ctx.ask_permission = permission_handler_;
+  ctx.question_handler = question_handler_;
+  ctx.completion = std::make_shared<ToolCompletion>();
+  ctx.completion->notify = [post = run_poster(), weak = weak_from_this()]() {
+    post([weak]() {
+      if (auto self = weak.lock()) self->on_tool_result_ready();
+    });
+  };
+
+  // Provide child session creation callback for Task tool
+  auto self = shared_from_this();
+  ctx.create_child_session = [self](AgentType agent_type) {
+    return self->create_child(agent_type);
+  };
+
+  // Provide subagent event callback for Task tool progress reporting
+  ctx.on_subagent_event = [self, tool_call_id](const SubagentEvent& event) {
+    if (self->subagent_event_handler_) {
+      self->subagent_event_handler_(tool_call_id, event);
+    }
+  };
+  return ctx;
+}
+
+void Session::start_speculative_tool(const std::string& tool_call_id, const std::string& tool_name, const json& args, const MessageId& message_id) {
+  if (speculative_tools_.count(tool_call_id) || !args.is_object()) return;
+
+  // Only tools without side effects that would run without asking; everything else waits for the full response
+  auto tool = ToolRegistry::instance().get(tool_name);
+  if (!tool || !tool->is_read_only()) return;
+  if (PermissionManager::instance().check_permission(tool_name, agent_config_) != Permission::Allow) return;
+
+  SpeculativeExecution execution;
+  execution.context = make_tool_context(tool_call_id, message_id);
+  try {
+    execution.future = tool->execute(args, execution.context);
+    watch_tool_result(execution.future, execution.context);
+  } catch (const std::exception& e) {
+    // execute_tool_calls starts it again and reports the failure
+    spdlog::debug("[Session {}] Speculative start of {} failed: {}", id_, tool_name, e.what());
+    return;
+  }
+  spdlog::debug("[Session {}] Started read-only tool {} while streaming", id_, tool_name);
+  speculative_tools_.emplace(tool_call_id, std::move(execution));
 }
 
 bool Session::needs_compaction() const {
@@ -690,14 +1125,22 @@ bool Session::needs_compaction() const {
   return estimated_context_tokens() > limit * 0.8;  // 80% threshold
 }
 
-void Session::trigger_compaction() {
+void Session::trigger_compaction(Continuation then) {
   state_ = SessionState::Compacting;
   spdlog::info("Session {} triggering compaction", id_);
 
+  // Clearing old outputs keeps more of the cached prefix than a summary, which replaces all of it
+  if (config_.context.prune_mode == PruneMode::CacheAware && prune_old_outputs(true) && !needs_compaction()) {
+    state_ = SessionState::Running;
+    schedule(std::move(then));
+    return;
+  }
+
   if (!provider_) {
     // No provider available, fall back to pruning only
-    prune_old_outputs();
+    prune_old_outputs(true);
     state_ = SessionState::Running;
+    schedule(std::move(then));
     return;
   }
 
@@ -705,15 +1148,16 @@ void Session::trigger_compaction() {
   auto messages_to_summarize = collect_messages_for_compaction();
 
   if (messages_to_summarize.empty()) {
-    prune_old_outputs();
+    prune_old_outputs(true);
     state_ = SessionState::Running;
+    schedule(std::move(then));
     return;
   }
 
   // 2. Build compaction request
-  llm::LlmRequest request;
-  request.model = agent_config_.model;
-  request.system_prompt =
+  auto request = std::make_shared<llm::LlmRequest>();
+  request->model = agent_config_.model;
+  request->system_prompt =
       "You are a conversation summarizer. Summarize the following conversation into a concise summary "
       "that preserves all important context, decisions made, code changes, file paths, and any ongoing tasks. "
       "The summary will be used to continue the conversation, so include all information needed to pick up "
@@ -724,59 +1168,50 @@ void Session::trigger_compaction() {
       "- **Key Decisions**: Important choices made\n"
       "- **Current State**: Where things stand now\n"
       "- **Pending Items**: What still needs to be done (if any)";
-  request.messages = std::move(messages_to_summarize);
+  request->messages = std::move(messages_to_summarize);
+  request->priority = net::RequestPriority::Background;
   // No tools for compaction agent
 
   // 3. Call LLM to generate summary
-  std::string summary_text = stream_compaction(request);
-
-  if (summary_text.empty()) {
-    spdlog::warn("Session {} compaction failed, falling back to prune", id_);
-    prune_old_outputs();
-    state_ = SessionState::Running;
-    return;
-  }
+  stream_compaction(std::move(request), [self = shared_from_this(), then = std::move(then)](std::string summary_text) {
+    if (summary_text.empty()) {
+      spdlog::warn("Session {} compaction failed, falling back to prune", self->id_);
+      self->prune_old_outputs(true);
+      self->state_ = SessionState::Running;
+      then();
+      return;
+    }
 
-  // 4. Create summary message
-  Message summary_msg(Role::Assistant, "");
-  summary_msg.add_text(summary_text);
-  summary_msg.set_summary(true);
-  summary_msg.set_finished(true);
-  summary_msg.set_synthetic(true);
+    // 4. Create summary message
+    Message summary_msg(Role::Assistant, "");
+    summary_msg.add_text(summary_text);
+    summary_msg.set_summary(true);
+    summary_msg.set_finished(true);
+    summary_msg.set_synthetic(true);
+
+    // The summary replaces the whole cached prefix
+    auto& messages = self->messages_;
+    self->prune_stats_.epochs++;
+    for (size_t m = self->context_start(); m < std::min(self->cache_boundary_, messages.size()); ++m) {
+      self->prune_stats_.tokens_invalidated += messages[m].token_count();
+    }
 
-  // 5. Add summary message (auto-persists via store)
-  add_message(std::move(summary_msg));
+    // 5. Add summary message (auto-persists via store)
+    self->add_message(std::move(summary_msg));
 
-  // 6. Prune old tool outputs
-  prune_old_outputs();
+    // 6. Prune old tool outputs
+    self->prune_old_outputs(true);
 
-  state_ = SessionState::Running;
-  spdlog::info("Session {} compaction completed", id_);
+    self->state_ = SessionState::Running;
+    spdlog::info("Session {} compaction completed", self->id_);
+    then();
+  });
 }
 
 std::vector<Message> Session::collect_messages_for_compaction() const {
-  // Find the most recent summary
-  int summary_index = -1;
-  for (int i = static_cast<int>(messages_.size()) - 1; i >= 0; --i) {
-    if (messages_[i].is_summary() && messages_[i].is_finished()) {
-      summary_index = i;
-      break;
-    }
-  }
-
-  // Collect all messages (or all since last summary) to be summarized
-  // We pass the full context to the LLM so it can generate a comprehensive summary
-  std::vector<Message> result;
-
-  if (summary_index >= 0) {
-    // Include old summary + everything after it (to create a new combined summary)
-    for (int i = summary_index; i < static_cast<int>(messages_.size()); ++i) {
-      result.push_back(messages_[i]);
-    }
-  } else {
-    // No summary exists, include all messages
-    result = messages_;
-  }
+  // All messages since the last summary, including it (to create a new combined summary), or all
+  // messages when there is none. We pass the full context to the LLM so it can generate a comprehensive summary
+  auto result = context_messages();
 
   // Convert to a single user message containing the conversation for the summarizer
   if (result.empty()) return {};
@@ -807,11 +1242,11 @@ std::vector<Message> Session::collect_messages_for_compaction() const {
       if (tr->compacted) {
         conversation_text += "[Tool result: " + tr->tool_name + " (content cleared)]\n";
       } else {
-        auto output = tr->output;
-        if (output.size() > 500) {
-          output = output.substr(0, 500) + "... (truncated)";
-        }
-        conversation_text += "[Tool result: " + tr->tool_name + "]\n" + output + "\n\n";
+        std::string_view output = tr->output;
+        conversation_text += "[Tool result: " + tr->tool_name + "]\n";
+        conversation_text += output.substr(0, 500);
+        if (output.size() > 500) conversation_text += "... (truncated)";
+        conversation_text += "\n\n";
       }
     }
   }
@@ -822,62 +1257,69 @@ std::vector<Message> Session::collect_messages_for_compaction() const {
   return compaction_messages;
 }
 
-std::string Session::stream_compaction(const llm::LlmRequest& request) {
-  std::promise<void> done;
-  auto done_future = done.get_future();
-
-  std::string accumulated_text;
-  std::optional<std::string> error_message;
+void Session::stream_compaction(std::shared_ptr<llm::LlmRequest> request, std::function<void(std::string)> then) {
+  struct Summary {
+    std::string accumulated_text;
+    std::optional<std::string> error_message;
+  };
+  auto summary = std::make_shared<Summary>();
 
   provider_->stream(
-      request,
-      [&accumulated_text, &error_message](const llm::StreamEvent& event) {
+      *request,
+      [summary](const llm::StreamEvent& event) {
         std::visit(
-            [&accumulated_text, &error_message](auto&& e) {
+            [&summary](auto&& e) {
               using T = std::decay_t<decltype(e)>;
               if constexpr (std::is_same_v<T, llm::TextDelta>) {
-                accumulated_text += e.text;
+                summary->accumulated_text += e.text;
               } else if constexpr (std::is_same_v<T, llm::StreamError>) {
-                error_message = e.message;
+                summary->error_message = e.message;
               }
               // Ignore tool calls and other events for compaction
             },
             event);
       },
-      [&done]() {
-        done.set_value();
+      [request, summary, then = std::move(then), executor = executor_]() {
+        asio::post(executor, [summary, then]() {
+          if (summary->error_message) {
+            spdlog::warn("Compaction stream error: {}", *summary->error_message);
+            then("");
+            return;
+          }
+          then(std::move(summary->accumulated_text));
+        });
       });
-
-  done_future.wait();
-
-  if (error_message) {
-    spdlog::warn("Compaction stream error: {}", *error_message);
-    return "";
-  }
-
-  return accumulated_text;
 }
 
-void Session::handle_compaction() {
-  trigger_compaction();
+void Session::handle_compaction(Continuation then) {
+  trigger_compaction(std::move(then));
 }
 
-void Session::prune_old_outputs() {
+bool Session::prune_old_outputs(bool force) {
   const int64_t protect_tokens = config_.context.prune_protect_tokens;
   const int64_t minimum_tokens = config_.context.prune_minimum_tokens;
 
-  int64_t accumulated = 0;
-  int64_t pruned = 0;
+  // Messages before the context start are no longer sent; those from there up to the cache boundary
+  // are the provider's cached prefix, where any change makes the rest of it be processed again
+  const size_t first_sent = context_start();
+  const size_t boundary = std::max(first_sent, std::min(cache_boundary_, messages_.size()));
 
-  // Track messages that were modified for store sync
-  std::vector<const Message*> modified_messages;
+  struct Candidate {
+    size_t message;
+    size_t part;
+    int64_t tokens;
+  };
+  std::vector<Candidate> candidates;
+  int64_t accumulated = 0;
+  int64_t deferred = 0;
 
   // Scan from newest to oldest
-  for (auto it = messages_.rbegin(); it != messages_.rend(); ++it) {
-    bool modified = false;
-    for (auto& part : it->parts()) {
-      if (auto* tr = std::get_if<ToolResultPart>(&part)) {
-        int64_t part_tokens = tr->output.size() / 4;
+  for (size_t m = messages_.size(); m-- > 0;) {
+    // Read through the const view: taking the parts mutably drops the message's cached request fragments
+    const auto& parts = std::as_const(messages_[m]).parts();
+    for (size_t i = 0; i < parts.size(); ++i) {
+      if (auto* tr = std::get_if<ToolResultPart>(&parts[i])) {
+        int64_t part_tokens = messages_[m].part_tokens(i);
 
         if (accumulated < protect_tokens) {
           accumulated += part_tokens;
@@ -885,24 +1327,66 @@ void Session::prune_old_outputs() {
           // Check if tool is protected (e.g., skill)
           if (tr->tool_name == "skill") continue;
 
-          // Compact this output
-          tr->compacted = true;
-          tr->compacted_at = std::chrono::system_clock::now();
-          tr->output = "[Old tool result content cleared]";
-          pruned += part_tokens;
-          modified = true;
+          candidates.push_back({m, i, part_tokens});
+          if (m >= first_sent && m < boundary) deferred += part_tokens;
         }
       }
     }
-    if (modified) {
-      modified_messages.push_back(&(*it));
+  }
+
+  // Cache-aware mode leaves the cached prefix alone until an epoch clears everything prunable at once
+  bool epoch = force || config_.context.prune_mode != PruneMode::CacheAware || deferred >= config_.context.prune_epoch_tokens;
+
+  std::vector<Candidate> selected;
+  size_t first_changed = boundary;
+  int64_t saved = 0;
+  for (const auto& c : candidates) {
+    bool in_cached_prefix = c.message >= first_sent && c.message < boundary;
+    if (in_cached_prefix && !epoch) continue;
+    if (in_cached_prefix) first_changed = std::min(first_changed, c.message);
+    if (c.message >= first_sent) saved += c.tokens;
+    selected.push_back(c);
+  }
+
+  // Measured before clearing: what the provider had cached from the first change on
+  int64_t invalidated = 0;
+  for (size_t m = first_changed; m < boundary; ++m) {
+    invalidated += messages_[m].token_count();
+  }
+
+  // Track messages that were modified for store sync
+  std::vector<size_t> modified_messages;
+  int64_t pruned = 0;
+  for (const auto& c : selected) {
+    if (modified_messages.empty() || modified_messages.back() != c.message) {
+      modified_messages.push_back(c.message);
+      if (c.message >= first_sent) context_tokens_ -= messages_[c.message].token_count();
     }
+
+    // Compact this output
+    auto& compacted = std::get<ToolResultPart>(messages_[c.message].parts()[c.part]);
+    compacted.compacted = true;
+    compacted.compacted_at = std::chrono::system_clock::now();
+    compacted.output = "[Old tool result content cleared]";
+    pruned += c.tokens;
+  }
+  for (size_t m : modified_messages) {
+    if (m >= first_sent) context_tokens_ += messages_[m].token_count();
+  }
+
+  prune_stats_.outputs_cleared += static_cast<int64_t>(selected.size());
+  prune_stats_.tokens_saved += saved;
+  prune_stats_.deferred_tokens = epoch ? 0 : deferred;
+  if (first_changed < boundary) {
+    prune_stats_.epochs++;
+    prune_stats_.tokens_invalidated += invalidated;
+    spdlog::info("Session {} prune epoch: saved ~{} tokens per request, invalidated ~{} cached tokens", id_, saved, invalidated);
   }
 
   // Sync modified messages to store
-  if (store_ && !modified_messages.empty()) {
-    for (const auto* msg : modified_messages) {
-      store_->update(*msg);
+  if (store_) {
+    for (size_t m : modified_messages) {
+      store_->update(messages_[m]);
     }
   }
 
@@ -911,6 +1395,7 @@ void Session::prune_old_outputs() {
 
     Bus::instance().publish(events::ContextCompacted{id_, accumulated + pruned, accumulated});
   }
+  return pruned > 0;
 }
 
 bool Session::detect_doom_loop(const std::string& tool_name, const json& args) {
@@ -954,6 +1439,7 @@ std::shared_ptr<Session> Session::resume(asio::io_context& io_ctx, const Config&
 
   // Load messages from store
   session->messages_ = store->list(session_id);
+  session->recount_context_tokens();
 
   spdlog::info("Resumed session {} with {} messages", session_id, session->messages_.size());
 
@@ -990,74 +1476,70 @@ void Session::sync_to_store() {
   json_store->save_session(meta);
 }
 
-bool Session::should_retry_on_error(const std::string& error_msg) {
+bool Session::should_retry_on_error(const std::string& error_msg, bool retryable, std::optional<std::chrono::milliseconds> retry_after) {
   // 检查是否达到最大重试次数
-  if (retry_state_.current_attempt >= retry_state_.max_retries) {
+  if (retry_state_.current_attempt >= retry_state_.policy.max_retries) {
     return false;
   }
 
-  // 检查错误类型是否可以重试
-  // 超时错误
-  if (error_msg.find("timed out") != std::string::npos || error_msg.find("Request timed out") != std::string::npos) {
-    return true;
-  }
-
-  // 网络连接错误
-  if (error_msg.find("Network error") != std::string::npos || error_msg.find("Connection") != std::string::npos) {
-    return true;
+  // 检查错误类型是否可以重试（超时、连接错误、5xx、429/529 等，由 provider 标记或按错误信息判断）
+  if (!retryable && !net::RetryPolicy::retryable_error(error_msg)) {
+    return false;
   }
 
-  // 临时服务器错误 (5xx)
-  if (error_msg.find("HTTP error: 5") != std::string::npos) {
-    return true;
+  // 服务端要求的等待过长时放弃，与 HTTP 层一致
+  if (retry_after && *retry_after > retry_state_.policy.max_server_delay) {
+    spdlog::warn("[Session {}] Server asked to wait {}ms, not retrying: {}", id_, retry_after->count(), error_msg);
+    return false;
   }
 
-  // 速率限制错误 (429)
-  if (error_msg.find("HTTP error: 429") != std::string::npos) {
-    return true;
+  // 全局重试预算耗尽时不再重试，避免故障期间重试风暴放大压力
+  if (retry_state_.policy.use_budget && !net::RetryBudget::instance().try_acquire()) {
+    spdlog::warn("[Session {}] Retry budget exhausted, not retrying: {}", id_, error_msg);
+    return false;
   }
 
-  return false;
+  return true;
 }
 
-bool Session::retry_on_error(const std::string& error_msg) {
-  auto now = std::chrono::steady_clock::now();
-
-  // 确保重试间隔至少为3秒（避免过于频繁的重试）
-  if (retry_state_.current_attempt > 0) {
-    auto elapsed = now - retry_state_.last_retry_time;
-    if (elapsed < std::chrono::seconds(3)) {
-      std::this_thread::sleep_for(std::chrono::seconds(3) - elapsed);
-    }
-  }
-
+void Session::retry_on_error(const std::string& error_msg, std::optional<std::chrono::milliseconds> retry_after, Continuation then) {
+  // 指数退避 + 全抖动：在 [0, min(上限, 基础间隔 * 2^n)] 内随机等待，避免多个会话同时重试；
+  // 服务端给出 Retry-After / 限流重置时间时至少等待该时长
+  auto backoff = retry_state_.policy.backoff(retry_state_.current_attempt);
+  if (retry_after) backoff = std::max(backoff, *retry_after);
   retry_state_.current_attempt++;
-  retry_state_.last_retry_time = std::chrono::steady_clock::now();
-
-  // 指数退避：每次重试时间间隔增加
-  auto backoff_seconds = std::min(30, static_cast<int>(std::pow(2, retry_state_.current_attempt - 1) * 3));
 
-  spdlog::warn("[Session {}] Retrying after error (attempt {}/{}): {}", id_, retry_state_.current_attempt, retry_state_.max_retries, error_msg);
-  spdlog::info("[Session {}] Waiting {}s before retry...", id_, backoff_seconds);
-
-  std::this_thread::sleep_for(std::chrono::seconds(backoff_seconds));
+  spdlog::warn("[Session {}] Retrying after error (attempt {}/{}): {}", id_, retry_state_.current_attempt, retry_state_.policy.max_retries,
+               error_msg);
+  spdlog::info("[Session {}] Waiting {}ms before retry...", id_, backoff.count());
 
   // 保存当前消息数量，以便重试时避免重复添加
   retry_state_.last_message_count = messages_.size();
 
-  try {
-    // 重新调用 process_stream，但不添加新的用户消息
-    spdlog::info("[Session {}] Starting retry attempt {}", id_, retry_state_.current_attempt);
-    process_stream();
-
-    // 重试成功，重置重试状态
-    retry_state_.current_attempt = 0;
-    return true;
-
-  } catch (const std::exception& e) {
-    spdlog::error("[Session {}] Retry attempt {} failed: {}", id_, retry_state_.current_attempt, e.what());
-    return false;
+  // 等待期间不占用线程；取消后不再重试。cancel() 先置 abort_signal_ 再取走 retry_timer_，
+  // 因此它要么取消这里登记的定时器，要么在登记后被下面的检查看到
+  auto timer = std::make_shared<asio::steady_timer>(executor_, backoff);
+  {
+    std::lock_guard<std::mutex> lock(retry_mutex_);
+    retry_timer_ = timer;
   }
+  if (abort_signal_->load()) {
+    schedule(std::move(then));
+    return;
+  }
+  timer->async_wait([self = shared_from_this(), timer, then = std::move(then)](const std::error_code&) {
+    {
+      std::lock_guard<std::mutex> lock(self->retry_mutex_);
+      if (self->retry_timer_ == timer) self->retry_timer_.reset();
+    }
+    if (self->abort_signal_->load()) {
+      then();
+      return;
+    }
+    // 重新调用 process_stream，但不添加新的用户消息
+    spdlog::info("[Session {}] Starting retry attempt {}", self->id_, self->retry_state_.current_attempt);
+    self->process_stream(then);
+  });
 }
 
 }  // namespace agent
@@ -3,8 +3,12 @@
 #include <asio.hpp>
 #include <atomic>
 #include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -13,6 +17,7 @@
 #include "core/message.hpp"
 #include "core/types.hpp"
 #include "llm/provider.hpp"
+#include "net/retry_policy.hpp"
 #include "tool/tool.hpp"
 
 namespace agent {
@@ -22,6 +27,15 @@ enum class SessionState { Idle, Running, WaitingForTool, WaitingForUser, Compact
 
 std::string to_string(SessionState state);
 
+// What clearing old tool outputs has cost and gained, in estimated tokens (see Config::ContextSettings::prune_mode)
+struct PruneStats {
+  int64_t epochs = 0;              // Prunes or compactions that rewrote part of the cached prompt prefix
+  int64_t outputs_cleared = 0;     // Tool outputs replaced by a placeholder
+  int64_t tokens_saved = 0;        // Removed from every later request
+  int64_t tokens_invalidated = 0;  // Cached prefix after the first change, processed again on the next request
+  int64_t deferred_tokens = 0;     // Prunable now but held back to keep the cached prefix stable
+};
+
 // Session class - manages a conversation with an agent
 class Session : public std::enable_shared_from_this<Session> {
  public:
@@ -73,26 +87,45 @@ class Session : public std::enable_shared_from_this<Session> {
     return messages_;
   }
 
-  std::vector<Message> get_context_messages() const;  // Filtered for LLM
+  // Messages sent to the model: the latest summary and everything after it. The view is invalidated by
+  // the next add_message.
+  std::span<const Message> context_messages() const;
+
+  std::vector<Message> get_context_messages() const;  // Copy of context_messages()
 
   // Token tracking
   TokenUsage total_usage() const {
     return total_usage_;
   }
 
-  int64_t estimated_context_tokens() const;
+  // Tokens of the messages sent to the model (from the latest summary on), kept as a running total
+  int64_t estimated_context_tokens() const {
+    return context_tokens_;
+  }
+
   int64_t context_window() const;  // 返回模型的上下文窗口大小
 
+  PruneStats prune_stats() const {
+    return prune_stats_;
+  }
+
   // Agent config
   const AgentConfig& agent_config() const {
     return agent_config_;
   }
 
-  // Send user message and run agent loop
+  // Send user message and run agent loop. Returns when the run ends; the calling thread drives it.
   void prompt(const std::string& text);
 
   void prompt(Message user_msg);
 
+  // Send user message and return at once: the run is driven by the io_context and ends with on_complete.
+  // A session waiting on the model, a tool or a permission answer holds no thread, so any number of them
+  // can share the io_context's threads. One run at a time: a prompt while one is running is ignored.
+  void prompt_async(const std::string& text);
+
+  void prompt_async(Message user_msg);
+
   // Cancel current operation
   void cancel();
 
@@ -101,6 +134,8 @@ class Session : public std::enable_shared_from_this<Session> {
   using OnStreamCallback = std::function<void(const std::string& text)>;
   using OnThinkingCallback = std::function<void(const std::string& thinking)>;
   using OnToolCallCallback = std::function<void(const std::string& tool_call_id, const std::string& tool, const json& args)>;
+  // Arguments parsed so far while a tool call streams; the last string value may be incomplete
+  using OnToolCallProgressCallback = std::function<void(const std::string& tool_call_id, const std::string& tool, const json& partial_args)>;
   using OnToolResultCallback =
       std::function<void(const std::string& tool_call_id, const std::string& tool, const std::string& result, bool is_error)>;
   using OnCompleteCallback = std::function<void(FinishReason)>;
@@ -122,6 +157,10 @@ class Session : public std::enable_shared_from_this<Session> {
     on_tool_call_ = std::move(cb);
   }
 
+  void on_tool_call_progress(OnToolCallProgressCallback cb) {
+    on_tool_call_progress_ = std::move(cb);
+  }
+
   void on_tool_result(OnToolResultCallback cb) {
     on_tool_result_ = std::move(cb);
   }
@@ -158,32 +197,95 @@ class Session : public std::enable_shared_from_this<Session> {
  private:
   Session(asio::io_context& io_ctx, const Config& config, AgentType agent_type, std::shared_ptr<MessageStore> store);
 
-  // The main agent loop
-  void run_loop();
+  using Continuation = std::function<void()>;
+
+  // The agent loop, as a state machine: each step either ends the run or starts something asynchronous
+  // (a model stream, tool calls, a compaction) whose completion schedules the next step on executor.
+  void run_loop(asio::any_io_executor executor);
+
+  void run_step();
+
+  void finish_run();
+
+  void schedule(Continuation next);
+
+  // Posts a continuation to the current run's executor from any thread. Dropped once that run has ended.
+  std::function<void(Continuation)> run_poster() const;
+
+  // A running tool call's result is ready: resume the batch waiting for it, if any
+  void on_tool_result_ready();
+
+  struct StreamTurn;
+
+  void process_stream(Continuation then);
+
+  void finish_stream(const std::shared_ptr<StreamTurn>& turn, Continuation then);
 
-  void process_stream();
+  struct ToolBatch;
 
-  void execute_tool_calls();
+  void execute_tool_calls(Continuation then);
 
-  void handle_compaction();
+  // Check calls from index on, waiting for permission answers as needed; then launch them
+  void prepare_tool_calls(const std::shared_ptr<ToolBatch>& batch, size_t index);
+
+  // Give the calls from index on that have no result yet a "Cancelled" one
+  void cancel_tool_calls(ToolBatch& batch, size_t index);
+
+  void add_tool_execution(ToolBatch& batch, ToolCallPart* tool_call, std::shared_ptr<Tool> tool);
+
+  // Start the calls that conflict with no earlier call; the rest start as the calls they wait for finish
+  void launch_tool_calls(const std::shared_ptr<ToolBatch>& batch);
+
+  void start_ready_tools(ToolBatch& batch);
+
+  void finish_tool_call(ToolBatch& batch, size_t index, std::string output, bool is_error);
+
+  // Take the results of finished calls until all have finished
+  void collect_tool_results(const std::shared_ptr<ToolBatch>& batch);
+
+  // Add finished results to the result message in call order
+  void report_tool_results(ToolBatch& batch);
+
+  // Record call's started and completed flags in the message it belongs to
+  void mark_tool_call(const MessageId& message_id, const ToolCallPart& call);
+
+  ToolContext make_tool_context(const std::string& tool_call_id, const MessageId& message_id);
+
+  // For a started call whose tool does not report completion itself: have a Waiting-lane thread wait on
+  // future and notify the session, replacing future with that thread's
+  static void watch_tool_result(std::future<ToolResult>& future, const ToolContext& context);
+
+  // Start a permitted read-only tool as soon as its call completes in the stream (config tools.speculative_read_only)
+  void start_speculative_tool(const std::string& tool_call_id, const std::string& tool_name, const json& args, const MessageId& message_id);
+
+  void handle_compaction(Continuation then);
 
   // Context management
   bool needs_compaction() const;
 
-  void trigger_compaction();
+  void trigger_compaction(Continuation then);
+
+  // Clear old tool outputs per config context.prune_mode; force starts an epoch regardless of the threshold.
+  // Returns true if anything was cleared.
+  bool prune_old_outputs(bool force = false);
 
-  void prune_old_outputs();
+  // Index of the first message sent to the model (the latest summary, or 0)
+  size_t context_start() const;
+
+  // Rebuild context_tokens_ from the messages' cached counts (after loading a stored session)
+  void recount_context_tokens();
 
   // Compaction helpers
   std::vector<Message> collect_messages_for_compaction() const;
-  std::string stream_compaction(const llm::LlmRequest& request);
+  // then(summary), empty on failure
+  void stream_compaction(std::shared_ptr<llm::LlmRequest> request, std::function<void(std::string)> then);
 
   // Doom loop detection
   bool detect_doom_loop(const std::string& tool_name, const json& args);
 
   // Retry mechanism helper methods
-  bool should_retry_on_error(const std::string& error_msg);
-  bool retry_on_error(const std::string& error_msg);
+  bool should_retry_on_error(const std::string& error_msg, bool retryable, std::optional<std::chrono::milliseconds> retry_after);
+  void retry_on_error(const std::string& error_msg, std::optional<std::chrono::milliseconds> retry_after, Continuation then);
 
   // Sync session metadata to persistent store
   void sync_to_store();
@@ -199,9 +301,22 @@ class Session : public std::enable_shared_from_this<Session> {
   std::atomic<SessionState> state_{SessionState::Idle};
   std::shared_ptr<std::atomic<bool>> abort_signal_;
 
+  // The current run: its steps are posted to executor_, which also keeps the executor's context running
+  // (tracked work) until the run ends
+  std::atomic<bool> running_{false};
+  asio::any_io_executor executor_;
+  // Tracked copy of executor_, held weakly by run_poster(): while one holds it the run's context keeps running
+  std::shared_ptr<const asio::any_io_executor> run_wake_;
+  int step_ = 0;
+
   std::vector<Message> messages_;
   TokenUsage total_usage_;
 
+  // messages_ before this index were in the last request, i.e. in the provider's cached prefix
+  size_t cache_boundary_ = 0;
+  PruneStats prune_stats_;
+  int64_t context_tokens_ = 0;  // Sum of token_count() from context_start() on
+
   std::shared_ptr<llm::Provider> provider_;
   std::shared_ptr<MessageStore> store_;  // Persistent storage (optional)
 
@@ -210,6 +325,7 @@ class Session : public std::enable_shared_from_this<Session> {
   OnStreamCallback on_stream_;
   OnThinkingCallback on_thinking_;
   OnToolCallCallback on_tool_call_;
+  OnToolCallProgressCallback on_tool_call_progress_;
   OnToolResultCallback on_tool_result_;
   OnCompleteCallback on_complete_;
   OnErrorCallback on_error_;
@@ -226,12 +342,30 @@ class Session : public std::enable_shared_from_this<Session> {
 
   // Retry mechanism
   struct RetryState {
-    int max_retries = 3;            // 最大重试次数
+    // 最多重试3次，首次退避上限3秒，之后指数增长至30秒；已输出内容的流式请求由会话整体重放
+    net::RetryPolicy policy{.max_retries = 3, .base_delay = std::chrono::seconds(3), .max_delay = std::chrono::seconds(30)};
     int current_attempt = 0;        // 当前尝试次数
     size_t last_message_count = 0;  // 重试前的消息数量（用于避免重复添加）
-    std::chrono::steady_clock::time_point last_retry_time;
   };
   RetryState retry_state_;
+  // Backoff before the next retry; cancel() cancels it so a cancelled run does not sit out the wait
+  std::mutex retry_mutex_;
+  std::shared_ptr<asio::steady_timer> retry_timer_;
+
+  // Read-only tools started while the response streamed, joined by execute_tool_calls (by tool call id)
+  struct SpeculativeExecution {
+    ToolContext context;
+    std::future<ToolResult> future;
+  };
+  std::map<std::string, SpeculativeExecution> speculative_tools_;
+
+  // Batch with calls still running, resumed by on_tool_result_ready
+  std::shared_ptr<ToolBatch> waiting_batch_;
+
+  // Resumes a run waiting for a permission answer with the answer; cancel() resumes it with none.
+  // Only held here, so the thread waiting for the answer does not keep the session alive.
+  std::mutex permission_mutex_;
+  std::shared_ptr<std::function<void(bool allowed)>> permission_wait_;
 
   // Child sessions
   std::vector<std::weak_ptr<Session>> children_;
@@ -34,7 +34,7 @@ std::vector<ParameterSchema> BashTool::parameters() const {
 }
 
 std::future<ToolResult> BashTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Blocking, [args, ctx]() -> ToolResult {
     std::string command = args.value("command", "");
     std::string workdir = args.value("workdir", ctx.working_dir);
     int timeout_ms = args.value("timeout", DEFAULT_TIMEOUT_MS);
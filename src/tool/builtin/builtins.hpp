@@ -25,6 +25,12 @@ class ReadTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
+
+  bool is_read_only() const override {
+    return true;
+  }
 };
 
 // Write tool - write file contents
@@ -35,6 +41,8 @@ class WriteTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
 };
 
 // Edit tool - edit file with search/replace
@@ -45,6 +53,8 @@ class EditTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
 };
 
 // Glob tool - find files by pattern
@@ -55,6 +65,12 @@ class GlobTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
+
+  bool is_read_only() const override {
+    return true;
+  }
 };
 
 // Grep tool - search file contents
@@ -65,6 +81,12 @@ class GrepTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
+
+  bool is_read_only() const override {
+    return true;
+  }
 };
 
 // Question tool - ask user a question
@@ -75,6 +97,8 @@ class QuestionTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
 };
 
 // Task tool - launch subagent
@@ -98,6 +122,8 @@ class SkillTool : public SimpleTool {
   std::vector<ParameterSchema> parameters() const override;
 
   std::future<ToolResult> execute(const json& args, const ToolContext& ctx) override;
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override;
 };
 
 // Register all builtin tools
@@ -21,8 +21,13 @@ std::vector<ParameterSchema> EditTool::parameters() const {
           {"replaceAll", "boolean", "Replace all occurrences (default false)", false, json(false), std::nullopt}};
 }
 
+ToolAccess EditTool::access(const json& args, const ToolContext& ctx) const {
+  std::string file_path = args.value("filePath", "");
+  return file_path.empty() ? ToolAccess{} : ToolAccess::writing(file_path, ctx.working_dir);
+}
+
 std::future<ToolResult> EditTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args, ctx]() -> ToolResult {
     std::string file_path = args.value("filePath", "");
     std::string old_str = args.value("oldString", "");
     std::string new_str = args.value("newString", "");
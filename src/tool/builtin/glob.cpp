@@ -193,8 +193,12 @@ std::vector<ParameterSchema> GlobTool::parameters() const {
           {"path", "string", "The directory to search in", false, std::nullopt, std::nullopt}};
 }
 
+ToolAccess GlobTool::access(const json& args, const ToolContext& ctx) const {
+  return ToolAccess::reading(args.value("path", ctx.working_dir), ctx.working_dir);
+}
+
 std::future<ToolResult> GlobTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args, ctx]() -> ToolResult {
     std::string pattern = args.value("pattern", "");
     std::string search_path = args.value("path", ctx.working_dir);
 
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <regex>
@@ -21,8 +22,12 @@ std::vector<ParameterSchema> GrepTool::parameters() const {
           {"include", "string", "File pattern to include (e.g. \"*.js\")", false, std::nullopt, std::nullopt}};
 }
 
+ToolAccess GrepTool::access(const json& args, const ToolContext& ctx) const {
+  return ToolAccess::reading(args.value("path", ctx.working_dir), ctx.working_dir);
+}
+
 std::future<ToolResult> GrepTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args, ctx]() -> ToolResult {
     std::string pattern = args.value("pattern", "");
     std::string search_path = args.value("path", ctx.working_dir);
     std::string include = args.value("include", "");
@@ -47,6 +52,45 @@ std::future<ToolResult> GrepTool::execute(const json& args, const ToolContext& c
     size_t match_count = 0;
     const size_t max_matches = 100;
 
+    // Files are searched in batches across the tool executor and merged in walk order, so the result
+    // is the same as searching them one by one. Files are taken in order, and one is skipped once the
+    // files before it hold enough matches: those it could add would be cut anyway.
+    const size_t batch_size = 64;
+    std::vector<fs::path> batch;
+    auto search_batch = [&]() {
+      const size_t wanted = max_matches - match_count;
+      std::vector<std::vector<std::string>> found(batch.size());
+      std::vector<std::atomic<size_t>> counts(batch.size());
+      ctx.tool_executor().parallel_for(batch.size(), [&](size_t i) {
+        size_t before = 0;
+        for (size_t j = 0; j < i; ++j) before += counts[j];
+        if (before >= wanted) return;
+
+        std::ifstream file(batch[i]);
+        if (!file.is_open()) return;
+
+        std::string line;
+        int line_num = 0;
+        std::string rel_path = fs::relative(batch[i], base_path).string();
+
+        while (std::getline(file, line) && before + found[i].size() < wanted) {
+          line_num++;
+          if (std::regex_search(line, search_regex)) {
+            found[i].push_back(rel_path + ":" + std::to_string(line_num) + ": " + line);
+            counts[i]++;
+          }
+        }
+      });
+      for (const auto& lines : found) {
+        for (const auto& match : lines) {
+          if (match_count >= max_matches) break;
+          output << match << "\n";
+          match_count++;
+        }
+      }
+      batch.clear();
+    };
+
     try {
       for (const auto& entry : fs::recursive_directory_iterator(base_path)) {
         if (!entry.is_regular_file()) continue;
@@ -68,21 +112,10 @@ std::future<ToolResult> GrepTool::execute(const json& args, const ToolContext& c
           if (!matches_include) continue;
         }
 
-        std::ifstream file(entry.path());
-        if (!file.is_open()) continue;
-
-        std::string line;
-        int line_num = 0;
-        std::string rel_path = fs::relative(entry.path(), base_path).string();
-
-        while (std::getline(file, line) && match_count < max_matches) {
-          line_num++;
-          if (std::regex_search(line, search_regex)) {
-            output << rel_path << ":" << line_num << ": " << line << "\n";
-            match_count++;
-          }
-        }
+        batch.push_back(entry.path());
+        if (batch.size() == batch_size) search_batch();
       }
+      if (!batch.empty() && match_count < max_matches) search_batch();
     } catch (const std::exception& e) {
       return ToolResult::error(std::string("Error searching: ") + e.what());
     }
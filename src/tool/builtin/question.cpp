@@ -16,8 +16,13 @@ std::vector<ParameterSchema> QuestionTool::parameters() const {
   return {{"questions", "array", "Array of questions to ask the user (strings)", true, std::nullopt, std::nullopt}};
 }
 
+// Asks the user; touches no files
+ToolAccess QuestionTool::access(const json&, const ToolContext&) const {
+  return {};
+}
+
 std::future<ToolResult> QuestionTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, &ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Waiting, [args, ctx]() -> ToolResult {
     auto questions_json = args.value("questions", json::array());
 
     // Extract question strings
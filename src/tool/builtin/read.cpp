@@ -21,8 +21,13 @@ std::vector<ParameterSchema> ReadTool::parameters() const {
           {"limit", "number", "The number of lines to read (defaults to 2000)", false, json(2000), std::nullopt}};
 }
 
+ToolAccess ReadTool::access(const json& args, const ToolContext& ctx) const {
+  std::string file_path = args.value("filePath", "");
+  return file_path.empty() ? ToolAccess{} : ToolAccess::reading(file_path, ctx.working_dir);
+}
+
 std::future<ToolResult> ReadTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args, ctx]() -> ToolResult {
     std::string file_path = args.value("filePath", "");
     int offset = args.value("offset", 0);
     int limit = args.value("limit", 2000);
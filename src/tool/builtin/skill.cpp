@@ -40,8 +40,13 @@ std::vector<ParameterSchema> SkillTool::parameters() const {
   return {{"name", "string", "The name of the skill to load (from available_skills)", true, std::nullopt, std::nullopt}};
 }
 
+// Skill files are only read, and no tool call writes them
+ToolAccess SkillTool::access(const json&, const ToolContext&) const {
+  return {};
+}
+
 std::future<ToolResult> SkillTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args]() -> ToolResult {
     std::string name = args.value("name", "");
     if (name.empty()) {
       return ToolResult::error("Skill name is required");
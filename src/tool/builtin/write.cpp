@@ -18,8 +18,13 @@ std::vector<ParameterSchema> WriteTool::parameters() const {
           {"content", "string", "The content to write to the file", true, std::nullopt, std::nullopt}};
 }
 
+ToolAccess WriteTool::access(const json& args, const ToolContext& ctx) const {
+  std::string file_path = args.value("filePath", "");
+  return file_path.empty() ? ToolAccess{} : ToolAccess::writing(file_path, ctx.working_dir);
+}
+
 std::future<ToolResult> WriteTool::execute(const json& args, const ToolContext& ctx) {
-  return std::async(std::launch::async, [args, ctx]() -> ToolResult {
+  return ctx.run(id_, ToolLane::Compute, [args, ctx]() -> ToolResult {
     std::string file_path = args.value("filePath", "");
     std::string content = args.value("content", "");
 
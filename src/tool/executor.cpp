@@ -0,0 +1,344 @@
+#include "executor.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace agent {
+
+namespace {
+
+// The compute thread running on this thread, so tasks it submits go to its own deque
+thread_local const ToolExecutor* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+void raise_max(std::atomic<size_t>& max, size_t value) {
+  size_t seen = max.load();
+  while (value > seen && !max.compare_exchange_weak(seen, value)) {
+  }
+}
+
+void raise_max(std::atomic<int64_t>& max, int64_t value) {
+  int64_t seen = max.load();
+  while (value > seen && !max.compare_exchange_weak(seen, value)) {
+  }
+}
+
+}  // namespace
+
+ToolExecutor& ToolExecutor::instance() {
+  // Never destroyed: a tool still running at exit (a long bash command) must not hold exit up
+  static auto* executor = new ToolExecutor();
+  return *executor;
+}
+
+ToolExecutor::ToolExecutor(ToolExecutorOptions options) : options_(options) {
+  size_t threads = options_.compute_threads ? options_.compute_threads : std::max(1u, std::thread::hardware_concurrency());
+  blocking_.max_threads = std::max<size_t>(1, options_.blocking_threads);
+  for (size_t i = 0; i < threads; ++i) workers_.push_back(std::make_unique<Worker>());
+  for (size_t i = 0; i < threads; ++i) {
+    workers_[i]->thread = std::thread([this, i]() {
+      compute_loop(i);
+    });
+  }
+}
+
+ToolExecutor::~ToolExecutor() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) worker->thread.join();
+
+  stop_threaded(blocking_);
+  stop_threaded(waiting_);
+}
+
+void ToolExecutor::submit(const std::string& tool, ToolLane lane, Task task) {
+  counters_[static_cast<size_t>(lane)].submitted++;
+  {
+    std::lock_guard lock(tools_mutex_);
+    auto it = tools_.find(tool);
+    if (it != tools_.end() && it->second.limit > 0) {
+      // Holds one of the tool's slots until it finishes, thrown or not
+      task = [this, tool, inner = std::move(task)]() {
+        try {
+          inner();
+        } catch (...) {
+          on_tool_done(tool);
+          throw;
+        }
+        on_tool_done(tool);
+      };
+      auto& slots = it->second;
+      if (slots.running >= slots.limit) {
+        slots.waiting.push_back({lane, std::move(task)});
+        limited_total_++;
+        limited_++;
+        return;
+      }
+      slots.running++;
+    }
+  }
+  dispatch(lane, std::move(task));
+}
+
+void ToolExecutor::parallel_for(size_t count, const std::function<void(size_t)>& body) {
+  if (count == 0) return;
+
+  struct Fork {
+    const std::function<void(size_t)>* body;
+    size_t count;
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t done = 0;
+    std::exception_ptr error;
+  };
+  auto fork = std::make_shared<Fork>();
+  fork->body = &body;
+  fork->count = count;
+
+  // Takes indices until none are left. A helper that starts after that never touches body.
+  auto work = [](Fork& fork) {
+    size_t ran = 0;
+    for (size_t i; (i = fork.next++) < fork.count; ++ran) {
+      try {
+        (*fork.body)(i);
+      } catch (...) {
+        std::lock_guard lock(fork.mutex);
+        if (!fork.error) fork.error = std::current_exception();
+      }
+    }
+    if (ran == 0) return;
+    std::lock_guard lock(fork.mutex);
+    fork.done += ran;
+    if (fork.done == fork.count) fork.finished.notify_all();
+  };
+
+  size_t helpers = std::min(count - 1, workers_.size());
+  counters_[static_cast<size_t>(ToolLane::Compute)].submitted += helpers;
+  for (size_t i = 0; i < helpers; ++i) {
+    dispatch(ToolLane::Compute, [fork, work]() {
+      work(*fork);
+    });
+  }
+  work(*fork);
+
+  std::unique_lock lock(fork->mutex);
+  fork->finished.wait(lock, [&fork]() {
+    return fork->done == fork->count;
+  });
+  if (fork->error) std::rethrow_exception(fork->error);
+}
+
+void ToolExecutor::set_tool_limit(const std::string& tool, size_t max_running) {
+  std::vector<Limited> ready;
+  {
+    std::lock_guard lock(tools_mutex_);
+    auto& slots = tools_[tool];
+    slots.limit = max_running;
+    release_locked(slots, ready);
+  }
+  limited_ -= ready.size();
+  for (auto& limited : ready) dispatch(limited.lane, std::move(limited.task));
+}
+
+ToolExecutorStats ToolExecutor::stats() const {
+  ToolExecutorStats stats;
+  for (size_t i = 0; i < kToolLaneCount; ++i) {
+    const auto& counters = counters_[i];
+    auto& lane = stats.lanes[i];
+    lane.submitted = counters.submitted;
+    lane.started = counters.started;
+    lane.completed = counters.completed;
+    lane.stolen = counters.stolen;
+    lane.queued = counters.queued;
+    lane.max_queued = counters.max_queued;
+    lane.running = counters.running;
+    lane.total_wait = std::chrono::microseconds(counters.total_wait_us.load());
+    lane.max_wait = std::chrono::microseconds(counters.max_wait_us.load());
+  }
+  stats.lanes[static_cast<size_t>(ToolLane::Compute)].threads = workers_.size();
+  for (auto lane : {ToolLane::Blocking, ToolLane::Waiting}) {
+    const auto& lane_threads = threaded(lane);
+    std::lock_guard lock(lane_threads.mutex);
+    stats.lanes[static_cast<size_t>(lane)].threads = lane_threads.threads.size();
+  }
+  stats.limited_total = limited_total_;
+  stats.limited = limited_;
+  return stats;
+}
+
+void ToolExecutor::dispatch(ToolLane lane, Task task) {
+  auto& counters = counters_[static_cast<size_t>(lane)];
+  raise_max(counters.max_queued, ++counters.queued);
+  Item item{std::move(task), Clock::now()};
+  if (lane == ToolLane::Compute) {
+    push_compute(std::move(item));
+  } else {
+    push_threaded(lane, std::move(item));
+  }
+}
+
+void ToolExecutor::push_compute(Item item) {
+  size_t target = current_executor == this ? current_worker : next_worker_++ % workers_.size();
+  // Counted first: a thread that wakes and finds nothing yet only looks again
+  pending_++;
+  {
+    std::lock_guard lock(workers_[target]->mutex);
+    workers_[target]->items.push_back(std::move(item));
+  }
+  {
+    // Not lost between a sleeping thread's check of pending_ and its wait
+    std::lock_guard lock(sleep_mutex_);
+  }
+  wake_.notify_one();
+}
+
+bool ToolExecutor::take_compute(size_t self, Item& item) {
+  {
+    auto& own = *workers_[self];
+    std::lock_guard lock(own.mutex);
+    if (!own.items.empty()) {
+      item = std::move(own.items.back());
+      own.items.pop_back();
+      pending_--;
+      return true;
+    }
+  }
+  for (size_t k = 1; k < workers_.size(); ++k) {
+    auto& victim = *workers_[(self + k) % workers_.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.items.empty()) {
+      item = std::move(victim.items.front());
+      victim.items.pop_front();
+      pending_--;
+      counters_[static_cast<size_t>(ToolLane::Compute)].stolen++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ToolExecutor::compute_loop(size_t self) {
+  current_executor = this;
+  current_worker = self;
+  while (true) {
+    Item item;
+    if (take_compute(self, item)) {
+      execute(ToolLane::Compute, item);
+      continue;
+    }
+    std::unique_lock lock(sleep_mutex_);
+    wake_.wait(lock, [this]() {
+      return pending_ > 0 || stopping_;
+    });
+    if (stopping_ && pending_ == 0) return;
+  }
+}
+
+ToolExecutor::ThreadedLane& ToolExecutor::threaded(ToolLane lane) {
+  return lane == ToolLane::Waiting ? waiting_ : blocking_;
+}
+
+const ToolExecutor::ThreadedLane& ToolExecutor::threaded(ToolLane lane) const {
+  return lane == ToolLane::Waiting ? waiting_ : blocking_;
+}
+
+void ToolExecutor::push_threaded(ToolLane lane, Item item) {
+  auto& threaded = this->threaded(lane);
+  {
+    std::lock_guard lock(threaded.mutex);
+    threaded.items.push_back(std::move(item));
+    bool below_cap = threaded.max_threads == 0 || threaded.threads.size() < threaded.max_threads;
+    if (threaded.items.size() > threaded.idle && below_cap) {
+      threaded.threads.emplace_back([this, lane]() {
+        threaded_loop(lane);
+      });
+    }
+  }
+  threaded.ready.notify_one();
+}
+
+void ToolExecutor::threaded_loop(ToolLane lane) {
+  auto& threaded = this->threaded(lane);
+  std::unique_lock lock(threaded.mutex);
+  while (true) {
+    if (!threaded.items.empty()) {
+      Item item = std::move(threaded.items.front());
+      threaded.items.pop_front();
+      lock.unlock();
+      execute(lane, item);
+      lock.lock();
+      continue;
+    }
+    if (threaded.stopping) return;
+    threaded.idle++;
+    threaded.ready.wait(lock);
+    threaded.idle--;
+  }
+}
+
+void ToolExecutor::stop_threaded(ThreadedLane& threaded) {
+  {
+    std::lock_guard lock(threaded.mutex);
+    threaded.stopping = true;
+  }
+  threaded.ready.notify_all();
+  // Queued tasks may still start threads while the first ones are joined
+  while (true) {
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard lock(threaded.mutex);
+      threads.swap(threaded.threads);
+    }
+    if (threads.empty()) break;
+    for (auto& thread : threads) thread.join();
+  }
+}
+
+void ToolExecutor::execute(ToolLane lane, Item& item) {
+  auto& counters = counters_[static_cast<size_t>(lane)];
+  counters.queued--;
+  counters.running++;
+  counters.started++;
+  auto wait = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - item.queued_at).count();
+  counters.total_wait_us += wait;
+  raise_max(counters.max_wait_us, wait);
+
+  try {
+    item.task();
+  } catch (const std::exception& e) {
+    spdlog::error("[ToolExecutor] Task failed: {}", e.what());
+  } catch (...) {
+    spdlog::error("[ToolExecutor] Task failed");
+  }
+
+  counters.running--;
+  counters.completed++;
+}
+
+void ToolExecutor::on_tool_done(const std::string& tool) {
+  std::vector<Limited> ready;
+  {
+    std::lock_guard lock(tools_mutex_);
+    auto& slots = tools_[tool];
+    slots.running--;
+    release_locked(slots, ready);
+  }
+  limited_ -= ready.size();
+  for (auto& limited : ready) dispatch(limited.lane, std::move(limited.task));
+}
+
+void ToolExecutor::release_locked(ToolSlots& slots, std::vector<Limited>& ready) {
+  while (!slots.waiting.empty() && (slots.limit == 0 || slots.running < slots.limit)) {
+    ready.push_back(std::move(slots.waiting.front()));
+    slots.waiting.pop_front();
+    slots.running++;
+  }
+}
+
+}  // namespace agent
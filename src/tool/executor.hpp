@@ -0,0 +1,205 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace agent {
+
+// Which threads a tool task runs on
+enum class ToolLane {
+  Compute = 0,   // Short CPU and disk work (read, grep, glob, edit): one thread per core
+  Blocking = 1,  // Work that waits on something else (bash, MCP calls): kept off the compute threads
+  Waiting = 2,   // Waits for a person (questions), for as long as they take: never queued behind a cap
+};
+
+constexpr size_t kToolLaneCount = 3;
+
+struct ToolExecutorOptions {
+  size_t compute_threads = 0;    // 0 = one per hardware thread
+  size_t blocking_threads = 32;  // Started on demand, up to this many
+};
+
+struct ToolLaneStats {
+  uint64_t submitted = 0;
+  uint64_t started = 0;
+  uint64_t completed = 0;
+  uint64_t stolen = 0;    // Compute tasks run by a thread other than the one they were queued on
+  size_t queued = 0;      // Currently waiting for a thread
+  size_t max_queued = 0;  // High-water mark of queued
+  size_t running = 0;
+  size_t threads = 0;
+  std::chrono::microseconds total_wait{0};
+  std::chrono::microseconds max_wait{0};
+
+  std::chrono::microseconds average_wait() const {
+    return started ? total_wait / static_cast<int64_t>(started) : std::chrono::microseconds{0};
+  }
+};
+
+struct ToolExecutorStats {
+  std::array<ToolLaneStats, kToolLaneCount> lanes;
+  uint64_t limited_total = 0;  // Tasks that had to wait for their tool's limit
+  size_t limited = 0;          // Currently waiting for their tool's limit
+
+  const ToolLaneStats& operator[](ToolLane lane) const {
+    return lanes[static_cast<size_t>(lane)];
+  }
+};
+
+// Shared thread pool for tool execution, in place of a thread per call. The compute lane has a fixed
+// set of threads, each with its own deque: a thread runs its newest task first and, when out of work,
+// steals the oldest task of another. The blocking lane is a FIFO served by threads started as needed
+// up to a cap, so long waits (a 2 minute bash command) never hold a compute thread. The waiting lane works
+// the same way without the cap: its tasks hold a thread but no CPU, and an unanswered question must not
+// keep a bash command from starting. A tool may also be capped at a number of running tasks; the rest
+// wait in order for one of its tasks to finish.
+//
+// Tasks on the compute lane must not block on other compute tasks; use parallel_for to fan out.
+class ToolExecutor {
+ public:
+  using Task = std::function<void()>;
+
+  static ToolExecutor& instance();
+
+  explicit ToolExecutor(ToolExecutorOptions options = {});
+
+  // Runs what is queued, then joins the threads
+  ~ToolExecutor();
+
+  ToolExecutor(const ToolExecutor&) = delete;
+  ToolExecutor& operator=(const ToolExecutor&) = delete;
+
+  // Queue task for tool on lane
+  void submit(const std::string& tool, ToolLane lane, Task task);
+
+  // submit() fn, delivering its result (or exception) through the returned future
+  template <typename Fn>
+  std::future<std::invoke_result_t<std::decay_t<Fn>&>> run(const std::string& tool, ToolLane lane, Fn&& fn) {
+    using Result = std::invoke_result_t<std::decay_t<Fn>&>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+    auto future = task->get_future();
+    submit(tool, lane, [task]() {
+      (*task)();
+    });
+    return future;
+  }
+
+  // run(), then on_done on the same thread once the result is set, so a waiter can be resumed instead of polling
+  template <typename Fn>
+  std::future<std::invoke_result_t<std::decay_t<Fn>&>> run(const std::string& tool, ToolLane lane, Fn&& fn, std::function<void()> on_done) {
+    using Result = std::invoke_result_t<std::decay_t<Fn>&>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+    auto future = task->get_future();
+    submit(tool, lane, [task, on_done = std::move(on_done)]() {
+      (*task)();
+      if (on_done) on_done();
+    });
+    return future;
+  }
+
+  // Call body(i) for every i below count across the compute lane, returning once all calls have
+  // finished. The calling thread takes indices as well, so it never waits on a queue and may be a
+  // compute task itself. The first exception thrown by body is rethrown here.
+  void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+  // Running tasks of tool at most (0 = unlimited)
+  void set_tool_limit(const std::string& tool, size_t max_running);
+
+  ToolExecutorStats stats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Item {
+    Task task;
+    Clock::time_point queued_at;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Item> items;
+    std::thread thread;
+  };
+
+  struct LaneCounters {
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> stolen{0};
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> max_queued{0};
+    std::atomic<size_t> running{0};
+    std::atomic<int64_t> total_wait_us{0};
+    std::atomic<int64_t> max_wait_us{0};
+  };
+
+  // FIFO served by threads started as needed, up to max_threads (0 = no limit), and kept for reuse
+  struct ThreadedLane {
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Item> items;
+    std::vector<std::thread> threads;
+    size_t max_threads = 0;
+    size_t idle = 0;
+    bool stopping = false;
+  };
+
+  struct Limited {
+    ToolLane lane;
+    Task task;
+  };
+
+  struct ToolSlots {
+    size_t limit = 0;
+    size_t running = 0;
+    std::deque<Limited> waiting;
+  };
+
+  void dispatch(ToolLane lane, Task task);
+  void push_compute(Item item);
+  bool take_compute(size_t self, Item& item);
+  void compute_loop(size_t self);
+  ThreadedLane& threaded(ToolLane lane);
+  const ThreadedLane& threaded(ToolLane lane) const;
+  void push_threaded(ToolLane lane, Item item);
+  void threaded_loop(ToolLane lane);
+  void stop_threaded(ThreadedLane& threaded);
+  void execute(ToolLane lane, Item& item);
+  void on_tool_done(const std::string& tool);
+  static void release_locked(ToolSlots& slots, std::vector<Limited>& ready);
+
+  ToolExecutorOptions options_;
+
+  // Compute lane. pending_ counts queued items across all deques; idle threads sleep until it is nonzero.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_{0};
+  std::atomic<size_t> pending_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+
+  ThreadedLane blocking_;
+  ThreadedLane waiting_;
+
+  std::mutex tools_mutex_;
+  std::map<std::string, ToolSlots> tools_;
+  std::atomic<uint64_t> limited_total_{0};
+  std::atomic<size_t> limited_{0};
+
+  std::array<LaneCounters, kToolLaneCount> counters_;
+};
+
+}  // namespace agent
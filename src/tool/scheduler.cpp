@@ -0,0 +1,42 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+namespace agent {
+
+ToolCallSchedule::ToolCallSchedule(const std::vector<ToolAccess>& calls)
+    : dependencies_(calls.size()), dependents_(calls.size()), unfinished_dependencies_(calls.size(), 0), states_(calls.size(), State::Waiting) {
+  std::vector<size_t> depth(calls.size(), 1);
+  for (size_t i = 0; i < calls.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (!calls[i].conflicts_with(calls[j])) continue;
+      dependencies_[i].push_back(j);
+      dependents_[j].push_back(i);
+      depth[i] = std::max(depth[i], depth[j] + 1);
+    }
+    unfinished_dependencies_[i] = dependencies_[i].size();
+    critical_path_ = std::max(critical_path_, depth[i]);
+  }
+}
+
+std::vector<size_t> ToolCallSchedule::take_ready() {
+  std::vector<size_t> ready;
+  for (size_t i = 0; i < size(); ++i) {
+    if (states_[i] != State::Waiting || unfinished_dependencies_[i] > 0) continue;
+    states_[i] = State::Running;
+    ready.push_back(i);
+  }
+  running_ += ready.size();
+  max_running_ = std::max(max_running_, running_);
+  return ready;
+}
+
+void ToolCallSchedule::finish(size_t call) {
+  if (states_[call] == State::Finished) return;
+  if (states_[call] == State::Running) running_--;
+  states_[call] = State::Finished;
+  finished_++;
+  for (size_t dependent : dependents_[call]) unfinished_dependencies_[dependent]--;
+}
+
+}  // namespace agent
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "tool.hpp"
+
+namespace agent {
+
+// Order for the tool calls of one response. Each call waits for every earlier call it conflicts with
+// (ToolAccess::conflicts_with), so calls that touch different files run together and conflicting ones
+// run in the order the model gave them. Not thread-safe: the session drives it from its executor.
+class ToolCallSchedule {
+ public:
+  explicit ToolCallSchedule(const std::vector<ToolAccess>& calls);
+
+  size_t size() const {
+    return dependencies_.size();
+  }
+
+  // Earlier calls that call waits for
+  const std::vector<size_t>& dependencies(size_t call) const {
+    return dependencies_[call];
+  }
+
+  // Calls not started yet whose dependencies have all finished, in call order; marks them started
+  std::vector<size_t> take_ready();
+
+  void finish(size_t call);
+
+  bool finished() const {
+    return finished_ == size();
+  }
+
+  // Calls in the longest chain of dependent calls: the fewest rounds the batch can run in
+  size_t critical_path() const {
+    return critical_path_;
+  }
+
+  // Most calls started and not finished at once so far
+  size_t max_running() const {
+    return max_running_;
+  }
+
+ private:
+  enum class State { Waiting, Running, Finished };
+
+  std::vector<std::vector<size_t>> dependencies_;
+  std::vector<std::vector<size_t>> dependents_;
+  std::vector<size_t> unfinished_dependencies_;
+  std::vector<State> states_;
+  size_t finished_ = 0;
+  size_t running_ = 0;
+  size_t max_running_ = 0;
+  size_t critical_path_ = 0;
+};
+
+}  // namespace agent
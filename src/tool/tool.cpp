@@ -29,6 +29,60 @@ json ParameterSchema::to_json_schema() const {
   return schema;
 }
 
+ToolAccess ToolAccess::reading(const std::string& path, const std::string& working_dir) {
+  ToolAccess access;
+  access.reads.push_back(resolve(path, working_dir));
+  return access;
+}
+
+ToolAccess ToolAccess::writing(const std::string& path, const std::string& working_dir) {
+  ToolAccess access;
+  access.writes.push_back(resolve(path, working_dir));
+  return access;
+}
+
+ToolAccess ToolAccess::unknown() {
+  ToolAccess access;
+  access.opaque = true;
+  return access;
+}
+
+namespace {
+
+// a is b or a directory containing it
+bool covers(const std::string& a, const std::string& b) {
+  if (b.size() < a.size() || b.compare(0, a.size(), a) != 0) return false;
+  return b.size() == a.size() || a.back() == '/' || b[a.size()] == '/';
+}
+
+bool overlaps(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+  for (const auto& x : a) {
+    for (const auto& y : b) {
+      if (covers(x, y) || covers(y, x)) return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool ToolAccess::conflicts_with(const ToolAccess& other) const {
+  if (opaque || other.opaque) return true;
+  return overlaps(writes, other.writes) || overlaps(writes, other.reads) || overlaps(reads, other.writes);
+}
+
+std::string ToolAccess::resolve(const std::string& path, const std::string& working_dir) {
+  fs::path resolved = path;
+  if (!resolved.is_absolute()) resolved = fs::path(working_dir) / resolved;
+  auto normal = resolved.lexically_normal().generic_string();
+  while (normal.size() > 1 && normal.back() == '/') normal.pop_back();
+  return normal;
+}
+
+ToolAccess Tool::access(const json&, const ToolContext& ctx) const {
+  return is_read_only() ? ToolAccess::reading("/", ctx.working_dir) : ToolAccess::unknown();
+}
+
 // Tool to JSON schema
 json Tool::to_json_schema() const {
   json schema;
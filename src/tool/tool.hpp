@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <future>
 #include <map>
@@ -12,6 +13,7 @@
 #include "core/config.hpp"
 #include "core/message.hpp"
 #include "core/types.hpp"
+#include "executor.hpp"
 
 namespace agent {
 
@@ -38,6 +40,12 @@ struct SubagentEvent {
   bool is_error = false;
 };
 
+// How a tool call tells the session that its result is ready, so the session is resumed rather than polling
+struct ToolCompletion {
+  std::function<void()> notify;      // Callable from any thread
+  std::atomic<bool> claimed{false};  // The tool calls notify itself; otherwise the session waits on the future
+};
+
 // Tool execution context
 struct ToolContext {
   SessionId session_id;
@@ -61,6 +69,30 @@ struct ToolContext {
 
   // Question handler callback (for Question tool)
   std::function<std::future<QuestionResponse>(const QuestionInfo& info)> question_handler;
+
+  // Pool tools run their work on; unset means the shared one
+  ToolExecutor* executor = nullptr;
+
+  ToolExecutor& tool_executor() const {
+    return executor ? *executor : ToolExecutor::instance();
+  }
+
+  // Set by the session for each call; null outside one
+  std::shared_ptr<ToolCompletion> completion;
+
+  // For a tool that completes its own future: what to call right after setting the result. Tells the
+  // session it need not wait on the future.
+  std::function<void()> claim_completion() const {
+    if (!completion) return [] {};
+    completion->claimed = true;
+    return completion->notify;
+  }
+
+  // Run fn for tool on lane of tool_executor(), notifying the session once the result is set
+  template <typename Fn>
+  auto run(const std::string& tool, ToolLane lane, Fn&& fn) const {
+    return tool_executor().run(tool, lane, std::forward<Fn>(fn), claim_completion());
+  }
 };
 
 // Tool execution result
@@ -84,6 +116,24 @@ struct ToolResult {
   }
 };
 
+// What a tool call reads and writes, so that calls touching the same files run in the order the model
+// gave them while the others run together
+struct ToolAccess {
+  std::vector<std::string> reads;  // Absolute, normalized paths; a directory covers everything under it
+  std::vector<std::string> writes;
+  bool opaque = false;  // Side effects unknown (bash, MCP, subagents): ordered against every other call
+
+  static ToolAccess reading(const std::string& path, const std::string& working_dir);
+  static ToolAccess writing(const std::string& path, const std::string& working_dir);
+  static ToolAccess unknown();
+
+  // One writes what the other reads or writes, or either is opaque
+  bool conflicts_with(const ToolAccess& other) const;
+
+  // path made absolute against working_dir, without "." and ".." or a trailing separator
+  static std::string resolve(const std::string& path, const std::string& working_dir);
+};
+
 // Parameter schema (simplified JSON Schema)
 struct ParameterSchema {
   std::string name;
@@ -112,6 +162,15 @@ class Tool {
   // Execution
   virtual std::future<ToolResult> execute(const json& args, const ToolContext& ctx) = 0;
 
+  // No side effects (only reads), so it may start before the response that requested it has finished
+  virtual bool is_read_only() const {
+    return false;
+  }
+
+  // What a call with args reads and writes. By default a read-only tool reads everything and any
+  // other tool is opaque.
+  virtual ToolAccess access(const json& args, const ToolContext& ctx) const;
+
   // Generate JSON Schema for tool
   json to_json_schema() const;
 
@@ -483,3 +483,24 @@ TEST_F(GrepToolTest, WithIncludeFilter) {
   EXPECT_NE(result.output.find("a.cpp"), std::string::npos);
   EXPECT_EQ(result.output.find("b.txt"), std::string::npos);
 }
+
+TEST_F(GrepToolTest, KeepsWalkOrderAcrossBatches) {
+  // More files than one batch, two matches each: the first 100 matches in walk order
+  for (int i = 0; i < 150; ++i) tmp_.create_file("dir" + std::to_string(i % 7) + "/f" + std::to_string(i) + ".txt", "needle 1\nhay\nneedle 2\n");
+  std::string expected;
+  size_t count = 0;
+  for (const auto& entry : fs::recursive_directory_iterator(tmp_.path())) {
+    if (!entry.is_regular_file()) continue;
+    auto rel = fs::relative(entry.path(), tmp_.path()).string();
+    for (int line : {1, 3}) {
+      if (count++ < 100) expected += rel + ":" + std::to_string(line) + ": needle " + std::to_string(line == 1 ? 1 : 2) + "\n";
+    }
+  }
+
+  auto ctx = make_context(tmp_.str());
+  auto result = tool_.execute({{"pattern", "needle"}, {"path", tmp_.str()}}, ctx).get();
+
+  EXPECT_FALSE(result.is_error);
+  EXPECT_EQ(result.output.substr(0, expected.size()), expected);
+  EXPECT_NE(result.output.find("results truncated"), std::string::npos);
+}
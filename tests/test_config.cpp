@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <filesystem>
+#include <fstream>
 
 #include "core/config.hpp"
 
@@ -69,6 +70,79 @@ TEST(ConfigTest, ContextSettings) {
   EXPECT_EQ(config.context.prune_minimum_tokens, 20000);
   EXPECT_EQ(config.context.truncate_max_lines, 2000u);
   EXPECT_EQ(config.context.truncate_max_bytes, 51200u);
+  EXPECT_EQ(config.context.prune_mode, PruneMode::Eager);
+  EXPECT_EQ(config.context.prune_epoch_tokens, 60000);
+  EXPECT_TRUE(config.prompt_cache.enabled);
+}
+
+TEST(ConfigTest, CacheSettingsRoundTrip) {
+  Config config;
+  config.context.prune_mode = PruneMode::CacheAware;
+  config.context.prune_epoch_tokens = 12345;
+  config.prompt_cache.enabled = false;
+
+  auto tmp_path = fs::temp_directory_path() / "test_cache_settings_config.json";
+  config.save(tmp_path);
+  auto loaded = Config::load(tmp_path);
+  fs::remove(tmp_path);
+
+  EXPECT_EQ(loaded.context.prune_mode, PruneMode::CacheAware);
+  EXPECT_EQ(loaded.context.prune_epoch_tokens, 12345);
+  EXPECT_FALSE(loaded.prompt_cache.enabled);
+}
+
+TEST(ConfigTest, UnknownPruneModeFallsBackToEager) {
+  auto tmp_path = fs::temp_directory_path() / "test_prune_mode_config.json";
+  {
+    std::ofstream file(tmp_path);
+    file << R"({"context": {"prune_mode": "aggressive"}})";
+  }
+  auto loaded = Config::load(tmp_path);
+  fs::remove(tmp_path);
+
+  EXPECT_EQ(loaded.context.prune_mode, PruneMode::Eager);
+  EXPECT_EQ(prune_mode_from_string("cache_aware"), PruneMode::CacheAware);
+  EXPECT_FALSE(prune_mode_from_string("aggressive").has_value());
+}
+
+TEST(ConfigTest, ReplaySettingsRoundTrip) {
+  Config config;
+  EXPECT_TRUE(config.replay.mode.empty());
+  config.replay.mode = "replay";
+  config.replay.cassette = "/tmp/session.cassette.json";
+  config.replay.pacing = "injected";
+  config.replay.first_token_ms = 400;
+  config.replay.event_interval_ms = 20;
+  config.replay.jitter_ms = 5;
+
+  auto tmp_path = fs::temp_directory_path() / "test_replay_settings_config.json";
+  config.save(tmp_path);
+  auto loaded = Config::load(tmp_path);
+  fs::remove(tmp_path);
+
+  EXPECT_EQ(loaded.replay.mode, "replay");
+  EXPECT_EQ(loaded.replay.cassette, "/tmp/session.cassette.json");
+  EXPECT_EQ(loaded.replay.pacing, "injected");
+  EXPECT_EQ(loaded.replay.first_token_ms, 400);
+  EXPECT_EQ(loaded.replay.event_interval_ms, 20);
+  EXPECT_EQ(loaded.replay.jitter_ms, 5);
+}
+
+TEST(ConfigTest, ToolLimitsRoundTrip) {
+  Config config;
+  EXPECT_EQ(config.tools.limits["bash"], 4u);
+  EXPECT_EQ(config.tools.limits["question"], 1u);
+  config.tools.limits["grep"] = 2;
+  config.tools.limits["bash"] = 0;
+
+  auto tmp_path = fs::temp_directory_path() / "test_tool_limits_config.json";
+  config.save(tmp_path);
+  auto loaded = Config::load(tmp_path);
+  fs::remove(tmp_path);
+
+  EXPECT_EQ(loaded.tools.limits["grep"], 2u);
+  EXPECT_EQ(loaded.tools.limits["bash"], 0u);
+  EXPECT_EQ(loaded.tools.limits["question"], 1u);
 }
 
 // --- ConfigPathsTest ---
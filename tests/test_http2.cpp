@@ -0,0 +1,595 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <future>
+#include <thread>
+
+#include "net/dns_cache.hpp"
+#include "net/hpack.hpp"
+#include "net/http2.hpp"
+#include "net/http_client.hpp"
+#include "test_http2_server.hpp"
+#include "test_http_server.hpp"
+#include "test_tls_proxy.hpp"
+
+using namespace agent::net;
+
+namespace {
+
+std::string from_hex(const std::string& hex) {
+  std::string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    out += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+  }
+  return out;
+}
+
+std::string to_hex(std::string_view data) {
+  static const char* digits = "0123456789abcdef";
+  std::string out;
+  for (unsigned char c : data) {
+    out += digits[c >> 4];
+    out += digits[c & 0xf];
+  }
+  return out;
+}
+
+}  // namespace
+
+// ============================================================
+// HPACK 测试 (RFC 7541 附录 C 向量)
+// ============================================================
+
+TEST(HpackTest, IntegerRoundTrip) {
+  // C.1.2: 1337 with a 5-bit prefix
+  std::string out;
+  hpack::encode_integer(out, 1337, 5, 0);
+  EXPECT_EQ(to_hex(out), "1f9a0a");
+
+  for (uint64_t value : {0ull, 30ull, 31ull, 127ull, 128ull, 1337ull, 1ull << 31}) {
+    std::string encoded;
+    hpack::encode_integer(encoded, value, 7, 0x80);
+    std::string_view in(encoded);
+    uint64_t decoded = 0;
+    ASSERT_TRUE(hpack::decode_integer(in, 7, decoded));
+    EXPECT_EQ(decoded, value);
+    EXPECT_TRUE(in.empty());
+  }
+}
+
+TEST(HpackTest, HuffmanVectors) {
+  EXPECT_EQ(to_hex(hpack::huffman_encode("www.example.com")), "f1e3c2e5f23a6ba0ab90f4ff");
+  EXPECT_EQ(to_hex(hpack::huffman_encode("no-cache")), "a8eb10649cbf");
+  EXPECT_EQ(hpack::huffman_encoded_size("www.example.com"), 12u);
+
+  std::string decoded;
+  ASSERT_TRUE(hpack::huffman_decode(from_hex("f1e3c2e5f23a6ba0ab90f4ff"), decoded));
+  EXPECT_EQ(decoded, "www.example.com");
+
+  std::string all;
+  for (int c = 0; c < 256; ++c) all += static_cast<char>(c);
+  decoded.clear();
+  ASSERT_TRUE(hpack::huffman_decode(hpack::huffman_encode(all), decoded));
+  EXPECT_EQ(decoded, all);
+}
+
+TEST(HpackTest, DecodesRfcRequestBlocks) {
+  hpack::Decoder decoder;
+  hpack::HeaderList headers;
+
+  // C.4.1
+  ASSERT_TRUE(decoder.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), headers));
+  hpack::HeaderList expected = {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+  EXPECT_EQ(headers, expected);
+
+  // C.4.2 reuses the dynamic table entry added above
+  headers.clear();
+  ASSERT_TRUE(decoder.decode(from_hex("828684be5886a8eb10649cbf"), headers));
+  expected.push_back({"cache-control", "no-cache"});
+  EXPECT_EQ(headers, expected);
+}
+
+TEST(HpackTest, DecodesLiteralWithIndexing) {
+  // C.2.1
+  hpack::Decoder decoder;
+  hpack::HeaderList headers;
+  ASSERT_TRUE(decoder.decode(from_hex("400a637573746f6d2d6b65790d637573746f6d2d686561646572"), headers));
+  ASSERT_EQ(headers.size(), 1u);
+  EXPECT_EQ(headers[0].name, "custom-key");
+  EXPECT_EQ(headers[0].value, "custom-header");
+}
+
+TEST(HpackTest, RejectsInvalidIndex) {
+  hpack::Decoder decoder;
+  hpack::HeaderList headers;
+  EXPECT_FALSE(decoder.decode(from_hex("ff00"), headers));
+}
+
+TEST(HpackTest, EncoderRoundTripUsesDynamicTable) {
+  hpack::Encoder encoder;
+  hpack::Decoder decoder;
+  hpack::HeaderList headers = {{":method", "POST"},
+                               {":scheme", "https"},
+                               {":path", "/v1/messages"},
+                               {":authority", "api.anthropic.com"},
+                               {"content-type", "application/json"},
+                               {"anthropic-version", "2023-06-01"},
+                               {"x-api-key", "secret"}};
+
+  auto first = encoder.encode(headers);
+  auto second = encoder.encode(headers);
+  EXPECT_LT(second.size(), first.size() / 2);
+
+  for (const auto& block : {first, second}) {
+    hpack::HeaderList decoded;
+    ASSERT_TRUE(decoder.decode(block, decoded));
+    EXPECT_EQ(decoded, headers);
+  }
+
+  // The api key is sent as never-indexed, so its (Huffman-coded) value is repeated in every block
+  EXPECT_NE(second.find(hpack::huffman_encode("secret")), std::string::npos);
+}
+
+TEST(HpackTest, TableSizeUpdate) {
+  hpack::Encoder encoder;
+  hpack::Decoder decoder;
+  hpack::HeaderList headers = {{"x-custom", "value"}};
+  hpack::HeaderList decoded;
+  ASSERT_TRUE(decoder.decode(encoder.encode(headers), decoded));
+
+  encoder.set_max_table_size(0);
+  auto block = encoder.encode(headers);
+  EXPECT_EQ(static_cast<uint8_t>(block[0]), 0x20);
+  decoded.clear();
+  ASSERT_TRUE(decoder.decode(block, decoded));
+  EXPECT_EQ(decoded, headers);
+}
+
+// ============================================================
+// HTTP/2 帧测试
+// ============================================================
+
+TEST(Http2FrameTest, HeaderRoundTrip) {
+  std::string out;
+  http2::append_frame(out, http2::FrameType::Headers, http2::flags::kEndHeaders, 5, "abc");
+  ASSERT_EQ(out.size(), http2::kFrameHeaderSize + 3);
+  EXPECT_EQ(to_hex(out.substr(0, 9)), "000003010400000005");
+
+  auto header = http2::parse_frame_header(reinterpret_cast<const uint8_t*>(out.data()));
+  EXPECT_EQ(header.length, 3u);
+  EXPECT_EQ(header.type, http2::FrameType::Headers);
+  EXPECT_EQ(header.flags, http2::flags::kEndHeaders);
+  EXPECT_EQ(header.stream_id, 5u);
+}
+
+TEST(Http2FrameTest, StripPadding) {
+  http2::FrameHeader header;
+  header.type = http2::FrameType::Data;
+  header.flags = http2::flags::kPadded;
+  std::string payload = std::string("\x02", 1) + "data" + std::string(2, '\0');
+  header.length = static_cast<uint32_t>(payload.size());
+  std::string_view view(payload);
+  ASSERT_TRUE(http2::strip_padding(header, view));
+  EXPECT_EQ(view, "data");
+
+  std::string bad = std::string("\x09", 1) + "data";
+  header.length = static_cast<uint32_t>(bad.size());
+  view = bad;
+  EXPECT_FALSE(http2::strip_padding(header, view));
+}
+
+// ============================================================
+// HttpClient HTTP/2 测试
+// ============================================================
+
+class HttpClientHttp2Test : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    io_thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  void TearDown() override {
+    client_.reset();
+    work_.reset();
+    io_thread_.join();
+  }
+
+  HttpOptions h2_options(const std::string& method = "GET", const std::string& body = "") {
+    HttpOptions options;
+    options.method = method;
+    options.body = body;
+    options.version = HttpVersion::Http2PriorKnowledge;
+    return options;
+  }
+
+  asio::io_context io_ctx_;
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_{asio::make_work_guard(io_ctx_)};
+  std::unique_ptr<HttpClient> client_ = std::make_unique<HttpClient>(io_ctx_);
+  std::thread io_thread_;
+};
+
+TEST_F(HttpClientHttp2Test, GetAndPost) {
+  TestHttp2Server server([](const TestHttp2Server::Request& request) {
+    TestHttp2Server::Response response;
+    response.headers = {{"content-type", "text/plain"}};
+    response.body = request.header(":method") + " " + request.header(":path") + " " + request.header("x-test") + " " + request.body;
+    return response;
+  });
+
+  auto options = h2_options();
+  options.headers["X-Test"] = "yes";
+  auto response = client_->request(server.url("/get?q=1"), options).get();
+  EXPECT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.status_code, 200);
+  EXPECT_EQ(response.headers["content-type"], "text/plain");
+  EXPECT_EQ(response.body, "GET /get?q=1 yes ");
+
+  response = client_->request(server.url("/post"), h2_options("POST", "payload")).get();
+  EXPECT_EQ(response.body, "POST /post  payload");
+
+  EXPECT_EQ(server.connections(), 1);
+  auto stats = client_->pool_stats();
+  EXPECT_EQ(stats.h2_streams, 2u);
+  EXPECT_EQ(stats.h2_connections, 1u);
+  EXPECT_EQ(stats.reuse_misses, 0u);
+}
+
+TEST_F(HttpClientHttp2Test, ConcurrentRequestsShareOneConnection) {
+  // Responses are held until all three streams are open, so they must be multiplexed
+  TestHttp2Server server(
+      [](const TestHttp2Server::Request& request) {
+        TestHttp2Server::Response response;
+        response.body = request.header(":path");
+        return response;
+      },
+      3);
+
+  std::vector<std::future<HttpResponse>> futures;
+  for (int i = 0; i < 3; ++i) {
+    futures.push_back(client_->request(server.url("/" + std::to_string(i)), h2_options()));
+  }
+  for (int i = 0; i < 3; ++i) {
+    auto response = futures[i].get();
+    EXPECT_TRUE(response.error.empty()) << response.error;
+    EXPECT_EQ(response.body, "/" + std::to_string(i));
+  }
+
+  EXPECT_EQ(server.connections(), 1);
+  EXPECT_EQ(server.max_open_streams(), 3);
+}
+
+TEST_F(HttpClientHttp2Test, RespectsMaxConcurrentStreams) {
+  TestHttp2Server server(
+      [](const TestHttp2Server::Request&) {
+        TestHttp2Server::Response response;
+        response.body = "ok";
+        return response;
+      },
+      0, 1);
+
+  // Open the connection first so the server's SETTINGS are known before the burst
+  EXPECT_EQ(client_->request(server.url(), h2_options()).get().body, "ok");
+
+  std::vector<std::future<HttpResponse>> futures;
+  for (int i = 0; i < 4; ++i) futures.push_back(client_->request(server.url(), h2_options()));
+  for (auto& future : futures) EXPECT_EQ(future.get().body, "ok");
+
+  EXPECT_EQ(server.connections(), 1);
+  EXPECT_EQ(server.max_open_streams(), 1);
+}
+
+TEST_F(HttpClientHttp2Test, LargeBodiesUseFlowControl) {
+  TestHttp2Server server([](const TestHttp2Server::Request& request) {
+    TestHttp2Server::Response response;
+    response.body = std::to_string(request.body.size()) + ":" + std::string(3 * 1024 * 1024, 'r');
+    return response;
+  });
+
+  std::string body(200 * 1024, 'q');
+  auto response = client_->request(server.url("/upload"), h2_options("POST", body)).get();
+  EXPECT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.body.substr(0, 7), std::to_string(body.size()) + ":");
+  EXPECT_EQ(response.body.size(), 7 + 3 * 1024 * 1024u);
+}
+
+TEST_F(HttpClientHttp2Test, StreamingResponse) {
+  TestHttp2Server server([](const TestHttp2Server::Request&) {
+    TestHttp2Server::Response response;
+    response.headers = {{"content-type", "text/event-stream"}};
+    response.body = "data: a\n\ndata: b\n\n";
+    return response;
+  });
+
+  std::promise<std::pair<int, std::string>> done;
+  std::string received;
+  client_->request_stream(
+      server.url("/stream"), h2_options("POST", "{}"),
+      [&received](const std::string& chunk) {
+        received += chunk;
+      },
+      [&done](int status, const std::string& error) {
+        done.set_value({status, error});
+      });
+  auto [status, error] = done.get_future().get();
+  EXPECT_EQ(status, 200);
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_EQ(received, "data: a\n\ndata: b\n\n");
+}
+
+TEST_F(HttpClientHttp2Test, StreamingErrorStatus) {
+  TestHttp2Server server([](const TestHttp2Server::Request&) {
+    TestHttp2Server::Response response;
+    response.status = 429;
+    response.body = "slow down";
+    return response;
+  });
+
+  std::promise<std::pair<int, std::string>> done;
+  client_->request_stream(
+      server.url("/stream"), h2_options("POST", "{}"), [](const std::string&) {},
+      [&done](int status, const std::string& error) {
+        done.set_value({status, error});
+      });
+  auto [status, error] = done.get_future().get();
+  EXPECT_EQ(status, 429);
+  EXPECT_EQ(error, "HTTP error 429: slow down");
+}
+
+TEST_F(HttpClientHttp2Test, ClientsOnSameContextShareConnection) {
+  TestHttp2Server server([](const TestHttp2Server::Request&) {
+    TestHttp2Server::Response response;
+    response.body = "ok";
+    return response;
+  });
+
+  HttpClient other(io_ctx_);
+  EXPECT_EQ(client_->request(server.url(), h2_options()).get().body, "ok");
+  EXPECT_EQ(other.request(server.url(), h2_options()).get().body, "ok");
+  EXPECT_EQ(server.connections(), 1);
+}
+
+TEST_F(HttpClientHttp2Test, GzipResponseIsInflated) {
+  std::string body(64 * 1024, 'z');
+  std::string compressed;
+  {
+    z_stream zs{};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+    compressed.resize(deflateBound(&zs, body.size()) + 32);
+    zs.next_in = reinterpret_cast<Bytef*>(body.data());
+    zs.avail_in = static_cast<uInt>(body.size());
+    zs.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    zs.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&zs, Z_FINISH);
+    compressed.resize(zs.total_out);
+    deflateEnd(&zs);
+  }
+
+  TestHttp2Server server([&compressed](const TestHttp2Server::Request& request) {
+    TestHttp2Server::Response response;
+    if (request.header("accept-encoding") == "gzip, deflate") {
+      response.headers = {{"content-encoding", "gzip"}};
+      response.body = compressed;
+    }
+    return response;
+  });
+
+  EXPECT_EQ(client_->request(server.url(), h2_options()).get().body, body);
+
+  std::promise<std::string> done;
+  std::string received;
+  client_->request_stream_view(
+      server.url(), h2_options(),
+      [&received](std::string_view chunk) {
+        received.append(chunk);
+      },
+      [&done](int, const std::string& error) {
+        done.set_value(error);
+      });
+  EXPECT_EQ(done.get_future().get(), "");
+  EXPECT_EQ(received, body);
+}
+
+TEST_F(HttpClientHttp2Test, TimedOutRequestsAreReleased) {
+  // Holds every response, so both requests time out
+  TestHttp2Server server(
+      [](const TestHttp2Server::Request&) {
+        return TestHttp2Server::Response{};
+      },
+      100);
+
+  auto options = h2_options();
+  options.timeout = std::chrono::seconds(1);
+  auto owner = std::make_shared<int>(0);
+  std::weak_ptr<int> watched = owner;
+  std::promise<std::string> response_error;
+  std::promise<std::string> stream_error;
+  client_->request(server.url(), options, [owner, &response_error](HttpResponse response) {
+    response_error.set_value(response.error);
+  });
+  client_->request_stream_view(server.url(), options, [](std::string_view) {}, [owner, &stream_error](int, const std::string& error) {
+    stream_error.set_value(error);
+  });
+  owner.reset();
+
+  EXPECT_EQ(response_error.get_future().get(), "Request timed out");
+  EXPECT_EQ(stream_error.get_future().get(), "Request timed out");
+  // Nothing the client keeps for cancel() still holds the callbacks
+  for (int i = 0; i < 200 && !watched.expired(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_TRUE(watched.expired());
+}
+
+// ============================================================
+// TLS ALPN 协商测试
+// ============================================================
+
+TEST_F(HttpClientHttp2Test, AlpnNegotiatesHttp2) {
+  TestHttp2Server backend([](const TestHttp2Server::Request& request) {
+    TestHttp2Server::Response response;
+    response.body = "h2 " + request.header(":scheme") + " " + request.body;
+    return response;
+  });
+  TestTlsProxy proxy(backend.port(), "h2");
+  HttpClient client(io_ctx_);
+
+  // Default options: HttpVersion::Auto offers h2 and uses it when the server agrees
+  for (int i = 0; i < 2; ++i) {
+    auto response = client.post(proxy.url(), std::to_string(i)).get();
+    EXPECT_TRUE(response.error.empty()) << response.error;
+    EXPECT_EQ(response.body, "h2 https " + std::to_string(i));
+  }
+  EXPECT_EQ(proxy.negotiated(), "h2");
+  EXPECT_EQ(proxy.handshakes(), 1);
+  EXPECT_EQ(client.pool_stats().h2_streams, 2u);
+
+  std::promise<std::string> done;
+  std::string received;
+  client.request_stream_view(
+      proxy.url(), HttpOptions{},
+      [&received](std::string_view chunk) {
+        received.append(chunk);
+      },
+      [&done](int, const std::string& error) {
+        done.set_value(error);
+      });
+  EXPECT_EQ(done.get_future().get(), "");
+  EXPECT_EQ(received, "h2 https ");
+  EXPECT_EQ(proxy.handshakes(), 1);
+}
+
+TEST_F(HttpClientHttp2Test, AlpnFallsBackToHttp1) {
+  TestHttpServer backend([](const std::string& head, const std::string& body) {
+    return TestHttpServer::response(200, head.substr(head.find("HTTP/1.1"), 8) + " " + body);
+  });
+
+  for (const char* alpn : {"http/1.1", ""}) {
+    TestTlsProxy proxy(backend.port(), alpn);
+    HttpClient client(io_ctx_);
+    for (int i = 0; i < 2; ++i) {
+      auto response = client.post(proxy.url(), std::to_string(i)).get();
+      EXPECT_TRUE(response.error.empty()) << alpn << ": " << response.error;
+      EXPECT_EQ(response.body, "HTTP/1.1 " + std::to_string(i)) << alpn;
+    }
+    EXPECT_EQ(proxy.negotiated(), alpn);
+    // The connection opened for negotiation serves both requests
+    EXPECT_EQ(proxy.handshakes(), 1) << alpn;
+    auto stats = client.pool_stats();
+    EXPECT_EQ(stats.h2_streams, 0u) << alpn;
+    EXPECT_EQ(stats.reuse_hits, 2u) << alpn;
+  }
+}
+
+TEST_F(HttpClientHttp2Test, StalledHandshakeTimesOut) {
+  // Listens but never accepts: TCP connects, then the TLS handshake never completes
+  asio::io_context listener_ctx;
+  asio::ip::tcp::acceptor listener(listener_ctx, {asio::ip::make_address("127.0.0.1"), 0});
+  auto url = "https://127.0.0.1:" + std::to_string(listener.local_endpoint().port()) + "/";
+
+  // Both requests wait on the same connect, and each gives up when its own timeout fires
+  HttpOptions options;
+  options.timeout = std::chrono::seconds(1);
+  std::promise<std::string> first;
+  std::promise<std::string> second;
+  client_->request(url, options, [&first](HttpResponse response) {
+    first.set_value(response.error);
+  });
+  client_->request(url, options, [&second](HttpResponse response) {
+    second.set_value(response.error);
+  });
+  EXPECT_EQ(first.get_future().get(), "Request timed out");
+  EXPECT_EQ(second.get_future().get(), "Request timed out");
+
+  // cancel() reaches a connect in progress
+  std::promise<std::string> cancelled;
+  client_->request(url, HttpOptions{}, [&cancelled](HttpResponse response) {
+    cancelled.set_value(response.error);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  client_->cancel();
+  auto future = cancelled.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(future.get(), "Request cancelled");
+}
+
+TEST_F(HttpClientHttp2Test, CancelLeavesOtherClientsConnectWaiting) {
+  TestHttp2Server backend([](const TestHttp2Server::Request&) {
+    TestHttp2Server::Response response;
+    response.body = "ok";
+    return response;
+  });
+  TestTlsProxy proxy(backend.port(), "h2");
+
+  // A slow lookup keeps the shared connect in progress while both clients wait on it
+  DnsCache::instance().clear();
+  DnsCache::instance().set_resolver([](asio::io_context& io_ctx, const std::string&, const std::string& port, ResolveCallback callback) {
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx, std::chrono::milliseconds(300));
+    timer->async_wait([timer, port, callback](const asio::error_code&) {
+      callback({}, {{asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(std::stoi(port))}});
+    });
+  });
+
+  auto url = "https://slow-dns.test:" + std::to_string(proxy.port()) + "/";
+  HttpClient other(io_ctx_);
+  std::promise<HttpResponse> cancelled;
+  std::promise<HttpResponse> kept;
+  client_->request(url, HttpOptions{}, [&cancelled](HttpResponse response) {
+    cancelled.set_value(std::move(response));
+  });
+  other.request(url, HttpOptions{}, [&kept](HttpResponse response) {
+    kept.set_value(std::move(response));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  client_->cancel();
+
+  // Only the cancelled client's request fails; the other gets its response over the connect they shared
+  auto first = cancelled.get_future();
+  ASSERT_EQ(first.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(first.get().error, "Request cancelled");
+  auto second = kept.get_future();
+  ASSERT_EQ(second.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  auto response = second.get();
+  EXPECT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.body, "ok");
+  EXPECT_EQ(proxy.handshakes(), 1);
+
+  DnsCache::instance().set_resolver(nullptr);
+  DnsCache::instance().clear();
+}
+
+TEST(HttpClientPrivateContextTest, CacheMissKeepsContextRunning) {
+  TestHttp2Server backend([](const TestHttp2Server::Request&) {
+    TestHttp2Server::Response response;
+    response.body = "resolved";
+    return response;
+  });
+  TestTlsProxy proxy(backend.port(), "h2");
+
+  // A slow lookup on the cache's own context: HTTP/2 starts nothing on the caller's context before it connects
+  DnsCache::instance().clear();
+  DnsCache::instance().set_resolver([](asio::io_context& io_ctx, const std::string&, const std::string& port, ResolveCallback callback) {
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx, std::chrono::milliseconds(50));
+    timer->async_wait([timer, port, callback](const asio::error_code&) {
+      callback({}, {{asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(std::stoi(port))}});
+    });
+  });
+
+  {
+    // Like the MCP HTTP transport: a private context driven only until the request completes
+    asio::io_context io_ctx;
+    HttpClient client(io_ctx);
+    auto response = client.request("https://slow-dns.test:" + std::to_string(proxy.port()) + "/", HttpOptions{});
+    while (response.wait_for(std::chrono::seconds(0)) != std::future_status::ready && io_ctx.run_one_for(std::chrono::seconds(5)) > 0) {
+    }
+    bool ready = response.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    EXPECT_TRUE(ready) << "io_context ran out of work during the lookup";
+    if (ready) {
+      auto result = response.get();
+      EXPECT_TRUE(result.error.empty()) << result.error;
+      EXPECT_EQ(result.body, "resolved");
+    }
+  }
+
+  DnsCache::instance().set_resolver(nullptr);
+  DnsCache::instance().clear();
+}
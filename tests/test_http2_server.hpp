@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <asio.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "net/hpack.hpp"
+#include "net/http2.hpp"
+
+// Minimal local HTTP/2 server (cleartext, prior knowledge) for network tests.
+// Honours flow control in both directions and answers each request with the handler's response.
+class TestHttp2Server {
+ public:
+  struct Request {
+    agent::net::hpack::HeaderList headers;
+    std::string body;
+
+    std::string header(const std::string& name) const {
+      for (const auto& field : headers) {
+        if (field.name == name) return field.value;
+      }
+      return "";
+    }
+  };
+
+  struct Response {
+    int status = 200;
+    agent::net::hpack::HeaderList headers;
+    std::string body;
+  };
+
+  using Handler = std::function<Response(const Request&)>;
+
+  // hold_until: delay all responses on a connection until this many requests are outstanding on it
+  explicit TestHttp2Server(Handler handler, size_t hold_until = 0, uint32_t max_concurrent_streams = 100)
+      : handler_(std::move(handler)),
+        hold_until_(hold_until),
+        max_concurrent_streams_(max_concurrent_streams),
+        acceptor_(io_ctx_, {asio::ip::make_address("127.0.0.1"), 0}) {
+    accept();
+    thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  ~TestHttp2Server() {
+    asio::post(io_ctx_, [this]() {
+      asio::error_code ec;
+      acceptor_.close(ec);
+      io_ctx_.stop();
+    });
+    thread_.join();
+  }
+
+  unsigned short port() const {
+    return acceptor_.local_endpoint().port();
+  }
+
+  std::string url(const std::string& path = "/") const {
+    return "http://127.0.0.1:" + std::to_string(port()) + path;
+  }
+
+  int connections() const {
+    return connections_.load();
+  }
+
+  int requests() const {
+    return requests_.load();
+  }
+
+  // Highest number of streams open at once on a single connection
+  int max_open_streams() const {
+    return max_open_streams_.load();
+  }
+
+ private:
+  using FrameType = agent::net::http2::FrameType;
+
+  struct Stream {
+    Request request;
+    std::string header_block;
+    std::string outgoing;  // Response body not yet sent
+    bool responding = false;
+    int64_t send_window = agent::net::http2::kDefaultWindowSize;
+  };
+
+  struct Connection {
+    explicit Connection(asio::io_context& io_ctx) : socket(io_ctx) {}
+    asio::ip::tcp::socket socket;
+    std::array<char, 16384> read_buffer;
+    std::string input;
+    bool preface_received = false;
+    agent::net::hpack::Decoder decoder;
+    agent::net::hpack::Encoder encoder;
+    std::map<uint32_t, Stream> streams;
+    std::deque<uint32_t> held;
+    int64_t conn_send_window = agent::net::http2::kDefaultWindowSize;
+    uint32_t peer_initial_window = agent::net::http2::kDefaultWindowSize;
+    uint32_t continuation_stream = 0;
+    std::string output;
+    std::string writing;
+    bool write_in_flight = false;
+  };
+
+  void accept() {
+    auto conn = std::make_shared<Connection>(io_ctx_);
+    acceptor_.async_accept(conn->socket, [this, conn](const asio::error_code& ec) {
+      if (ec) return;
+      connections_++;
+      std::string settings;
+      settings += '\0';
+      settings += static_cast<char>(agent::net::http2::SettingId::MaxConcurrentStreams);
+      agent::net::http2::append_uint32(settings, max_concurrent_streams_);
+      agent::net::http2::append_frame(conn->output, FrameType::Settings, 0, 0, settings);
+      flush(conn);
+      read(conn);
+      accept();
+    });
+  }
+
+  void read(std::shared_ptr<Connection> conn) {
+    conn->socket.async_read_some(asio::buffer(conn->read_buffer), [this, conn](const asio::error_code& ec, size_t bytes) {
+      if (ec) return;
+      conn->input.append(conn->read_buffer.data(), bytes);
+      if (!process(conn)) return;
+      flush(conn);
+      read(conn);
+    });
+  }
+
+  bool process(const std::shared_ptr<Connection>& conn) {
+    namespace h2 = agent::net::http2;
+    if (!conn->preface_received) {
+      if (conn->input.size() < h2::kClientPreface.size()) return true;
+      if (conn->input.compare(0, h2::kClientPreface.size(), h2::kClientPreface) != 0) return false;
+      conn->input.erase(0, h2::kClientPreface.size());
+      conn->preface_received = true;
+    }
+
+    while (conn->input.size() >= h2::kFrameHeaderSize) {
+      auto header = h2::parse_frame_header(reinterpret_cast<const uint8_t*>(conn->input.data()));
+      if (conn->input.size() < h2::kFrameHeaderSize + header.length) break;
+      std::string payload_storage = conn->input.substr(h2::kFrameHeaderSize, header.length);
+      conn->input.erase(0, h2::kFrameHeaderSize + header.length);
+      std::string_view payload(payload_storage);
+      if (!handle_frame(conn, header, payload)) return false;
+    }
+    return true;
+  }
+
+  bool handle_frame(const std::shared_ptr<Connection>& conn, const agent::net::http2::FrameHeader& header, std::string_view payload) {
+    namespace h2 = agent::net::http2;
+    switch (header.type) {
+      case FrameType::Settings:
+        if (header.flags & h2::flags::kAck) return true;
+        for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+          const auto* data = reinterpret_cast<const uint8_t*>(payload.data() + i);
+          if (((data[0] << 8) | data[1]) == static_cast<int>(h2::SettingId::InitialWindowSize)) {
+            auto value = h2::read_uint32(data + 2);
+            for (auto& [id, stream] : conn->streams) stream.send_window += int64_t(value) - conn->peer_initial_window;
+            conn->peer_initial_window = value;
+          }
+        }
+        h2::append_frame(conn->output, FrameType::Settings, h2::flags::kAck, 0, {});
+        send_data(conn);
+        return true;
+
+      case FrameType::WindowUpdate: {
+        auto increment = h2::read_uint32(reinterpret_cast<const uint8_t*>(payload.data()));
+        if (header.stream_id == 0) {
+          conn->conn_send_window += increment;
+        } else if (conn->streams.count(header.stream_id)) {
+          conn->streams[header.stream_id].send_window += increment;
+        }
+        send_data(conn);
+        return true;
+      }
+
+      case FrameType::Headers: {
+        if (!h2::strip_padding(header, payload)) return false;
+        auto& stream = conn->streams[header.stream_id];
+        stream.send_window = conn->peer_initial_window;
+        stream.header_block.assign(payload);
+        max_open_streams_ = std::max<int>(max_open_streams_.load(), static_cast<int>(conn->streams.size()));
+        if (!(header.flags & h2::flags::kEndHeaders)) {
+          conn->continuation_stream = header.stream_id;
+          return true;
+        }
+        return finish_headers(conn, header.stream_id, header.flags);
+      }
+
+      case FrameType::Continuation: {
+        auto& stream = conn->streams[header.stream_id];
+        stream.header_block.append(payload);
+        if (header.flags & h2::flags::kEndHeaders) {
+          conn->continuation_stream = 0;
+          return finish_headers(conn, header.stream_id, 0);
+        }
+        return true;
+      }
+
+      case FrameType::Data: {
+        if (!h2::strip_padding(header, payload)) return false;
+        conn->streams[header.stream_id].request.body.append(payload);
+        if (header.length > 0) {
+          // Consume immediately and reopen both windows
+          std::string increment;
+          h2::append_uint32(increment, header.length);
+          h2::append_frame(conn->output, FrameType::WindowUpdate, 0, 0, increment);
+          if (!(header.flags & h2::flags::kEndStream)) h2::append_frame(conn->output, FrameType::WindowUpdate, 0, header.stream_id, increment);
+        }
+        if (header.flags & h2::flags::kEndStream) complete_request(conn, header.stream_id);
+        return true;
+      }
+
+      case FrameType::Ping:
+        if (!(header.flags & h2::flags::kAck)) h2::append_frame(conn->output, FrameType::Ping, h2::flags::kAck, 0, payload);
+        return true;
+
+      case FrameType::RstStream:
+        conn->streams.erase(header.stream_id);
+        return true;
+
+      default:
+        return true;
+    }
+  }
+
+  bool finish_headers(const std::shared_ptr<Connection>& conn, uint32_t stream_id, uint8_t flags) {
+    auto& stream = conn->streams[stream_id];
+    if (!conn->decoder.decode(stream.header_block, stream.request.headers)) return false;
+    stream.header_block.clear();
+    if (flags & agent::net::http2::flags::kEndStream) complete_request(conn, stream_id);
+    return true;
+  }
+
+  void complete_request(const std::shared_ptr<Connection>& conn, uint32_t stream_id) {
+    requests_++;
+    conn->held.push_back(stream_id);
+    if (conn->held.size() < hold_until_) return;
+    while (!conn->held.empty()) {
+      respond(conn, conn->held.front());
+      conn->held.pop_front();
+    }
+  }
+
+  void respond(const std::shared_ptr<Connection>& conn, uint32_t stream_id) {
+    namespace h2 = agent::net::http2;
+    auto it = conn->streams.find(stream_id);
+    if (it == conn->streams.end()) return;
+    auto& stream = it->second;
+    auto response = handler_(stream.request);
+
+    agent::net::hpack::HeaderList headers = {{":status", std::to_string(response.status)}};
+    headers.insert(headers.end(), response.headers.begin(), response.headers.end());
+    uint8_t flags = h2::flags::kEndHeaders | (response.body.empty() ? h2::flags::kEndStream : 0);
+    h2::append_frame(conn->output, FrameType::Headers, flags, stream_id, conn->encoder.encode(headers));
+
+    if (response.body.empty()) {
+      conn->streams.erase(it);
+      return;
+    }
+    stream.outgoing = std::move(response.body);
+    stream.responding = true;
+    send_data(conn);
+  }
+
+  // Send as much pending response data as the client's windows allow
+  void send_data(const std::shared_ptr<Connection>& conn) {
+    namespace h2 = agent::net::http2;
+    for (auto it = conn->streams.begin(); it != conn->streams.end();) {
+      auto& stream = it->second;
+      while (stream.responding && !stream.outgoing.empty() && stream.send_window > 0 && conn->conn_send_window > 0) {
+        size_t n = std::min<size_t>({stream.outgoing.size(), static_cast<size_t>(stream.send_window),
+                                     static_cast<size_t>(conn->conn_send_window), h2::kDefaultMaxFrameSize});
+        bool last = n == stream.outgoing.size();
+        h2::append_frame(conn->output, FrameType::Data, last ? h2::flags::kEndStream : 0, it->first, std::string_view(stream.outgoing).substr(0, n));
+        stream.outgoing.erase(0, n);
+        stream.send_window -= static_cast<int64_t>(n);
+        conn->conn_send_window -= static_cast<int64_t>(n);
+      }
+      bool done = stream.responding && stream.outgoing.empty();
+      it = done ? conn->streams.erase(it) : std::next(it);
+    }
+  }
+
+  void flush(std::shared_ptr<Connection> conn) {
+    if (conn->write_in_flight || conn->output.empty()) return;
+    conn->writing.swap(conn->output);
+    conn->output.clear();
+    conn->write_in_flight = true;
+    asio::async_write(conn->socket, asio::buffer(conn->writing), [this, conn](const asio::error_code& ec, size_t) {
+      conn->write_in_flight = false;
+      if (ec) return;
+      flush(conn);
+    });
+  }
+
+  Handler handler_;
+  size_t hold_until_;
+  uint32_t max_concurrent_streams_;
+  asio::io_context io_ctx_;
+  asio::ip::tcp::acceptor acceptor_;
+  std::thread thread_;
+  std::atomic<int> connections_{0};
+  std::atomic<int> requests_{0};
+  std::atomic<int> max_open_streams_{0};
+};
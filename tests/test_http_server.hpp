@@ -0,0 +1,119 @@
+#pragma once
+
+#include <asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Minimal local HTTP/1.1 server for network tests.
+// Listens on 127.0.0.1 (ephemeral port) and answers every request with the raw bytes returned by the handler.
+// Connections stay open between requests unless the response contains "Connection: close".
+class TestHttpServer {
+ public:
+  // Receives the request head (request line + headers) and body, returns a complete raw HTTP response
+  using Handler = std::function<std::string(const std::string& head, const std::string& body)>;
+
+  explicit TestHttpServer(Handler handler) : handler_(std::move(handler)), acceptor_(io_ctx_, {asio::ip::make_address("127.0.0.1"), 0}) {
+    accept();
+    thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  ~TestHttpServer() {
+    asio::post(io_ctx_, [this]() {
+      asio::error_code ec;
+      acceptor_.close(ec);
+      io_ctx_.stop();
+    });
+    thread_.join();
+  }
+
+  unsigned short port() const {
+    return acceptor_.local_endpoint().port();
+  }
+
+  std::string url(const std::string& path = "/") const {
+    return "http://127.0.0.1:" + std::to_string(port()) + path;
+  }
+
+  // Number of TCP connections accepted so far
+  int connections() const {
+    return connections_.load();
+  }
+
+  // Number of requests answered so far
+  int requests() const {
+    return requests_.load();
+  }
+
+  // Build a response with Content-Length framing
+  static std::string response(int status, const std::string& body, const std::string& extra_headers = "") {
+    return "HTTP/1.1 " + std::to_string(status) + " OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + extra_headers + "\r\n" + body;
+  }
+
+ private:
+  struct Connection {
+    explicit Connection(asio::io_context& io_ctx) : socket(io_ctx) {}
+    asio::ip::tcp::socket socket;
+    asio::streambuf buffer;
+    std::string response;
+  };
+
+  void accept() {
+    auto conn = std::make_shared<Connection>(io_ctx_);
+    acceptor_.async_accept(conn->socket, [this, conn](const asio::error_code& ec) {
+      if (ec) return;
+      connections_++;
+      read_request(conn);
+      accept();
+    });
+  }
+
+  void read_request(std::shared_ptr<Connection> conn) {
+    asio::async_read_until(conn->socket, conn->buffer, "\r\n\r\n", [this, conn](const asio::error_code& ec, size_t head_size) {
+      if (ec) return;
+      std::string head(static_cast<const char*>(conn->buffer.data().data()), head_size);
+      conn->buffer.consume(head_size);
+
+      size_t content_length = 0;
+      auto pos = head.find("Content-Length: ");
+      if (pos != std::string::npos) {
+        content_length = std::stoul(head.substr(pos + 16));
+      }
+
+      auto have = conn->buffer.size();
+      auto need = content_length > have ? content_length - have : 0;
+      asio::async_read(conn->socket, conn->buffer, asio::transfer_exactly(need), [this, conn, head, content_length](const asio::error_code& ec, size_t) {
+        if (ec) return;
+        std::string body(static_cast<const char*>(conn->buffer.data().data()), content_length);
+        conn->buffer.consume(content_length);
+        respond(conn, handler_(head, body));
+      });
+    });
+  }
+
+  void respond(std::shared_ptr<Connection> conn, std::string response) {
+    requests_++;
+    conn->response = std::move(response);
+    asio::async_write(conn->socket, asio::buffer(conn->response), [this, conn](const asio::error_code& ec, size_t) {
+      if (ec) return;
+      if (conn->response.find("Connection: close") != std::string::npos) {
+        asio::error_code ignored;
+        conn->socket.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+        conn->socket.close(ignored);
+        return;
+      }
+      read_request(conn);
+    });
+  }
+
+  Handler handler_;
+  asio::io_context io_ctx_;
+  asio::ip::tcp::acceptor acceptor_;
+  std::thread thread_;
+  std::atomic<int> connections_{0};
+  std::atomic<int> requests_{0};
+};
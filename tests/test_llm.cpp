@@ -1,8 +1,22 @@
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
 #include "llm/anthropic.hpp"
+#include "llm/event_stream.hpp"
+#include "llm/hedged.hpp"
 #include "llm/openai.hpp"
+#include "llm/partial_json.hpp"
+#include "llm/prompt_cache.hpp"
 #include "llm/provider.hpp"
+#include "llm/replay.hpp"
+#include "llm/stream_decoder.hpp"
+#include "llm/trace.hpp"
+#include "test_http_server.hpp"
 #include "tool/tool.hpp"
 
 using namespace agent;
@@ -350,6 +364,54 @@ TEST(LlmRequestTest, OpenAIFormatToolResultMessage) {
   EXPECT_TRUE(found_tool);
 }
 
+// A history with every part kind the formats convert
+static LlmRequest mixed_request() {
+  LlmRequest request;
+  request.model = "test-model";
+  request.system_prompt = "Be brief.";
+  request.max_tokens = 1024;
+  request.stop_sequences = std::vector<std::string>{"STOP"};
+  request.tools.push_back(std::make_shared<MockTool>());
+
+  request.messages.push_back(Message::system("ignored"));
+  request.messages.push_back(Message::user("Find \"cats\"\n"));
+  Message call = Message::assistant("Searching");
+  call.add_tool_call("tc_1", "mock_tool", {{"query", "cats"}});
+  request.messages.push_back(call);
+  Message result(Role::User, "");
+  result.add_tool_result("tc_1", "mock_tool", "3 cats", false);
+  request.messages.push_back(result);
+  Message image = Message::user("What is this?");
+  image.add_part(ImagePart{"data:image/png;base64,AAAA", "image/png"});
+  request.messages.push_back(image);
+  return request;
+}
+
+TEST(LlmRequestTest, SplicedBodiesMatchJsonFormats) {
+  auto request = mixed_request();
+  for (bool stream : {false, true}) {
+    auto anthropic = request.to_anthropic_format();
+    auto openai = request.to_openai_format();
+    if (stream) {
+      anthropic["stream"] = true;
+      openai["stream"] = true;
+    }
+    EXPECT_EQ(json::parse(request.to_anthropic_body(stream)), anthropic);
+    EXPECT_EQ(json::parse(request.to_openai_body(stream)), openai);
+  }
+
+  // Second build comes from the cached fragments; a changed message is picked up
+  auto cached = request.to_anthropic_body();
+  EXPECT_EQ(request.to_anthropic_body(), cached);
+  request.messages[1].add_text("more");
+  EXPECT_EQ(json::parse(request.to_anthropic_body()), request.to_anthropic_format());
+  EXPECT_EQ(json::parse(request.to_openai_body()), request.to_openai_format());
+
+  // No messages at all
+  LlmRequest empty;
+  EXPECT_EQ(json::parse(empty.to_openai_body()), empty.to_openai_format());
+}
+
 TEST(LlmRequestTest, OpenAIFormatNoOptionals) {
   LlmRequest request;
   request.model = "gpt-4o-mini";
@@ -638,3 +700,1023 @@ TEST(ModelInfoTest, OpenAIModelCount) {
     EXPECT_GT(m.max_output_tokens, 0);
   }
 }
+
+// ============================================================
+// 请求对冲测试
+// ============================================================
+
+// Replays a fixed event list after a delay on the io_context; cancel() drops the remaining events
+class DelayedProvider : public Provider {
+ public:
+  DelayedProvider(asio::io_context& io_ctx, std::string name, std::chrono::milliseconds delay, std::vector<StreamEvent> events)
+      : io_ctx_(io_ctx), name_(std::move(name)), delay_(delay), events_(std::move(events)) {}
+
+  std::string name() const override {
+    return name_;
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return {};
+  }
+
+  std::future<LlmResponse> complete(const LlmRequest&) override {
+    std::promise<LlmResponse> promise;
+    promise.set_value(LlmResponse{});
+    return promise.get_future();
+  }
+
+  void stream(const LlmRequest& request, StreamCallback callback, std::function<void()> on_complete) override {
+    streams++;
+    model = request.model;
+    timer_ = std::make_shared<asio::steady_timer>(io_ctx_, delay_);
+    timer_->async_wait([this, timer = timer_, callback, on_complete](const asio::error_code& ec) {
+      if (!ec) {
+        for (const auto& event : events_) callback(event);
+      }
+      on_complete();
+    });
+  }
+
+  void cancel() override {
+    cancels++;
+    if (timer_) timer_->cancel();
+  }
+
+  int streams = 0;
+  int cancels = 0;
+  std::string model;  // Of the last stream
+
+ private:
+  asio::io_context& io_ctx_;
+  std::string name_;
+  std::chrono::milliseconds delay_;
+  std::vector<StreamEvent> events_;
+  std::shared_ptr<asio::steady_timer> timer_;
+};
+
+struct HedgeRun {
+  std::vector<std::string> texts;
+  std::vector<std::string> errors;
+  int completions = 0;
+};
+
+static HedgeRun run_hedged(asio::io_context& io_ctx, HedgedProvider& provider, const LlmRequest& request = {}) {
+  HedgeRun run;
+  provider.stream(
+      request,
+      [&run](const StreamEvent& event) {
+        if (auto text = std::get_if<TextDelta>(&event)) run.texts.push_back(text->text);
+        if (auto error = std::get_if<StreamError>(&event)) run.errors.push_back(error->message);
+      },
+      [&run]() {
+        run.completions++;
+      });
+  io_ctx.restart();
+  io_ctx.run();
+  return run;
+}
+
+static HedgeOptions fixed_hedge(std::chrono::milliseconds delay) {
+  HedgeOptions options;
+  options.delay = delay;
+  options.adaptive = false;
+  return options;
+}
+
+TEST(HedgedProviderTest, FastPrimaryIsNotHedged) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(5), std::vector<StreamEvent>{TextDelta{"a"}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(5), std::vector<StreamEvent>{TextDelta{"b"}});
+  HedgedProvider provider(primary, backup, io_ctx, fixed_hedge(std::chrono::milliseconds(200)));
+
+  auto run = run_hedged(io_ctx, provider);
+  EXPECT_EQ(run.texts, std::vector<std::string>{"a"});
+  EXPECT_EQ(run.completions, 1);
+  EXPECT_EQ(backup->streams, 0);
+  EXPECT_EQ(provider.name(), "primary");
+
+  auto stats = provider.stats();
+  EXPECT_EQ(stats.requests, 1u);
+  EXPECT_EQ(stats.hedges, 0u);
+  EXPECT_EQ(stats.primary_wins, 1u);
+}
+
+TEST(HedgedProviderTest, SlowPrimaryLosesToBackup) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(500),
+                                                   std::vector<StreamEvent>{TextDelta{"slow"}, FinishStep{FinishReason::Stop, {}}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(5),
+                                                  std::vector<StreamEvent>{TextDelta{"fast"}, FinishStep{FinishReason::Stop, {}}});
+  HedgedProvider provider(primary, backup, io_ctx, fixed_hedge(std::chrono::milliseconds(20)));
+
+  auto start = std::chrono::steady_clock::now();
+  auto run = run_hedged(io_ctx, provider);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // The loser is cancelled and none of its events reach the caller
+  EXPECT_EQ(run.texts, std::vector<std::string>{"fast"});
+  EXPECT_EQ(run.completions, 1);
+  EXPECT_EQ(primary->cancels, 1);
+  EXPECT_LT(elapsed, std::chrono::milliseconds(400));
+
+  auto stats = provider.stats();
+  EXPECT_EQ(stats.hedges, 1u);
+  EXPECT_EQ(stats.hedge_wins, 1u);
+  EXPECT_EQ(stats.primary_wins, 0u);
+}
+
+TEST(HedgedProviderTest, PrimaryErrorWaitsForBackup) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(40),
+                                                   std::vector<StreamEvent>{StreamError{"HTTP error 529: overloaded", true}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(40), std::vector<StreamEvent>{TextDelta{"ok"}});
+  HedgedProvider provider(primary, backup, io_ctx, fixed_hedge(std::chrono::milliseconds(10)));
+
+  auto run = run_hedged(io_ctx, provider);
+  EXPECT_EQ(run.texts, std::vector<std::string>{"ok"});
+  EXPECT_TRUE(run.errors.empty());
+  EXPECT_EQ(run.completions, 1);
+}
+
+TEST(HedgedProviderTest, BothLegsFailForwardsError) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(30),
+                                                   std::vector<StreamEvent>{StreamError{"primary failed", false}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(30),
+                                                  std::vector<StreamEvent>{StreamError{"backup failed", false}});
+  HedgedProvider provider(primary, backup, io_ctx, fixed_hedge(std::chrono::milliseconds(10)));
+
+  auto run = run_hedged(io_ctx, provider);
+  EXPECT_TRUE(run.texts.empty());
+  EXPECT_EQ(run.errors, std::vector<std::string>{"backup failed"});
+  EXPECT_EQ(run.completions, 1);
+}
+
+TEST(HedgedProviderTest, AdaptiveThreshold) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(1), std::vector<StreamEvent>{TextDelta{"a"}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(1), std::vector<StreamEvent>{TextDelta{"b"}});
+  HedgeOptions options;
+  options.delay = std::chrono::milliseconds(5000);
+  options.min_samples = 3;
+  options.min_delay = std::chrono::milliseconds(50);
+  HedgedProvider provider(primary, backup, io_ctx, options);
+
+  for (int i = 0; i < 3; ++i) run_hedged(io_ctx, provider);
+  EXPECT_EQ(provider.stats().threshold, std::chrono::milliseconds(5000));
+
+  // With enough fast samples the threshold drops to the percentile, clamped to min_delay
+  run_hedged(io_ctx, provider);
+  EXPECT_EQ(provider.stats().threshold, std::chrono::milliseconds(50));
+}
+
+TEST(HedgedProviderTest, BackupModel) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(200), std::vector<StreamEvent>{TextDelta{"a"}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(5), std::vector<StreamEvent>{TextDelta{"b"}});
+  auto options = fixed_hedge(std::chrono::milliseconds(10));
+  options.backup_model = "backup-model";
+  HedgedProvider provider(primary, backup, io_ctx, options);
+
+  LlmRequest request;
+  request.model = "primary-model";
+  auto run = run_hedged(io_ctx, provider, request);
+  EXPECT_EQ(run.texts, std::vector<std::string>{"b"});
+  EXPECT_EQ(primary->model, "primary-model");
+  EXPECT_EQ(backup->model, "backup-model");
+}
+
+TEST(HedgedProviderTest, BackupWinsSamplePrimaryLatency) {
+  asio::io_context io_ctx;
+  auto primary = std::make_shared<DelayedProvider>(io_ctx, "primary", std::chrono::milliseconds(300), std::vector<StreamEvent>{TextDelta{"a"}});
+  auto backup = std::make_shared<DelayedProvider>(io_ctx, "backup", std::chrono::milliseconds(1), std::vector<StreamEvent>{TextDelta{"b"}});
+  HedgeOptions options;
+  options.delay = std::chrono::milliseconds(30);
+  options.min_samples = 3;
+  options.min_delay = std::chrono::milliseconds(1);
+  HedgedProvider provider(primary, backup, io_ctx, options);
+
+  for (int i = 0; i < 3; ++i) run_hedged(io_ctx, provider);
+  EXPECT_EQ(provider.stats().hedge_wins, 3u);
+
+  // The samples are how long the primary had waited, not the backup's fast first token
+  run_hedged(io_ctx, provider);
+  EXPECT_GE(provider.stats().threshold, std::chrono::milliseconds(30));
+}
+
+// ============================================================
+// 协程事件流测试
+// ============================================================
+
+TEST(EventStreamTest, DrainsProviderStreamInOrder) {
+  asio::io_context io_ctx;
+  DelayedProvider provider(io_ctx, "p", std::chrono::milliseconds(10),
+                           std::vector<StreamEvent>{TextDelta{"a"}, TextDelta{"b"}, FinishStep{FinishReason::Stop, {}}});
+
+  std::vector<std::string> texts;
+  bool finished = false;
+  asio::co_spawn(
+      io_ctx,
+      [&]() -> asio::awaitable<void> {
+        auto events = EventStream::open(provider, LlmRequest{});
+        while (auto event = co_await events->next()) {
+          if (auto text = std::get_if<TextDelta>(&*event)) texts.push_back(text->text);
+          if (std::holds_alternative<FinishStep>(*event)) finished = true;
+        }
+        EXPECT_TRUE(events->finished());
+      },
+      asio::detached);
+  io_ctx.run();
+
+  EXPECT_EQ(texts, (std::vector<std::string>{"a", "b"}));
+  EXPECT_TRUE(finished);
+}
+
+TEST(EventStreamTest, BufferedEventsAndCrossThreadProducer) {
+  asio::io_context io_ctx;
+  auto events = std::make_shared<EventStream>();
+  events->push(TextDelta{"early"});
+
+  std::thread producer([events]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    events->push(TextDelta{"late"});
+    events->finish();
+  });
+
+  // A suspended next() is not io_context work; keep run() alive until the coroutine ends
+  auto work = asio::make_work_guard(io_ctx);
+  std::vector<std::string> texts;
+  asio::co_spawn(
+      io_ctx,
+      [&]() -> asio::awaitable<void> {
+        while (auto event = co_await events->next()) texts.push_back(std::get<TextDelta>(*event).text);
+        // Stays at end of stream
+        EXPECT_FALSE((co_await events->next()).has_value());
+        work.reset();
+      },
+      asio::detached);
+  io_ctx.run();
+  producer.join();
+
+  EXPECT_EQ(texts, (std::vector<std::string>{"early", "late"}));
+}
+
+// ============================================================
+// 流式增量快速解码测试
+// ============================================================
+
+TEST(JsonScannerTest, ReadsSelectedFieldsAndSkipsTheRest) {
+  JsonScanner scanner(R"( {"skip": {"a": [1, "}", {"b": null}], "c": "\"]"}, "text": "a\"b\\c\né😀", "n": -42, "z": null} )");
+  std::string text;
+  int64_t n = 0;
+  bool saw_null = false;
+  ASSERT_TRUE(scanner.enter_object());
+  while (auto key = scanner.next_key()) {
+    if (*key == "text") {
+      EXPECT_TRUE(scanner.read_string(text));
+    } else if (*key == "n") {
+      EXPECT_TRUE(scanner.read_int(n));
+    } else if (*key == "z") {
+      saw_null = scanner.read_null();
+    } else {
+      EXPECT_TRUE(scanner.skip_value());
+    }
+  }
+  EXPECT_TRUE(scanner.at_end());
+  EXPECT_EQ(text, "a\"b\\c\n\xC3\xA9\xF0\x9F\x98\x80");
+  EXPECT_EQ(n, -42);
+  EXPECT_TRUE(saw_null);
+}
+
+TEST(JsonScannerTest, MalformedInputFails) {
+  for (std::string_view text : {R"({"a": "unterminated})", R"({"a": 1,})", R"({"a" 1})", R"({"a": "\u12"})", R"({"a": [1, 2})", R"({"a": 1} x)"}) {
+    JsonScanner scanner(text);
+    std::string value;
+    if (scanner.enter_object()) {
+      while (auto key = scanner.next_key()) {
+        if (*key == "a") {
+          scanner.read_string(value) || scanner.skip_value();
+        } else {
+          scanner.skip_value();
+        }
+      }
+    }
+    EXPECT_FALSE(scanner.at_end()) << text;
+  }
+}
+
+TEST(StreamDecoderTest, AnthropicDeltas) {
+  AnthropicDelta delta;
+  ASSERT_TRUE(decode_anthropic_delta(R"({"type":"content_block_delta","index":0,"delta":{"type":"text_delta","text":"Hi \"there\""}})", delta));
+  EXPECT_EQ(delta.kind, AnthropicDelta::Kind::Text);
+  EXPECT_EQ(delta.index, 0);
+  EXPECT_EQ(delta.text, "Hi \"there\"");
+
+  ASSERT_TRUE(decode_anthropic_delta(
+      R"({"type":"content_block_delta","index":2,"delta":{"type":"input_json_delta","partial_json":"{\"path\":"}})", delta));
+  EXPECT_EQ(delta.kind, AnthropicDelta::Kind::InputJson);
+  EXPECT_EQ(delta.index, 2);
+  EXPECT_EQ(delta.text, "{\"path\":");
+
+  ASSERT_TRUE(decode_anthropic_delta(R"({"type": "ping"})", delta));
+  EXPECT_EQ(delta.kind, AnthropicDelta::Kind::Ping);
+
+  // Everything else goes to the full parser
+  EXPECT_FALSE(decode_anthropic_delta(R"({"type":"message_delta","delta":{"stop_reason":"end_turn"},"usage":{"output_tokens":5}})", delta));
+  EXPECT_FALSE(decode_anthropic_delta(R"({"type":"content_block_delta","index":0,"delta":{"type":"thinking_delta","thinking":"hm"}})", delta));
+  EXPECT_FALSE(decode_anthropic_delta(R"({"type":"content_block_delta","index":0,"delta":{"type":"text_delta","text":"cut)", delta));
+}
+
+TEST(StreamDecoderTest, OpenAIDeltas) {
+  OpenAIDelta delta;
+  ASSERT_TRUE(decode_openai_delta(
+      R"({"id":"c","choices":[{"index":0,"delta":{"role":"assistant","content":"Hello"},"finish_reason":null}]})", delta));
+  EXPECT_EQ(delta.content, "Hello");
+  EXPECT_FALSE(delta.reasoning_content.has_value());
+
+  ASSERT_TRUE(decode_openai_delta(R"({"choices":[{"delta":{"content":null,"reasoning_content":"think"}}],"usage":null})", delta));
+  EXPECT_FALSE(delta.content.has_value());
+  EXPECT_EQ(delta.reasoning_content, "think");
+
+  ASSERT_TRUE(decode_openai_delta(R"({"choices":[{"delta":{"tool_calls":[{"index":1,"id":"","function":{"arguments":"{\"a\":"}}]}}]})", delta));
+  ASSERT_EQ(delta.tool_arguments.size(), 1u);
+  EXPECT_EQ(delta.tool_arguments[0].index, 1);
+  EXPECT_EQ(delta.tool_arguments[0].arguments, "{\"a\":");
+
+  // A tool call's first chunk, finish_reason, usage, errors and multiple choices go to the full parser
+  EXPECT_FALSE(
+      decode_openai_delta(R"({"choices":[{"delta":{"tool_calls":[{"index":0,"id":"call_1","function":{"name":"read","arguments":""}}]}}]})", delta));
+  EXPECT_FALSE(decode_openai_delta(R"({"choices":[{"delta":{},"finish_reason":"stop"}]})", delta));
+  EXPECT_FALSE(decode_openai_delta(R"({"choices":[],"usage":{"prompt_tokens":3,"completion_tokens":4}})", delta));
+  EXPECT_FALSE(decode_openai_delta(R"({"error":{"message":"overloaded"}})", delta));
+  EXPECT_FALSE(decode_openai_delta(R"({"choices":[{"delta":{"content":"a"}},{"delta":{"content":"b"}}]})", delta));
+}
+
+namespace {
+
+// Streams a recorded SSE body through a provider and collects the emitted events
+template <typename ProviderT>
+std::vector<StreamEvent> stream_recorded(const std::string& sse_body) {
+  TestHttpServer server([&sse_body](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, sse_body, "Content-Type: text/event-stream\r\n");
+  });
+  asio::io_context io_ctx;
+  ProviderConfig config;
+  config.api_key = "test-key";
+  config.base_url = server.url("");
+  ProviderT provider(config, io_ctx);
+
+  std::vector<StreamEvent> events;
+  LlmRequest request;
+  request.model = "test-model";
+  request.messages.push_back(Message::user("hi"));
+  provider.stream(
+      request,
+      [&events](const StreamEvent& event) {
+        events.push_back(event);
+      },
+      [&io_ctx]() {
+        io_ctx.stop();
+      });
+  io_ctx.run();
+  return events;
+}
+
+}  // namespace
+
+TEST(StreamDecoderTest, AnthropicStreamUsesFastPathAndFallback) {
+  std::string body =
+      "event: message_start\ndata: {\"type\":\"message_start\",\"message\":{\"usage\":{\"input_tokens\":10,\"output_tokens\":1}}}\n\n"
+      "event: content_block_start\ndata: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"Hel\"}}\n\n"
+      "event: ping\ndata: {\"type\": \"ping\"}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"lo\"}}\n\n"
+      "event: content_block_stop\ndata: {\"type\":\"content_block_stop\",\"index\":0}\n\n"
+      "event: content_block_start\ndata: {\"type\":\"content_block_start\",\"index\":1,"
+      "\"content_block\":{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"read\",\"input\":{}}}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":1,"
+      "\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"path\\\"\"}}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":1,"
+      "\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\":\\\"a.txt\\\"}\"}}\n\n"
+      "event: content_block_stop\ndata: {\"type\":\"content_block_stop\",\"index\":1}\n\n"
+      "event: message_delta\ndata: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"tool_use\"},\"usage\":{\"output_tokens\":7}}\n\n"
+      "event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n";
+  auto events = stream_recorded<AnthropicProvider>(body);
+
+  std::string text;
+  const ToolCallComplete* complete = nullptr;
+  const FinishStep* finish = nullptr;
+  for (const auto& event : events) {
+    if (auto delta = std::get_if<TextDelta>(&event)) text += delta->text;
+    if (auto call = std::get_if<ToolCallComplete>(&event)) complete = call;
+    if (auto step = std::get_if<FinishStep>(&event)) finish = step;
+  }
+  EXPECT_EQ(text, "Hello");
+  ASSERT_NE(complete, nullptr);
+  EXPECT_EQ(complete->id, "toolu_1");
+  EXPECT_EQ(complete->arguments, json({{"path", "a.txt"}}));
+  ASSERT_NE(finish, nullptr);
+  EXPECT_EQ(finish->reason, FinishReason::ToolCalls);
+}
+
+TEST(StreamDecoderTest, OpenAIStreamUsesFastPathAndFallback) {
+  auto chunk = [](const std::string& choice) {
+    return "data: {\"id\":\"c\",\"object\":\"chat.completion.chunk\",\"choices\":[" + choice + "]}\n\n";
+  };
+  std::string body = chunk(R"({"index":0,"delta":{"role":"assistant","reasoning_content":"plan"},"finish_reason":null})") +
+                     chunk(R"({"index":0,"delta":{"content":"Hi"},"finish_reason":null})") +
+                     chunk(R"({"index":0,"delta":{"tool_calls":[{"index":0,"id":"call_1","function":{"name":"read","arguments":""}}]}})") +
+                     chunk(R"({"index":0,"delta":{"tool_calls":[{"index":0,"function":{"arguments":"{\"path\":"}}]}})") +
+                     chunk(R"({"index":0,"delta":{"tool_calls":[{"index":0,"function":{"arguments":"\"a.txt\"}"}}]}})") +
+                     chunk(R"({"index":0,"delta":{},"finish_reason":"tool_calls"})") + "data: [DONE]\n\n";
+  auto events = stream_recorded<OpenAIProvider>(body);
+
+  std::string thinking;
+  std::string text;
+  std::string args;
+  const ToolCallComplete* complete = nullptr;
+  const FinishStep* finish = nullptr;
+  for (const auto& event : events) {
+    if (auto delta = std::get_if<ThinkingDelta>(&event)) thinking += delta->text;
+    if (auto delta = std::get_if<TextDelta>(&event)) text += delta->text;
+    if (auto delta = std::get_if<ToolCallDelta>(&event)) args += delta->arguments_delta;
+    if (auto call = std::get_if<ToolCallComplete>(&event)) complete = call;
+    if (auto step = std::get_if<FinishStep>(&event)) finish = step;
+  }
+  EXPECT_EQ(thinking, "plan");
+  EXPECT_EQ(text, "Hi");
+  EXPECT_EQ(args, "{\"path\":\"a.txt\"}");
+  ASSERT_NE(complete, nullptr);
+  EXPECT_EQ(complete->id, "call_1");
+  EXPECT_EQ(complete->name, "read");
+  EXPECT_EQ(complete->arguments, json({{"path", "a.txt"}}));
+  ASSERT_NE(finish, nullptr);
+  EXPECT_EQ(finish->reason, FinishReason::ToolCalls);
+}
+
+// ============================================================
+// 增量 JSON 解析测试
+// ============================================================
+
+namespace {
+
+const std::vector<std::string> kValidJson = {
+    R"({"filePath": "src/main.cpp", "offset": 10, "limit": 200})",
+    R"({"command": "ls -la | grep \"x\"", "timeout": 120000, "background": false, "description": null})",
+    R"({"a": [1, -2, 3.5, -0, 1e10, 1.5E-3, 18446744073709551615, -9223372036854775808], "b": {"c": {"d": [[], {}, [{}]]}}})",
+    R"({"text": "tab\there\nnew \\ slash\/ é 中 😀 \"q\"", "empty": "", "u": "\u0000x"})",
+    R"(  { "spaced" :  [ true ,false , null ] , "k" : "v" }  )",
+    R"({"dup": 1, "dup": "second"})",
+    R"(["top", "level", [1, 2]])",
+    R"("just a string")",
+    R"({})",
+    "{\"utf8\": \"h\xC3\xA9llo \xE4\xB8\xAD\xE6\x96\x87\"}",
+};
+
+const std::vector<std::string> kMalformedJson = {
+    R"({"a": 1,})",     R"({"a" 1})",         R"({"a": tru})",      R"({"a": truex})",       R"({"a": 01})",   R"({"a": 1.})",
+    R"({"a": -})",      R"({"a": "\x"})",     R"({"a": "\u12G4"})", R"({"a": "\ud83d"})",    R"({"a": [1 2]})", R"({"a": 1]})",
+    R"({"a": 1} {})",   R"({a: 1})",          R"([,1])",            "{\"a\": \"line\nbreak\"}", R"({"a": 1e})",   R"({"a": "\udc00"})",
+};
+
+// Feed doc in pieces cut at the given offsets
+PartialJsonParser feed_split(const std::string& doc, const std::vector<size_t>& cuts) {
+  PartialJsonParser parser;
+  size_t pos = 0;
+  for (size_t cut : cuts) {
+    parser.feed(std::string_view(doc).substr(pos, cut - pos));
+    pos = cut;
+  }
+  parser.feed(std::string_view(doc).substr(pos));
+  parser.finish();
+  return parser;
+}
+
+}  // namespace
+
+TEST(PartialJsonParserTest, MatchesFullParseAtEverySplitPoint) {
+  for (const auto& doc : kValidJson) {
+    auto expected = json::parse(doc).dump();
+    for (size_t cut = 0; cut <= doc.size(); ++cut) {
+      auto parser = feed_split(doc, {cut});
+      ASSERT_TRUE(parser.complete()) << doc << " cut at " << cut << ": " << parser.error();
+      EXPECT_EQ(parser.value().dump(), expected) << doc << " cut at " << cut;
+    }
+  }
+}
+
+TEST(PartialJsonParserTest, RandomFragmentationFuzz) {
+  std::mt19937 rng(1234);
+  for (const auto& doc : kValidJson) {
+    auto expected = json::parse(doc).dump();
+    for (int trial = 0; trial < 200; ++trial) {
+      std::vector<size_t> cuts;
+      std::uniform_int_distribution<size_t> step(0, 4);
+      for (size_t pos = step(rng); pos < doc.size(); pos += step(rng)) cuts.push_back(pos);
+
+      auto parser = feed_split(doc, cuts);
+      ASSERT_TRUE(parser.complete()) << doc << ": " << parser.error();
+      EXPECT_EQ(parser.value().dump(), expected) << doc;
+    }
+  }
+}
+
+TEST(PartialJsonParserTest, MalformedDetectedAtSameOffsetAnySplit) {
+  for (const auto& doc : kMalformedJson) {
+    EXPECT_FALSE(json::accept(doc)) << doc;
+
+    auto whole = feed_split(doc, {});
+    ASSERT_TRUE(whole.failed()) << doc;
+    for (size_t cut = 0; cut <= doc.size(); ++cut) {
+      auto parser = feed_split(doc, {cut});
+      EXPECT_TRUE(parser.failed()) << doc << " cut at " << cut;
+      EXPECT_EQ(parser.error(), whole.error()) << doc << " cut at " << cut;
+      EXPECT_FALSE(parser.complete());
+    }
+  }
+}
+
+TEST(PartialJsonParserTest, ExposesFieldsBeforeTheValueCloses) {
+  PartialJsonParser parser;
+  EXPECT_TRUE(parser.value().is_null());
+  EXPECT_FALSE(parser.started());
+
+  ASSERT_TRUE(parser.feed(R"({"filePath": "src/ma)"));
+  EXPECT_TRUE(parser.started());
+  EXPECT_EQ(parser.value(), json({{"filePath", "src/ma"}}));
+
+  ASSERT_TRUE(parser.feed(R"(in.cpp", "content": "line 1\n)"));
+  EXPECT_EQ(parser.value()["filePath"], "src/main.cpp");
+  EXPECT_EQ(parser.value()["content"], "line 1\n");
+
+  // A half-received escape or number shows nothing until it completes
+  ASSERT_TRUE(parser.feed(R"(\u00)"));
+  EXPECT_EQ(parser.value()["content"], "line 1\n");
+  ASSERT_TRUE(parser.feed(R"(e9", "limit": 12)"));
+  EXPECT_EQ(parser.value()["content"], "line 1\n\xC3\xA9");
+  EXPECT_FALSE(parser.value().contains("limit"));
+  EXPECT_FALSE(parser.complete());
+
+  ASSERT_TRUE(parser.feed("}"));
+  EXPECT_TRUE(parser.complete());
+  EXPECT_EQ(parser.value()["limit"], 12);
+
+  // The parser is movable mid-value (builders live in vectors)
+  PartialJsonParser streaming;
+  streaming.feed(R"({"a": {"b": [1, "par)");
+  PartialJsonParser moved = std::move(streaming);
+  ASSERT_TRUE(moved.feed(R"(tial"]}, "c": "d"})"));
+  EXPECT_TRUE(moved.complete());
+  EXPECT_EQ(moved.take(), json::parse(R"({"a": {"b": [1, "partial"]}, "c": "d"})"));
+  EXPECT_FALSE(moved.started());
+}
+
+// ============================================================
+// 提示词缓存断点测试
+// ============================================================
+
+namespace {
+
+// count messages alternating user/assistant, each with the given number of text parts
+LlmRequest cache_request(size_t count, size_t parts_per_message) {
+  LlmRequest request;
+  request.model = "test-model";
+  for (size_t i = 0; i < count; ++i) {
+    Message msg(i % 2 == 0 ? Role::User : Role::Assistant, "");
+    for (size_t p = 0; p < parts_per_message; ++p) msg.add_text("m" + std::to_string(i) + "p" + std::to_string(p));
+    request.messages.push_back(msg);
+  }
+  return request;
+}
+
+}  // namespace
+
+TEST(PromptCacheTest, PlansToolsSystemAndRollingPoints) {
+  auto request = cache_request(6, 1);
+  request.system_prompt = "sys";
+  request.tools.push_back(std::make_shared<MockTool>());
+
+  auto plan = plan_cache_breakpoints(request);
+  EXPECT_TRUE(plan.tools);
+  EXPECT_TRUE(plan.system);
+  EXPECT_EQ(plan.messages, std::vector<size_t>({5}));  // Short history: the end is within reach of every earlier entry
+
+  // A long history gets a second point one lookback window before the end
+  request = cache_request(30, 2);
+  request.system_prompt = "sys";
+  request.tools.push_back(std::make_shared<MockTool>());
+  plan = plan_cache_breakpoints(request);
+  EXPECT_EQ(plan.messages, std::vector<size_t>({29, 19}));
+
+  // Without tools or system prompt all four go to the history; system and empty messages are skipped
+  request = cache_request(100, 2);
+  request.messages.push_back(Message::system("not sent"));
+  request.messages.push_back(Message(Role::User, ""));
+  plan = plan_cache_breakpoints(request);
+  EXPECT_FALSE(plan.tools);
+  EXPECT_FALSE(plan.system);
+  EXPECT_EQ(plan.messages, std::vector<size_t>({99, 89, 79, 69}));
+
+  EXPECT_TRUE(plan_cache_breakpoints(LlmRequest{}).messages.empty());
+}
+
+TEST(PromptCacheTest, AnthropicFormatCarriesBreakpoints) {
+  auto request = mixed_request();
+  request.prompt_cache = true;
+
+  auto j = request.to_anthropic_format();
+  json ephemeral = {{"type", "ephemeral"}};
+  ASSERT_TRUE(j["system"].is_array());
+  EXPECT_EQ(j["system"][0]["text"], "Be brief.");
+  EXPECT_EQ(j["system"][0]["cache_control"], ephemeral);
+  EXPECT_EQ(j["tools"].back()["cache_control"], ephemeral);
+
+  // Only the last message is marked, on its last block
+  auto& msgs = j["messages"];
+  EXPECT_EQ(msgs.back()["content"].back()["cache_control"], ephemeral);
+  EXPECT_FALSE(msgs.back()["content"][0].contains("cache_control"));
+  EXPECT_TRUE(msgs[0]["content"].is_string());
+  auto dump = j.dump();
+  size_t markers = 0;
+  for (auto pos = dump.find("cache_control"); pos != std::string::npos; pos = dump.find("cache_control", pos + 1)) ++markers;
+  EXPECT_EQ(markers, 3u);
+
+  // A plain-string message is turned into a text block to carry the marker
+  LlmRequest single;
+  single.prompt_cache = true;
+  single.messages.push_back(Message::user("hi"));
+  EXPECT_EQ(single.to_anthropic_format()["messages"][0]["content"], json::array({{{"type", "text"}, {"text", "hi"}, {"cache_control", ephemeral}}}));
+  EXPECT_FALSE(single.to_anthropic_format().contains("tools"));
+
+  // The spliced body matches, and the cached fragments stay unmarked for later turns
+  EXPECT_EQ(json::parse(request.to_anthropic_body(true)), [&] {
+    auto expected = request.to_anthropic_format();
+    expected["stream"] = true;
+    return expected;
+  }());
+  request.prompt_cache = false;
+  EXPECT_EQ(request.to_anthropic_body().find("cache_control"), std::string::npos);
+  EXPECT_EQ(json::parse(request.to_anthropic_body()), request.to_anthropic_format());
+
+  // OpenAI-compatible APIs have no markers
+  request.prompt_cache = true;
+  EXPECT_EQ(request.to_openai_body().find("cache_control"), std::string::npos);
+}
+
+TEST(PromptCacheTest, AnthropicStreamReportsCacheUsage) {
+  std::string body =
+      "event: message_start\ndata: {\"type\":\"message_start\",\"message\":{\"usage\":"
+      "{\"input_tokens\":12,\"cache_read_input_tokens\":900,\"cache_creation_input_tokens\":88,\"output_tokens\":1}}}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"ok\"}}\n\n"
+      "event: message_delta\ndata: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"end_turn\"},\"usage\":{\"output_tokens\":5}}\n\n"
+      "event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n";
+  auto events = stream_recorded<AnthropicProvider>(body);
+
+  const FinishStep* finish = nullptr;
+  for (const auto& event : events) {
+    if (auto step = std::get_if<FinishStep>(&event)) finish = step;
+  }
+  ASSERT_NE(finish, nullptr);
+  EXPECT_EQ(finish->usage.input_tokens, 12);
+  EXPECT_EQ(finish->usage.output_tokens, 5);
+  EXPECT_EQ(finish->usage.cache_read_tokens, 900);
+  EXPECT_EQ(finish->usage.cache_write_tokens, 88);
+  EXPECT_DOUBLE_EQ(finish->usage.cache_hit_ratio(), 0.9);
+}
+
+// ============================================================
+// 流量追踪测试
+// ============================================================
+
+namespace {
+
+std::vector<json> read_trace(const std::filesystem::path& path) {
+  std::vector<json> records;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) records.push_back(json::parse(line));
+  return records;
+}
+
+}  // namespace
+
+TEST(TraceRecorderTest, RecordsRawTrafficAndPrintsOffline) {
+  auto path = std::filesystem::temp_directory_path() / "agent_trace_test.ndjson";
+  std::filesystem::remove(path);
+  EXPECT_FALSE(TraceRecorder::enabled());
+
+  std::string body =
+      "event: message_start\ndata: {\"type\":\"message_start\",\"message\":{\"usage\":{\"input_tokens\":3}}}\n\n"
+      "event: content_block_delta\ndata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"Hi\"}}\n\n"
+      "event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n";
+
+  // Off: nothing is written
+  stream_recorded<AnthropicProvider>(body);
+  EXPECT_FALSE(std::filesystem::exists(path));
+
+  ASSERT_TRUE(TraceRecorder::instance().start(path));
+  EXPECT_TRUE(TraceRecorder::enabled());
+  stream_recorded<AnthropicProvider>(body);
+  TraceRecorder::instance().stop();
+  EXPECT_FALSE(TraceRecorder::enabled());
+
+  auto records = read_trace(path);
+  ASSERT_GE(records.size(), 3u);
+  EXPECT_EQ(records.front()["kind"], "request");
+  EXPECT_EQ(records.front()["provider"], "anthropic");
+  EXPECT_EQ(json::parse(records.front()["data"].get<std::string>())["model"], "test-model");
+  EXPECT_EQ(records.back()["kind"], "end");
+  EXPECT_EQ(records.back()["status"], 200);
+
+  // The chunks are the response bytes exactly, all under the request's id
+  std::string received;
+  for (size_t i = 1; i + 1 < records.size(); ++i) {
+    EXPECT_EQ(records[i]["kind"], "chunk");
+    EXPECT_EQ(records[i]["id"], records.front()["id"]);
+    EXPECT_GE(records[i]["t"].get<int64_t>(), records.front()["t"].get<int64_t>());
+    received += records[i]["data"].get<std::string>();
+  }
+  EXPECT_EQ(received, body);
+
+  std::ifstream file(path);
+  std::ostringstream out;
+  print_trace(file, out);
+  auto text = out.str();
+  EXPECT_NE(text.find("anthropic"), std::string::npos);
+  EXPECT_NE(text.find("\"model\": \"test-model\""), std::string::npos);  // Indented request body
+  EXPECT_NE(text.find("event: content_block_delta"), std::string::npos);
+  EXPECT_NE(text.find("\"text\": \"Hi\""), std::string::npos);  // Indented event payload
+  EXPECT_NE(text.find("status 200"), std::string::npos);
+  std::filesystem::remove(path);
+}
+
+TEST(TraceRecorderTest, KeepsCharactersSplitAcrossChunks) {
+  auto path = std::filesystem::temp_directory_path() / "agent_trace_utf8_test.ndjson";
+  std::filesystem::remove(path);
+
+  auto& trace = TraceRecorder::instance();
+  ASSERT_TRUE(trace.start(path));
+  auto id = trace.next_id();
+  trace.request(id, "test", "http://localhost/", "{}");
+  trace.chunk(id, "data: \xE4\xBD");  // First two bytes of U+4F60
+  trace.chunk(id, "\xA0ok\n\n");
+  trace.chunk(id, "\xE4");  // Cut off by the end of the stream
+  trace.end(id, 200, "");
+  trace.stop();
+
+  std::string received;
+  for (const auto& r : read_trace(path)) {
+    if (r["kind"] == "chunk") received += r["data"].get<std::string>();
+  }
+  EXPECT_EQ(received, "data: \xE4\xBD\xA0ok\n\n\xEF\xBF\xBD");  // The dangling byte becomes U+FFFD
+  std::filesystem::remove(path);
+}
+
+TEST(TraceRecorderTest, DropsRecordsOverTheQueueLimit) {
+  auto path = std::filesystem::temp_directory_path() / "agent_trace_dropped_test.ndjson";
+  std::filesystem::remove(path);
+
+  // Each chunk alone is over the limit, so it never reaches the queue however fast the writer is
+  auto& trace = TraceRecorder::instance();
+  ASSERT_TRUE(trace.start(path, 64));
+  auto id = trace.next_id();
+  trace.request(id, "test", "http://localhost/", "{}");
+  trace.chunk(id, std::string(100, 'x'));
+  trace.chunk(id, std::string(200, 'y'));
+  trace.end(id, 200, "");
+  trace.stop();
+  EXPECT_EQ(trace.dropped(), 2u);
+
+  // The request and end records, and where the writer noticed the gap, one line for both chunks
+  auto records = read_trace(path);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records.front()["kind"], "request");
+  json dropped;
+  for (const auto& r : records) {
+    EXPECT_NE(r["kind"], "chunk");
+    if (r["kind"] == "dropped") dropped = r;
+  }
+  ASSERT_FALSE(dropped.is_null());
+  EXPECT_EQ(dropped["records"], 2);
+  EXPECT_EQ(dropped["bytes"], 300);
+
+  std::ifstream file(path);
+  std::ostringstream out;
+  print_trace(file, out);
+  EXPECT_NE(out.str().find("2 records, 300 bytes dropped"), std::string::npos);
+  std::filesystem::remove(path);
+}
+
+// ============================================================
+// 录制回放测试
+// ============================================================
+
+namespace {
+
+struct ReplayRun {
+  std::vector<StreamEvent> events;
+  std::vector<std::chrono::milliseconds> times;  // Arrival of each event after stream()
+  std::chrono::milliseconds elapsed{0};
+  int completions = 0;
+};
+
+ReplayRun run_replay(asio::io_context& io_ctx, Provider& provider, const LlmRequest& request) {
+  ReplayRun run;
+  auto start = std::chrono::steady_clock::now();
+  auto now = [start]() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  };
+  provider.stream(
+      request,
+      [&](const StreamEvent& event) {
+        run.events.push_back(event);
+        run.times.push_back(now());
+      },
+      [&]() {
+        run.completions++;
+        run.elapsed = now();
+      });
+  io_ctx.restart();
+  io_ctx.run();
+  return run;
+}
+
+LlmRequest replay_request(const std::string& prompt) {
+  LlmRequest request;
+  request.model = "test-model";
+  request.messages.push_back(Message::user(prompt));
+  return request;
+}
+
+}  // namespace
+
+TEST(ReplayProviderTest, RecordsAndReplaysByFingerprint) {
+  auto path = std::filesystem::temp_directory_path() / "agent_replay_test.json";
+  std::filesystem::remove(path);
+  asio::io_context io_ctx;
+
+  ReplayOptions record;
+  record.record = true;
+  {
+    auto cassette = std::make_shared<ReplayCassette>(path);
+    std::vector<StreamEvent> hello_events{TextDelta{"Hello"}, ToolCallComplete{"c1", "read", {{"filePath", "a.txt"}}},
+                                          FinishStep{FinishReason::ToolCalls, {10, 5}}};
+    auto hello = std::make_shared<DelayedProvider>(io_ctx, "upstream", std::chrono::milliseconds(5), hello_events);
+    auto world = std::make_shared<DelayedProvider>(io_ctx, "upstream", std::chrono::milliseconds(5),
+                                                   std::vector<StreamEvent>{TextDelta{"World"}, FinishStep{FinishReason::Stop, {20, 1}}});
+    ReplayProvider recorder_a(hello, cassette, io_ctx, record);
+    ReplayProvider recorder_b(world, cassette, io_ctx, record);
+    EXPECT_EQ(run_replay(io_ctx, recorder_a, replay_request("a")).events.size(), 3u);
+    EXPECT_EQ(run_replay(io_ctx, recorder_b, replay_request("b")).events.size(), 2u);
+    EXPECT_EQ(recorder_a.name(), "upstream");
+    EXPECT_EQ(recorder_a.stats().recorded, 1u);
+    EXPECT_EQ(cassette->size(), 2u);
+  }
+
+  // A fresh cassette from the file, replayed in the opposite order
+  ReplayOptions fast;
+  fast.pacing = ReplayPacing::MaxSpeed;
+  fast.sequential = false;
+  ReplayProvider replay(nullptr, std::make_shared<ReplayCassette>(path), io_ctx, fast);
+  EXPECT_EQ(replay.name(), "replay");
+
+  auto b = run_replay(io_ctx, replay, replay_request("b"));
+  ASSERT_EQ(b.events.size(), 2u);
+  EXPECT_EQ(std::get<TextDelta>(b.events[0]).text, "World");
+  EXPECT_EQ(b.completions, 1);
+
+  auto a = run_replay(io_ctx, replay, replay_request("a"));
+  ASSERT_EQ(a.events.size(), 3u);
+  EXPECT_EQ(std::get<TextDelta>(a.events[0]).text, "Hello");
+  const auto& call = std::get<ToolCallComplete>(a.events[1]);
+  EXPECT_EQ(call.name, "read");
+  EXPECT_EQ(call.arguments["filePath"], "a.txt");
+  const auto& finish = std::get<FinishStep>(a.events[2]);
+  EXPECT_EQ(finish.reason, FinishReason::ToolCalls);
+  EXPECT_EQ(finish.usage.input_tokens, 10);
+  EXPECT_EQ(finish.usage.output_tokens, 5);
+
+  // The same request again gets the same answer; an unknown one gets an error
+  EXPECT_EQ(std::get<TextDelta>(run_replay(io_ctx, replay, replay_request("a")).events[0]).text, "Hello");
+  auto unknown = run_replay(io_ctx, replay, replay_request("c"));
+  ASSERT_EQ(unknown.events.size(), 1u);
+  EXPECT_TRUE(std::holds_alternative<StreamError>(unknown.events[0]));
+  EXPECT_EQ(unknown.completions, 1);
+
+  auto stats = replay.stats();
+  EXPECT_EQ(stats.exact, 3u);
+  EXPECT_EQ(stats.sequential, 0u);
+  EXPECT_EQ(stats.missed, 1u);
+  std::filesystem::remove(path);
+}
+
+TEST(ReplayProviderTest, RecordsCompletionsWithoutWaitingOnTheFuture) {
+  asio::io_context io_ctx;
+  ReplayOptions record;
+  record.record = true;
+  auto cassette = std::make_shared<ReplayCassette>();
+  auto upstream = std::make_shared<DelayedProvider>(io_ctx, "upstream", std::chrono::milliseconds(5),
+                                                    std::vector<StreamEvent>{TextDelta{"Hi"}, FinishStep{FinishReason::Stop, {4, 1}}});
+  ReplayProvider recorder(upstream, cassette, io_ctx, record);
+
+  auto future = recorder.complete(replay_request("a"));
+  io_ctx.run();
+  EXPECT_EQ(cassette->size(), 1u);
+  EXPECT_EQ(recorder.stats().recorded, 1u);
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+  auto response = future.get();
+  ASSERT_TRUE(response.ok());
+  EXPECT_EQ(response.message.text(), "Hi");
+  EXPECT_EQ(response.usage.output_tokens, 1);
+
+  // A cancelled upstream leaves nothing to record and answers with an error
+  auto cancelled = recorder.complete(replay_request("b"));
+  recorder.cancel();
+  io_ctx.restart();
+  io_ctx.run();
+  EXPECT_EQ(cassette->size(), 1u);
+  EXPECT_FALSE(cancelled.get().ok());
+}
+
+TEST(ReplayProviderTest, CassetteWritesOnSaveOrDestruction) {
+  auto path = std::filesystem::temp_directory_path() / "agent_replay_save_test.json";
+  std::filesystem::remove(path);
+  {
+    ReplayCassette cassette(path);
+    cassette.add({"one", "test-model", {{{}, TextDelta{"a"}}, {{}, FinishStep{FinishReason::Stop, {}}}}});
+    EXPECT_FALSE(std::filesystem::exists(path));  // Recordings stay in memory
+    EXPECT_TRUE(cassette.save());
+    EXPECT_EQ(ReplayCassette(path).size(), 1u);
+
+    cassette.add({"two", "test-model", {{{}, StreamError{"overloaded", true, std::chrono::milliseconds(1500)}}}});
+    EXPECT_EQ(ReplayCassette(path).size(), 1u);
+  }
+
+  ReplayCassette reloaded(path);
+  ASSERT_EQ(reloaded.size(), 2u);
+  auto two = reloaded.next("two", false);
+  ASSERT_TRUE(two);
+  EXPECT_EQ(std::get<StreamError>(two->events[0].event).retry_after, std::chrono::milliseconds(1500));
+  std::filesystem::remove(path);
+}
+
+TEST(ReplayProviderTest, PacingFollowsRecordingOrInjectedLatency) {
+  using std::chrono::milliseconds;
+  asio::io_context io_ctx;
+  auto cassette = std::make_shared<ReplayCassette>();
+  cassette->add({"other", "test-model",
+                 {{milliseconds(0), TextDelta{"a"}}, {milliseconds(30), TextDelta{"b"}}, {milliseconds(60), FinishStep{FinishReason::Stop, {}}}}});
+  auto request = replay_request("unrecorded");  // Played in recording order
+
+  ReplayOptions options;
+  options.pacing = ReplayPacing::Recorded;
+  cassette->rewind();
+  auto recorded = run_replay(io_ctx, *std::make_shared<ReplayProvider>(nullptr, cassette, io_ctx, options), request);
+  ASSERT_EQ(recorded.events.size(), 3u);
+  EXPECT_GE(recorded.times[1], milliseconds(30));
+  EXPECT_GE(recorded.elapsed, milliseconds(60));
+
+  options.pacing = ReplayPacing::MaxSpeed;
+  cassette->rewind();
+  auto fast = run_replay(io_ctx, *std::make_shared<ReplayProvider>(nullptr, cassette, io_ctx, options), request);
+  ASSERT_EQ(fast.events.size(), 3u);
+  EXPECT_LT(fast.elapsed, milliseconds(30));
+
+  options.pacing = ReplayPacing::Injected;
+  options.first_token_latency = milliseconds(40);
+  options.event_interval = milliseconds(10);
+  options.jitter = milliseconds(5);
+  cassette->rewind();
+  auto injected = run_replay(io_ctx, *std::make_shared<ReplayProvider>(nullptr, cassette, io_ctx, options), request);
+  ASSERT_EQ(injected.events.size(), 3u);
+  EXPECT_GE(injected.times[0], milliseconds(35));
+  EXPECT_GE(injected.elapsed, milliseconds(45));
+  for (size_t i = 1; i < injected.times.size(); ++i) EXPECT_GE(injected.times[i], injected.times[i - 1]);
+}
+
+TEST(ReplayProviderTest, RegisteredThroughFactory) {
+  asio::io_context io_ctx;
+  auto cassette = std::make_shared<ReplayCassette>();
+  cassette->add({request_fingerprint(replay_request("hi")), "test-model",
+                 {{std::chrono::milliseconds(0), TextDelta{"Hel"}},
+                  {std::chrono::milliseconds(1), TextDelta{"lo"}},
+                  {std::chrono::milliseconds(2), FinishStep{FinishReason::Stop, {3, 2}}}}});
+  cassette->rewind();
+
+  register_replay_provider("replay-test", cassette);
+  auto provider = ProviderFactory::instance().create("replay-test", ProviderConfig{}, io_ctx);
+  ASSERT_NE(provider, nullptr);
+  EXPECT_EQ(provider->name(), "replay");
+
+  auto response = provider->complete(replay_request("hi")).get();
+  ASSERT_TRUE(response.ok());
+  EXPECT_EQ(response.message.text(), "Hello");
+  EXPECT_EQ(response.finish_reason, FinishReason::Stop);
+  EXPECT_EQ(response.usage.output_tokens, 2);
+
+  // Fingerprints ignore prompt-cache markers but not content
+  auto cached = replay_request("hi");
+  cached.prompt_cache = true;
+  EXPECT_EQ(request_fingerprint(cached), request_fingerprint(replay_request("hi")));
+  EXPECT_NE(request_fingerprint(replay_request("hi!")), request_fingerprint(replay_request("hi")));
+}
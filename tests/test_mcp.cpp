@@ -6,6 +6,7 @@
 #include "core/config.hpp"
 #include "mcp/client.hpp"
 #include "mcp/transport.hpp"
+#include "test_http_server.hpp"
 
 #ifdef AGENT_PLUGIN_QWEN
 #include "plugin/qwen/qwen_oauth.hpp"
@@ -166,6 +167,43 @@ TEST(TransportStateTest, ToString) {
   EXPECT_EQ(to_string(TransportState::Failed), "Failed");
 }
 
+// ============================================================
+// SseTransportTest — 事件流响应
+// ============================================================
+
+TEST(SseTransportTest, EventStreamResponse) {
+  std::string accept;
+  TestHttpServer server([&accept](const std::string& head, const std::string&) {
+    accept = head;
+    std::string body =
+        "event: message\r\n"
+        "data: {\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progress\":1}}\r\n\r\n"
+        "event: message\r\n"
+        "data: {\"jsonrpc\":\"2.0\",\"id\":7,\"result\":{\"tools\":[]}}\r\n\r\n";
+    return TestHttpServer::response(200, body, "Content-Type: text/event-stream\r\n");
+  });
+
+  SseTransport transport(server.url("/mcp"));
+  ASSERT_TRUE(transport.connect().get());
+
+  std::vector<std::string> notifications;
+  transport.set_notification_handler([&notifications](const std::string& method, const json&) {
+    notifications.push_back(method);
+  });
+
+  JsonRpcRequest request;
+  request.method = "tools/list";
+  request.id = 7;
+  auto response = transport.send_request(request).get();
+
+  EXPECT_FALSE(response.error.has_value());
+  ASSERT_TRUE(response.result.has_value());
+  EXPECT_TRUE(response.result->contains("tools"));
+  EXPECT_EQ(notifications, std::vector<std::string>{"notifications/progress"});
+  EXPECT_NE(accept.find("text/event-stream"), std::string::npos);
+  transport.disconnect();
+}
+
 // ============================================================
 // ClientStateTest — 客户端状态
 // ============================================================
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <utility>
+
 #include "core/message.hpp"
 
 using namespace agent;
@@ -49,3 +51,134 @@ TEST(MessageTest, JsonSerialization) {
   EXPECT_EQ(j["role"], "user");
   EXPECT_TRUE(j.contains("parts"));
 }
+
+TEST(MessageTest, ApiFragmentCachedAndSharedByCopies) {
+  auto msg = Message::user("Hello");
+  int renders = 0;
+  auto render = [&renders](const Message& m) {
+    ++renders;
+    return m.text();
+  };
+
+  EXPECT_EQ(msg.api_fragment(Message::ApiFormat::Anthropic, render), "Hello");
+  EXPECT_EQ(msg.api_fragment(Message::ApiFormat::Anthropic, render), "Hello");
+  EXPECT_EQ(renders, 1);
+
+  // Formats are cached separately
+  msg.api_fragment(Message::ApiFormat::OpenAI, render);
+  EXPECT_EQ(renders, 2);
+
+  // A copy (as in every request) reuses the fragment; filling it through a copy is seen by the original
+  Message copy = msg;
+  copy.api_fragment(Message::ApiFormat::Anthropic, render);
+  EXPECT_EQ(renders, 2);
+  auto other = Message::user("World");
+  other.token_count();  // Creates the cache, as the session does for each message it adds
+  Message other_copy = other;
+  other_copy.api_fragment(Message::ApiFormat::Anthropic, render);
+  other.api_fragment(Message::ApiFormat::Anthropic, render);
+  EXPECT_EQ(renders, 3);
+
+  // Changing the parts re-renders that message only
+  copy.add_text("again");
+  EXPECT_EQ(copy.api_fragment(Message::ApiFormat::Anthropic, render), "Hello\nagain");
+  EXPECT_EQ(renders, 4);
+  EXPECT_EQ(msg.api_fragment(Message::ApiFormat::Anthropic, render), "Hello");
+  EXPECT_EQ(renders, 4);
+
+  // Mutable access to the parts (e.g. pruning a tool result) also invalidates
+  msg.parts();
+  msg.api_fragment(Message::ApiFormat::Anthropic, render);
+  EXPECT_EQ(renders, 5);
+}
+
+TEST(MessageTest, AppendingRefreshesUnsharedFragment) {
+  auto msg = Message::user("Hello");
+  auto render = [](const Message& m) {
+    return m.text();
+  };
+  EXPECT_EQ(msg.api_fragment(Message::ApiFormat::Anthropic, render), "Hello");
+  int64_t first_part = msg.part_tokens(0);
+
+  // The cache is not shared, so it is reused: the fragment is dropped and the earlier count kept
+  msg.add_text("again");
+  EXPECT_EQ(msg.api_fragment(Message::ApiFormat::Anthropic, render), "Hello\nagain");
+  EXPECT_EQ(msg.part_tokens(0), first_part);
+  EXPECT_EQ(msg.token_count(), first_part + msg.part_tokens(1));
+}
+
+TEST(MessageTest, CopiesShareParts) {
+  Message msg(Role::User, "");
+  msg.add_tool_result("tc_1", "read", std::string(10000, 'x'));
+  const Message copy = msg;
+  EXPECT_EQ(&copy.parts(), &std::as_const(msg).parts());  // No deep copy
+
+  // Changing a copy's parts gives it its own; the other copy is unaffected
+  msg.tool_results()[0]->output = "[cleared]";
+  EXPECT_NE(&copy.parts(), &std::as_const(msg).parts());
+  EXPECT_EQ(copy.tool_results()[0]->output.size(), 10000u);
+  EXPECT_EQ(std::as_const(msg).tool_results()[0]->output, "[cleared]");
+
+  // A moved-from message is empty, and usable again
+  Message moved = std::move(msg);
+  EXPECT_TRUE(std::as_const(msg).parts().empty());
+  msg.add_text("again");
+  EXPECT_EQ(msg.text(), "again");
+  EXPECT_EQ(moved.tool_results().size(), 1u);
+}
+
+TEST(MessageTest, ToolCallStateKeepsFragments) {
+  auto msg = Message::assistant("Reading");
+  msg.add_tool_call("tc_1", "read", {{"path", "a.txt"}});
+  int renders = 0;
+  auto render = [&renders](const Message& m) {
+    ++renders;
+    return m.text();
+  };
+  msg.api_fragment(Message::ApiFormat::Anthropic, render);
+  int64_t tokens = msg.token_count();
+  const Message copy = msg;
+
+  // Execution state is not part of any request: nothing is re-rendered, and the earlier copy keeps its flags
+  msg.set_tool_call_state("tc_1", true, true);
+  msg.api_fragment(Message::ApiFormat::Anthropic, render);
+  EXPECT_EQ(renders, 1);
+  EXPECT_EQ(msg.token_count(), tokens);
+  EXPECT_TRUE(std::as_const(msg).tool_calls()[0]->completed);
+  EXPECT_FALSE(copy.tool_calls()[0]->completed);
+}
+
+TEST(MessageTest, CopiesShareIds) {
+  Message msg(Role::User, "hi");
+  msg.set_session_id("session-shared");
+  Message other(Role::User, "there");
+  other.set_session_id(std::string("session-shared"));
+
+  // One interned session id for the session's messages
+  EXPECT_EQ(&msg.session_id(), &other.session_id());
+  const Message copy = msg;
+  EXPECT_EQ(&copy.id(), &msg.id());
+  EXPECT_EQ(Message::from_json(msg.to_json()).session_id(), "session-shared");
+}
+
+// ============================================================
+// 字符串池测试
+// ============================================================
+
+TEST(StringPoolTest, InternsEqualValuesWhileInUse) {
+  auto& pool = StringPool::instance();
+  size_t before = pool.size();
+  {
+    auto a = pool.intern("tool-call-42");
+    auto b = pool.intern(std::string("tool-call-") + "42");
+    EXPECT_TRUE(a.shares_with(b));
+    EXPECT_EQ(a.str(), "tool-call-42");
+    EXPECT_FALSE(a.shares_with(pool.intern("tool-call-43")));
+    EXPECT_EQ(pool.size(), before + 1);  // tool-call-43 was released with its temporary
+  }
+  EXPECT_EQ(pool.size(), before);
+
+  SharedString empty = pool.intern("");
+  EXPECT_TRUE(empty.str().empty());
+  EXPECT_EQ(pool.size(), before);
+}
@@ -1,6 +1,24 @@
 #include <gtest/gtest.h>
+#include <zlib.h>
 
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "net/content_decoder.hpp"
+#include "net/dns_cache.hpp"
 #include "net/http_client.hpp"
+#include "net/http_framing.hpp"
+#include "net/request_scheduler.hpp"
+#include "net/retry_policy.hpp"
+#include "net/sse_parser.hpp"
+#include "net/tls_session_cache.hpp"
+#include "test_http_server.hpp"
 
 using namespace agent::net;
 
@@ -118,3 +136,1419 @@ TEST(HttpResponseTest, ErrorStatusCodes) {
   resp500.status_code = 500;
   EXPECT_FALSE(resp500.ok());
 }
+
+// ============================================================
+// HTTP 报文分帧测试
+// ============================================================
+
+namespace {
+
+std::string decode_all(ChunkedDecoder& decoder, const std::string& input, size_t* consumed = nullptr) {
+  std::string out;
+  size_t used = decoder.decode(input, [&out](std::string_view data) {
+    out.append(data);
+  });
+  if (consumed) *consumed = used;
+  return out;
+}
+
+}  // namespace
+
+TEST(HttpFramingTest, FindHeaderCaseInsensitive) {
+  std::map<std::string, std::string> headers = {{"content-length", "42"}, {"X-Test", "a"}};
+  ASSERT_NE(find_header(headers, "Content-Length"), nullptr);
+  EXPECT_EQ(*find_header(headers, "Content-Length"), "42");
+  EXPECT_EQ(*find_header(headers, "x-test"), "a");
+  EXPECT_EQ(find_header(headers, "Transfer-Encoding"), nullptr);
+}
+
+TEST(HttpFramingTest, HeaderTokens) {
+  EXPECT_TRUE(header_has_token("keep-alive, Upgrade", "upgrade"));
+  EXPECT_TRUE(header_has_token("gzip, chunked", "chunked"));
+  EXPECT_FALSE(header_has_token("chunkedx", "chunked"));
+}
+
+TEST(HttpFramingTest, ResponseFraming) {
+  auto chunked = response_framing("POST", 200, 1, {{"Transfer-Encoding", "chunked"}, {"Content-Length", "10"}});
+  EXPECT_EQ(chunked.framing, BodyFraming::Chunked);
+  EXPECT_TRUE(chunked.keep_alive);
+
+  auto length = response_framing("GET", 200, 1, {{"content-length", "10"}});
+  EXPECT_EQ(length.framing, BodyFraming::ContentLength);
+  EXPECT_EQ(length.content_length, 10u);
+
+  auto until_close = response_framing("GET", 200, 1, {});
+  EXPECT_EQ(until_close.framing, BodyFraming::UntilClose);
+  EXPECT_FALSE(until_close.keep_alive);
+
+  EXPECT_EQ(response_framing("HEAD", 200, 1, {{"Content-Length", "10"}}).framing, BodyFraming::None);
+  EXPECT_EQ(response_framing("GET", 204, 1, {}).framing, BodyFraming::None);
+  EXPECT_FALSE(response_framing("GET", 200, 1, {{"Connection", "close"}, {"Content-Length", "1"}}).keep_alive);
+  EXPECT_FALSE(response_framing("GET", 200, 0, {{"Content-Length", "1"}}).keep_alive);
+  EXPECT_TRUE(response_framing("GET", 200, 0, {{"Connection", "keep-alive"}, {"Content-Length", "1"}}).keep_alive);
+}
+
+TEST(ChunkedDecoderTest, DecodeComplete) {
+  ChunkedDecoder decoder;
+  size_t consumed = 0;
+  std::string input = "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\nNEXT";
+  EXPECT_EQ(decode_all(decoder, input, &consumed), "hello, world");
+  EXPECT_TRUE(decoder.done());
+  EXPECT_EQ(input.substr(consumed), "NEXT");
+}
+
+TEST(ChunkedDecoderTest, DecodeByteByByte) {
+  std::string input = "a\r\n0123456789\r\n3\r\nabc\r\n0\r\n\r\n";
+  ChunkedDecoder decoder;
+  std::string out;
+  for (char c : input) {
+    out += decode_all(decoder, std::string(1, c));
+  }
+  EXPECT_EQ(out, "0123456789abc");
+  EXPECT_TRUE(decoder.done());
+}
+
+TEST(ChunkedDecoderTest, InvalidSize) {
+  ChunkedDecoder decoder;
+  decode_all(decoder, "zz\r\nhello\r\n");
+  EXPECT_TRUE(decoder.failed());
+}
+
+// ============================================================
+// 连接池测试（本地 HTTP 服务器）
+// ============================================================
+
+class HttpClientPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    io_thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  void TearDown() override {
+    client_.reset();
+    work_.reset();
+    io_thread_.join();
+  }
+
+  asio::io_context io_ctx_;
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_{asio::make_work_guard(io_ctx_)};
+  std::unique_ptr<HttpClient> client_ = std::make_unique<HttpClient>(io_ctx_);
+  std::thread io_thread_;
+};
+
+TEST_F(HttpClientPoolTest, ReusesKeepAliveConnection) {
+  TestHttpServer server([](const std::string&, const std::string& body) {
+    return TestHttpServer::response(200, "echo:" + body);
+  });
+
+  for (int i = 0; i < 3; ++i) {
+    auto response = client_->post(server.url("/echo"), std::to_string(i)).get();
+    EXPECT_EQ(response.status_code, 200);
+    EXPECT_EQ(response.body, "echo:" + std::to_string(i));
+  }
+
+  EXPECT_EQ(server.connections(), 1);
+  auto stats = client_->pool_stats();
+  EXPECT_EQ(stats.reuse_misses, 1u);
+  EXPECT_EQ(stats.reuse_hits, 2u);
+  EXPECT_EQ(stats.idle, 1u);
+}
+
+TEST_F(HttpClientPoolTest, ChunkedResponseIsDecodedAndReused) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n4\r\ndata\r\n6\r\n-chunk\r\n0\r\n\r\n");
+  });
+
+  EXPECT_EQ(client_->get(server.url()).get().body, "data-chunk");
+  EXPECT_EQ(client_->get(server.url()).get().body, "data-chunk");
+  EXPECT_EQ(server.connections(), 1);
+}
+
+TEST_F(HttpClientPoolTest, StreamingResponseReturnsConnection) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n6\r\ndata: \r\n3\r\nx\n\n\r\n0\r\n\r\n");
+  });
+
+  for (int i = 0; i < 2; ++i) {
+    std::promise<std::pair<int, std::string>> done;
+    std::string received;
+    HttpOptions options;
+    options.method = "POST";
+    options.body = "{}";
+    client_->request_stream(
+        server.url("/stream"), options,
+        [&received](const std::string& chunk) {
+          received += chunk;
+        },
+        [&done](int status, const std::string& error) {
+          done.set_value({status, error});
+        });
+    auto [status, error] = done.get_future().get();
+    EXPECT_EQ(status, 200);
+    EXPECT_TRUE(error.empty()) << error;
+    EXPECT_EQ(received, "data: x\n\n");
+  }
+
+  EXPECT_EQ(server.connections(), 1);
+  EXPECT_EQ(client_->pool_stats().reuse_hits, 1u);
+}
+
+TEST_F(HttpClientPoolTest, ConnectionCloseIsNotPooled) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, "bye", "Connection: close\r\n");
+  });
+
+  EXPECT_EQ(client_->get(server.url()).get().body, "bye");
+  EXPECT_EQ(client_->get(server.url()).get().body, "bye");
+  EXPECT_EQ(server.connections(), 2);
+  EXPECT_EQ(client_->pool_stats().idle, 0u);
+}
+
+TEST_F(HttpClientPoolTest, IdleTimeoutEvictsConnection) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, "ok");
+  });
+
+  EXPECT_EQ(client_->get(server.url()).get().body, "ok");
+  ConnectionPoolOptions options;
+  options.idle_timeout = std::chrono::seconds(0);
+  client_->set_pool_options(options);
+  EXPECT_EQ(client_->pool_stats().idle, 0u);
+  EXPECT_EQ(client_->pool_stats().evictions, 1u);
+
+  EXPECT_EQ(client_->get(server.url()).get().body, "ok");
+  EXPECT_EQ(server.connections(), 2);
+}
+
+TEST_F(HttpClientPoolTest, DroppedConnectionIsReplaced) {
+  // The server closes the socket after answering but still advertises a persistent connection
+  // (the test server drops the connection when the raw response contains "Connection: close")
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, "ok", "X-Note: Connection: close\r\n");
+  });
+
+  EXPECT_EQ(client_->get(server.url()).get().body, "ok");
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto response = client_->get(server.url()).get();
+  EXPECT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.body, "ok");
+  EXPECT_EQ(server.connections(), 2);
+}
+
+TEST_F(HttpClientPoolTest, KeepAliveDisabled) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, "ok");
+  });
+
+  HttpOptions options;
+  options.keep_alive = false;
+  EXPECT_EQ(client_->request(server.url(), options).get().body, "ok");
+  EXPECT_EQ(client_->request(server.url(), options).get().body, "ok");
+  EXPECT_EQ(server.connections(), 2);
+  EXPECT_EQ(client_->pool_stats().idle, 0u);
+}
+
+// ============================================================
+// 零拷贝流式读取测试
+// ============================================================
+
+using HttpClientStreamViewTest = HttpClientPoolTest;
+
+namespace {
+
+// Stream a request through request_stream_view; returns (status, error, concatenated body, callback count)
+std::tuple<int, std::string, std::string, int> stream_view(HttpClient& client, const std::string& url) {
+  std::promise<std::pair<int, std::string>> done;
+  std::string received;
+  int calls = 0;
+  HttpOptions options;
+  options.method = "POST";
+  options.body = "{}";
+  client.request_stream_view(
+      url, options,
+      [&received, &calls](std::string_view chunk) {
+        received.append(chunk);
+        calls++;
+      },
+      [&done](int status, const std::string& error) {
+        done.set_value({status, error});
+      });
+  auto [status, error] = done.get_future().get();
+  return {status, error, received, calls};
+}
+
+}  // namespace
+
+TEST_F(HttpClientStreamViewTest, ChunkedFramingIsRemoved) {
+  std::string expected;
+  std::string raw = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for (int i = 0; i < 200; ++i) {
+    std::string event = "event: content_block_delta\ndata: {\"index\":" + std::to_string(i) + "}\n\n";
+    expected += event;
+    char size[16];
+    std::snprintf(size, sizeof(size), "%zx", event.size());
+    raw += std::string(size) + (i % 2 ? ";ext=1" : "") + "\r\n" + event + "\r\n";
+  }
+  raw += "0\r\n\r\n";
+  TestHttpServer server([&raw](const std::string&, const std::string&) {
+    return raw;
+  });
+
+  for (int i = 0; i < 2; ++i) {
+    auto [status, error, received, calls] = stream_view(*client_, server.url("/stream"));
+    EXPECT_EQ(status, 200);
+    EXPECT_TRUE(error.empty()) << error;
+    EXPECT_EQ(received, expected);
+    EXPECT_GE(calls, 1);
+  }
+  EXPECT_EQ(server.connections(), 1);
+}
+
+TEST_F(HttpClientStreamViewTest, LargeContentLengthBody) {
+  std::string body(1024 * 1024, 'x');
+  TestHttpServer server([&body](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, body);
+  });
+
+  auto [status, error, received, calls] = stream_view(*client_, server.url("/stream"));
+  EXPECT_EQ(status, 200);
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_EQ(received.size(), body.size());
+  EXPECT_EQ(received, body);
+  EXPECT_GT(calls, 1);
+}
+
+TEST_F(HttpClientStreamViewTest, ErrorStatusReportsBody) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return std::string("HTTP/1.1 400 Bad Request\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nbad\r\n0\r\n\r\n");
+  });
+
+  auto [status, error, received, calls] = stream_view(*client_, server.url("/stream"));
+  EXPECT_EQ(status, 400);
+  EXPECT_EQ(error, "HTTP error 400: bad");
+  EXPECT_EQ(calls, 0);
+}
+
+// ============================================================
+// 响应解压测试
+// ============================================================
+
+namespace {
+
+// Compress with zlib: window_bits 31 = gzip, 15 = zlib-wrapped deflate, -15 = raw deflate
+std::string compress(const std::string& data, int window_bits) {
+  z_stream zs{};
+  deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, data.size()) + 32, '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = static_cast<uInt>(data.size());
+  zs.next_out = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = static_cast<uInt>(out.size());
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+std::string inflate_all(ContentDecoder& decoder, const std::string& input, size_t step) {
+  std::string out;
+  for (size_t pos = 0; pos < input.size(); pos += step) {
+    decoder.decode(std::string_view(input).substr(pos, step), [&out](std::string_view data) {
+      out.append(data);
+    });
+  }
+  return out;
+}
+
+std::string sample_json(size_t items) {
+  std::string json = "{\"data\":[";
+  for (size_t i = 0; i < items; ++i) {
+    json += (i ? "," : "") + std::string("{\"id\":\"model-") + std::to_string(i) + "\",\"object\":\"model\",\"owned_by\":\"org\"}";
+  }
+  return json + "]}";
+}
+
+}  // namespace
+
+TEST(ContentDecoderTest, CreateByEncoding) {
+  EXPECT_NE(ContentDecoder::create("gzip"), nullptr);
+  EXPECT_NE(ContentDecoder::create(" GZIP "), nullptr);
+  EXPECT_NE(ContentDecoder::create("x-gzip"), nullptr);
+  EXPECT_NE(ContentDecoder::create("deflate"), nullptr);
+  EXPECT_EQ(ContentDecoder::create("identity"), nullptr);
+  EXPECT_EQ(ContentDecoder::create("br"), nullptr);
+  EXPECT_EQ(ContentDecoder::create("gzip, br"), nullptr);
+}
+
+TEST(ContentDecoderTest, InflateAtAnySplit) {
+  auto json = sample_json(2000);
+  for (int window_bits : {31, 15, -15}) {
+    auto compressed = compress(json, window_bits);
+    for (size_t step : {size_t(1), size_t(7), size_t(4096), compressed.size()}) {
+      auto decoder = ContentDecoder::create(window_bits == 31 ? "gzip" : "deflate");
+      EXPECT_EQ(inflate_all(*decoder, compressed, step), json) << "window_bits=" << window_bits << " step=" << step;
+      EXPECT_TRUE(decoder->finished());
+      EXPECT_FALSE(decoder->failed());
+    }
+  }
+}
+
+TEST(ContentDecoderTest, ConcatenatedGzipMembers) {
+  auto decoder = ContentDecoder::create("gzip");
+  EXPECT_EQ(inflate_all(*decoder, compress("hello, ", 31) + compress("world", 31), 5), "hello, world");
+  EXPECT_TRUE(decoder->finished());
+}
+
+TEST(ContentDecoderTest, CorruptInputFails) {
+  auto decoder = ContentDecoder::create("gzip");
+  inflate_all(*decoder, "this is not gzip data", 64);
+  EXPECT_TRUE(decoder->failed());
+  EXPECT_FALSE(decoder->error().empty());
+
+  auto truncated = ContentDecoder::create("gzip");
+  auto compressed = compress(sample_json(100), 31);
+  inflate_all(*truncated, compressed.substr(0, compressed.size() / 2), 64);
+  EXPECT_FALSE(truncated->failed());
+  EXPECT_FALSE(truncated->finished());
+}
+
+using HttpClientDecompressTest = HttpClientPoolTest;
+
+TEST_F(HttpClientDecompressTest, GzipResponseIsInflated) {
+  auto json = sample_json(500);
+  auto compressed = compress(json, 31);
+  std::string request_head;
+  TestHttpServer server([&](const std::string& head, const std::string&) {
+    request_head = head;
+    return TestHttpServer::response(200, compressed, "Content-Encoding: gzip\r\n");
+  });
+
+  auto response = client_->get(server.url("/v1/models")).get();
+  EXPECT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.body, json);
+  EXPECT_NE(request_head.find("Accept-Encoding: gzip, deflate\r\n"), std::string::npos);
+
+  // The connection stays reusable after a compressed body
+  EXPECT_EQ(client_->get(server.url("/v1/models")).get().body, json);
+  EXPECT_EQ(server.connections(), 1);
+}
+
+TEST_F(HttpClientDecompressTest, ChunkedDeflateStream) {
+  std::string events;
+  for (int i = 0; i < 300; ++i) events += "data: {\"delta\":\"token " + std::to_string(i) + "\"}\n\n";
+  auto compressed = compress(events, 15);
+  std::string raw = "HTTP/1.1 200 OK\r\nContent-Encoding: deflate\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for (size_t pos = 0; pos < compressed.size(); pos += 100) {
+    auto part = compressed.substr(pos, 100);
+    char size[16];
+    std::snprintf(size, sizeof(size), "%zx", part.size());
+    raw += std::string(size) + "\r\n" + part + "\r\n";
+  }
+  raw += "0\r\n\r\n";
+  TestHttpServer server([&raw](const std::string&, const std::string&) {
+    return raw;
+  });
+
+  auto [status, error, received, calls] = stream_view(*client_, server.url("/stream"));
+  EXPECT_EQ(status, 200);
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_EQ(received, events);
+}
+
+TEST_F(HttpClientDecompressTest, CorruptBodyReportsError) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(200, "definitely not gzip", "Content-Encoding: gzip\r\n");
+  });
+
+  auto response = client_->get(server.url()).get();
+  EXPECT_EQ(response.error.rfind("Invalid compressed body", 0), 0u) << response.error;
+}
+
+TEST_F(HttpClientDecompressTest, DisabledOrCallerManaged) {
+  auto compressed = compress("payload", 31);
+  std::string request_head;
+  TestHttpServer server([&](const std::string& head, const std::string&) {
+    request_head = head;
+    return TestHttpServer::response(200, compressed, "Content-Encoding: gzip\r\n");
+  });
+
+  HttpOptions options;
+  options.decompress = false;
+  EXPECT_EQ(client_->request(server.url(), options).get().body, compressed);
+  EXPECT_EQ(request_head.find("Accept-Encoding"), std::string::npos);
+
+  // A caller that negotiates its own encoding gets the body as sent
+  HttpOptions manual;
+  manual.headers["Accept-Encoding"] = "gzip";
+  EXPECT_EQ(client_->request(server.url(), manual).get().body, compressed);
+}
+
+// ============================================================
+// TLS 会话缓存测试
+// ============================================================
+
+namespace {
+
+// Build a resumable TLS 1.2 client session without a network handshake
+SSL_SESSION* make_test_session(long timeout_seconds, unsigned char id_byte) {
+  SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+  SSL* ssl = SSL_new(ctx);
+  const unsigned char cipher_id[] = {0xC0, 0x2F};  // ECDHE-RSA-AES128-GCM-SHA256
+  const SSL_CIPHER* cipher = SSL_CIPHER_find(ssl, cipher_id);
+
+  SSL_SESSION* session = SSL_SESSION_new();
+  SSL_SESSION_set_protocol_version(session, TLS1_2_VERSION);
+  SSL_SESSION_set_cipher(session, cipher);
+  unsigned char master_key[48] = {};
+  unsigned char session_id[32] = {};
+  session_id[0] = id_byte;
+  SSL_SESSION_set1_master_key(session, master_key, sizeof(master_key));
+  SSL_SESSION_set1_id(session, session_id, sizeof(session_id));
+  SSL_SESSION_set_time(session, static_cast<long>(std::time(nullptr)));
+  SSL_SESSION_set_timeout(session, timeout_seconds);
+
+  SSL_free(ssl);
+  SSL_CTX_free(ctx);
+  return session;
+}
+
+std::string session_id_of(SSL_SESSION* session) {
+  unsigned int length = 0;
+  const unsigned char* id = SSL_SESSION_get_id(session, &length);
+  return std::string(reinterpret_cast<const char*>(id), length);
+}
+
+class TlsSessionCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    cache().set_persist_path({});
+    cache().set_max_entries(64);
+    cache().clear();
+  }
+
+  void TearDown() override {
+    SetUp();
+    std::filesystem::remove_all(temp_dir_);
+  }
+
+  static TlsSessionCache& cache() {
+    return TlsSessionCache::instance();
+  }
+
+  std::filesystem::path temp_dir_ = std::filesystem::temp_directory_path() / "agent_sdk_tls_cache_test";
+};
+
+}  // namespace
+
+TEST_F(TlsSessionCacheTest, StoreAndLookup) {
+  SSL_SESSION* session = make_test_session(300, 7);
+  cache().store("api.example.com:443", session);
+  EXPECT_EQ(cache().stats().stored, 1u);
+  EXPECT_EQ(cache().stats().entries, 1u);
+
+  SSL_SESSION* cached = cache().lookup("api.example.com:443");
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(session_id_of(cached), session_id_of(session));
+  EXPECT_EQ(cache().lookup("api.example.com:8443"), nullptr);
+
+  SSL_SESSION_free(cached);
+  SSL_SESSION_free(session);
+}
+
+TEST_F(TlsSessionCacheTest, ExpiredSessionIsDropped) {
+  SSL_SESSION* session = make_test_session(300, 1);
+  SSL_SESSION_set_time(session, static_cast<long>(std::time(nullptr)) - 600);
+  cache().store("old.example.com:443", session);
+  EXPECT_EQ(cache().lookup("old.example.com:443"), nullptr);
+  EXPECT_EQ(cache().stats().entries, 0u);
+  SSL_SESSION_free(session);
+}
+
+TEST_F(TlsSessionCacheTest, MaxEntries) {
+  cache().set_max_entries(2);
+  for (int i = 0; i < 3; ++i) {
+    SSL_SESSION* session = make_test_session(100 + i * 100, static_cast<unsigned char>(i));
+    cache().store("host" + std::to_string(i) + ":443", session);
+    SSL_SESSION_free(session);
+  }
+  EXPECT_EQ(cache().stats().entries, 2u);
+  // The session closest to expiry is evicted first
+  EXPECT_EQ(cache().lookup("host0:443"), nullptr);
+}
+
+TEST_F(TlsSessionCacheTest, PersistAndReload) {
+  auto path = temp_dir_ / "tls_sessions.json";
+  cache().set_persist_path(path);
+
+  SSL_SESSION* session = make_test_session(300, 42);
+  cache().store("persist.example.com:443", session);
+  // Stored from the handshake callback: the write is deferred to the writer thread or flush()
+  EXPECT_FALSE(std::filesystem::exists(path));
+  cache().flush();
+  ASSERT_TRUE(std::filesystem::exists(path));
+  auto perms = std::filesystem::status(path).permissions();
+  EXPECT_EQ(perms & (std::filesystem::perms::group_all | std::filesystem::perms::others_all), std::filesystem::perms::none);
+
+  // Simulate a new process: drop in-memory state, then load from disk
+  cache().set_persist_path({});
+  cache().clear();
+  EXPECT_EQ(cache().stats().entries, 0u);
+  cache().set_persist_path(path);
+  EXPECT_EQ(cache().stats().entries, 1u);
+
+  SSL_SESSION* cached = cache().lookup("persist.example.com:443");
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(session_id_of(cached), session_id_of(session));
+
+  SSL_SESSION_free(cached);
+  SSL_SESSION_free(session);
+}
+
+TEST_F(TlsSessionCacheTest, HandshakeStats) {
+  SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+  cache().attach(ctx);
+
+  // No cached session: a full handshake
+  SSL* first = SSL_new(ctx);
+  cache().prepare(first, "stats.example.com:443");
+  cache().record_handshake(first);
+  SSL_free(first);
+  EXPECT_EQ(cache().stats().misses, 1u);
+  EXPECT_EQ(cache().stats().rejected, 0u);
+
+  // Cached session offered but not resumed (no real handshake happened)
+  SSL_SESSION* session = make_test_session(300, 9);
+  cache().store("stats.example.com:443", session);
+  SSL* second = SSL_new(ctx);
+  cache().prepare(second, "stats.example.com:443");
+  cache().record_handshake(second);
+  SSL_free(second);
+
+  auto stats = cache().stats();
+  EXPECT_EQ(stats.hits, 0u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.rejected, 1u);
+
+  SSL_SESSION_free(session);
+  SSL_CTX_free(ctx);
+}
+
+// ============================================================
+// DNS 缓存测试（桩解析器）
+// ============================================================
+
+class DnsCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    DnsCache::instance().clear();
+    DnsCache::instance().set_resolver([this](asio::io_context& io_ctx, const std::string& host, const std::string&, ResolveCallback callback) {
+      lookups_++;
+      if (hold_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_.push_back(std::move(callback));
+        return;
+      }
+      asio::post(io_ctx, [this, host, callback]() {
+        if (host == "missing.test") {
+          callback(asio::error::host_not_found, {});
+        } else {
+          callback({}, {{asio::ip::make_address(address_), 443}});
+        }
+      });
+    });
+    io_thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  void TearDown() override {
+    work_.reset();
+    io_thread_.join();
+    DnsCache::instance().set_resolver(nullptr);
+    DnsCache::instance().set_options({});
+    DnsCache::instance().clear();
+  }
+
+  std::pair<asio::error_code, Endpoints> resolve(const std::string& host) {
+    std::promise<std::pair<asio::error_code, Endpoints>> done;
+    DnsCache::instance().resolve(io_ctx_, host, "443", [&done](const asio::error_code& ec, Endpoints endpoints) {
+      done.set_value({ec, std::move(endpoints)});
+    });
+    return done.get_future().get();
+  }
+
+  void wait_for_lookups(int count) {
+    for (int i = 0; i < 200 && lookups_.load() < count; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+
+  asio::io_context io_ctx_;
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_{asio::make_work_guard(io_ctx_)};
+  std::thread io_thread_;
+  std::atomic<int> lookups_{0};
+  std::atomic<bool> hold_{false};
+  std::string address_ = "10.0.0.1";
+  std::mutex mutex_;
+  std::vector<ResolveCallback> held_;
+};
+
+TEST_F(DnsCacheTest, FreshEntrySkipsLookup) {
+  auto [ec1, first] = resolve("api.test");
+  auto [ec2, second] = resolve("api.test");
+  EXPECT_FALSE(ec1);
+  EXPECT_FALSE(ec2);
+  ASSERT_EQ(second.size(), 1u);
+  EXPECT_EQ(second[0].address().to_string(), "10.0.0.1");
+
+  auto stats = DnsCache::instance().stats();
+  EXPECT_EQ(lookups_.load(), 1);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+}
+
+TEST_F(DnsCacheTest, StaleWhileRevalidate) {
+  DnsCacheOptions options;
+  options.ttl = std::chrono::seconds(0);
+  options.stale_ttl = std::chrono::seconds(300);
+  DnsCache::instance().set_options(options);
+
+  resolve("api.test");
+  address_ = "10.0.0.2";
+
+  // Expired entry is served immediately while a background lookup refreshes it
+  auto [ec, stale] = resolve("api.test");
+  EXPECT_FALSE(ec);
+  ASSERT_EQ(stale.size(), 1u);
+  EXPECT_EQ(stale[0].address().to_string(), "10.0.0.1");
+  wait_for_lookups(2);
+  EXPECT_EQ(lookups_.load(), 2);
+  EXPECT_EQ(DnsCache::instance().stats().stale_hits, 1u);
+
+  // Allow the refresh result to land
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto [ec2, refreshed] = resolve("api.test");
+  ASSERT_EQ(refreshed.size(), 1u);
+  EXPECT_EQ(refreshed[0].address().to_string(), "10.0.0.2");
+}
+
+TEST_F(DnsCacheTest, NegativeCaching) {
+  auto [ec1, first] = resolve("missing.test");
+  auto [ec2, second] = resolve("missing.test");
+  EXPECT_EQ(ec1, asio::error::host_not_found);
+  EXPECT_EQ(ec2, asio::error::host_not_found);
+  EXPECT_TRUE(second.empty());
+  EXPECT_EQ(lookups_.load(), 1);
+  EXPECT_EQ(DnsCache::instance().stats().negative_hits, 1u);
+}
+
+TEST_F(DnsCacheTest, NegativeEntryExpires) {
+  DnsCacheOptions options;
+  options.negative_ttl = std::chrono::seconds(0);
+  DnsCache::instance().set_options(options);
+
+  resolve("missing.test");
+  resolve("missing.test");
+  EXPECT_EQ(lookups_.load(), 2);
+}
+
+TEST_F(DnsCacheTest, ConcurrentMissesShareLookup) {
+  hold_ = true;
+  std::atomic<int> answered{0};
+  for (int i = 0; i < 3; ++i) {
+    DnsCache::instance().resolve(io_ctx_, "api.test", "443", [&answered](const asio::error_code& ec, Endpoints endpoints) {
+      if (!ec && endpoints.size() == 1) answered++;
+    });
+  }
+  EXPECT_EQ(lookups_.load(), 1);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ASSERT_EQ(held_.size(), 1u);
+    held_[0]({}, {{asio::ip::make_address("10.0.0.3"), 443}});
+  }
+  for (int i = 0; i < 200 && answered.load() < 3; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(answered.load(), 3);
+  EXPECT_EQ(DnsCache::instance().stats().misses, 3u);
+}
+
+TEST_F(DnsCacheTest, LookupDoesNotDependOnCallerContext) {
+  // The first caller's io_context never runs, yet its lookup must still complete for everyone else
+  asio::io_context idle_ctx;
+  DnsCache::instance().resolve(idle_ctx, "api.test", "443", [](const asio::error_code&, Endpoints) {});
+
+  auto [ec, endpoints] = resolve("api.test");
+  EXPECT_FALSE(ec);
+  ASSERT_EQ(endpoints.size(), 1u);
+  EXPECT_EQ(lookups_.load(), 1);
+}
+
+TEST_F(DnsCacheTest, InvalidateForcesLookup) {
+  resolve("api.test");
+  DnsCache::instance().invalidate("api.test", "443");
+  resolve("api.test");
+  EXPECT_EQ(lookups_.load(), 2);
+}
+
+TEST_F(DnsCacheTest, HttpClientUsesCache) {
+  TestHttpServer server([](const std::string& head, const std::string&) {
+    return TestHttpServer::response(200, head.find("Host: stub.test") != std::string::npos ? "host ok" : "bad host");
+  });
+  DnsCache::instance().set_resolver([](asio::io_context& io_ctx, const std::string&, const std::string& port, ResolveCallback callback) {
+    asio::post(io_ctx, [port, callback]() {
+      callback({}, {{asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(std::stoi(port))}});
+    });
+  });
+
+  HttpClient client(io_ctx_);
+  HttpOptions options;
+  options.keep_alive = false;
+  auto url = "http://stub.test:" + std::to_string(server.port()) + "/";
+  EXPECT_EQ(client.request(url, options).get().body, "host ok");
+  EXPECT_EQ(client.request(url, options).get().body, "host ok");
+
+  auto stats = DnsCache::instance().stats();
+  EXPECT_EQ(stats.lookups, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+}
+
+// ============================================================
+// 请求调度器测试
+// ============================================================
+
+class RequestSchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RequestScheduler::instance().clear();
+    io_thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  void TearDown() override {
+    // Release every slot, including those of queued requests as they start, so no host state leaks into the next test
+    for (size_t seen = 0;;) {
+      std::vector<RequestScheduler::Release> releases;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_.size() == seen) break;
+        seen = started_.size();
+        for (const auto& [label, release] : releases_) releases.push_back(release);
+      }
+      for (const auto& release : releases) release();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    work_.reset();
+    io_thread_.join();
+    RequestScheduler::instance().clear();
+  }
+
+  // Submit a request that records its label when it starts and holds its slot until finish(label)
+  void submit(const std::string& label, RequestPriority priority, const std::string& host = "http://sched.test:80") {
+    RequestScheduler::instance().submit(io_ctx_, host, priority, [this, label](RequestScheduler::Release release) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      started_.push_back(label);
+      releases_[label] = std::move(release);
+    });
+  }
+
+  void finish(const std::string& label) {
+    RequestScheduler::Release release;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      release = releases_.at(label);
+    }
+    release();
+  }
+
+  std::vector<std::string> started(size_t wait_for = 0) {
+    for (int i = 0; i < 200; ++i) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_.size() >= wait_for) return started_;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_;
+  }
+
+  asio::io_context io_ctx_;
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_{asio::make_work_guard(io_ctx_)};
+  std::thread io_thread_;
+  std::mutex mutex_;
+  std::vector<std::string> started_;
+  std::map<std::string, RequestScheduler::Release> releases_;
+};
+
+TEST_F(RequestSchedulerTest, HostCapQueuesExtraRequests) {
+  RequestScheduler::instance().set_options({2, 0});
+  submit("a", RequestPriority::Interactive);
+  submit("b", RequestPriority::Interactive);
+  submit("c", RequestPriority::Interactive);
+  submit("other", RequestPriority::Interactive, "http://other.test:80");
+  EXPECT_EQ(started(), (std::vector<std::string>{"a", "b", "other"}));
+
+  auto stats = RequestScheduler::instance().stats();
+  EXPECT_EQ(stats[RequestPriority::Interactive].in_flight, 3u);
+  EXPECT_EQ(stats[RequestPriority::Interactive].queued, 1u);
+  EXPECT_EQ(stats.hosts, 2u);
+
+  finish("a");
+  finish("a");  // A second release is ignored
+  EXPECT_EQ(started(4).back(), "c");
+  stats = RequestScheduler::instance().stats();
+  EXPECT_EQ(stats[RequestPriority::Interactive].in_flight, 3u);
+  EXPECT_EQ(stats[RequestPriority::Interactive].queued, 0u);
+}
+
+TEST_F(RequestSchedulerTest, HigherPriorityGoesFirst) {
+  RequestScheduler::instance().set_options({1, 0});
+  submit("running", RequestPriority::Interactive);
+  submit("compact", RequestPriority::Background);
+  submit("child", RequestPriority::Subagent);
+  submit("user", RequestPriority::Interactive);
+
+  finish("running");
+  EXPECT_EQ(started(2).back(), "user");
+  finish("user");
+  EXPECT_EQ(started(3).back(), "child");
+  finish("child");
+  EXPECT_EQ(started(4).back(), "compact");
+}
+
+TEST_F(RequestSchedulerTest, FifoWithinClass) {
+  RequestScheduler::instance().set_options({1, 0});
+  submit("running", RequestPriority::Subagent);
+  for (const auto* label : {"s1", "s2", "s3"}) submit(label, RequestPriority::Subagent);
+  finish("running");
+  // Arrives after a slot was freed, but s2 and s3 are still queued ahead of it
+  submit("s4", RequestPriority::Subagent);
+
+  size_t count = 2;
+  for (const auto* label : {"s1", "s2", "s3"}) {
+    EXPECT_EQ(started(count++).back(), label);
+    finish(label);
+  }
+  EXPECT_EQ(started(5), (std::vector<std::string>{"running", "s1", "s2", "s3", "s4"}));
+}
+
+TEST_F(RequestSchedulerTest, InteractiveReserve) {
+  RequestScheduler::instance().set_options({2, 1});
+  submit("child1", RequestPriority::Subagent);
+  submit("child2", RequestPriority::Subagent);
+  submit("user", RequestPriority::Interactive);
+  EXPECT_EQ(started(), (std::vector<std::string>{"child1", "user"}));
+
+  // Subagents share what is left after the reserve, whether or not the reserved slot is busy
+  finish("child1");
+  EXPECT_EQ(started(3).back(), "child2");
+
+  // A per-host limit overrides the default
+  RequestScheduler::instance().set_host_limit("http://wide.test:80", 0);
+  for (int i = 0; i < 5; ++i) submit("bg" + std::to_string(i), RequestPriority::Background, "http://wide.test:80");
+  EXPECT_EQ(started().size(), 8u);
+}
+
+TEST_F(RequestSchedulerTest, WaitTimeMetrics) {
+  RequestScheduler::instance().set_options({1, 0});
+  submit("running", RequestPriority::Interactive);
+  submit("compact", RequestPriority::Background);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  finish("running");
+  started(2);
+
+  auto stats = RequestScheduler::instance().stats();
+  const auto& background = stats[RequestPriority::Background];
+  EXPECT_EQ(background.submitted, 1u);
+  EXPECT_EQ(background.dispatched, 1u);
+  EXPECT_EQ(background.queued_total, 1u);
+  EXPECT_EQ(background.max_queued, 1u);
+  EXPECT_GE(background.max_wait, std::chrono::milliseconds(20));
+  EXPECT_EQ(background.average_wait(), background.max_wait);
+  EXPECT_EQ(stats[RequestPriority::Interactive].queued_total, 0u);
+  EXPECT_EQ(stats[RequestPriority::Interactive].max_wait.count(), 0);
+}
+
+TEST_F(RequestSchedulerTest, HttpClientHoldsSlotPerRequest) {
+  TestHttpServer server([](const std::string&, const std::string& body) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return TestHttpServer::response(200, "echo:" + body);
+  });
+  RequestScheduler::instance().set_host_limit("http://127.0.0.1:" + std::to_string(server.port()), 1);
+
+  HttpClient client(io_ctx_);
+  auto url = "http://127.0.0.1:" + std::to_string(server.port()) + "/";
+  std::vector<std::future<HttpResponse>> futures;
+  for (int i = 0; i < 3; ++i) {
+    HttpOptions options;
+    options.method = "POST";
+    options.body = std::to_string(i);
+    options.priority = RequestPriority::Subagent;
+    futures.push_back(client.request(url, options));
+  }
+  for (int i = 0; i < 3; ++i) EXPECT_EQ(futures[i].get().body, "echo:" + std::to_string(i));
+
+  auto stats = RequestScheduler::instance().stats();
+  EXPECT_EQ(stats[RequestPriority::Subagent].dispatched, 3u);
+  EXPECT_EQ(stats[RequestPriority::Subagent].queued_total, 2u);
+  EXPECT_EQ(stats[RequestPriority::Subagent].in_flight, 0u);
+}
+
+TEST_F(RequestSchedulerTest, ClientDestroyedWhileQueued) {
+  RequestScheduler::instance().set_options({1, 0});
+  submit("running", RequestPriority::Interactive, "http://gone.test:80");
+
+  auto client = std::make_unique<HttpClient>(io_ctx_);
+  auto response = client->request("http://gone.test/", HttpOptions{});
+  std::promise<std::string> done;
+  client->request_stream_view("http://gone.test/", HttpOptions{}, [](std::string_view) {}, [&done](int, const std::string& error) {
+    done.set_value(error);
+  });
+  client.reset();
+
+  // The queued requests start after their client is gone: they hand their slots back and report cancellation
+  finish("running");
+  ASSERT_EQ(response.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+  EXPECT_EQ(response.get().error, "Request cancelled");
+  auto error = done.get_future();
+  ASSERT_EQ(error.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+  EXPECT_EQ(error.get(), "Request cancelled");
+  for (int i = 0; i < 200 && RequestScheduler::instance().stats()[RequestPriority::Interactive].in_flight > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(RequestScheduler::instance().stats()[RequestPriority::Interactive].in_flight, 0u);
+}
+
+TEST_F(RequestSchedulerTest, ClientDestroyedInFlight) {
+  TestHttpServer server([](const std::string&, const std::string& body) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return TestHttpServer::response(200, "echo:" + body);
+  });
+
+  auto client = std::make_unique<HttpClient>(io_ctx_);
+  auto response = client->post(server.url(), "late");
+  std::promise<std::string> done;
+  std::string received;
+  client->request_stream_view(
+      server.url(), HttpOptions{},
+      [&received](std::string_view chunk) {
+        received.append(chunk);
+      },
+      [&done](int, const std::string& error) {
+        done.set_value(error);
+      });
+  client.reset();
+
+  // Requests already dispatched keep the client alive until they complete and hand their slots back
+  ASSERT_EQ(response.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(response.get().body, "echo:late");
+  EXPECT_EQ(done.get_future().get(), "");
+  EXPECT_EQ(received, "echo:");
+  for (int i = 0; i < 200 && RequestScheduler::instance().stats()[RequestPriority::Interactive].in_flight > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(RequestScheduler::instance().stats()[RequestPriority::Interactive].in_flight, 0u);
+}
+
+// ============================================================
+// 重试策略测试
+// ============================================================
+
+TEST(RetryPolicyTest, RetryableStatus) {
+  for (int status : {0, 408, 429, 500, 502, 503, 504, 529}) EXPECT_TRUE(RetryPolicy::retryable_status(status, "")) << status;
+  for (int status : {200, 400, 401, 403, 404, 422}) EXPECT_FALSE(RetryPolicy::retryable_status(status, "")) << status;
+  EXPECT_FALSE(RetryPolicy::retryable_status(429, R"({"error":{"code":"insufficient_quota"}})"));
+
+  EXPECT_TRUE(RetryPolicy::retryable_error("HTTP error 529: {\"type\":\"overloaded_error\"}"));
+  EXPECT_TRUE(RetryPolicy::retryable_error("HTTP error: 503"));
+  EXPECT_FALSE(RetryPolicy::retryable_error("HTTP error 400: bad request"));
+  EXPECT_TRUE(RetryPolicy::retryable_error("Request timed out"));
+  EXPECT_TRUE(RetryPolicy::retryable_error("Read failed: Connection reset by peer"));
+  EXPECT_FALSE(RetryPolicy::retryable_error("Invalid URL"));
+}
+
+TEST(RetryPolicyTest, FullJitterBackoff) {
+  RetryPolicy policy;
+  policy.base_delay = std::chrono::milliseconds(100);
+  policy.max_delay = std::chrono::milliseconds(350);
+
+  std::chrono::milliseconds highest{0};
+  for (int i = 0; i < 500; ++i) {
+    auto first = policy.backoff(0);
+    EXPECT_GE(first.count(), 0);
+    EXPECT_LE(first.count(), 100);
+    auto capped = policy.backoff(10);
+    EXPECT_LE(capped.count(), 350);
+    highest = std::max(highest, capped);
+  }
+  // Jitter spreads over the whole range rather than clustering at the ceiling
+  EXPECT_GT(highest.count(), 200);
+}
+
+TEST(RetryPolicyTest, ServerDelayHeaders) {
+  auto now = std::chrono::system_clock::from_time_t(784111777);  // Sun, 06 Nov 1994 08:49:37 GMT
+  using std::chrono::milliseconds;
+
+  EXPECT_EQ(RetryPolicy::server_delay(503, {{"Retry-After", "7"}}, now), milliseconds(7000));
+  EXPECT_EQ(RetryPolicy::server_delay(503, {{"retry-after", "Sun, 06 Nov 1994 08:50:07 GMT"}}, now), milliseconds(30000));
+  EXPECT_EQ(RetryPolicy::server_delay(429, {{"retry-after-ms", "250"}, {"retry-after", "9"}}, now), milliseconds(250));
+
+  // Rate-limit resets count only on 429 and only for exhausted limits
+  std::map<std::string, std::string> anthropic = {{"anthropic-ratelimit-requests-remaining", "0"},
+                                                   {"anthropic-ratelimit-requests-reset", "1994-11-06T08:49:42Z"},
+                                                   {"anthropic-ratelimit-tokens-remaining", "5000"},
+                                                   {"anthropic-ratelimit-tokens-reset", "1994-11-06T08:59:37Z"}};
+  EXPECT_EQ(RetryPolicy::server_delay(429, anthropic, now), milliseconds(5000));
+  EXPECT_EQ(RetryPolicy::server_delay(200, anthropic, now), std::nullopt);
+
+  std::map<std::string, std::string> openai = {{"x-ratelimit-remaining-requests", "0"},
+                                               {"x-ratelimit-reset-requests", "1m30s"},
+                                               {"x-ratelimit-remaining-tokens", "0"},
+                                               {"x-ratelimit-reset-tokens", "20ms"}};
+  EXPECT_EQ(RetryPolicy::server_delay(429, openai, now), milliseconds(90000));
+  EXPECT_EQ(RetryPolicy::server_delay(429, {{"Retry-After", "soon"}}, now), std::nullopt);
+}
+
+TEST(RetryPolicyTest, NextDelay) {
+  RetryPolicy policy;
+  policy.max_retries = 2;
+  policy.base_delay = std::chrono::milliseconds(10);
+  policy.max_server_delay = std::chrono::milliseconds(5000);
+
+  EXPECT_TRUE(policy.next_delay(0, 503, "", {}, false));
+  EXPECT_FALSE(policy.next_delay(2, 503, "", {}, false));  // Out of attempts
+  EXPECT_FALSE(policy.next_delay(0, 400, "", {}, false));
+  EXPECT_EQ(policy.next_delay(0, 429, "", {{"Retry-After", "2"}}, false), std::chrono::milliseconds(2000));
+  EXPECT_FALSE(policy.next_delay(0, 429, "", {{"Retry-After", "60"}}, false));  // Longer than max_server_delay
+
+  // A stream that already delivered bytes is only replayed when the request is idempotent
+  EXPECT_TRUE(policy.next_delay(0, 0, "Read failed", {}, true));
+  policy.kind = RetryKind::Streaming;
+  EXPECT_FALSE(policy.next_delay(0, 0, "Read failed", {}, true));
+  EXPECT_TRUE(policy.next_delay(0, 0, "Read failed", {}, false));
+}
+
+class RetryBudgetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RetryBudget::instance().set_options({2, 0, 0.5});
+    RetryBudget::instance().clear();
+  }
+
+  void TearDown() override {
+    RetryBudget::instance().set_options({});
+    RetryBudget::instance().clear();
+  }
+};
+
+TEST_F(RetryBudgetTest, TokenBucket) {
+  auto& budget = RetryBudget::instance();
+  EXPECT_TRUE(budget.try_acquire());
+  EXPECT_TRUE(budget.try_acquire());
+  EXPECT_FALSE(budget.try_acquire());
+
+  // Two successes earn back one retry
+  budget.record_success();
+  EXPECT_FALSE(budget.try_acquire());
+  budget.record_success();
+  EXPECT_TRUE(budget.try_acquire());
+
+  auto stats = budget.stats();
+  EXPECT_EQ(stats.granted, 3u);
+  EXPECT_EQ(stats.denied, 2u);
+  EXPECT_DOUBLE_EQ(stats.tokens, 0.0);
+}
+
+class HttpClientRetryTest : public HttpClientPoolTest {
+ protected:
+  void SetUp() override {
+    HttpClientPoolTest::SetUp();
+    RetryBudget::instance().clear();
+  }
+
+  void TearDown() override {
+    HttpClientPoolTest::TearDown();
+    RetryBudget::instance().set_options({});
+    RetryBudget::instance().clear();
+  }
+
+  static HttpOptions retry_options(int max_retries, RetryKind kind = RetryKind::Idempotent) {
+    HttpOptions options;
+    options.retry.max_retries = max_retries;
+    options.retry.base_delay = std::chrono::milliseconds(1);
+    options.retry.kind = kind;
+    return options;
+  }
+};
+
+TEST_F(HttpClientRetryTest, RetriesUntilSuccess) {
+  std::atomic<int> calls{0};
+  TestHttpServer server([&calls](const std::string&, const std::string&) {
+    return calls++ < 2 ? TestHttpServer::response(503, "busy") : TestHttpServer::response(200, "ok");
+  });
+
+  auto response = client_->request(server.url(), retry_options(3)).get();
+  EXPECT_EQ(response.status_code, 200);
+  EXPECT_EQ(response.body, "ok");
+  EXPECT_EQ(calls.load(), 3);
+  EXPECT_EQ(RetryBudget::instance().stats().granted, 2u);
+}
+
+TEST_F(HttpClientRetryTest, HonoursRetryAfter) {
+  std::atomic<int> calls{0};
+  TestHttpServer server([&calls](const std::string&, const std::string&) {
+    return calls++ == 0 ? TestHttpServer::response(429, "slow down", "retry-after-ms: 150\r\n") : TestHttpServer::response(200, "ok");
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(client_->request(server.url(), retry_options(1)).get().body, "ok");
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+}
+
+TEST_F(HttpClientRetryTest, GivesUpOnClientErrorsAndExhaustedBudget) {
+  std::atomic<int> calls{0};
+  TestHttpServer server([&calls](const std::string& head, const std::string&) {
+    calls++;
+    return TestHttpServer::response(head.find("/bad") != std::string::npos ? 400 : 503, "no");
+  });
+
+  EXPECT_EQ(client_->request(server.url("/bad"), retry_options(3)).get().status_code, 400);
+  EXPECT_EQ(calls.load(), 1);
+
+  // One token left: the second attempt is allowed, the third is refused
+  RetryBudget::instance().set_options({1, 0, 0});
+  calls = 0;
+  EXPECT_EQ(client_->request(server.url(), retry_options(3)).get().status_code, 503);
+  EXPECT_EQ(calls.load(), 2);
+  EXPECT_EQ(RetryBudget::instance().stats().denied, 1u);
+}
+
+TEST_F(HttpClientRetryTest, StreamRetriedBeforeFirstByte) {
+  std::atomic<int> calls{0};
+  TestHttpServer server([&calls](const std::string&, const std::string&) {
+    return calls++ == 0 ? TestHttpServer::response(529, "overloaded", "Retry-After: 0\r\n") : TestHttpServer::response(200, "data: hi\n\n");
+  });
+
+  std::promise<std::pair<int, std::string>> done;
+  std::string received;
+  client_->request_stream_view(
+      server.url(), retry_options(2, RetryKind::Streaming),
+      [&received](std::string_view chunk) {
+        received.append(chunk);
+      },
+      [&done](int status, const std::string& error) {
+        done.set_value({status, error});
+      });
+  auto [status, error] = done.get_future().get();
+  EXPECT_EQ(status, 200);
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_EQ(received, "data: hi\n\n");  // The error body never reached the caller
+  EXPECT_EQ(calls.load(), 2);
+}
+
+TEST_F(HttpClientRetryTest, StreamCompletionCarriesHeaders) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(429, "slow down", "retry-after-ms: 1500\r\n");
+  });
+
+  std::promise<std::optional<std::chrono::milliseconds>> done;
+  client_->request_stream_view(
+      server.url(), retry_options(0, RetryKind::Streaming), [](std::string_view) {},
+      [&done](int status, const std::string&, const std::map<std::string, std::string>& headers) {
+        done.set_value(RetryPolicy::server_delay(status, headers));
+      });
+  EXPECT_EQ(done.get_future().get(), std::chrono::milliseconds(1500));
+}
+
+TEST_F(HttpClientRetryTest, CancelAbortsPendingRetries) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(503, "busy", "retry-after-ms: 5000\r\n");
+  });
+
+  auto response = client_->request(server.url(), retry_options(3));
+  std::promise<std::pair<int, std::string>> done;
+  client_->request_stream_view(
+      server.url(), retry_options(3, RetryKind::Streaming), [](std::string_view) {},
+      [&done](int status, const std::string& error) {
+        done.set_value({status, error});
+      });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = std::chrono::steady_clock::now();
+  client_->cancel();
+
+  EXPECT_EQ(response.get().error, "Request cancelled");
+  EXPECT_EQ(done.get_future().get().second, "Request cancelled");
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+  // Requests issued after cancel() are unaffected
+  EXPECT_EQ(client_->request(server.url(), HttpOptions{}).get().status_code, 503);
+}
+
+TEST_F(HttpClientRetryTest, ClientDestroyedDuringBackoff) {
+  TestHttpServer server([](const std::string&, const std::string&) {
+    return TestHttpServer::response(503, "busy", "retry-after-ms: 5000\r\n");
+  });
+
+  auto response = client_->request(server.url(), retry_options(3));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = std::chrono::steady_clock::now();
+  client_.reset();
+
+  // The backoff ends with the client and the request reports cancellation, not retried
+  ASSERT_EQ(response.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+  EXPECT_EQ(response.get().error, "Request cancelled");
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+  EXPECT_EQ(server.connections(), 1);
+}
+
+// ============================================================
+// 协程接口测试
+// ============================================================
+
+using HttpClientAwaitableTest = HttpClientPoolTest;
+
+TEST_F(HttpClientAwaitableTest, SequentialRequestsInOneCoroutine) {
+  TestHttpServer server([](const std::string&, const std::string& body) {
+    return TestHttpServer::response(200, "echo:" + body);
+  });
+
+  auto bodies = asio::co_spawn(
+      io_ctx_,
+      [this, &server]() -> asio::awaitable<std::vector<std::string>> {
+        std::vector<std::string> bodies;
+        for (int i = 0; i < 3; ++i) {
+          HttpOptions options;
+          options.method = "POST";
+          options.body = std::to_string(i);
+          auto response = co_await client_->async_request(server.url("/echo"), options);
+          bodies.push_back(response.body);
+        }
+        co_return bodies;
+      },
+      asio::use_future);
+
+  EXPECT_EQ(bodies.get(), (std::vector<std::string>{"echo:0", "echo:1", "echo:2"}));
+  EXPECT_EQ(client_->pool_stats().reuse_hits, 2u);
+}
+
+TEST_F(HttpClientAwaitableTest, ErrorsAreReturnedNotThrown) {
+  auto response = asio::co_spawn(io_ctx_, client_->async_request("not a url", HttpOptions{}), asio::use_future).get();
+  EXPECT_EQ(response.status_code, 0);
+  EXPECT_FALSE(response.error.empty());
+}
+
+// ============================================================
+// SSE 解析测试
+// ============================================================
+
+struct ParsedSse {
+  std::string event;
+  std::string data;
+  std::string id;
+
+  bool operator==(const ParsedSse&) const = default;
+};
+
+// Feed the stream split at the given offsets
+static std::vector<ParsedSse> parse_sse(std::string_view stream, const std::vector<size_t>& splits = {}) {
+  std::vector<ParsedSse> events;
+  SseParser parser([&events](const SseEventView& event) {
+    events.push_back({std::string(event.event), std::string(event.data), std::string(event.id)});
+  });
+  size_t pos = 0;
+  for (size_t split : splits) {
+    parser.feed(stream.substr(pos, split - pos));
+    pos = split;
+  }
+  parser.feed(stream.substr(pos));
+  return events;
+}
+
+TEST(SseParserTest, FieldsAndMultiLineData) {
+  auto events = parse_sse(
+      ": keep-alive\n"
+      "event: content_block_delta\n"
+      "data: {\"a\":1}\n\n"
+      "id: 7\n"
+      "data: line one\n"
+      "data:line two\n"
+      "data\n"
+      "\n");
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0], (ParsedSse{"content_block_delta", "{\"a\":1}", ""}));
+  // Only one leading space is stripped; a bare field name is an empty value
+  EXPECT_EQ(events[1], (ParsedSse{"", "line one\nline two\n", "7"}));
+}
+
+TEST(SseParserTest, LineEndings) {
+  auto expected = std::vector<ParsedSse>{{"a", "1", ""}, {"", "2", ""}, {"", "3", ""}};
+  EXPECT_EQ(parse_sse("event: a\r\ndata: 1\r\n\r\ndata: 2\r\rdata: 3\n\n"), expected);
+  EXPECT_EQ(parse_sse("event: a\rdata: 1\r\rdata: 2\n\ndata: 3\r\n\n"), expected);
+}
+
+TEST(SseParserTest, EventStateAndIds) {
+  using namespace std::string_view_literals;
+  auto stream =
+      "event: ignored\n\n"     // No data: not dispatched, and the type does not leak into the next event
+      "id: 1\ndata: a\n\n"
+      "data: b\n\n"            // The last event ID carries over
+      "id: 2\0x\ndata: c\n\n"  // An id containing NUL is ignored
+      "retry: 1500\nretry: x\n"
+      "data: pending"sv;       // No blank line yet: not dispatched
+  std::vector<ParsedSse> events;
+  SseParser parser([&events](const SseEventView& event) {
+    events.push_back({std::string(event.event), std::string(event.data), std::string(event.id)});
+  });
+  parser.feed(stream);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0], (ParsedSse{"", "a", "1"}));
+  EXPECT_EQ(events[1], (ParsedSse{"", "b", "1"}));
+  EXPECT_EQ(events[2], (ParsedSse{"", "c", "1"}));
+  EXPECT_EQ(parser.retry(), std::chrono::milliseconds(1500));
+  EXPECT_EQ(parser.last_event_id(), "1");
+
+  // reset() drops the pending event
+  parser.reset();
+  parser.feed("\n");
+  EXPECT_EQ(events.size(), 3u);
+}
+
+TEST(SseParserTest, ByteOrderMark) {
+  EXPECT_EQ(parse_sse("\xEF\xBB\xBF" "data: x\n\n", {1, 2}), (std::vector<ParsedSse>{{"", "x", ""}}));
+  // A BOM is only skipped at the start of the stream
+  EXPECT_EQ(parse_sse("data: x\n\n\xEF\xBB\xBF" "data: y\n\n").size(), 1u);
+}
+
+TEST(SseParserTest, AnySplitMatchesWholeStream) {
+  std::string stream =
+      "\xEF\xBB\xBF: comment\r\n"
+      "event: message_start\r\n"
+      "data: {\"type\":\"message_start\"}\r\n\r\n"
+      "event: content_block_delta\n"
+      "id: 42\n"
+      "data: {\"text\":\"hello\"}\n"
+      "data: second\n\n"
+      "data: cr only\r\r"
+      "data: [DONE]\r\n\n";
+  auto expected = parse_sse(stream);
+  ASSERT_EQ(expected.size(), 4u);
+  EXPECT_EQ(expected[1], (ParsedSse{"content_block_delta", "{\"text\":\"hello\"}\nsecond", "42"}));
+
+  for (size_t i = 0; i <= stream.size(); ++i) {
+    ASSERT_EQ(parse_sse(stream, {i}), expected) << "split at " << i;
+    for (size_t j = i; j <= stream.size(); j += 7) {
+      ASSERT_EQ(parse_sse(stream, {i, j}), expected) << "split at " << i << ", " << j;
+    }
+  }
+
+  // One byte at a time
+  std::vector<size_t> every_byte;
+  for (size_t i = 1; i < stream.size(); ++i) every_byte.push_back(i);
+  EXPECT_EQ(parse_sse(stream, every_byte), expected);
+}
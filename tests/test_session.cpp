@@ -1,6 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "bus/bus.hpp"
+#include "llm/ollama.hpp"
 #include "session/session.hpp"
+#include "tool/permission.hpp"
 
 using namespace agent;
 
@@ -103,3 +114,731 @@ TEST_F(SessionTest, GetContextMessagesNoSummary) {
   auto context = session->get_context_messages();
   ASSERT_EQ(context.size(), 2);
 }
+
+// ============================================================
+// 工具推测执行测试
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Plays one scripted response per stream() call, synchronously
+class ScriptedProvider : public llm::Provider {
+ public:
+  using Turn = std::function<void(llm::StreamCallback& callback)>;
+
+  explicit ScriptedProvider(std::vector<Turn> turns) : turns_(std::move(turns)) {}
+
+  std::string name() const override {
+    return "scripted";
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return {};
+  }
+
+  std::future<llm::LlmResponse> complete(const llm::LlmRequest&) override {
+    std::promise<llm::LlmResponse> promise;
+    promise.set_value({});
+    return promise.get_future();
+  }
+
+  void stream(const llm::LlmRequest& request, llm::StreamCallback callback, std::function<void()> on_complete) override {
+    bodies.push_back(request.to_anthropic_body());
+    if (turn_ < turns_.size()) turns_[turn_++](callback);
+    on_complete();
+  }
+
+  void cancel() override {}
+
+  std::vector<std::string> bodies;  // Every request as sent
+
+ private:
+  std::vector<Turn> turns_;
+  size_t turn_ = 0;
+};
+
+// Records when it started
+class ProbeTool : public SimpleTool {
+ public:
+  ProbeTool(std::string id, bool read_only) : SimpleTool(std::move(id), "probe"), read_only_(read_only) {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  bool is_read_only() const override {
+    return read_only_;
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    {
+      std::lock_guard lock(mutex_);
+      started_at_ = Clock::now();
+    }
+    return std::async(std::launch::async, []() {
+      return ToolResult::success("ok");
+    });
+  }
+
+  std::optional<Clock::time_point> started_at() const {
+    std::lock_guard lock(mutex_);
+    return started_at_;
+  }
+
+ private:
+  bool read_only_;
+  mutable std::mutex mutex_;
+  std::optional<Clock::time_point> started_at_;
+};
+
+// Installs a provider in place of the built-in "ollama" one and registers tools, for its own lifetime:
+// whatever the test does, the registry, the provider factory and the permission cache are restored.
+// config uses the provider and allows the added tools.
+class SessionHarness {
+ public:
+  using MakeProvider = std::function<std::shared_ptr<llm::Provider>(asio::io_context& io_ctx)>;
+
+  // threads: run io_ctx on that many threads (for prompt_async); prompt() needs none
+  explicit SessionHarness(MakeProvider provider, size_t threads = 0) : threads_(threads) {
+    PermissionManager::instance().clear_cache();
+    llm::ProviderFactory::instance().create("ollama", {}, io_ctx);  // Make sure the built-ins are registered before overriding
+    llm::ProviderFactory::instance().register_provider("ollama", [provider = std::move(provider)](const ProviderConfig&, asio::io_context& ctx) {
+      return provider(ctx);
+    });
+    config.default_model = "test-model";
+    config.providers["ollama"] = ProviderConfig{};
+    for (auto& thread : threads_) {
+      thread = std::thread([this]() {
+        io_ctx.run();
+      });
+    }
+  }
+
+  ~SessionHarness() {
+    work_.reset();
+    for (auto& thread : threads_) thread.join();
+    llm::ProviderFactory::instance().register_provider("ollama", [](const ProviderConfig& cfg, asio::io_context& ctx) {
+      return std::make_shared<llm::OllamaProvider>(cfg, ctx);
+    });
+    for (const auto& name : tools_) ToolRegistry::instance().unregister_tool(name);
+    PermissionManager::instance().clear_cache();
+  }
+
+  void add_tool(std::shared_ptr<Tool> tool, Permission permission = Permission::Allow) {
+    auto agent = config.get_or_create_agent(AgentType::Build);
+    agent.permissions[tool->id()] = permission;
+    config.agents[agent.id] = agent;
+    tools_.push_back(tool->id());
+    ToolRegistry::instance().register_tool(std::move(tool));
+  }
+
+  std::shared_ptr<Session> session() {
+    return Session::create(io_ctx, config, AgentType::Build);
+  }
+
+  asio::io_context io_ctx;
+  Config config;
+
+ private:
+  std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_{asio::make_work_guard(io_ctx)};
+  std::vector<std::thread> threads_;
+  std::vector<std::string> tools_;
+};
+
+struct SpeculationRun {
+  std::optional<Clock::time_point> read_started;
+  std::optional<Clock::time_point> write_started;
+  Clock::time_point stream_finished;
+  size_t tool_results = 0;
+};
+
+// One response calling a read-only and a side-effecting tool, then a plain answer
+SpeculationRun run_speculation(bool speculative) {
+  SpeculationRun run;
+  auto provider = std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{
+      [&run](llm::StreamCallback& callback) {
+        callback(llm::ToolCallDelta{"call_read", "spec_read", ""});
+        callback(llm::ToolCallComplete{"call_read", "spec_read", json{{"path", "a.txt"}}});
+        callback(llm::ToolCallDelta{"call_write", "spec_write", ""});
+        callback(llm::ToolCallComplete{"call_write", "spec_write", json{{"path", "b.txt"}}});
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));  // The model is still generating
+        run.stream_finished = Clock::now();
+        callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+      },
+      [](llm::StreamCallback& callback) {
+        callback(llm::TextDelta{"done"});
+        callback(llm::FinishStep{FinishReason::Stop, {}});
+      },
+  });
+
+  SessionHarness harness([provider](asio::io_context&) {
+    return provider;
+  });
+  auto read_tool = std::make_shared<ProbeTool>("spec_read", true);
+  auto write_tool = std::make_shared<ProbeTool>("spec_write", false);
+  harness.add_tool(read_tool);
+  harness.add_tool(write_tool);
+  harness.config.tools.speculative_read_only = speculative;
+
+  auto session = harness.session();
+  session->prompt("go");
+  for (const auto& msg : session->messages()) run.tool_results += msg.tool_results().size();
+  run.read_started = read_tool->started_at();
+  run.write_started = write_tool->started_at();
+  return run;
+}
+
+}  // namespace
+
+TEST(SpeculativeToolTest, ReadOnlyToolStartsWhileStreaming) {
+  auto run = run_speculation(true);
+  ASSERT_TRUE(run.read_started.has_value());
+  ASSERT_TRUE(run.write_started.has_value());
+  EXPECT_LT(*run.read_started, run.stream_finished);
+  // Side effects still wait for the whole response
+  EXPECT_GE(*run.write_started, run.stream_finished);
+  EXPECT_EQ(run.tool_results, 2u);
+}
+
+TEST(SpeculativeToolTest, DisabledByDefault) {
+  auto run = run_speculation(false);
+  ASSERT_TRUE(run.read_started.has_value());
+  EXPECT_GE(*run.read_started, run.stream_finished);
+  EXPECT_EQ(run.tool_results, 2u);
+}
+
+// ============================================================
+// 缓存感知裁剪测试
+// ============================================================
+
+namespace {
+
+// A tool whose output is 2000 estimated tokens
+class BigOutputTool : public SimpleTool {
+ public:
+  BigOutputTool() : SimpleTool("big_output", "big") {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    std::promise<ToolResult> promise;
+    promise.set_value(ToolResult::success(std::string(8000, 'x')));
+    return promise.get_future();
+  }
+};
+
+struct PruneRun {
+  PruneStats stats;
+  size_t prefix_breaks = 0;  // Requests whose messages did not extend the previous request's
+  int64_t context_tokens = 0;  // Session's running total
+  int64_t recounted = 0;       // The same, summed over the messages afterwards
+};
+
+// Six prompts, each calling the tool once; old outputs become prunable after the newest 1000 tokens
+PruneRun run_pruning(PruneMode mode) {
+  const int prompts = 6;
+  std::vector<ScriptedProvider::Turn> turns;
+  for (int p = 0; p < prompts; ++p) {
+    auto id = "call_" + std::to_string(p);
+    turns.push_back([id](llm::StreamCallback& callback) {
+      callback(llm::ToolCallComplete{id, "big_output", json::object()});
+      callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+    });
+    turns.push_back([](llm::StreamCallback& callback) {
+      callback(llm::TextDelta{"done"});
+      callback(llm::FinishStep{FinishReason::Stop, {}});
+    });
+  }
+  auto provider = std::make_shared<ScriptedProvider>(std::move(turns));
+
+  SessionHarness harness([provider](asio::io_context&) {
+    return provider;
+  });
+  harness.add_tool(std::make_shared<BigOutputTool>());
+  auto& config = harness.config;
+  config.prompt_cache.enabled = false;  // Compare plain message bytes
+  config.context.prune_mode = mode;
+  config.context.prune_protect_tokens = 1000;
+  config.context.prune_minimum_tokens = 0;
+  config.context.prune_epoch_tokens = 3000;
+
+  auto session = harness.session();
+  for (int p = 0; p < prompts; ++p) session->prompt("step " + std::to_string(p));
+
+  PruneRun run;
+  run.stats = session->prune_stats();
+  run.context_tokens = session->estimated_context_tokens();
+  for (const auto& msg : session->messages()) run.recounted += msg.token_count();
+  for (size_t i = 1; i < provider->bodies.size(); ++i) {
+    auto previous = provider->bodies[i - 1].substr(0, provider->bodies[i - 1].size() - 2);  // Without "]}"
+    if (!provider->bodies[i].starts_with(previous)) run.prefix_breaks++;
+  }
+  return run;
+}
+
+}  // namespace
+
+TEST(CacheAwarePruneTest, EagerPruningRewritesThePrefixEveryTurn) {
+  auto run = run_pruning(PruneMode::Eager);
+  // From the second prompt on, each prompt clears the previous output inside the cached prefix
+  // (the last prompt's prune is only seen by a later request)
+  EXPECT_EQ(run.stats.epochs, 5);
+  EXPECT_EQ(run.prefix_breaks, 4u);
+  EXPECT_EQ(run.stats.outputs_cleared, 5);
+  EXPECT_EQ(run.stats.tokens_saved, 10000);
+  EXPECT_EQ(run.stats.deferred_tokens, 0);
+  // Adding messages and clearing outputs kept the running total exact
+  EXPECT_EQ(run.context_tokens, run.recounted);
+  EXPECT_GT(run.context_tokens, 2000);
+}
+
+TEST(CacheAwarePruneTest, CacheAwarePruningBatchesIntoEpochs) {
+  auto eager = run_pruning(PruneMode::Eager);
+  auto run = run_pruning(PruneMode::CacheAware);
+  // Outputs are held back until 3000 tokens are prunable, then cleared two at a time
+  EXPECT_EQ(run.stats.epochs, 2);
+  EXPECT_EQ(run.prefix_breaks, 2u);
+  EXPECT_EQ(run.stats.outputs_cleared, 4);
+  EXPECT_EQ(run.stats.tokens_saved, 8000);
+  EXPECT_EQ(run.stats.deferred_tokens, 2000);
+  EXPECT_LT(run.stats.tokens_invalidated, eager.stats.tokens_invalidated);
+  EXPECT_EQ(run.context_tokens, run.recounted);
+}
+
+// ============================================================
+// 异步会话测试
+// ============================================================
+
+namespace {
+
+// Answers each request after a delay on the io_context: a tool call first, then "done" once it has a result
+class TimedProvider : public llm::Provider {
+ public:
+  TimedProvider(asio::io_context& io_ctx, std::string tool) : io_ctx_(io_ctx), tool_(std::move(tool)) {}
+
+  std::string name() const override {
+    return "timed";
+  }
+
+  std::vector<ModelInfo> models() const override {
+    return {};
+  }
+
+  std::future<llm::LlmResponse> complete(const llm::LlmRequest&) override {
+    std::promise<llm::LlmResponse> promise;
+    promise.set_value({});
+    return promise.get_future();
+  }
+
+  void stream(const llm::LlmRequest& request, llm::StreamCallback callback, std::function<void()> on_complete) override {
+    bool answered = !request.messages.empty() && !request.messages.back().tool_results().empty();
+    auto id = "call_" + std::to_string(calls_++);
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, std::chrono::milliseconds(5));
+    timer->async_wait([timer, answered, id, tool = tool_, callback, on_complete](const std::error_code&) {
+      if (answered) {
+        callback(llm::TextDelta{"done"});
+        callback(llm::FinishStep{FinishReason::Stop, {}});
+      } else {
+        callback(llm::ToolCallComplete{id, tool, json::object()});
+        callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+      }
+      on_complete();
+    });
+  }
+
+  void cancel() override {}
+
+ private:
+  asio::io_context& io_ctx_;
+  std::string tool_;
+  std::atomic<int> calls_{0};
+};
+
+// Completes after a delay on the io_context, without a thread of its own
+class TimedTool : public SimpleTool {
+ public:
+  explicit TimedTool(asio::io_context& io_ctx) : SimpleTool("timed_tool", "timed"), io_ctx_(io_ctx) {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    auto promise = std::make_shared<std::promise<ToolResult>>();
+    auto timer = std::make_shared<asio::steady_timer>(io_ctx_, std::chrono::milliseconds(5));
+    timer->async_wait([timer, promise](const std::error_code&) {
+      promise->set_value(ToolResult::success("ok"));
+    });
+    return promise->get_future();
+  }
+
+ private:
+  asio::io_context& io_ctx_;
+};
+
+// Calls on_execute as it starts, then succeeds
+class HookTool : public SimpleTool {
+ public:
+  HookTool(std::string id, std::function<void()> on_execute) : SimpleTool(std::move(id), "hook"), on_execute_(std::move(on_execute)) {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  std::future<ToolResult> execute(const json&, const ToolContext&) override {
+    on_execute_();
+    std::promise<ToolResult> promise;
+    promise.set_value(ToolResult::success("ok"));
+    return promise.get_future();
+  }
+
+ private:
+  std::function<void()> on_execute_;
+};
+
+// Runs io_ctx on two threads with the timed provider and tool
+class TimedHarness : public SessionHarness {
+ public:
+  explicit TimedHarness(Permission permission, size_t threads = 2)
+      : SessionHarness(
+            [](asio::io_context& io_ctx) {
+              return std::make_shared<TimedProvider>(io_ctx, "timed_tool");
+            },
+            threads) {
+    add_tool(std::make_shared<TimedTool>(io_ctx), permission);
+  }
+};
+
+}  // namespace
+
+TEST(AsyncSessionTest, ManySessionsShareTwoThreads) {
+  TimedHarness harness(Permission::Allow);
+
+  const int count = 200;
+  std::mutex mutex;
+  std::condition_variable cv;
+  int completed = 0;
+  std::vector<std::shared_ptr<Session>> sessions;
+  for (int i = 0; i < count; ++i) {
+    auto session = harness.session();
+    session->on_complete([&](FinishReason) {
+      std::lock_guard lock(mutex);
+      completed++;
+      cv.notify_one();
+    });
+    sessions.push_back(session);
+  }
+
+  // Each run waits on two model calls and a tool, all timers: 200 runs need no more than the two threads
+  auto begin = Clock::now();
+  for (auto& session : sessions) session->prompt_async("go");
+  EXPECT_LT(Clock::now() - begin, std::chrono::milliseconds(500));  // Nothing waited for
+
+  std::unique_lock lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(20), [&]() {
+    return completed == count;
+  }));
+  lock.unlock();
+  for (auto& session : sessions) {
+    EXPECT_EQ(session->state(), SessionState::Completed);
+    ASSERT_EQ(session->messages().size(), 4u);  // Prompt, tool call, result, answer
+    EXPECT_EQ(session->messages().back().text(), "done");
+  }
+}
+
+TEST(AsyncSessionTest, PermissionAnswerIsAwaitedWithoutBlocking) {
+  TimedHarness harness(Permission::Ask, 1);
+
+  auto session = harness.session();
+  std::promise<bool> answer;
+  std::promise<void> asked;
+  session->set_permission_handler([&](const std::string&, const std::string&) {
+    asked.set_value();
+    return answer.get_future();
+  });
+  std::promise<void> done;
+  session->on_complete([&](FinishReason) {
+    done.set_value();
+  });
+
+  session->prompt_async("go");
+  ASSERT_EQ(asked.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+  // The only io thread is free while the user has not answered
+  std::promise<void> probe;
+  asio::post(harness.io_ctx, [&probe]() {
+    probe.set_value();
+  });
+  EXPECT_EQ(probe.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(session->state(), SessionState::WaitingForTool);
+
+  answer.set_value(true);
+  ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  ASSERT_EQ(session->messages().size(), 4u);
+  auto results = session->messages()[2].tool_results();
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_FALSE(results[0]->is_error);
+  EXPECT_EQ(results[0]->output, "ok");
+}
+
+TEST(AsyncSessionTest, CancelWhileAskingRecordsNoDecision) {
+  SessionHarness harness(
+      [](asio::io_context&) {
+        return std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{[](llm::StreamCallback& callback) {
+          callback(llm::ToolCallComplete{"call_1", "ask_tool", json::object()});
+          callback(llm::ToolCallComplete{"call_2", "ask_tool", json::object()});
+          callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+        }});
+      },
+      1);
+  std::atomic<int> executed{0};
+  auto count_execution = [&executed]() {
+    executed++;
+  };
+  harness.add_tool(std::make_shared<HookTool>("ask_tool", count_execution), Permission::Ask);
+
+  auto session = harness.session();
+  std::promise<bool> answer;  // Never given
+  std::atomic<int> asked{0};
+  std::promise<void> first_ask;
+  session->set_permission_handler([&](const std::string&, const std::string&) {
+    if (asked++ == 0) first_ask.set_value();
+    return answer.get_future();
+  });
+  std::promise<void> done;
+  session->on_complete([&](FinishReason) {
+    done.set_value();
+  });
+
+  session->prompt_async("go");
+  ASSERT_EQ(first_ask.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  session->cancel();
+  ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+  // Cancelling is not refusing: nothing is cached for later runs, and the second call is not asked about
+  EXPECT_EQ(session->state(), SessionState::Cancelled);
+  EXPECT_FALSE(PermissionManager::instance().get_cached("ask_tool").has_value());
+  EXPECT_EQ(asked.load(), 1);
+  EXPECT_EQ(executed.load(), 0);
+  ASSERT_EQ(session->messages().size(), 3u);  // Prompt, tool calls, results
+  auto results = session->messages()[2].tool_results();
+  ASSERT_EQ(results.size(), 2u);
+  for (const auto* result : results) {
+    EXPECT_TRUE(result->is_error);
+    EXPECT_EQ(result->output, "Cancelled");
+  }
+}
+
+TEST(AsyncSessionTest, CancelDuringRetryBackoffEndsTheRun) {
+  net::RetryBudget::instance().clear();  // The retry must be granted
+  std::promise<void> failed;
+  SessionHarness harness(
+      [&failed](asio::io_context&) {
+        return std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{[&failed](llm::StreamCallback& callback) {
+          callback(llm::StreamError{"Service overloaded", true, std::chrono::seconds(30)});
+          failed.set_value();
+        }});
+      },
+      1);
+
+  auto session = harness.session();
+  std::promise<void> done;
+  session->on_complete([&](FinishReason) {
+    done.set_value();
+  });
+
+  session->prompt_async("go");
+  ASSERT_EQ(failed.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Let the run start its 30s wait
+
+  // The run ends now rather than after the server-requested wait
+  session->cancel();
+  ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(session->state(), SessionState::Cancelled);
+}
+
+// ============================================================
+// 工具调度测试
+// ============================================================
+
+namespace {
+
+// Writes the file named in its arguments, taking a while; records when each call ran
+class SlowWriteTool : public SimpleTool {
+ public:
+  struct Span {
+    std::string path;
+    Clock::time_point start;
+    Clock::time_point end;
+  };
+
+  SlowWriteTool() : SimpleTool("slow_write", "Writes a file, slowly") {}
+
+  std::vector<ParameterSchema> parameters() const override {
+    return {};
+  }
+
+  ToolAccess access(const json& args, const ToolContext& ctx) const override {
+    return ToolAccess::writing(args.value("path", ""), ctx.working_dir);
+  }
+
+  std::future<ToolResult> execute(const json& args, const ToolContext&) override {
+    return std::async(std::launch::async, [this, path = args.value("path", "")]() {
+      auto start = Clock::now();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      std::lock_guard lock(mutex_);
+      spans_.push_back({path, start, Clock::now()});
+      return ToolResult::success("wrote " + path);
+    });
+  }
+
+  std::vector<Span> spans() const {
+    std::lock_guard lock(mutex_);
+    return spans_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Span> spans_;
+};
+
+}  // namespace
+
+TEST(ToolSchedulingTest, ConflictingCallsRunInModelOrder) {
+  auto provider = std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{
+      [](llm::StreamCallback& callback) {
+        callback(llm::ToolCallComplete{"call_1", "slow_write", json{{"path", "a.txt"}}});
+        callback(llm::ToolCallComplete{"call_2", "slow_write", json{{"path", "./a.txt"}}});
+        callback(llm::ToolCallComplete{"call_3", "slow_write", json{{"path", "b.txt"}}});
+        callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+      },
+      [](llm::StreamCallback& callback) {
+        callback(llm::TextDelta{"done"});
+        callback(llm::FinishStep{FinishReason::Stop, {}});
+      },
+  });
+
+  SessionHarness harness([provider](asio::io_context&) {
+    return provider;
+  });
+  auto tool = std::make_shared<SlowWriteTool>();
+  harness.add_tool(tool);
+  std::vector<events::ToolBatchCompleted> batches;
+  auto subscription = Bus::instance().subscribe<events::ToolBatchCompleted>([&batches](const events::ToolBatchCompleted& event) {
+    batches.push_back(event);
+  });
+
+  auto session = harness.session();
+  session->prompt("go");
+  Bus::instance().unsubscribe(subscription);
+
+  // The second write to a.txt waits for the first; b.txt runs alongside it
+  auto spans = tool->spans();
+  ASSERT_EQ(spans.size(), 3u);
+  std::vector<SlowWriteTool::Span> a_writes;
+  std::optional<SlowWriteTool::Span> b_write;
+  for (const auto& span : spans) {
+    if (span.path == "b.txt") {
+      b_write = span;
+    } else {
+      a_writes.push_back(span);
+    }
+  }
+  ASSERT_EQ(a_writes.size(), 2u);
+  ASSERT_TRUE(b_write.has_value());
+  EXPECT_EQ(a_writes[0].path, "a.txt");
+  EXPECT_GE(a_writes[1].start, a_writes[0].end);
+  EXPECT_LT(b_write->start, a_writes[0].end);
+
+  // Results keep call order
+  const Message* results = nullptr;
+  for (const auto& msg : session->messages()) {
+    if (!msg.tool_results().empty()) results = &msg;
+  }
+  ASSERT_NE(results, nullptr);
+  auto parts = results->tool_results();
+  ASSERT_EQ(parts.size(), 3u);
+  EXPECT_EQ(parts[0]->tool_call_id, "call_1");
+  EXPECT_EQ(parts[1]->tool_call_id, "call_2");
+  EXPECT_EQ(parts[2]->tool_call_id, "call_3");
+
+  ASSERT_EQ(batches.size(), 1u);
+  EXPECT_EQ(batches[0].calls, 3u);
+  EXPECT_EQ(batches[0].critical_path, 2u);
+  EXPECT_EQ(batches[0].max_running, 2u);
+  EXPECT_GT(batches[0].parallelism, 1.2);
+}
+
+TEST(ToolSchedulingTest, SpeculativeReadAfterAWriteRunsAgain) {
+  auto provider = std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{
+      [](llm::StreamCallback& callback) {
+        callback(llm::ToolCallComplete{"call_write", "slow_write", json{{"path", "a.txt"}}});
+        callback(llm::ToolCallComplete{"call_read", "spec_read", json{{"path", "a.txt"}}});  // Starts while streaming
+        callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+      },
+      [](llm::StreamCallback& callback) {
+        callback(llm::TextDelta{"done"});
+        callback(llm::FinishStep{FinishReason::Stop, {}});
+      },
+  });
+
+  SessionHarness harness([provider](asio::io_context&) {
+    return provider;
+  });
+  auto write_tool = std::make_shared<SlowWriteTool>();
+  auto read_tool = std::make_shared<ProbeTool>("spec_read", true);
+  harness.add_tool(write_tool);
+  harness.add_tool(read_tool);
+  harness.config.tools.speculative_read_only = true;
+
+  auto session = harness.session();
+  session->prompt("go");
+
+  // The read that counts started after the write it depends on
+  auto spans = write_tool->spans();
+  ASSERT_EQ(spans.size(), 1u);
+  ASSERT_TRUE(read_tool->started_at().has_value());
+  EXPECT_GE(*read_tool->started_at(), spans[0].end);
+  size_t results = 0;
+  for (const auto& msg : session->messages()) results += msg.tool_results().size();
+  EXPECT_EQ(results, 2u);
+}
+
+TEST(ToolSchedulingTest, MessageCopiesKeepTheirToolCallState) {
+  auto provider = std::make_shared<ScriptedProvider>(std::vector<ScriptedProvider::Turn>{
+      [](llm::StreamCallback& callback) {
+        callback(llm::ToolCallComplete{"call_1", "copy_probe", json::object()});
+        callback(llm::FinishStep{FinishReason::ToolCalls, {}});
+      },
+      [](llm::StreamCallback& callback) {
+        callback(llm::TextDelta{"done"});
+        callback(llm::FinishStep{FinishReason::Stop, {}});
+      },
+  });
+  SessionHarness harness([provider](asio::io_context&) {
+    return provider;
+  });
+  std::shared_ptr<Session> session;
+  std::optional<Message> copy;
+  harness.add_tool(std::make_shared<HookTool>("copy_probe", [&session, &copy]() {
+    copy = session->messages()[1];
+  }));
+
+  session = harness.session();
+  session->prompt("go");
+
+  // Copied as the call started: marking it started and completed changed only the session's message
+  ASSERT_TRUE(copy.has_value());
+  auto copied = std::as_const(*copy).tool_calls();
+  ASSERT_EQ(copied.size(), 1u);
+  EXPECT_FALSE(copied[0]->started);
+  EXPECT_FALSE(copied[0]->completed);
+  auto marked = session->messages()[1].tool_calls();
+  ASSERT_EQ(marked.size(), 1u);
+  EXPECT_TRUE(marked[0]->started);
+  EXPECT_TRUE(marked[0]->completed);
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <array>
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// TLS front for the plaintext test servers. Terminates TLS on 127.0.0.1 with a self-signed certificate,
+// answers ALPN with a fixed protocol (or not at all when it is empty) and relays bytes to a backend port.
+// While it exists SSL_CERT_FILE names its certificate, so HttpClients created meanwhile trust it.
+class TestTlsProxy {
+ public:
+  TestTlsProxy(unsigned short backend_port, std::string alpn)
+      : backend_port_(backend_port),
+        alpn_(std::move(alpn)),
+        ssl_ctx_(asio::ssl::context::tls_server),
+        acceptor_(io_ctx_, {asio::ip::make_address("127.0.0.1"), 0}) {
+    auto [cert, key] = make_certificate();
+    ssl_ctx_.use_certificate(asio::buffer(cert), asio::ssl::context::pem);
+    ssl_ctx_.use_private_key(asio::buffer(key), asio::ssl::context::pem);
+    SSL_CTX_set_alpn_select_cb(ssl_ctx_.native_handle(), &TestTlsProxy::select_alpn, this);
+
+    cert_path_ = std::filesystem::temp_directory_path() / ("agent_test_tls_" + std::to_string(port()) + ".pem");
+    std::ofstream(cert_path_) << cert;
+    if (const char* previous = std::getenv("SSL_CERT_FILE")) previous_cert_file_ = previous;
+    setenv("SSL_CERT_FILE", cert_path_.c_str(), 1);
+
+    accept();
+    thread_ = std::thread([this]() {
+      io_ctx_.run();
+    });
+  }
+
+  ~TestTlsProxy() {
+    asio::post(io_ctx_, [this]() {
+      asio::error_code ec;
+      acceptor_.close(ec);
+      io_ctx_.stop();
+    });
+    thread_.join();
+    if (previous_cert_file_.empty()) {
+      unsetenv("SSL_CERT_FILE");
+    } else {
+      setenv("SSL_CERT_FILE", previous_cert_file_.c_str(), 1);
+    }
+    std::filesystem::remove(cert_path_);
+  }
+
+  unsigned short port() const {
+    return acceptor_.local_endpoint().port();
+  }
+
+  std::string url(const std::string& path = "/") const {
+    return "https://127.0.0.1:" + std::to_string(port()) + path;
+  }
+
+  // Completed TLS handshakes
+  int handshakes() const {
+    return handshakes_.load();
+  }
+
+  // Protocol chosen during the last handshake ("" when ALPN was not used)
+  std::string negotiated() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return negotiated_;
+  }
+
+ private:
+  using SslStream = asio::ssl::stream<asio::ip::tcp::socket>;
+
+  struct Relay {
+    Relay(asio::io_context& io_ctx, asio::ssl::context& ssl_ctx) : tls(io_ctx, ssl_ctx), plain(io_ctx) {}
+    SslStream tls;
+    asio::ip::tcp::socket plain;
+    std::array<char, 16384> upstream;
+    std::array<char, 16384> downstream;
+
+    void close() {
+      asio::error_code ec;
+      tls.lowest_layer().close(ec);
+      plain.close(ec);
+    }
+  };
+
+  // Self-signed P-256 certificate and key, PEM encoded
+  static std::pair<std::string, std::string> make_certificate() {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    auto to_pem = [](auto write) {
+      BIO* bio = BIO_new(BIO_s_mem());
+      write(bio);
+      char* data = nullptr;
+      long length = BIO_get_mem_data(bio, &data);
+      std::string pem(data, static_cast<size_t>(length));
+      BIO_free(bio);
+      return pem;
+    };
+    auto cert_pem = to_pem([cert](BIO* bio) {
+      PEM_write_bio_X509(bio, cert);
+    });
+    auto key_pem = to_pem([key](BIO* bio) {
+      PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+    });
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return {cert_pem, key_pem};
+  }
+
+  static int select_alpn(SSL*, const unsigned char** out, unsigned char* out_length, const unsigned char* in, unsigned int in_length, void* arg) {
+    const auto* self = static_cast<TestTlsProxy*>(arg);
+    for (unsigned int i = 0; i < in_length; i += 1 + in[i]) {
+      std::string_view offered(reinterpret_cast<const char*>(in + i + 1), in[i]);
+      if (!self->alpn_.empty() && offered == self->alpn_) {
+        *out = in + i + 1;
+        *out_length = in[i];
+        return SSL_TLSEXT_ERR_OK;
+      }
+    }
+    return SSL_TLSEXT_ERR_NOACK;
+  }
+
+  void accept() {
+    auto relay = std::make_shared<Relay>(io_ctx_, ssl_ctx_);
+    acceptor_.async_accept(relay->tls.lowest_layer(), [this, relay](const asio::error_code& ec) {
+      if (ec) return;
+      accept();
+      relay->tls.async_handshake(asio::ssl::stream_base::server, [this, relay](const asio::error_code& ec) {
+        if (ec) return relay->close();
+        const unsigned char* protocol = nullptr;
+        unsigned int length = 0;
+        SSL_get0_alpn_selected(relay->tls.native_handle(), &protocol, &length);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          negotiated_.assign(reinterpret_cast<const char*>(protocol), length);
+        }
+        handshakes_++;
+        relay->plain.async_connect({asio::ip::make_address("127.0.0.1"), backend_port_}, [this, relay](const asio::error_code& ec) {
+          if (ec) return relay->close();
+          pump_up(relay);
+          pump_down(relay);
+        });
+      });
+    });
+  }
+
+  // Client to backend
+  void pump_up(std::shared_ptr<Relay> relay) {
+    relay->tls.async_read_some(asio::buffer(relay->upstream), [this, relay](const asio::error_code& ec, size_t bytes) {
+      if (ec) return relay->close();
+      asio::async_write(relay->plain, asio::buffer(relay->upstream, bytes), [this, relay](const asio::error_code& ec, size_t) {
+        if (ec) return relay->close();
+        pump_up(relay);
+      });
+    });
+  }
+
+  // Backend to client
+  void pump_down(std::shared_ptr<Relay> relay) {
+    relay->plain.async_read_some(asio::buffer(relay->downstream), [this, relay](const asio::error_code& ec, size_t bytes) {
+      if (ec) return relay->close();
+      asio::async_write(relay->tls, asio::buffer(relay->downstream, bytes), [this, relay](const asio::error_code& ec, size_t) {
+        if (ec) return relay->close();
+        pump_down(relay);
+      });
+    });
+  }
+
+  unsigned short backend_port_;
+  std::string alpn_;
+  asio::io_context io_ctx_;
+  asio::ssl::context ssl_ctx_;
+  asio::ip::tcp::acceptor acceptor_;
+  std::thread thread_;
+  std::filesystem::path cert_path_;
+  std::string previous_cert_file_;
+  std::atomic<int> handshakes_{0};
+  mutable std::mutex mutex_;
+  std::string negotiated_;
+};
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "core/message.hpp"
+#include "core/tokenizer.hpp"
+
+using namespace agent;
+
+namespace {
+
+std::vector<std::string> pieces(std::string_view text) {
+  std::vector<std::string> result;
+  Tokenizer::pretokenize(text, [&result](std::string_view piece) {
+    result.emplace_back(piece);
+  });
+  return result;
+}
+
+// Loads a tiny vocabulary for the test's lifetime
+class TinyVocabulary {
+ public:
+  TinyVocabulary() {
+    path_ = std::filesystem::temp_directory_path() / "agent_tokenizer_test.tiktoken";
+    std::ofstream file(path_);
+    // a b c d " " ab cd abcd
+    file << "YQ== 0\nYg== 1\nYw== 2\nZA== 3\nIA== 4\nYWI= 5\nY2Q= 6\nYWJjZA== 7\n";
+    file.close();
+    loaded_ = Tokenizer::instance().load(path_);
+  }
+
+  ~TinyVocabulary() {
+    Tokenizer::instance().unload();
+    std::filesystem::remove(path_);
+  }
+
+  bool loaded() const {
+    return loaded_;
+  }
+
+ private:
+  std::filesystem::path path_;
+  bool loaded_ = false;
+};
+
+}  // namespace
+
+// ============================================================
+// 预分词测试
+// ============================================================
+
+TEST(TokenizerTest, PretokenizesLikeCl100k) {
+  std::vector<std::string> expected{"Hello", " world", "'s", " ", "123", "456", " foo", "!!\n\n", " ", " bar", " 你好"};
+  EXPECT_EQ(pieces("Hello world's 123456 foo!!\n\n  bar 你好"), expected);
+
+  expected = {"int", " x", " =", " ", "42", ";\n", "    ", " return", " x", ";"};
+  EXPECT_EQ(pieces("int x = 42;\n     return x;"), expected);
+}
+
+TEST(TokenizerTest, LetterRunsEndAtTheFirstNonLetter) {
+  // Crosses the 16-byte blocks of the vectorized scan at every offset
+  for (size_t length = 1; length < 48; ++length) {
+    std::string word;
+    for (size_t i = 0; i < length; ++i) word += static_cast<char>(i % 3 == 0 ? 'A' + i % 26 : 'a' + i % 26);
+    EXPECT_EQ(Tokenizer::piece_end(word + ".rest", 0), length) << length;
+    EXPECT_EQ(Tokenizer::piece_end(word, 0), length) << length;
+  }
+  std::string mixed = "abcdefghij\xE4\xBD\xA0\xE5\xA5\xBDklmnopqrstuvwxyz[0]";
+  EXPECT_EQ(Tokenizer::piece_end(mixed, 0), mixed.find('['));
+  EXPECT_EQ(Tokenizer::piece_end("abcdefghijklmnopqrstuvwxyz@", 0), 26u);
+  EXPECT_EQ(Tokenizer::piece_end("abcdefghijklmnopqrstuvwxyz`", 0), 26u);  // Just below 'a'
+  EXPECT_EQ(Tokenizer::piece_end("abcdefghijklmnopqrstuvwxyz{", 0), 26u);  // Just above 'z'
+}
+
+// ============================================================
+// 计数测试
+// ============================================================
+
+TEST(TokenizerTest, EstimatesWideCharactersAsTokens) {
+  ASSERT_FALSE(Tokenizer::instance().has_vocabulary());
+  auto& tokenizer = Tokenizer::instance();
+  EXPECT_EQ(tokenizer.count(""), 0u);
+  EXPECT_EQ(tokenizer.count("你好世界"), 4u);  // bytes / 4 would say 3
+  EXPECT_EQ(tokenizer.count(std::string(8000, 'x')), 2000u);
+  EXPECT_TRUE(tokenizer.encode("abc").empty());
+}
+
+TEST(TokenizerTest, BytePairMergesByRank) {
+  TinyVocabulary vocabulary;
+  ASSERT_TRUE(vocabulary.loaded());
+  auto& tokenizer = Tokenizer::instance();
+  EXPECT_TRUE(tokenizer.has_vocabulary());
+
+  EXPECT_EQ(tokenizer.encode("abcd"), std::vector<uint32_t>{7});
+  // ab, c, d, ab -> ab, cd, ab -> abcd, ab
+  EXPECT_EQ(tokenizer.encode("abcdab"), (std::vector<uint32_t>{7, 5}));
+  // " abcd" is one piece; the space is its own token
+  EXPECT_EQ(tokenizer.encode(" abcd"), (std::vector<uint32_t>{4, 7}));
+  EXPECT_EQ(tokenizer.count("abcdab abcd"), 4u);
+  EXPECT_EQ(tokenizer.count("dcba"), 4u);
+
+  EXPECT_FALSE(tokenizer.load("/nonexistent/vocabulary.tiktoken"));
+  EXPECT_TRUE(tokenizer.has_vocabulary());  // A failed load keeps the current vocabulary
+}
+
+TEST(TokenizerTest, MessageCountsPartsSentToTheModel) {
+  auto& tokenizer = Tokenizer::instance();
+  auto msg = Message::assistant("你好世界");
+  msg.add_thinking("not sent, not counted");
+  msg.add_tool_call("call_1", "read", {{"filePath", "a.txt"}});
+  EXPECT_EQ(msg.part_tokens(0), 4);
+  EXPECT_EQ(msg.part_tokens(1), 0);
+  int64_t call_tokens = tokenizer.count("read") + tokenizer.count(R"({"filePath":"a.txt"})");
+  EXPECT_EQ(msg.part_tokens(2), call_tokens);
+  EXPECT_EQ(msg.token_count(), 4 + call_tokens);
+
+  // Copies share the counts; appending adds to them
+  Message copy = msg;
+  copy.add_tool_result("call_1", "read", std::string(400, 'x'));
+  EXPECT_EQ(copy.token_count(), 4 + call_tokens + 100);
+  EXPECT_EQ(msg.token_count(), 4 + call_tokens);
+
+  // Editing parts in place recounts
+  std::get<TextPart>(copy.parts()[0]).text = "hi";
+  EXPECT_EQ(copy.token_count(), 1 + call_tokens + 100);
+}
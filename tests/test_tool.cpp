@@ -1,6 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include "tool/builtin/builtins.hpp"
+#include "tool/scheduler.hpp"
 #include "tool/tool.hpp"
 
 using namespace agent;
@@ -71,3 +79,218 @@ TEST(TruncateTest, TruncateByLines) {
   EXPECT_TRUE(result.truncated);
   EXPECT_LT(result.content.size(), long_text.size());
 }
+
+TEST(ToolExecutorTest, ToolLimitCapsRunningTasks) {
+  ToolExecutor executor({4, 4});
+  executor.set_tool_limit("grep", 2);
+
+  std::atomic<int> running{0};
+  std::atomic<int> peak{0};
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 8; ++i) {
+    results.push_back(executor.run("grep", ToolLane::Compute, [&running, &peak, i]() {
+      int now = ++running;
+      int seen = peak.load();
+      while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      --running;
+      return i;
+    }));
+  }
+  for (int i = 0; i < 8; ++i) EXPECT_EQ(results[i].get(), i);
+
+  EXPECT_LE(peak.load(), 2);
+  auto stats = executor.stats();
+  EXPECT_GT(stats.limited_total, 0u);
+  EXPECT_EQ(stats.limited, 0u);
+  EXPECT_EQ(stats[ToolLane::Compute].submitted, 8u);
+  EXPECT_EQ(stats[ToolLane::Compute].started, 8u);  // completed may lag the futures
+  EXPECT_EQ(stats[ToolLane::Compute].threads, 4u);
+}
+
+TEST(ToolExecutorTest, BlockingLaneLeavesComputeFree) {
+  ToolExecutor executor({1, 4});
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+
+  std::vector<std::future<void>> waiting;
+  for (int i = 0; i < 4; ++i) {
+    waiting.push_back(executor.run("bash", ToolLane::Blocking, [opened]() {
+      opened.wait();
+    }));
+  }
+  // The only compute thread is free while every blocking thread waits
+  auto compute = executor.run("read", ToolLane::Compute, []() {
+    return 42;
+  });
+  ASSERT_EQ(compute.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(compute.get(), 42);
+
+  auto stats = executor.stats();
+  EXPECT_EQ(stats[ToolLane::Blocking].threads, 4u);
+  gate.set_value();
+  for (auto& f : waiting) f.get();
+}
+
+TEST(ToolExecutorTest, OpenQuestionsLeaveTheBlockingLaneFree) {
+  ToolExecutor executor({1, 2});
+  ToolContext ctx;
+  ctx.executor = &executor;
+  std::promise<QuestionResponse> answer;
+  std::shared_future<QuestionResponse> answered = answer.get_future().share();
+  ctx.question_handler = [answered](const QuestionInfo&) {
+    return std::async(std::launch::deferred, [answered]() {
+      return answered.get();
+    });
+  };
+
+  // More open questions than there are blocking threads
+  tools::QuestionTool question;
+  std::vector<std::future<ToolResult>> questions;
+  for (int i = 0; i < 4; ++i) questions.push_back(question.execute({{"questions", {"Which one?"}}}, ctx));
+
+  auto bash = executor.run("bash", ToolLane::Blocking, []() {
+    return 42;
+  });
+  ASSERT_EQ(bash.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(bash.get(), 42);
+
+  answer.set_value({{"This one"}, false});
+  for (auto& result : questions) {
+    auto output = result.get();
+    EXPECT_FALSE(output.is_error);
+    EXPECT_NE(output.output.find("A1: This one"), std::string::npos);
+  }
+  auto stats = executor.stats();
+  EXPECT_EQ(stats[ToolLane::Waiting].threads, 4u);
+  EXPECT_EQ(stats[ToolLane::Blocking].threads, 1u);
+}
+
+TEST(ToolExecutorTest, RunNotifiesOnceTheResultIsSet) {
+  ToolExecutor executor({1, 1});
+  std::promise<int> notified;
+  std::future<int> result;
+  auto on_done = [&notified, &result]() {
+    // The result is already available to whoever is notified
+    notified.set_value(result.wait_for(std::chrono::seconds(0)) == std::future_status::ready ? 1 : 0);
+  };
+  std::promise<void> gate;
+  auto opened = gate.get_future().share();
+  result = executor.run(
+      "read", ToolLane::Compute,
+      [opened]() {
+        opened.wait();
+        return 7;
+      },
+      on_done);
+  gate.set_value();
+  EXPECT_EQ(notified.get_future().get(), 1);
+  EXPECT_EQ(result.get(), 7);
+}
+
+TEST(ToolExecutorTest, ContextRunClaimsCompletion) {
+  ToolExecutor executor({1, 1});
+  std::promise<void> notified;
+  ToolContext ctx;
+  ctx.executor = &executor;
+  ctx.completion = std::make_shared<ToolCompletion>();
+  ctx.completion->notify = [&notified]() {
+    notified.set_value();
+  };
+
+  auto result = ctx.run("read", ToolLane::Compute, []() {
+    return ToolResult::success("ok");
+  });
+  EXPECT_TRUE(ctx.completion->claimed);
+  EXPECT_EQ(notified.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(result.get().output, "ok");
+}
+
+TEST(ToolExecutorTest, ParallelForInsideComputeTasks) {
+  ToolExecutor executor({2, 2});
+
+  // Every compute thread fans out at once; the callers take indices themselves, so none waits on a queue
+  std::vector<std::future<long>> sums;
+  for (int t = 0; t < 8; ++t) {
+    sums.push_back(executor.run("grep", ToolLane::Compute, [&executor]() {
+      std::vector<long> values(1000);
+      executor.parallel_for(values.size(), [&values](size_t i) {
+        values[i] = static_cast<long>(i);
+      });
+      long sum = 0;
+      for (long v : values) sum += v;
+      return sum;
+    }));
+  }
+  for (auto& sum : sums) EXPECT_EQ(sum.get(), 999 * 1000 / 2);
+
+  EXPECT_THROW(executor.parallel_for(10,
+                                     [](size_t i) {
+                                       if (i == 5) throw std::runtime_error("boom");
+                                     }),
+               std::runtime_error);
+}
+
+TEST(ToolAccessTest, ConflictsByPath) {
+  auto write_a = ToolAccess::writing("src/a.cpp", "/repo");
+  EXPECT_EQ(write_a.writes[0], "/repo/src/a.cpp");
+  EXPECT_EQ(ToolAccess::resolve("./src/../src/a.cpp/", "/repo"), "/repo/src/a.cpp");
+
+  EXPECT_TRUE(write_a.conflicts_with(ToolAccess::writing("/repo/src/a.cpp", "/elsewhere")));
+  EXPECT_TRUE(write_a.conflicts_with(ToolAccess::reading("src/a.cpp", "/repo")));
+  EXPECT_TRUE(write_a.conflicts_with(ToolAccess::reading("src", "/repo")));  // A search of its directory
+  EXPECT_FALSE(write_a.conflicts_with(ToolAccess::writing("src/b.cpp", "/repo")));
+  EXPECT_FALSE(write_a.conflicts_with(ToolAccess::reading("src/a.cpp.orig", "/repo")));
+  EXPECT_FALSE(write_a.conflicts_with(ToolAccess::reading("srcs", "/repo")));
+  EXPECT_FALSE(ToolAccess::reading("/", "/repo").conflicts_with(ToolAccess::reading("src/a.cpp", "/repo")));
+  EXPECT_TRUE(write_a.conflicts_with(ToolAccess::unknown()));
+  EXPECT_TRUE(ToolAccess{}.conflicts_with(ToolAccess::unknown()));
+  EXPECT_FALSE(ToolAccess{}.conflicts_with(write_a));
+}
+
+TEST(ToolAccessTest, BuiltinsDeclareTheirPaths) {
+  tools::register_builtins();
+  auto& registry = ToolRegistry::instance();
+  ToolContext ctx;
+  ctx.working_dir = "/repo";
+
+  auto edit = registry.get("edit")->access({{"filePath", "src/a.cpp"}, {"oldString", "x"}, {"newString", "y"}}, ctx);
+  auto grep = registry.get("grep")->access({{"pattern", "x"}, {"path", "src"}}, ctx);
+  auto glob = registry.get("glob")->access({{"pattern", "*.md"}, {"path", "docs"}}, ctx);
+  auto read = registry.get("read")->access({{"filePath", "src/a.cpp"}}, ctx);
+  auto bash = registry.get("bash")->access({{"command", "make"}}, ctx);
+
+  EXPECT_TRUE(edit.conflicts_with(grep));
+  EXPECT_TRUE(edit.conflicts_with(read));
+  EXPECT_FALSE(edit.conflicts_with(glob));
+  EXPECT_FALSE(grep.conflicts_with(read));
+  EXPECT_TRUE(bash.opaque);
+  EXPECT_TRUE(bash.conflicts_with(glob));
+}
+
+TEST(ToolCallScheduleTest, ConflictingCallsWaitInOrder) {
+  // edit a, edit a, read b, bash, read a
+  ToolCallSchedule schedule({ToolAccess::writing("a", "/"), ToolAccess::writing("a", "/"), ToolAccess::reading("b", "/"), ToolAccess::unknown(),
+                             ToolAccess::reading("a", "/")});
+  EXPECT_EQ(schedule.dependencies(1), std::vector<size_t>{0});
+  EXPECT_TRUE(schedule.dependencies(2).empty());
+  EXPECT_EQ(schedule.dependencies(3), (std::vector<size_t>{0, 1, 2}));
+  EXPECT_EQ(schedule.dependencies(4), (std::vector<size_t>{0, 1, 3}));
+  EXPECT_EQ(schedule.critical_path(), 4u);
+
+  EXPECT_EQ(schedule.take_ready(), (std::vector<size_t>{0, 2}));
+  EXPECT_TRUE(schedule.take_ready().empty());
+  schedule.finish(2);
+  EXPECT_TRUE(schedule.take_ready().empty());
+  schedule.finish(0);
+  EXPECT_EQ(schedule.take_ready(), std::vector<size_t>{1});
+  schedule.finish(1);
+  EXPECT_EQ(schedule.take_ready(), std::vector<size_t>{3});
+  schedule.finish(3);
+  EXPECT_EQ(schedule.take_ready(), std::vector<size_t>{4});
+  EXPECT_FALSE(schedule.finished());
+  schedule.finish(4);
+  EXPECT_TRUE(schedule.finished());
+  EXPECT_EQ(schedule.max_running(), 2u);
+}
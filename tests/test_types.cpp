@@ -72,6 +72,18 @@ TEST(TokenUsageTest, PlusEquals) {
   EXPECT_EQ(a.total(), 450);
 }
 
+TEST(TokenUsageTest, CacheHitRatio) {
+  TokenUsage usage;
+  EXPECT_EQ(usage.cache_hit_ratio(), 0.0);
+
+  // Anthropic reports uncached, cache-read and cache-written prompt tokens separately
+  usage.input_tokens = 50;
+  usage.cache_read_tokens = 900;
+  usage.cache_write_tokens = 50;
+  usage.output_tokens = 400;
+  EXPECT_DOUBLE_EQ(usage.cache_hit_ratio(), 0.9);
+}
+
 // --- FinishReasonTest ---
 
 TEST(FinishReasonTest, ToString) {
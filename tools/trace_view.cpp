@@ -0,0 +1,23 @@
+// Offline viewer for provider traffic traces (Config::trace_file or AGENT_TRACE_FILE).
+// Prints each request body and its response events, JSON indented, with relative timings.
+//
+// Usage: agent_sdk_trace_view [trace.ndjson]   (reads stdin without a file)
+
+#include <fstream>
+#include <iostream>
+
+#include "llm/trace.hpp"
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+      std::cerr << "Cannot open " << argv[1] << "\n";
+      return 1;
+    }
+    agent::llm::print_trace(file, std::cout);
+  } else {
+    agent::llm::print_trace(std::cin, std::cout);
+  }
+  return 0;
+}
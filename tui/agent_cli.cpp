@@ -11,6 +11,7 @@
 #include <ftxui/screen/color.hpp>
 #include <future>
 #include <iostream>
+#include <spdlog/spdlog.h>
 #include <string>
 #include <thread>
 
@@ -129,6 +130,9 @@ int main(int argc, char* argv[]) {
   // 注册 Qwen OAuth 插件（如果编译时启用）
   plugin::qwen::register_qwen_plugin();
 #endif
+  // TLS 会话缓存持久化，重启后可复用会话（简化握手）
+  net::TlsSessionCache::instance().set_persist_path(config_paths::config_dir() / "tls_sessions.json");
+
   auto store = std::make_shared<JsonMessageStore>(config_paths::config_dir() / "sessions");
   auto session = Session::create(io_ctx, config, AgentType::Build, store);
 
@@ -348,5 +352,8 @@ int main(int argc, char* argv[]) {
   io_ctx.stop();
   if (io_thread.joinable()) io_thread.join();
 
+  auto tls_stats = net::TlsSessionCache::instance().stats();
+  spdlog::info("TLS sessions: {} resumed, {} full handshakes ({} rejected)", tls_stats.hits, tls_stats.misses, tls_stats.rejected);
+
   return 0;
 }
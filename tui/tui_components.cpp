@@ -353,9 +353,14 @@ std::string AgentState::session_id() const {
   return session_id_;
 }
 
-void AgentState::update_tokens(int64_t input, int64_t output) {
+void AgentState::update_tokens(int64_t input, int64_t output, double cache_hit_ratio) {
   input_tokens_.store(input);
   output_tokens_.store(output);
+  cache_hit_ratio_.store(cache_hit_ratio);
+}
+
+double AgentState::cache_hit_ratio() const {
+  return cache_hit_ratio_.load();
 }
 
 int64_t AgentState::input_tokens() const {
@@ -454,6 +459,9 @@ std::optional<int64_t> AgentState::session_duration_ms() const {
 std::string AgentState::status_text() const {
   std::string s = "Model: " + model();
   s += " | Tokens: " + format_tokens(input_tokens()) + "in/" + format_tokens(output_tokens()) + "out";
+  if (cache_hit_ratio() > 0) {
+    s += " | Cache: " + std::to_string(int(cache_hit_ratio() * 100 + 0.5)) + "%";
+  }
 
   // 添加会话耗时
   if (auto duration = session_duration_ms()) {
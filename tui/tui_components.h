@@ -193,9 +193,10 @@ class AgentState {
   void set_session_id(const std::string& id);
   std::string session_id() const;
 
-  void update_tokens(int64_t input, int64_t output);
+  void update_tokens(int64_t input, int64_t output, double cache_hit_ratio = 0.0);
   int64_t input_tokens() const;
   int64_t output_tokens() const;
+  double cache_hit_ratio() const;  // 提示词缓存命中率 0.0~1.0
 
   void update_context(int64_t used, int64_t limit);
   int64_t context_used() const;
@@ -221,6 +222,7 @@ class AgentState {
   std::atomic<bool> running_{false};
   std::atomic<int64_t> input_tokens_{0};
   std::atomic<int64_t> output_tokens_{0};
+  std::atomic<double> cache_hit_ratio_{0.0};
   std::atomic<int64_t> context_used_{0};
   std::atomic<int64_t> context_limit_{128000};  // 默认 128k
   std::atomic<int> mode_{static_cast<int>(AgentMode::Build)};
@@ -250,7 +250,7 @@ void handle_submit(AppState& state, AppContext& ctx, ScreenInteractive& screen)
   std::thread([&session, &state, user_msg, refresh_fn]() {
     session->prompt(user_msg);
     auto usage = session->total_usage();
-    state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens);
+    state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens, usage.cache_hit_ratio());
     state.agent_state.update_context(session->estimated_context_tokens(), session->context_window());
     state.agent_state.set_running(false);
     // 不在这里暂停计时器，让它在 on_complete 回调中暂停
@@ -312,7 +312,7 @@ void handle_sessions_command(AppState& state, AppContext& ctx, const std::string
         state.agent_state.set_session_id(ctx.session->id());
         setup_tui_callbacks(state, ctx);
         auto usage = ctx.session->total_usage();
-        state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens);
+        state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens, usage.cache_hit_ratio());
         state.agent_state.update_context(ctx.session->estimated_context_tokens(), ctx.session->context_window());
         state.clear_all();
         std::string title = meta.title.empty() ? "(untitled)" : meta.title;
@@ -379,7 +379,7 @@ bool handle_sessions_panel_event(AppState& state, AppContext& ctx, Event event)
         state.agent_state.set_session_id(ctx.session->id());
         setup_tui_callbacks(state, ctx);
         auto usage = ctx.session->total_usage();
-        state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens);
+        state.agent_state.update_tokens(usage.input_tokens, usage.output_tokens, usage.cache_hit_ratio());
         state.agent_state.update_context(ctx.session->estimated_context_tokens(), ctx.session->context_window());
         state.clear_all();
         std::string title = meta.title.empty() ? "(untitled)" : meta.title;
@@ -429,6 +429,12 @@ Element build_status_bar(const AppState& state) {
     context_color = Color::Yellow;
   }
 
+  // 提示词缓存命中率（有缓存读取时才显示）
+  std::string cache_str;
+  if (double cache_ratio = state.agent_state.cache_hit_ratio(); cache_ratio > 0) {
+    cache_str = " cache:" + std::to_string(static_cast<int>(cache_ratio * 100 + 0.5)) + "%";
+  }
+
   std::string session_time;
   if (auto duration = state.agent_state.session_duration_ms()) {
     session_time = "⏱" + format_duration_ms(*duration) + " ";
@@ -439,7 +445,7 @@ Element build_status_bar(const AppState& state) {
       text(" "),
       text(state.agent_state.model()) | dim,
       filler(),
-      text(format_tokens(state.agent_state.input_tokens()) + "↑ " + format_tokens(state.agent_state.output_tokens()) + "↓") | dim,
+      text(format_tokens(state.agent_state.input_tokens()) + "↑ " + format_tokens(state.agent_state.output_tokens()) + "↓" + cache_str) | dim,
       text("  "),
       text("ctx:" + context_str) | color(context_color),
       text("  "),